@@ -0,0 +1,66 @@
+// Audit overhead benchmark. Measures the cost of queueing one record on the
+// shell thread, then the per-command latency of running `true` through the
+// shell with auditing off and on (median of interleaved runs).
+//
+// Build and run from the repository root:
+//   g++ -O2 -o audit_bench bench/audit_bench.cpp src/secshell_core.cpp src/shell_*.cpp -lreadline -pthread
+//   ./audit_bench [commands] [records]
+#include "../src/secshell.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+static double median(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+static double per_record_ns(const std::string& path, int records) {
+    AuditLog log;
+    if (!log.open(path, 0)) {
+        fprintf(stderr, "cannot open %s: %s\n", path.c_str(), strerror(errno));
+        exit(1);
+    }
+    std::vector<std::string> argv = {"tcpdump", "-i", "eth0", "-nn", "port", "443"};
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < records; ++i) {
+        log.execution(1234, 0, 1500, 900, argv);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / records;
+    uint64_t stalls = log.producer_stalls();
+    log.close();
+    printf("queue one record: %.0f ns (%llu records in %llu batches, %llu producer stalls)\n", ns,
+           static_cast<unsigned long long>(log.records_written()), static_cast<unsigned long long>(log.batches_written()),
+           static_cast<unsigned long long>(stalls));
+    return ns;
+}
+
+int main(int argc, char* argv[]) {
+    int commands = argc > 1 ? atoi(argv[1]) : 500;
+    int records = argc > 2 ? atoi(argv[2]) : 1000000;
+    std::string path = "/tmp/secshell_audit_bench." + std::to_string(getpid());
+
+    per_record_ns(path, records);
+    unlink(path.c_str());
+
+    unsetenv("SECSHELL_AUDIT_LOG");
+    SecShell plain("/dev/null", false);
+    setenv("SECSHELL_AUDIT_LOG", path.c_str(), 1);
+    SecShell audited("/dev/null", false);
+
+    std::vector<double> off, on;
+    for (int i = 0; i < commands; ++i) {
+        for (SecShell* shell : {&plain, &audited}) {
+            auto start = std::chrono::steady_clock::now();
+            shell->run_command("true");
+            double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            (shell == &plain ? off : on).push_back(us);
+        }
+    }
+    double base = median(off), with_audit = median(on);
+    printf("run `true`, audit off: %.1f us median\n", base);
+    printf("run `true`, audit on:  %.1f us median (%+.1f%%)\n", with_audit, (with_audit - base) / base * 100);
+    unlink(path.c_str());
+    return 0;
+}
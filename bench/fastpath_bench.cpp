@@ -0,0 +1,149 @@
+// In-process fast path benchmark: FastPath's ls and cat against exec'ing
+// /bin/ls and /bin/cat, on small and large directories and files.
+// Output goes into a pipe drained by a reader thread, as it would in a
+// pipeline; the fast path only runs when stdout is not a terminal here,
+// so colour and column layout are not exercised.
+//
+// Build and run from the repository root:
+//   g++ -O2 -o fastpath_bench bench/fastpath_bench.cpp src/secshell_core.cpp src/shell_*.cpp -lreadline -pthread
+//   ./fastpath_bench [files] [file_mb] [iterations]
+#include "../src/secshell.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+// Reads the pipe until EOF and counts what arrived
+struct Drain {
+    int read_fd = -1, write_fd = -1;
+    size_t bytes = 0;
+    std::thread reader;
+
+    Drain() {
+        int fds[2];
+        if (pipe2(fds, O_CLOEXEC) != 0) {
+            perror("pipe2");
+            exit(1);
+        }
+        read_fd = fds[0];
+        write_fd = fds[1];
+        fcntl(write_fd, F_SETPIPE_SZ, 1 << 20);
+        reader = std::thread([this] {
+            static char buffer[1 << 16];
+            ssize_t n;
+            while ((n = read(read_fd, buffer, sizeof(buffer))) > 0) bytes += n;
+        });
+    }
+
+    size_t finish() {
+        close(write_fd);
+        reader.join();
+        close(read_fd);
+        return bytes;
+    }
+};
+
+static double fast_once(FastPath& fast, const std::vector<std::string>& args, size_t& bytes) {
+    Drain drain;
+    auto start = std::chrono::steady_clock::now();
+    int status = fast.run(args, STDIN_FILENO, drain.write_fd, STDERR_FILENO);
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    bytes = drain.finish();
+    if (status != 0) {
+        fprintf(stderr, "fast path %s returned %d\n", args[0].c_str(), status);
+        exit(1);
+    }
+    return us;
+}
+
+static double exec_once(const std::string& path, const std::vector<std::string>& args, size_t& bytes) {
+    Drain drain;
+    auto start = std::chrono::steady_clock::now();
+    Spawner spawner;
+    spawner.redirect(drain.write_fd, STDOUT_FILENO);
+    pid_t pid;
+    int status = -1;
+    if (spawner.spawn(path, args, pid) == 0) waitpid(pid, &status, 0);
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    bytes = drain.finish();
+    if (status != 0) {
+        fprintf(stderr, "%s exited with %d\n", path.c_str(), status);
+        exit(1);
+    }
+    return us;
+}
+
+static double median(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+int main(int argc, char* argv[]) {
+    int files = argc > 1 ? atoi(argv[1]) : 20000;
+    int file_mb = argc > 2 ? atoi(argv[2]) : 256;
+    int iterations = argc > 3 ? atoi(argv[3]) : 20;
+
+    char dir_template[] = "/tmp/fastpath_bench.XXXXXX";
+    if (!mkdtemp(dir_template)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::string dir = dir_template;
+    auto make_listing = [&dir](const std::string& name, int count) {
+        std::string path = dir + "/" + name;
+        mkdir(path.c_str(), 0755);
+        for (int i = 0; i < count; ++i) {
+            std::string file = path + "/file_" + std::to_string(i) + (i % 7 == 0 ? ".log" : "");
+            int fd = open(file.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+            if (fd != -1) close(fd);
+        }
+        return path;
+    };
+    auto make_file = [&dir](const std::string& name, size_t bytes) {
+        std::string path = dir + "/" + name;
+        std::string block(1 << 20, 'x');
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        for (size_t written = 0; written < bytes; written += block.size()) {
+            BoxRenderer::write_all(fd, block.substr(0, std::min(block.size(), bytes - written)));
+        }
+        close(fd);
+        return path;
+    };
+    std::string small_listing = make_listing("small", 30);
+    std::string listing = make_listing("listing", files);
+    std::string small = make_file("small_file", 4096);
+    std::string large = make_file("large_file", static_cast<size_t>(file_mb) << 20);
+
+    struct Case {
+        const char* label;
+        std::string path;
+        std::vector<std::string> args;
+    };
+    std::vector<Case> cases = {
+        {"ls small", "/bin/ls", {"ls", small_listing}},
+        {"ls -la small", "/bin/ls", {"ls", "-la", small_listing}},
+        {"ls", "/bin/ls", {"ls", listing}},
+        {"ls -la", "/bin/ls", {"ls", "-la", listing}},
+        {"cat small", "/bin/cat", {"cat", small}},
+        {"cat large", "/bin/cat", {"cat", large}},
+    };
+
+    FastPath fast;
+    printf("%-14s %10s %14s %14s %9s\n", "command", "bytes", "exec_us", "fast_us", "speedup");
+    for (const auto& c : cases) {
+        std::vector<double> exec_samples, fast_samples;
+        size_t exec_bytes = 0, fast_bytes = 0;
+        for (int i = 0; i < iterations; ++i) {
+            exec_samples.push_back(exec_once(c.path, c.args, exec_bytes));
+            fast_samples.push_back(fast_once(fast, c.args, fast_bytes));
+        }
+        if (exec_bytes != fast_bytes) {
+            fprintf(stderr, "%s: output differs (%zu vs %zu bytes)\n", c.label, exec_bytes, fast_bytes);
+        }
+        double exec_us = median(exec_samples), fast_us = median(fast_samples);
+        printf("%-14s %10zu %14.1f %14.1f %8.2fx\n", c.label, fast_bytes, exec_us, fast_us, exec_us / fast_us);
+    }
+
+    std::string cleanup = "rm -rf " + dir;
+    return system(cleanup.c_str()) == 0 ? 0 : 1;
+}
@@ -0,0 +1,149 @@
+// Glob expansion: GlobExpander (cold and with its listing cache warm, one
+// thread and the pool) against glibc glob(3) and a `find` child process,
+// on one flat directory with many files and on a tree for **.
+//
+// Build and run from the repository root:
+//   g++ -O2 -o glob_bench bench/glob_bench.cpp src/secshell_core.cpp src/shell_*.cpp -lreadline -pthread
+//   ./glob_bench [files] [iterations]
+#include "../src/secshell.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include <glob.h>
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double median(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+static size_t run_glob(const std::string& pattern) {
+    glob_t result;
+    int rc = glob(pattern.c_str(), 0, nullptr, &result);
+    size_t count = rc == 0 ? result.gl_pathc : 0;
+    globfree(&result);
+    return count;
+}
+
+// Spawns find and counts the lines it prints
+static size_t run_find(const std::vector<std::string>& args) {
+    int pipe_fds[2];
+    if (pipe2(pipe_fds, O_CLOEXEC) != 0) return 0;
+    Spawner spawner;
+    spawner.redirect(pipe_fds[1], STDOUT_FILENO);
+    pid_t pid;
+    int rc = spawner.spawn("/usr/bin/find", args, pid);
+    close(pipe_fds[1]);
+    size_t lines = 0;
+    char buffer[65536];
+    ssize_t n;
+    while (rc == 0 && (n = read(pipe_fds[0], buffer, sizeof(buffer))) > 0) lines += std::count(buffer, buffer + n, '\n');
+    close(pipe_fds[0]);
+    if (rc == 0) waitpid(pid, nullptr, 0);
+    return lines;
+}
+
+static void touch(const std::string& path) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        perror(path.c_str());
+        exit(1);
+    }
+    close(fd);
+}
+
+int main(int argc, char* argv[]) {
+    size_t files = argc > 1 ? strtoull(argv[1], nullptr, 10) : 200000;
+    int iterations = argc > 2 ? atoi(argv[2]) : 9;
+
+    char dir_template[] = "/tmp/glob_bench.XXXXXX";
+    if (!mkdtemp(dir_template)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::string dir = dir_template;
+    // Flat: one log directory, a tenth of it .gz
+    std::string flat = dir + "/flat";
+    mkdir(flat.c_str(), 0755);
+    for (size_t i = 0; i < files; ++i) touch(flat + "/app-" + std::to_string(i) + (i % 10 ? ".log" : ".gz"));
+    // Tree: 64 hosts x 16 days, files spread across them
+    std::string tree = dir + "/tree";
+    mkdir(tree.c_str(), 0755);
+    for (int host = 0; host < 64; ++host) {
+        std::string host_dir = tree + "/host" + std::to_string(host);
+        mkdir(host_dir.c_str(), 0755);
+        for (int day = 0; day < 16; ++day) {
+            std::string day_dir = host_dir + "/day" + std::to_string(day);
+            mkdir(day_dir.c_str(), 0755);
+            for (size_t i = 0; i < files / 1024; ++i) touch(day_dir + "/" + std::to_string(i) + (i % 10 ? ".log" : ".gz"));
+        }
+    }
+    // Older than the two second window in which listings are not trusted
+    sleep(2);
+
+    struct Case {
+        const char* label;
+        std::string pattern;
+        std::vector<std::string> find_args;
+    };
+    std::vector<Case> cases = {
+        {"flat *.gz", flat + "/*.gz", {"find", flat, "-maxdepth", "1", "-name", "*.gz"}},
+        {"tree */*/*.gz", tree + "/*/*/*.gz", {"find", tree, "-mindepth", "3", "-maxdepth", "3", "-name", "*.gz"}},
+        {"tree **/*.gz", tree + "/**/*.gz", {"find", tree, "-name", "*.gz"}},
+    };
+
+    unsigned threads = std::max(2u, std::min(8u, std::thread::hardware_concurrency()));
+    printf("%-16s %8s %11s %11s %11s %11s %11s\n", "pattern", "matches", "cold_ms", "cached_ms",
+           ("pool" + std::to_string(threads) + "_ms").c_str(), "glob3_ms", "find_ms");
+    for (const auto& c : cases) {
+        std::vector<double> cold, cached, pooled, libc, find;
+        size_t matches = 0;
+        for (int i = 0; i < iterations; ++i) {
+            std::vector<std::string> out;
+            GlobExpander fresh;
+            fresh.threads = 1;
+            fresh.max_results = SIZE_MAX;
+            fresh.max_bytes = SIZE_MAX;
+            auto start = std::chrono::steady_clock::now();
+            fresh.expand(c.pattern, "/", out);
+            cold.push_back(elapsed_ms(start));
+            matches = out.size();
+
+            out.clear();
+            start = std::chrono::steady_clock::now();
+            fresh.expand(c.pattern, "/", out);
+            cached.push_back(elapsed_ms(start));
+
+            out.clear();
+            fresh.threads = threads;
+            start = std::chrono::steady_clock::now();
+            fresh.expand(c.pattern, "/", out);
+            pooled.push_back(elapsed_ms(start));
+
+            // glob(3) has no ** (GLOB_STAR is not in glibc), so it only gets the fixed-depth cases
+            start = std::chrono::steady_clock::now();
+            size_t libc_matches = c.pattern.find("**") == std::string::npos ? run_glob(c.pattern) : 0;
+            libc.push_back(libc_matches ? elapsed_ms(start) : 0);
+
+            start = std::chrono::steady_clock::now();
+            size_t find_matches = run_find(c.find_args);
+            find.push_back(elapsed_ms(start));
+            if (find_matches != matches || (libc_matches && libc_matches != matches)) {
+                fprintf(stderr, "%s: %zu matches, glob(3) %zu, find %zu\n", c.label, matches, libc_matches, find_matches);
+                return 1;
+            }
+        }
+        char libc_ms[32] = "-";
+        if (median(libc) > 0) snprintf(libc_ms, sizeof(libc_ms), "%.2f", median(libc));
+        printf("%-16s %8zu %11.2f %11.2f %11.2f %11s %11.2f\n", c.label, matches, median(cold), median(cached),
+               median(pooled), libc_ms, median(find));
+    }
+
+    std::string cleanup = "rm -rf " + dir;
+    return system(cleanup.c_str()) == 0 ? 0 : 1;
+}
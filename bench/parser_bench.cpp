@@ -0,0 +1,117 @@
+// Parser micro-benchmark: the arena-backed CommandParser versus the previous
+// find('|') split plus character-at-a-time parse_arguments, over a corpus of
+// typical command lines.
+//
+// Build and run from the repository root:
+//   g++ -O2 -o parser_bench bench/parser_bench.cpp src/secshell_core.cpp src/shell_*.cpp -lreadline -pthread
+//   ./parser_bench [iterations]
+#include "../src/secshell.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+static const std::vector<std::string> CORPUS = {
+    "ls",
+    "ls -la /var/log",
+    "ps aux | grep sshd | wc -l",
+    "tcpdump -i eth0 -nn port 443 > /tmp/capture.txt &",
+    "cat < /etc/hosts | sort | uniq -c | sort -rn | head -20",
+    "grep -r \"Failed password\" /var/log/auth.log >> /tmp/failures.txt",
+    "echo $HOME $USER 'literal $HOME' \"quoted $PATH\"",
+    "netstat -tulpn | grep LISTEN | awk '{print $4}' | sort",
+};
+
+// The splitter this parser replaced, kept here as the baseline.
+static std::vector<std::string> legacy_parse_arguments(const std::string& input) {
+    std::vector<std::string> args;
+    std::string arg;
+    bool in_quotes = false;
+    char quote_char = '\0';
+    bool escape = false;
+    for (size_t i = 0; i < input.length(); ++i) {
+        char c = input[i];
+        if (escape) {
+            arg += c;
+            escape = false;
+            continue;
+        }
+        if (c == '\\') {
+            escape = true;
+            continue;
+        }
+        if (c == '"' || c == '\'') {
+            if (in_quotes && c == quote_char) {
+                in_quotes = false;
+                quote_char = '\0';
+            } else if (!in_quotes) {
+                in_quotes = true;
+                quote_char = c;
+            } else {
+                arg += c;
+            }
+        } else if (c == '$' && !in_quotes) {
+            std::string var_name;
+            while (i + 1 < input.length() && (isalnum(input[i + 1]) || input[i + 1] == '_')) {
+                var_name += input[++i];
+            }
+            const char* var_value = getenv(var_name.c_str());
+            if (var_value) arg += var_value;
+        } else if (c == ' ' && !in_quotes) {
+            if (!arg.empty()) {
+                args.push_back(arg);
+                arg.clear();
+            }
+        } else {
+            arg += c;
+        }
+    }
+    if (!arg.empty()) args.push_back(arg);
+    return args;
+}
+
+static size_t legacy_parse(const std::string& input) {
+    std::vector<std::vector<std::string>> commands;
+    size_t pos = 0;
+    while (pos < input.length()) {
+        size_t pipe_pos = input.find('|', pos);
+        std::vector<std::string> args = legacy_parse_arguments(input.substr(pos, pipe_pos - pos));
+        if (!args.empty()) commands.push_back(args);
+        if (pipe_pos == std::string::npos) break;
+        pos = pipe_pos + 1;
+    }
+    return commands.size();
+}
+
+template <typename F>
+static double ns_per_line(int iterations, F&& parse) {
+    size_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        for (const auto& line : CORPUS) sink += parse(line);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    if (sink == 42) printf(" "); // Keep the work observable
+    return ns / (static_cast<double>(iterations) * CORPUS.size());
+}
+
+int main(int argc, char* argv[]) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 200000;
+
+    double legacy = ns_per_line(iterations, legacy_parse);
+
+    Arena arena;
+    CommandParser parser(arena);
+    std::string error;
+    double arena_parser = ns_per_line(iterations, [&](const std::string& line) {
+        arena.reset();
+        const PipelineNode* pipeline = parser.parse(line, error);
+        return pipeline ? pipeline->length : 0;
+    });
+
+    printf("%-28s %10s\n", "parser", "ns/line");
+    printf("%-28s %10.1f\n", "legacy split+parse_arguments", legacy);
+    printf("%-28s %10.1f\n", "CommandParser (arena)", arena_parser);
+    printf("speedup: %.2fx\n", legacy / arena_parser);
+    return 0;
+}
@@ -0,0 +1,48 @@
+// Pipeline throughput benchmark: pushes a stream from /dev/zero through 2-,
+// 4- and 8-stage pipelines run by SecShell's pipeline executor, with the
+// kernel's default pipe size and with pipes raised via F_SETPIPE_SZ.
+//
+// Build and run from the repository root:
+//   g++ -O2 -o pipeline_bench bench/pipeline_bench.cpp src/secshell_core.cpp src/shell_*.cpp -lreadline -pthread
+//   ./pipeline_bench [gigabytes] [pipe_size_bytes]
+#include "../src/secshell.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+static double run_pipeline(size_t bytes, int stages, int pipe_size) {
+    setenv("SECSHELL_PIPE_SIZE", std::to_string(pipe_size).c_str(), 1);
+    SecShell shell("/dev/null", false);
+
+    std::string command = "head -c " + std::to_string(bytes) + " /dev/zero";
+    for (int i = 0; i < stages - 2; ++i) {
+        command += " | cat";
+    }
+    command += " | wc -c > /dev/null";
+
+    auto start = std::chrono::steady_clock::now();
+    int status = shell.run_command(command);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (status != 0) {
+        fprintf(stderr, "pipeline failed with status %d: %s\n", status, command.c_str());
+        exit(1);
+    }
+    return seconds;
+}
+
+int main(int argc, char* argv[]) {
+    double gigabytes = argc > 1 ? atof(argv[1]) : 4.0;
+    int large_pipe = argc > 2 ? atoi(argv[2]) : 1 << 20;
+    size_t bytes = static_cast<size_t>(gigabytes * (1ULL << 30));
+
+    printf("%8s %14s %12s %10s\n", "stages", "pipe_size", "seconds", "GiB/s");
+    for (int stages : {2, 4, 8}) {
+        for (int pipe_size : {0, large_pipe}) {
+            double seconds = run_pipeline(bytes, stages, pipe_size);
+            printf("%8d %14s %12.3f %10.2f\n", stages, pipe_size ? std::to_string(pipe_size).c_str() : "default",
+                   seconds, gigabytes / seconds);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,289 @@
+// Session recording overhead: high-volume terminal output (tcpdump-style
+// packet lines) written straight to a pty, through PtyRelay without
+// recording, through PtyRelay recording with each codec, and through
+// script(1) when it is installed. Reports throughput and the CPU spent on
+// the terminal side of the pty (the reader for a direct pty, the relay
+// with its writer thread otherwise), then the keystroke echo round trip
+// through a direct pty and through the relay.
+//
+// Build and run from the repository root:
+//   g++ -O2 -o record_bench bench/record_bench.cpp src/secshell_core.cpp src/shell_*.cpp -lreadline -pthread
+//   ./record_bench [megabytes] [round trips]
+#include "../src/pty_relay.h"
+#include "../src/secshell.h"
+#include "../src/session_recording.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/resource.h>
+
+static std::string make_lines() {
+    std::string lines;
+    char line[160];
+    for (int i = 0; lines.size() < (1 << 20); ++i) {
+        snprintf(line, sizeof(line),
+                 "12:%02d:%02d.%06d IP 10.0.%d.%d.%d > 192.168.1.%d.443: Flags [P.], seq %d:%d, ack %d, win 501, length %d\n",
+                 i / 60000 % 60, i / 1000 % 60, i * 37 % 1000000, i % 4, i % 250, 30000 + i % 30000, i % 200,
+                 i * 1448, i * 1448 + 1448, i * 517, 1448);
+        lines += line;
+    }
+    return lines;
+}
+
+// The session's side: bytes of packet lines to stdout, in 4 KiB writes
+[[noreturn]] static void generate(size_t bytes) {
+    static const std::string lines = make_lines();
+    size_t offset = 0;
+    while (bytes > 0) {
+        size_t n = std::min<size_t>({4096, bytes, lines.size() - offset});
+        if (write(STDOUT_FILENO, lines.data() + offset, n) != static_cast<ssize_t>(n)) _exit(1);
+        bytes -= n;
+        offset = (offset + n) % lines.size();
+    }
+    _exit(0);
+}
+
+// Echoes keystrokes in raw mode until 'q'
+[[noreturn]] static void echo_loop() {
+    struct termios raw;
+    if (tcgetattr(STDIN_FILENO, &raw) == 0) {
+        cfmakeraw(&raw);
+        tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+    }
+    char c;
+    while (read(STDIN_FILENO, &c, 1) == 1 && c != 'q') {
+        if (write(STDOUT_FILENO, &c, 1) != 1) break;
+    }
+    _exit(0);
+}
+
+static double cpu_us(const struct rusage& usage) {
+    return usage.ru_utime.tv_sec * 1e6 + usage.ru_utime.tv_usec + usage.ru_stime.tv_sec * 1e6 + usage.ru_stime.tv_usec;
+}
+
+static double elapsed_us(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct Result {
+    double wall_us = 0;
+    double cpu_us = 0;
+    uint64_t file_bytes = 0;
+};
+
+static int open_pty(std::string& slave) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (master == -1 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("posix_openpt");
+        exit(1);
+    }
+    slave = ptsname(master);
+    return master;
+}
+
+// Forks child() onto a new pty as its controlling terminal
+static pid_t fork_on_pty(const std::string& slave, void (*child)(size_t), size_t arg) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        setsid();
+        int fd = open(slave.c_str(), O_RDWR);
+        for (int target : {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO}) dup2(fd, target);
+        child(arg);
+    }
+    return pid;
+}
+
+// The generator on a pty read by this process, output discarded
+static Result direct_output(size_t bytes) {
+    std::string slave;
+    int master = open_pty(slave);
+    struct rusage before, after;
+    getrusage(RUSAGE_SELF, &before);
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork_on_pty(slave, [](size_t n) { generate(n); }, bytes);
+    static char buffer[65536];
+    while (read(master, buffer, sizeof(buffer)) > 0) {}
+    waitpid(pid, nullptr, 0);
+    Result result;
+    result.wall_us = elapsed_us(start);
+    getrusage(RUSAGE_SELF, &after);
+    result.cpu_us = cpu_us(after) - cpu_us(before);
+    close(master);
+    return result;
+}
+
+// The generator behind PtyRelay in this process, relaying to /dev/null;
+// recording to path unless it is empty
+static Result relay_output(size_t bytes, const std::string& path, RecordingCodec::Kind codec) {
+    int null_fd = open("/dev/null", O_RDWR | O_CLOEXEC);
+    SessionRecorder recorder;
+    if (!path.empty() && !recorder.open(path, 80, 24, codec)) {
+        perror(path.c_str());
+        exit(1);
+    }
+    PtyRelay relay;
+    PtyRelay::Options options;
+    options.input_fd = null_fd;
+    options.output_fd = null_fd;
+    struct rusage before, after;
+    getrusage(RUSAGE_SELF, &before);
+    auto start = std::chrono::steady_clock::now();
+    int status;
+    if (relay.fork_session(recorder, options, status)) generate(bytes);
+    Result result;
+    result.wall_us = elapsed_us(start);
+    getrusage(RUSAGE_SELF, &after);
+    result.cpu_us = cpu_us(after) - cpu_us(before);
+    result.file_bytes = recorder.file_bytes();
+    close(null_fd);
+    if (status != 0 || relay.output_bytes() < bytes) {
+        fprintf(stderr, "relay: status %d, %llu bytes\n", status, static_cast<unsigned long long>(relay.output_bytes()));
+        exit(1);
+    }
+    return result;
+}
+
+// script(1) running this binary as the generator. Its CPU comes from the
+// children's usage, less generator_us for the generator itself.
+static Result script_output(const std::string& self, size_t bytes, const std::string& path, double generator_us) {
+    std::string command = self + " --generate " + std::to_string(bytes);
+    int null_fd = open("/dev/null", O_RDWR | O_CLOEXEC);
+    struct rusage before, after;
+    getrusage(RUSAGE_CHILDREN, &before);
+    auto start = std::chrono::steady_clock::now();
+    Spawner spawner;
+    for (int fd : {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO}) spawner.redirect(null_fd, fd);
+    pid_t pid;
+    int status = -1;
+    if (spawner.spawn("/usr/bin/script", {"script", "-q", "-c", command, path}, pid) == 0) waitpid(pid, &status, 0);
+    Result result;
+    result.wall_us = elapsed_us(start);
+    getrusage(RUSAGE_CHILDREN, &after);
+    result.cpu_us = cpu_us(after) - cpu_us(before) - generator_us;
+    close(null_fd);
+    struct stat st;
+    if (status != 0 || stat(path.c_str(), &st) != 0) {
+        fprintf(stderr, "script exited with %d\n", status);
+        exit(1);
+    }
+    result.file_bytes = st.st_size;
+    return result;
+}
+
+// Median microseconds to see one byte written to input come back on output
+static double round_trip(int input, int output, int trips) {
+    std::vector<double> samples;
+    char c = 'x', back;
+    struct pollfd ready = {output, POLLIN, 0};
+    for (int i = 0; i < trips; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        if (write(input, &c, 1) != 1 || poll(&ready, 1, 5000) != 1 || read(output, &back, 1) != 1) {
+            fprintf(stderr, "no echo\n");
+            exit(1);
+        }
+        samples.push_back(elapsed_us(start));
+    }
+    if (write(input, "q", 1) != 1) perror("write");
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+static double direct_latency(int trips) {
+    std::string slave;
+    int master = open_pty(slave);
+    pid_t pid = fork_on_pty(slave, [](size_t) { echo_loop(); }, 0);
+    // Wait until the echo loop has set raw mode, so nothing is echoed twice
+    struct termios mode;
+    for (int tries = 0; tries < 500 && tcgetattr(master, &mode) == 0 && (mode.c_lflag & ECHO); ++tries) usleep(1000);
+    double us = round_trip(master, master, trips);
+    waitpid(pid, nullptr, 0);
+    close(master);
+    return us;
+}
+
+// The relay runs in a process of its own between two pipes and this one
+static double relay_latency(int trips, const std::string& path) {
+    int input[2], output[2];
+    if (pipe2(input, O_CLOEXEC) != 0 || pipe2(output, O_CLOEXEC) != 0) {
+        perror("pipe");
+        exit(1);
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        SessionRecorder recorder;
+        if (!path.empty() && !recorder.open(path, 80, 24)) _exit(1);
+        PtyRelay relay;
+        PtyRelay::Options options;
+        options.input_fd = input[0];
+        options.output_fd = output[1];
+        int status;
+        if (relay.fork_session(recorder, options, status)) echo_loop();
+        _exit(status == 0 ? 0 : 1);
+    }
+    close(input[0]);
+    close(output[1]);
+    usleep(100000); // Let the session reach raw mode
+    double us = round_trip(input[1], output[0], trips);
+    int status;
+    waitpid(pid, &status, 0);
+    close(input[1]);
+    close(output[0]);
+    return us;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc == 3 && std::string(argv[1]) == "--generate") generate(strtoull(argv[2], nullptr, 10));
+    size_t megabytes = argc > 1 ? strtoul(argv[1], nullptr, 10) : 128;
+    int trips = argc > 2 ? atoi(argv[2]) : 2000;
+    size_t bytes = megabytes << 20;
+
+    char dir_template[] = "/tmp/record_bench.XXXXXX";
+    if (!mkdtemp(dir_template)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::string dir = dir_template;
+    char self[PATH_MAX];
+    ssize_t self_length = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    self[self_length > 0 ? self_length : 0] = '\0';
+
+    // The generator's own CPU, for taking out of script(1)'s
+    struct rusage before, after;
+    getrusage(RUSAGE_CHILDREN, &before);
+    Result direct = direct_output(bytes);
+    getrusage(RUSAGE_CHILDREN, &after);
+    double generator_us = cpu_us(after) - cpu_us(before);
+
+    printf("%zu MiB of packet lines\n", megabytes);
+    printf("%-22s %10s %14s %12s %8s\n", "output path", "MB/s", "cpu_us/MB", "file_bytes", "ratio");
+    auto report = [&](const char* label, const Result& result) {
+        double mb = bytes / 1e6;
+        printf("%-22s %10.1f %14.1f %12llu", label, mb / (result.wall_us / 1e6), result.cpu_us / mb,
+               static_cast<unsigned long long>(result.file_bytes));
+        if (result.file_bytes) {
+            printf(" %7.1fx\n", static_cast<double>(bytes) / result.file_bytes);
+        } else {
+            printf(" %8s\n", "-");
+        }
+    };
+    report("direct pty", direct);
+    report("relay", relay_output(bytes, "", RecordingCodec::Stored));
+    report("relay + record stored", relay_output(bytes, dir + "/stored.rec", RecordingCodec::Stored));
+    report("relay + record lz4", relay_output(bytes, dir + "/lz4.rec", RecordingCodec::Lz4));
+    if (RecordingCodec::available(RecordingCodec::Zstd)) {
+        report("relay + record zstd", relay_output(bytes, dir + "/zstd.rec", RecordingCodec::Zstd));
+    }
+    if (access("/usr/bin/script", X_OK) == 0) {
+        report("script(1)", script_output(self, bytes, dir + "/typescript", generator_us));
+    }
+
+    printf("\n%-22s %14s\n", "echo path", "round_trip_us");
+    printf("%-22s %14.1f\n", "direct pty", direct_latency(trips));
+    printf("%-22s %14.1f\n", "relay", relay_latency(trips, ""));
+    printf("%-22s %14.1f\n", "relay + record", relay_latency(trips, dir + "/echo.rec"));
+
+    std::string cleanup = "rm -rf " + dir;
+    return system(cleanup.c_str()) == 0 ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+// Policy rule check cost against the number of rules: PolicyRules, which
+// compiles every pattern into one PatternSet, versus evaluating the rules
+// one by one (fnmatch for globs, std::regex for regexes). The rule sets mix
+// literal, glob and regex patterns; the commands checked are typical ones
+// that no rule denies plus a few that one does.
+//
+// Build and run from the repository root:
+//   g++ -O2 -o rules_bench bench/rules_bench.cpp src/secshell_core.cpp src/shell_*.cpp -lreadline -pthread
+//   ./rules_bench [iterations]
+#include "../src/secshell.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <regex>
+
+#include <fnmatch.h>
+
+using Clock = std::chrono::steady_clock;
+
+struct Command {
+    std::vector<std::string> args;
+    std::vector<std::string> redirects;
+};
+
+static const std::vector<Command> COMMANDS = {
+    {{"ls", "-la", "/var/log"}, {}},
+    {{"ps", "aux"}, {}},
+    {{"tcpdump", "-i", "eth0", "-nn", "port", "443"}, {"/tmp/capture.txt"}},
+    {{"grep", "-r", "Failed password", "/var/log/auth.log"}, {"/tmp/failures.txt"}},
+    {{"netstat", "-tulpn"}, {}},
+    {{"cat", "/etc/hosts"}, {}},
+    {{"apt", "remove", "nginx"}, {}},                        // Rule 0, a literal
+    {{"tool6", "--token-6=123"}, {}},                        // Rule 6, a regex
+    {{"cat", "/srv/app5/keys/server.key"}, {}},              // Rule 5, a glob
+};
+
+// n rules: 60% literal, 20% glob, 20% regex
+static std::string make_rules(size_t n) {
+    std::string text = "deny apt arg:remove\n";
+    for (size_t i = 1; i < n; ++i) {
+        std::string k = std::to_string(i);
+        switch (i % 5) {
+            case 0: text += "deny * path:/srv/app" + k + "/keys/*.key\n"; break;
+            case 1: text += "deny tool" + k + " arg:/^--token-" + k + "=[0-9]+$/\n"; break;
+            case 2: text += "deny cmd" + k + " arg:--opt-" + k + "\n"; break;
+            case 3: text += "deny * arg:--unsafe-" + k + "*\n"; break;
+            default: text += "deny cmd" + k + " redirect:/var/lib/data" + k + "\n"; break;
+        }
+    }
+    return text;
+}
+
+// One rule at a time, as a straightforward implementation would check them
+class LinearRules {
+public:
+    explicit LinearRules(const PolicyRules& compiled) {
+        for (const auto& rule : compiled.rules()) {
+            std::istringstream words(rule.text);
+            std::string word;
+            words >> word; // deny
+            Entry entry;
+            words >> entry.command;
+            while (words >> word) {
+                size_t colon = word.find(':');
+                Term term{word.substr(0, colon), word.substr(colon + 1), {}};
+                if (term.pattern.size() >= 2 && term.pattern.front() == '/' && term.pattern.back() == '/') {
+                    term.regex = std::regex(term.pattern.substr(1, term.pattern.size() - 2), std::regex::extended);
+                    term.is_regex = true;
+                }
+                entry.terms.push_back(std::move(term));
+            }
+            entries.push_back(std::move(entry));
+        }
+    }
+
+    bool denies(const std::vector<std::string>& args, const std::vector<std::string>& redirects, const std::string& cwd) const {
+        for (const Entry& entry : entries) {
+            if (fnmatch(entry.command.c_str(), args[0].c_str(), 0) != 0) continue;
+            bool all = true;
+            for (const Term& term : entry.terms) {
+                bool any = false;
+                if (term.field == "redirect") {
+                    for (const auto& target : redirects) any = any || term.matches(PolicyRules::normalize_path(target, cwd));
+                } else {
+                    for (size_t i = 1; i < args.size() && !any; ++i) {
+                        any = term.field == "arg" ? term.matches(args[i])
+                              : args[i][0] != '-' && term.matches(PolicyRules::normalize_path(args[i], cwd));
+                    }
+                }
+                if (!any) {
+                    all = false;
+                    break;
+                }
+            }
+            if (all) return true;
+        }
+        return false;
+    }
+
+private:
+    struct Term {
+        std::string field, pattern;
+        std::regex regex;
+        bool is_regex = false;
+
+        bool matches(const std::string& text) const {
+            return is_regex ? std::regex_search(text, regex) : fnmatch(pattern.c_str(), text.c_str(), 0) == 0;
+        }
+    };
+    struct Entry {
+        std::string command;
+        std::vector<Term> terms;
+    };
+    std::vector<Entry> entries;
+};
+
+static double elapsed_ns(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : 200000;
+    const std::string cwd = "/home/ops";
+
+    printf("%8s %11s %9s %9s %10s %13s %13s\n", "rules", "compile_ms", "literals", "nfa", "dfa", "compiled_ns", "linear_ns");
+    for (size_t n : {10, 100, 1000, 10000, 50000}) {
+        std::string text = make_rules(n);
+        std::vector<std::string> errors;
+        PolicyRules rules;
+        auto start = Clock::now();
+        rules.parse(text, errors);
+        double compile_ms = elapsed_ns(start) / 1e6;
+        if (!errors.empty()) {
+            fprintf(stderr, "%s\n", errors[0].c_str());
+            return 1;
+        }
+
+        // Warm the DFA cache, then time
+        size_t denied = 0;
+        for (const auto& command : COMMANDS) denied += rules.check(command.args, command.redirects, cwd) != nullptr;
+        if (denied != 3) {
+            fprintf(stderr, "%zu rules: expected 3 denied commands, got %zu\n", n, denied);
+            return 1;
+        }
+        start = Clock::now();
+        for (long i = 0; i < iterations; ++i) {
+            const Command& command = COMMANDS[i % COMMANDS.size()];
+            denied += rules.check(command.args, command.redirects, cwd) != nullptr;
+        }
+        double compiled_ns = elapsed_ns(start) / iterations;
+
+        // The baseline is linear in the rules; fewer iterations keep it bounded
+        LinearRules linear(rules);
+        long linear_iterations = std::max(static_cast<long>(COMMANDS.size()), iterations / static_cast<long>(n));
+        start = Clock::now();
+        for (long i = 0; i < linear_iterations; ++i) {
+            const Command& command = COMMANDS[i % COMMANDS.size()];
+            denied += linear.denies(command.args, command.redirects, cwd);
+        }
+        double linear_ns = elapsed_ns(start) / linear_iterations;
+
+        const PatternSet& patterns = rules.pattern_set();
+        printf("%8zu %11.1f %9zu %9zu %10zu %13.1f %13.1f\n", n, compile_ms, patterns.literal_count(),
+               patterns.nfa_size(), patterns.dfa_size(), compiled_ns, linear_ns);
+    }
+    return 0;
+}
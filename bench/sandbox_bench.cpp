@@ -0,0 +1,130 @@
+// Per-command isolation overhead: /bin/true launched and reaped with the
+// plain Spawner (no isolation), through the prepared Sandbox template, and
+// with the same isolation built from scratch for every command (fork,
+// unshare, read-only view, a new cgroup, compiling and installing the
+// filter, exec, then removing the cgroup), at several resident set sizes.
+// Also reports the one-time cost of Sandbox::prepare().
+//
+// Build and run from the repository root:
+//   g++ -O2 -o sandbox_bench bench/sandbox_bench.cpp src/secshell_core.cpp src/shell_*.cpp -lreadline -pthread
+//   ./sandbox_bench [iterations] [rss_mb ...]
+#include "../src/secshell.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+static const char* TARGET = "/bin/true";
+
+static double elapsed_us(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double spawn_once(const Sandbox* sandbox) {
+    auto start = std::chrono::steady_clock::now();
+    Spawner spawner;
+    spawner.isolate(sandbox);
+    pid_t pid;
+    if (spawner.spawn(TARGET, {TARGET}, pid) != 0) {
+        fprintf(stderr, "spawn failed\n");
+        exit(1);
+    }
+    waitpid(pid, nullptr, 0);
+    return elapsed_us(start);
+}
+
+// What the template saves: every step of Sandbox::prepare() in the child
+// of a fork, for one command. cgroup_base is empty when no cgroup can be
+// made here.
+static double setup_once(const std::vector<std::string>& writable, const std::string& cgroup_base, int n) {
+    auto start = std::chrono::steady_clock::now();
+    std::string cgroup = cgroup_base.empty() ? "" : cgroup_base + "/secshell-bench-" + std::to_string(n);
+    if (!cgroup.empty()) mkdir(cgroup.c_str(), 0755);
+    std::string procs = cgroup + "/cgroup.procs";
+    bool own_user_ns = geteuid() != 0;
+    uid_t uid = geteuid();
+    gid_t gid = getegid();
+    pid_t pid = fork();
+    if (pid == 0) {
+        const char* step;
+        if (!cgroup.empty()) {
+            int fd = open(procs.c_str(), O_WRONLY);
+            if (fd == -1 || write(fd, "0", 1) != 1) _exit(126);
+        }
+        if (unshare(CLONE_NEWNS | (own_user_ns ? CLONE_NEWUSER : 0)) != 0) _exit(126);
+        if (own_user_ns && !Sandbox::map_own_ids(uid, gid)) _exit(126);
+        if (!Sandbox::make_read_only_view(writable, step)) _exit(126);
+        if (!Sandbox::install_filter(Sandbox::compile_filter())) _exit(126);
+        char* argv[] = {const_cast<char*>(TARGET), nullptr};
+        execve(TARGET, argv, environ);
+        _exit(127);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    if (!cgroup.empty()) rmdir(cgroup.c_str());
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "per-command setup failed\n");
+        exit(1);
+    }
+    return elapsed_us(start);
+}
+
+static double median(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+int main(int argc, char* argv[]) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 200;
+    std::vector<size_t> sizes_mb;
+    for (int i = 2; i < argc; ++i) sizes_mb.push_back(strtoul(argv[i], nullptr, 10));
+    if (sizes_mb.empty()) sizes_mb = {0, 256};
+
+    Sandbox::Options options;
+    options.writable = {"/tmp", "/var/tmp", "/dev/shm"};
+    const char* home = getenv("HOME");
+    if (home && *home) options.writable.push_back(home);
+    Sandbox sandbox;
+    std::string error;
+    auto start = std::chrono::steady_clock::now();
+    if (!sandbox.prepare(options, error)) {
+        fprintf(stderr, "sandbox: %s\n", error.c_str());
+        return 1;
+    }
+    double prepare_us = elapsed_us(start);
+    std::string cgroup_base;
+    if (!sandbox.cgroup().empty()) cgroup_base = sandbox.cgroup().substr(0, sandbox.cgroup().rfind('/'));
+
+    printf("prepare once: %.1f us, %zu filter instructions, %s\n", prepare_us, sandbox.filter_length(),
+           sandbox.cgroup().empty() ? "no cgroup" : sandbox.clone_into_cgroup() ? "clone3 into cgroup" : "cgroup joined after clone");
+    for (const auto& note : sandbox.notes()) printf("note: %s\n", note.c_str());
+    printf("%10s %12s %14s %14s %12s %12s\n", "rss_mb", "spawn_us", "template_us", "per_cmd_us", "template+", "per_cmd+");
+    std::vector<char*> ballast;
+    size_t resident_mb = 0;
+    int n = 0;
+    for (size_t target_mb : sizes_mb) {
+        // Grow the process to the requested size and fault every page in
+        while (resident_mb < target_mb) {
+            char* block = static_cast<char*>(malloc(1 << 20));
+            if (!block) break;
+            memset(block, 1, 1 << 20);
+            ballast.push_back(block);
+            ++resident_mb;
+        }
+
+        std::vector<double> spawn_samples, template_samples, setup_samples;
+        for (int i = 0; i < iterations; ++i) {
+            spawn_samples.push_back(spawn_once(nullptr));
+            template_samples.push_back(spawn_once(&sandbox));
+            setup_samples.push_back(setup_once(options.writable, cgroup_base, n++));
+        }
+        double spawn_us = median(spawn_samples);
+        double template_us = median(template_samples);
+        double setup_us = median(setup_samples);
+        printf("%10zu %12.1f %14.1f %14.1f %12.1f %12.1f\n", resident_mb, spawn_us, template_us, setup_us,
+               template_us - spawn_us, setup_us - spawn_us);
+    }
+
+    for (char* block : ballast) free(block);
+    return 0;
+}
@@ -0,0 +1,246 @@
+// Benchmark suite for the secshell_core library. Every result is printed as
+// one JSON document on stdout so runs can be stored and compared:
+//
+//   {"suite": "secshell", "quick": false, "results": [
+//     {"name": "blacklist_lookup", "params": {"entries": 1000}, "unit": "ns/op",
+//      "value": 12.3, "iterations": 2000000}, ...]}
+//
+// Covered: parse_arguments throughput, the policy check (CommandPolicy::allows),
+// blacklist lookup at 10/1k/100k entries, the argument rule check at 10/10k
+// rules, spawn latency, pipeline throughput and prompt rendering. --quick runs a fraction of the iterations (ctest uses
+// it as a smoke test).
+//
+// Build and run from the repository root (or use the CMake target):
+//   g++ -O2 -o secshell_bench bench/secshell_bench.cpp src/secshell_core.cpp src/shell_*.cpp -lreadline -pthread
+//   ./secshell_bench [--quick] > results.json
+#include "../src/secshell.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> params; // Values are JSON literals
+    std::string unit;
+    double value;
+    long iterations;
+};
+
+std::vector<Result> results;
+bool quick = false;
+
+long scaled(long iterations) {
+    return quick ? std::max(1L, iterations / 50) : iterations;
+}
+
+double elapsed_ns(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+double median(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+std::string json_string(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+void record(const std::string& name, std::vector<std::pair<std::string, std::string>> params, const std::string& unit,
+            double value, long iterations) {
+    results.push_back({name, std::move(params), unit, value, iterations});
+}
+
+const std::vector<std::string> CORPUS = {
+    "ls",
+    "ls -la /var/log",
+    "ps aux | grep sshd | wc -l",
+    "tcpdump -i eth0 -nn port 443 > /tmp/capture.txt &",
+    "cat < /etc/hosts | sort | uniq -c | sort -rn | head -20",
+    "grep -r \"Failed password\" /var/log/auth.log >> /tmp/failures.txt",
+    "echo $HOME $USER 'literal $HOME' \"quoted $PATH\"",
+    "netstat -tulpn | grep LISTEN | awk '{print $4}' | sort",
+};
+
+void bench_parse_arguments(SecShell& shell) {
+    long iterations = scaled(200000);
+    size_t words = 0;
+    auto start = Clock::now();
+    for (long i = 0; i < iterations; ++i) {
+        words += shell.parse_arguments(CORPUS[i % CORPUS.size()]).size();
+    }
+    double ns = elapsed_ns(start);
+    if (words == 0) abort();
+    record("parse_arguments", {}, "ns/op", ns / iterations, iterations);
+    record("parse_arguments_throughput", {}, "lines/s", iterations / (ns / 1e9), iterations);
+}
+
+void bench_policy() {
+    CommandPolicy policy({"/usr/bin/", "/bin/", "/opt/"});
+    policy.index_executables(false);
+    policy.blacklist().publish(std::make_shared<const BlacklistSnapshot>(std::vector<std::string>{"nc", "ncat", "socat"}));
+    const char* cases[][2] = {{"allowed", "ls"}, {"blacklisted", "nc"}, {"unknown", "no-such-command"}};
+    long iterations = scaled(2000000);
+    for (const auto& c : cases) {
+        std::string command = c[1], resolved;
+        size_t allowed = 0;
+        auto start = Clock::now();
+        for (long i = 0; i < iterations; ++i) {
+            allowed += policy.allows(command, &resolved);
+        }
+        double ns = elapsed_ns(start);
+        if (allowed > static_cast<size_t>(iterations)) abort();
+        record("is_command_allowed", {{"case", json_string(c[0])}}, "ns/op", ns / iterations, iterations);
+    }
+}
+
+void bench_blacklist() {
+    long iterations = scaled(2000000);
+    for (size_t entries : {10, 1000, 100000}) {
+        std::vector<std::string> commands, probes;
+        for (size_t i = 0; i < entries; ++i) commands.push_back("blocked-command-" + std::to_string(i));
+        // Half hits, half misses
+        for (size_t i = 0; i < 1024; ++i) {
+            probes.push_back(i % 2 ? commands[(i * 7919) % entries] : "allowed-command-" + std::to_string(i));
+        }
+        Blacklist blacklist;
+        blacklist.publish(std::make_shared<const BlacklistSnapshot>(commands));
+        size_t hits = 0;
+        auto start = Clock::now();
+        for (long i = 0; i < iterations; ++i) {
+            hits += blacklist.contains(probes[i & 1023]);
+        }
+        double ns = elapsed_ns(start);
+        if (hits != static_cast<size_t>(iterations) / 2) abort();
+        record("blacklist_lookup", {{"entries", std::to_string(entries)}}, "ns/op", ns / iterations, iterations);
+    }
+}
+
+void bench_rules() {
+    long iterations = scaled(500000);
+    const std::vector<std::string> args = {"tcpdump", "-i", "eth0", "-w", "/tmp/capture.pcap"};
+    for (size_t count : {10, 10000}) {
+        std::string text;
+        for (size_t i = 0; i < count; ++i) {
+            std::string k = std::to_string(i);
+            text += i % 2 ? "deny cmd" + k + " arg:--opt-" + k + "\n" : "deny * path:/srv/app" + k + "/*.key\n";
+        }
+        std::vector<std::string> errors;
+        PolicyRules rules;
+        rules.parse(text, errors);
+        size_t denied = 0;
+        auto start = Clock::now();
+        for (long i = 0; i < iterations; ++i) {
+            denied += rules.check(args, {}, "/root") != nullptr;
+        }
+        double ns = elapsed_ns(start);
+        if (denied || !errors.empty()) abort();
+        record("rules_check", {{"rules", std::to_string(count)}}, "ns/op", ns / iterations, iterations);
+    }
+}
+
+void bench_spawn() {
+    long iterations = scaled(500);
+    std::vector<double> samples;
+    for (long i = 0; i < iterations; ++i) {
+        auto start = Clock::now();
+        Spawner spawner;
+        pid_t pid;
+        if (spawner.spawn("/bin/true", {"true"}, pid) != 0) abort();
+        waitpid(pid, nullptr, 0);
+        samples.push_back(elapsed_ns(start) / 1000);
+    }
+    record("spawn_latency", {}, "us", median(samples), iterations);
+}
+
+void bench_pipeline() {
+    size_t bytes = quick ? 16 << 20 : 1ULL << 30;
+    for (int stages : {2, 4}) {
+        SecShell shell("/dev/null", false);
+        std::string command = "head -c " + std::to_string(bytes) + " /dev/zero";
+        for (int i = 0; i < stages - 2; ++i) command += " | cat";
+        command += " | wc -c > /dev/null";
+        auto start = Clock::now();
+        if (shell.run_command(command) != 0) abort();
+        double seconds = elapsed_ns(start) / 1e9;
+        record("pipeline_throughput", {{"stages", std::to_string(stages)}}, "MiB/s", (bytes >> 20) / seconds, 1);
+    }
+}
+
+// Cheap segments only (cached between renders), then the default set, whose
+// git segment walks up to the repository root on every render when no
+// worker thread is running
+void bench_prompt() {
+    char cwd[PATH_MAX];
+    std::string directory = getcwd(cwd, sizeof(cwd)) ? cwd : "/";
+    for (const char* segments : {"user cwd jobs status", PromptRenderer::DEFAULT_SEGMENTS}) {
+        PromptRenderer prompt;
+        std::string error;
+        if (!prompt.configure(segments, error)) abort();
+        prompt.set_context("bench", "host", directory);
+        long iterations = scaled(200000);
+        size_t length = 0;
+        auto start = Clock::now();
+        for (long i = 0; i < iterations; ++i) {
+            length += prompt.render({static_cast<int>(i & 1), 0}).size();
+        }
+        double ns = elapsed_ns(start);
+        if (length == 0) abort();
+        record("prompt_render", {{"segments", json_string(segments)}}, "ns/op", ns / iterations, iterations);
+    }
+}
+
+void print_json() {
+    printf("{\"suite\": \"secshell\", \"quick\": %s, \"results\": [", quick ? "true" : "false");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        printf("%s\n  {\"name\": %s, \"params\": {", i ? "," : "", json_string(r.name).c_str());
+        for (size_t p = 0; p < r.params.size(); ++p) {
+            printf("%s%s: %s", p ? ", " : "", json_string(r.params[p].first).c_str(), r.params[p].second.c_str());
+        }
+        printf("}, \"unit\": %s, \"value\": %.3f, \"iterations\": %ld}", json_string(r.unit).c_str(), r.value, r.iterations);
+    }
+    printf("\n]}\n");
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--quick") {
+            quick = true;
+        } else {
+            fprintf(stderr, "Usage: %s [--quick]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    SecShell shell("/dev/null", false);
+    bench_parse_arguments(shell);
+    bench_policy();
+    bench_blacklist();
+    bench_rules();
+    bench_spawn();
+    bench_pipeline();
+    bench_prompt();
+    print_json();
+    return 0;
+}
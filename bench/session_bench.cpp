@@ -0,0 +1,149 @@
+// Session start latency: a standalone secshell against secshell --connect
+// served by secshelld. Interactive sessions run on a pty and are timed until
+// the prompt appears; -c sessions are timed until they exit.
+//
+// Build and run from the repository root:
+//   g++ -O2 -o secshell secshell.cpp src/secshell_core.cpp src/shell_*.cpp -lreadline -pthread
+//   g++ -O2 -o session_bench bench/session_bench.cpp src/secshell_core.cpp src/shell_*.cpp -lreadline -pthread
+//   ./session_bench [./secshell] [iterations]
+#include "../src/secshell.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static double elapsed_us(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// secshell -c true, output discarded
+static double command_once(const std::string& binary, const std::vector<std::string>& args) {
+    int null_fd = open("/dev/null", O_RDWR | O_CLOEXEC);
+    auto start = std::chrono::steady_clock::now();
+    Spawner spawner;
+    for (int fd : {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO}) spawner.redirect(null_fd, fd);
+    pid_t pid;
+    int status = -1;
+    if (spawner.spawn(binary, args, pid) == 0) waitpid(pid, &status, 0);
+    double us = elapsed_us(start);
+    close(null_fd);
+    if (status != 0) {
+        fprintf(stderr, "%s exited with %d\n", binary.c_str(), status);
+        exit(1);
+    }
+    return us;
+}
+
+// Starts the shell on a fresh pty and waits for the bottom line of its
+// prompt, then types exit.
+static double prompt_once(const std::string& binary, const std::vector<std::string>& args) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (master == -1 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("posix_openpt");
+        exit(1);
+    }
+    std::string slave = ptsname(master);
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        setsid();
+        int fd = open(slave.c_str(), O_RDWR); // Becomes the controlling terminal
+        for (int target : {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO}) dup2(fd, target);
+        std::vector<char*> argv;
+        for (const auto& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+        argv.push_back(nullptr);
+        execv(binary.c_str(), argv.data());
+        _exit(127);
+    }
+
+    std::string output;
+    char buffer[4096];
+    struct pollfd pfd = {master, POLLIN, 0};
+    while (output.find("\xe2\x94\x94\xe2\x94\x80") == std::string::npos) { // "└─"
+        if (poll(&pfd, 1, 5000) != 1) {
+            fprintf(stderr, "no prompt from %s\n", binary.c_str());
+            exit(1);
+        }
+        ssize_t n = read(master, buffer, sizeof(buffer));
+        if (n <= 0) break;
+        output.append(buffer, n);
+    }
+    double us = elapsed_us(start);
+
+    BoxRenderer::write_all(master, "exit\r");
+    while (poll(&pfd, 1, 2000) == 1 && read(master, buffer, sizeof(buffer)) > 0) {}
+    waitpid(pid, nullptr, 0);
+    close(master);
+    return us;
+}
+
+static double median(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+int main(int argc, char* argv[]) {
+    std::string binary = argc > 1 ? argv[1] : "./secshell";
+    int iterations = argc > 2 ? atoi(argv[2]) : 50;
+    if (binary.find('/') == std::string::npos) binary = "./" + binary;
+
+    char dir_template[] = "/tmp/session_bench.XXXXXX";
+    if (!mkdtemp(dir_template)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::string socket_path = std::string(dir_template) + "/secshelld.sock";
+    setenv("TERM", "xterm-256color", 1);
+    setenv("SECSHELL_HISTFILE", (std::string(dir_template) + "/history").c_str(), 1);
+
+    Spawner spawner;
+    pid_t daemon_pid;
+    if (spawner.spawn(binary, {binary, "--daemon", "--socket", socket_path}, daemon_pid) != 0) {
+        fprintf(stderr, "cannot start %s --daemon\n", binary.c_str());
+        return 1;
+    }
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    for (int tries = 0;; ++tries) {
+        int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        bool up = connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0;
+        close(fd);
+        if (up) break;
+        if (tries == 500) {
+            fprintf(stderr, "secshelld did not come up\n");
+            return 1;
+        }
+        usleep(10000);
+    }
+
+    struct Case {
+        const char* label;
+        bool interactive;
+        std::vector<std::string> standalone, connected;
+    };
+    std::vector<Case> cases = {
+        {"prompt", true, {binary}, {binary, "--connect", "--socket", socket_path}},
+        {"-c true", false, {binary, "-c", "true"}, {binary, "--connect", "--socket", socket_path, "-c", "true"}},
+    };
+
+    printf("%-10s %16s %16s %9s\n", "session", "standalone_us", "connected_us", "speedup");
+    for (const auto& c : cases) {
+        std::vector<double> standalone, connected;
+        for (int i = 0; i < iterations; ++i) {
+            standalone.push_back(c.interactive ? prompt_once(binary, c.standalone) : command_once(binary, c.standalone));
+            connected.push_back(c.interactive ? prompt_once(binary, c.connected) : command_once(binary, c.connected));
+        }
+        double standalone_us = median(standalone), connected_us = median(connected);
+        printf("%-10s %16.1f %16.1f %8.2fx\n", c.label, standalone_us, connected_us, standalone_us / connected_us);
+    }
+
+    kill(daemon_pid, SIGTERM);
+    waitpid(daemon_pid, nullptr, 0);
+    std::string cleanup = "rm -rf " + std::string(dir_template);
+    return system(cleanup.c_str()) == 0 ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+// Spawn latency micro-benchmark: fork()+execve() versus the posix_spawn
+// based Spawner used by SecShell, measured at several resident set sizes.
+//
+// Build and run from the repository root:
+//   g++ -O2 -o spawn_bench bench/spawn_bench.cpp src/secshell_core.cpp src/shell_*.cpp -lreadline -pthread
+//   ./spawn_bench [iterations] [rss_mb ...]
+#include "../src/secshell.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+static const char* TARGET = "/bin/true";
+
+static double fork_exec_once() {
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        char* argv[] = {const_cast<char*>(TARGET), nullptr};
+        execve(TARGET, argv, environ);
+        _exit(127);
+    }
+    waitpid(pid, nullptr, 0);
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double spawn_once() {
+    auto start = std::chrono::steady_clock::now();
+    Spawner spawner;
+    pid_t pid;
+    if (spawner.spawn(TARGET, {TARGET}, pid) == 0) {
+        waitpid(pid, nullptr, 0);
+    }
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double median(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+int main(int argc, char* argv[]) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 200;
+    std::vector<size_t> sizes_mb;
+    for (int i = 2; i < argc; ++i) sizes_mb.push_back(strtoul(argv[i], nullptr, 10));
+    if (sizes_mb.empty()) sizes_mb = {0, 64, 256, 1024};
+
+    printf("%10s %14s %14s %9s\n", "rss_mb", "fork_exec_us", "spawn_us", "speedup");
+    std::vector<char*> ballast;
+    size_t resident_mb = 0;
+    for (size_t target_mb : sizes_mb) {
+        // Grow the process to the requested size and fault every page in
+        while (resident_mb < target_mb) {
+            char* block = static_cast<char*>(malloc(1 << 20));
+            if (!block) break;
+            memset(block, 1, 1 << 20);
+            ballast.push_back(block);
+            ++resident_mb;
+        }
+
+        std::vector<double> fork_samples, spawn_samples;
+        for (int i = 0; i < iterations; ++i) {
+            fork_samples.push_back(fork_exec_once());
+            spawn_samples.push_back(spawn_once());
+        }
+        double fork_us = median(fork_samples);
+        double spawn_us = median(spawn_samples);
+        printf("%10zu %14.1f %14.1f %8.2fx\n", resident_mb, fork_us, spawn_us, fork_us / spawn_us);
+    }
+
+    for (char* block : ballast) free(block);
+    return 0;
+}
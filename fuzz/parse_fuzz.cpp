@@ -0,0 +1,65 @@
+// libFuzzer target for the command line parser, fed the same raw lines that
+// reach parse_arguments and process_command.
+//
+//   clang++ -g -O1 -std=c++17 -fsanitize=fuzzer,address,undefined \
+//       -o parse_fuzz fuzz/parse_fuzz.cpp src/secshell_core.cpp src/shell_*.cpp -lreadline -pthread
+//   ./parse_fuzz
+//
+// Without libFuzzer, build with -DSECSHELL_FUZZ_STANDALONE to replay files
+// given on the command line (e.g. a crash reproducer).
+#include "../src/secshell.h"
+
+#include <cstdint>
+#include <cstdlib>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    static Arena arena;
+    std::string_view input(reinterpret_cast<const char*>(data), size);
+    std::string error;
+
+    arena.reset();
+    CommandParser parser(arena, [](const std::string& name) -> const char* {
+        return name.size() % 2 ? "expanded" : nullptr;
+    });
+
+    const PipelineNode* pipeline = parser.parse(input, error);
+    if (pipeline) {
+        size_t commands = 0;
+        for (const CommandNode* command = pipeline->commands; command; command = command->next) {
+            ++commands;
+            size_t words = 0;
+            for (const WordNode* word = command->words; word; word = word->next) {
+                ++words;
+                // Separators and operators never survive inside an unquoted word
+                if (!word->quoted && word->text.find_first_of(" \t|&<>") != std::string_view::npos) {
+                    abort();
+                }
+            }
+            if (words != command->word_count || words == 0) abort();
+        }
+        if (commands != pipeline->length) abort();
+    } else if (error.empty()) {
+        abort();
+    }
+
+    std::vector<std::string> words;
+    error.clear();
+    if (!parser.split(input, words, error) && error.empty()) abort();
+    return 0;
+}
+
+#ifdef SECSHELL_FUZZ_STANDALONE
+#include <fstream>
+#include <sstream>
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        std::ifstream file(argv[i], std::ios::binary);
+        std::stringstream contents;
+        contents << file.rdbuf();
+        std::string data = contents.str();
+        LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+    }
+    return 0;
+}
+#endif
@@ -1,769 +1,369 @@
+// SecShell command line: the interactive shell, batch mode, and the
+// secshelld daemon and client. The shell itself lives in src/.
+#include <cstring>
+#include <ctime>
+#include <fstream>
 #include <iostream>
 #include <string>
 #include <vector>
-#include <algorithm>
-#include <unordered_map>
-#include <unistd.h>
-#include <sys/wait.h>
-#include <signal.h>
-#include <dirent.h>
-#include <readline/readline.h>
-#include <readline/history.h>
-#include <csignal>
-#include <fcntl.h>
-#include <fstream>
-#include <libgen.h>
-#include <limits.h>
-
-class SecShell {
-	std::unordered_map<pid_t, std::string> jobs;
-    bool running = true;
-
-    // Security whitelists
-    const std::vector<std::string> ALLOWED_DIRS = {"/usr/bin/", "/bin/","/opt/"};
-    const std::vector<std::string> ALLOWED_COMMANDS = {"ls", "ps", "netstat", "tcpdump","cd","clear","ifconfig","apk","apt","pacman","brew"};
-    std::string BLACKLIST=".blacklist";
-    
-    // Blacklist of commands
-    std::vector<std::string> BLACKLISTED_COMMANDS;
-    
-    // Function to load blacklisted commands from a file
-    void load_blacklist(const std::string& filename);
 
-    std::string repeat_string(const std::string& str, int n) {
-        std::string result;
-        for (int i = 0; i < n; ++i) {
-            result += str;
-        }
-        return result;
-    }
+#include <sys/ioctl.h>
+
+#include "src/pty_relay.h"
+#include "src/secshell.h"
+#include "src/session_daemon.h"
+#include "src/session_recording.h"
+
+static void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [--startup-trace] [--connect] [--socket path] [--record file] [-c command | -s | script]\n"
+              << "       " << program << " --daemon [--socket path]\n"
+              << "       " << program << " --replay file [--list | --at time | --command N] [--speed factor]\n"
+              << "  -c command        Run a single command line and exit\n"
+              << "  -s                Read commands from standard input\n"
+              << "  script            Run the commands in a script file\n"
+              << "  --startup-trace   Report time spent in each startup phase\n"
+              << "  --connect         Run the session in secshelld, or standalone if it is not up\n"
+              << "  --daemon          Serve sessions from a warm zygote (also when run as secshelld)\n"
+              << "  --socket path     secshelld's socket (default $SECSHELL_SOCKET or /run/secshelld.sock)\n"
+              << "  --record file     Record the interactive session (default $SECSHELL_RECORD; %u user, %p PID, %t time)\n"
+              << "  --replay file     Play a recording; --list shows its commands, --at [[h:]m:]s or --command N\n"
+              << "                    starts later, --speed scales time (0: no pauses)\n";
+}
 
-public:
-    SecShell(const std::string& blacklist_path) : BLACKLIST(blacklist_path) {
-        load_blacklist(BLACKLIST); // Load blacklisted commands from file
-    }
+// What to run, from the command line (or, in a secshelld session, the client's)
+struct Invocation {
+    bool startup_trace = false;
+    bool read_stdin = false;
+    bool have_command = false;
+    bool daemon = false;
+    bool connect = false;
+    std::string socket_path;
+    std::string record_path;
+    std::string replay_path;
+    bool replay_list = false;
+    std::string replay_at;
+    size_t replay_command = 0;
+    double replay_speed = 1.0;
+    std::string command;
+    std::string script;
+    std::vector<std::string> session_args; // What --connect hands to the session
 
-    void run() {
-        // Register signal handlers
-        signal(SIGINT, signal_handler);
-        signal(SIGTSTP, signal_handler);
+    bool interactive() const { return !have_command && !read_stdin && script.empty(); }
+};
 
-        while (running) {
-            std::string input = get_input();
-            process_command(input);
+static bool parse_invocation(const std::vector<std::string>& args, Invocation& invocation) {
+    for (size_t i = 0; i < args.size(); ++i) {
+        const std::string& arg = args[i];
+        if (arg == "--daemon") {
+            invocation.daemon = true;
+            continue;
+        } else if (arg == "--connect") {
+            invocation.connect = true;
+            continue;
+        } else if (arg == "--socket" && i + 1 < args.size()) {
+            invocation.socket_path = args[++i];
+            continue;
+        } else if (arg == "--record" && i + 1 < args.size()) {
+            invocation.record_path = args[++i];
+            continue;
+        } else if (arg == "--replay" && i + 1 < args.size()) {
+            invocation.replay_path = args[++i];
+            continue;
+        } else if (arg == "--list") {
+            invocation.replay_list = true;
+            continue;
+        } else if (arg == "--at" && i + 1 < args.size()) {
+            invocation.replay_at = args[++i];
+            continue;
+        } else if (arg == "--command" && i + 1 < args.size()) {
+            invocation.replay_command = strtoul(args[++i].c_str(), nullptr, 10);
+            if (invocation.replay_command == 0) return false;
+            continue;
+        } else if (arg == "--speed" && i + 1 < args.size()) {
+            invocation.replay_speed = atof(args[++i].c_str());
+            if (invocation.replay_speed < 0) return false;
+            continue;
+        } else if (arg == "--startup-trace") {
+            invocation.startup_trace = true;
+        } else if (arg == "-c" && i + 1 < args.size()) {
+            invocation.command = args[++i];
+            invocation.have_command = true;
+            invocation.session_args.push_back(arg);
+        } else if (arg == "-s") {
+            invocation.read_stdin = true;
+        } else if (!arg.empty() && arg[0] != '-' && invocation.script.empty()) {
+            invocation.script = arg;
+        } else {
+            return false;
         }
+        invocation.session_args.push_back(args[i]);
     }
-
-private:
-    void display_prompt() {
-        // Get current user
-        const char* user = getenv("USER");
-        if (!user) user = "unknown"; // Fallback if USER is not set
-
-        // Get current working directory
-        char cwd[1024];
-        if (getcwd(cwd, sizeof(cwd)) == nullptr) {
-            print_error("Failed to get current working directory");
-            return;
-        }
-
-        // Print prompt with user and working directory
-        std::cout << "\033[32m┌─[SecShell]\033[0m \033[1;34m(" << user << ")\033[0m \033[1;37m[" << cwd << "]\033[0;32m\n└─\033[0m$ ";
+    if (invocation.socket_path.empty()) invocation.socket_path = SessionDaemon::default_socket_path();
+    bool replay_options = invocation.replay_list || !invocation.replay_at.empty() || invocation.replay_command || invocation.replay_speed != 1.0;
+    if (invocation.replay_path.empty() ? replay_options
+                                       : invocation.daemon || invocation.connect || !invocation.session_args.empty() ||
+                                             (!invocation.replay_at.empty() && invocation.replay_command)) {
+        return false;
     }
+    return !(invocation.daemon && (invocation.connect || !invocation.session_args.empty()));
+}
 
-    std::string get_input() {
-        // Get current user
-        const char* user = getenv("USER");
-        if (!user) user = "unknown"; // Fallback if USER is not set
-
-        // Get current working directory
-        char cwd[1024];
-        if (getcwd(cwd, sizeof(cwd)) == nullptr) {
-            print_error("Failed to get current working directory");
-            return "";
-        }
-
-        // Construct the prompt string
-        std::string prompt = "\033[32m┌─[SecShell]\033[0m \033[1;34m(" + std::string(user) + ")\033[0m \033[1;37m[" + std::string(cwd) + "]\033[0;32m\n└─\033[0m$ ";
+// "HH:MM:SS.d" for an offset into a recording
+static std::string format_offset(uint64_t us) {
+    char text[32];
+    uint64_t seconds = us / 1000000;
+    snprintf(text, sizeof(text), "%02llu:%02llu:%02llu.%llu", static_cast<unsigned long long>(seconds / 3600),
+             static_cast<unsigned long long>(seconds / 60 % 60), static_cast<unsigned long long>(seconds % 60),
+             static_cast<unsigned long long>(us / 100000 % 10));
+    return text;
+}
 
-        // Read input using readline
-        char* input = readline(prompt.c_str());
-        if (input && *input) {
-            add_history(input);
+// Seconds, m:s or h:m:s, with an optional fraction; false if malformed
+static bool parse_offset(const std::string& text, uint64_t& us) {
+    double total = 0;
+    size_t pos = 0;
+    for (int field = 0; field < 3; ++field) {
+        size_t colon = text.find(':', pos);
+        std::string part = text.substr(pos, colon == std::string::npos ? std::string::npos : colon - pos);
+        char* end;
+        double value = strtod(part.c_str(), &end);
+        if (part.empty() || *end || value < 0) return false;
+        total = total * 60 + value;
+        if (colon == std::string::npos) {
+            us = static_cast<uint64_t>(total * 1e6);
+            return true;
         }
-        std::string sanitized = sanitize_input(input ? input : "");
-        free(input);
-        return sanitized;
+        pos = colon + 1;
     }
+    return false;
+}
 
-    std::string sanitize_input(const std::string& input) {
-        std::string sanitized = input;
-        const std::string forbidden = ";`";
-        sanitized.erase(std::remove_if(sanitized.begin(), sanitized.end(),
-            [&forbidden](char c) { return forbidden.find(c) != std::string::npos; }), sanitized.end());
-        return sanitized;
+// secshell --replay: lists a recording's commands or plays it back
+static int run_replay(const Invocation& invocation) {
+    RecordingReader reader;
+    std::string error;
+    if (!reader.open(invocation.replay_path, error)) {
+        std::cerr << "secshell: " << error << "\n";
+        return 1;
     }
-
-    void change_directory(const std::vector<std::string>& args) {
-        std::string dir;
-
-        if (args.size() < 2) {
-            // If no directory is provided, default to the home directory
-            const char* home = getenv("HOME");
-            if (!home) {
-                print_error("cd failed: HOME environment variable not set");
-                return;
-            }
-            dir = home;
+    const auto& commands = reader.commands();
+    if (invocation.replay_list) {
+        time_t started = reader.started_ns() / 1000000000;
+        char date[64];
+        strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&started));
+        std::cout << "Recorded by " << reader.recorded_by() << " at " << date << ", " << reader.initial_columns() << "x"
+                  << reader.initial_rows() << ", " << format_offset(reader.duration_us());
+        if (!reader.complete()) {
+            std::cout << " (cut short; index rebuilt)\n";
+        } else if (WIFSIGNALED(reader.exit_status())) {
+            std::cout << ", ended by signal " << WTERMSIG(reader.exit_status()) << "\n";
         } else {
-            dir = args[1];
+            std::cout << ", exit status " << WEXITSTATUS(reader.exit_status()) << "\n";
         }
-
-        if (chdir(dir.c_str()) != 0) {
-            print_error("cd failed: " + std::string(strerror(errno)));
+        for (size_t i = 0; i < commands.size(); ++i) {
+            std::cout << "  #" << i + 1 << "  " << format_offset(commands[i].us) << "  " << commands[i].text << "\n";
         }
+        return 0;
     }
 
-    void display_history() {
-		std::string drawbox_command = "drawbox \" Command History \" bold_white";
-        int result = system(drawbox_command.c_str());
-
-        if (result != 0) {
-            print_error("Failed to execute drawbox command.");
-            return;
-        }
-        HIST_ENTRY** history_entries = history_list(); // Renamed variable to avoid conflict
-        if (history_entries) {
-            for (int i = 0; history_entries[i]; i++) {
-                std::cout << "  " << (i + 1) << ". " << history_entries[i]->line << "\n";
-            }
-        } else {
-            std::cout << "No command history available.\n";
+    uint64_t start_us = 0;
+    if (invocation.replay_command) {
+        if (invocation.replay_command > commands.size()) {
+            std::cerr << "secshell: the recording has " << commands.size() << " commands\n";
+            return 1;
         }
+        start_us = commands[invocation.replay_command - 1].us;
+    } else if (!invocation.replay_at.empty() && !parse_offset(invocation.replay_at, start_us)) {
+        std::cerr << "secshell: bad time: " << invocation.replay_at << "\n";
+        return 2;
     }
-    
-    void export_variable(const std::vector<std::string>& args) {
-		if (args.size() < 2) {
-			print_error("Usage: export VAR=value");
-			return;
-		}
-
-		std::string var_value = args[1];
-		size_t equals_pos = var_value.find('=');
-		if (equals_pos == std::string::npos) {
-			print_error("Invalid export syntax. Use VAR=value");
-			return;
-		}
-
-		std::string var = var_value.substr(0, equals_pos);
-		std::string value = var_value.substr(equals_pos + 1);
-
-		if (setenv(var.c_str(), value.c_str(), 1) != 0) {
-			print_error("Failed to set environment variable: " + std::string(strerror(errno)));
-		} else {
-			print_alert("Exported: " + var + "=" + value);
-		}
-	}
-	
-	void list_env_variables() {
-		std::string drawbox_command = "drawbox \" Environment Variable \" bold_white";
-        int result = system(drawbox_command.c_str());
-
-        if (result != 0) {
-            print_error("Failed to execute drawbox command.");
-            return;
-        }
-		extern char** environ;
-		for (char** env = environ; *env; env++) {
-			std::cout << *env << "\n";
-		}
-	}
-
-	void unset_env_variable(const std::vector<std::string>& args) {
-		std::string var_value = args[1];
-		
-		
-		if (args.size() < 2) {
-			print_error("Usage: unset VAR");
-			return;
-		}
-		if (unsetenv(args[1].c_str()) != 0) {
-			print_error("Failed to unset environment variable: " + std::string(strerror(errno)));
-		} else {
-			print_alert("Unset: " + var_value);
-		}
-	}
-	
-	void reload_blacklist() {
-        	BLACKLISTED_COMMANDS.clear(); // Clear the existing blacklist
-        	load_blacklist(BLACKLIST); // Reload the blacklist from the file
-        	print_alert("Blacklist reloaded.");
-    	}
-	
-	void edit_blacklist() {
-	
-	 	std::string command = "nano " + BLACKLIST;
-		system(command.c_str());
-		return;
-
-	}
-
-	void list_blacklist_commands(const std::string& filename = ".blacklist") {
-	     std::string drawbox_command = "drawbox \" Blacklisted Commands \" bold_white";
-	     int result = system(drawbox_command.c_str());
-	     if (result != 0) {
-	            print_error("Failed to execute drawbox command.");
-	            return;
-	    }
-	    // Open the file
-	    std::ifstream file(filename);
-	    if (!file.is_open()) {
-	        std::cerr << "Error: Could not open file '" << filename << "'.\n";
-	        return;
-	    }
-	
-	    // Read and print each line
-	    int line_number = 0;
-	    std::string line;
-	    while (std::getline(file, line)) {
-		line_number += 1;
-	        std::cout << " " << line_number << ". " << line << "\n";
-	    }
-	
-	    // Close the file
-	    file.close();
-	}
-
-	void process_command(const std::string& input) {
-		std::string input_copy = input;
-		if (input_copy.empty()) return;
-
-		// Split commands by pipe
-		std::vector<std::vector<std::string>> commands;
-		size_t pos = 0;
-		while (pos < input_copy.length()) {
-			size_t pipe_pos = input_copy.find('|', pos);
-			std::string command_str = input_copy.substr(pos, pipe_pos - pos);
-			std::vector<std::string> args = parse_arguments(command_str);
-			if (!args.empty()) {
-				commands.push_back(args);
-			}
-			if (pipe_pos == std::string::npos) break;
-			pos = pipe_pos + 1;
-		}
-
-			if (commands.size() > 1) {
-				execute_piped_commands(commands);
-			} else if (!commands.empty()) {
-				std::vector<std::string> args = commands[0];
-				bool background = false;
-				if (args.back() == "&") {
-					background = true;
-					args.pop_back();
-			}
-
-			// Check if the command is blacklisted
-			if (std::find(BLACKLISTED_COMMANDS.begin(), BLACKLISTED_COMMANDS.end(), args[0])
-				!= BLACKLISTED_COMMANDS.end()) {
-				print_error("Command is blacklisted: " + args[0]);
-				return;
-			}
-
-			if (args[0] == "services") {
-				manage_services(args);
-			} else if (args[0] == "jobs") {
-				list_jobs();
-			} else if (args[0] == "help") {
-				display_help();
-			} else if (args[0] == "cd") {
-				change_directory(args);
-			} else if (args[0] == "history") {
-				display_history();
-			} else if (args[0] == "export") {
-				export_variable(args);
-			} else if (args[0] == "env") {
-				list_env_variables();
-			} else if (args[0] == "unset") {
-				unset_env_variable(args);
-			} else if (args[0] == "reload") { // Add the reload command
-                		reload_blacklist();
-			} else if (args[0] == "blacklist") {
-				list_blacklist_commands(BLACKLIST);
-			} else if (args[0] == "edit-blacklist") {
-				edit_blacklist();
-			} else if (args[0] == "exit") {
-				running = false;
-			} else {
-				
-				// Special handling for 'cat' without arguments
-				if (args[0] == "cat" && args.size() == 1) {
-					print_error("Usage: cat <file>");
-					return;
-				}
-				execute_system_command(args, background);
-			}
-		}
-	}
-
-    void manage_services(const std::vector<std::string>& args) {
-        if (args.size() < 2) {
-            print_error("Usage: services <start|stop|restart|status|list> <service_name>");
-            return;
-        }
-
-        std::string action = args[1];
-        std::string service_name = args.size() > 2 ? args[2] : "";
+    if (start_us > 0) {
+        // Earlier output is not replayed; start on a clear screen with a note of where this is
+        std::string note = "\033[H\033[2J\033[2m[" + format_offset(start_us) + "]";
+        size_t next = std::lower_bound(commands.begin(), commands.end(), start_us,
+                                       [](const RecordingReader::CommandEntry& entry, uint64_t us) { return entry.us < us; }) -
+                      commands.begin();
+        if (next < commands.size() && commands[next].us == start_us) note += " #" + std::to_string(next + 1) + " " + commands[next].text;
+        BoxRenderer::write_all(STDOUT_FILENO, note + "\033[0m\r\n");
+    }
+    RecordingPlayer player;
+    player.speed = invocation.replay_speed;
+    if (!player.play(reader, start_us, error)) {
+        std::cerr << "secshell: " << invocation.replay_path << ": " << error << "\n";
+        return 1;
+    }
+    return 0;
+}
 
-        if (action != "start" && action != "stop" && action != "restart" && action != "status" && action != "list") {
-            print_error("Invalid action. Use start, stop, restart, status, or list.");
-            return;
+// The recording file name for a --record or SECSHELL_RECORD template
+static std::string recording_path(const std::string& path_template) {
+    std::string path;
+    for (size_t i = 0; i < path_template.size(); ++i) {
+        if (path_template[i] != '%' || i + 1 == path_template.size()) {
+            path += path_template[i];
+            continue;
         }
-
-        std::string command;
-        if (action == "list") {
-            command = "systemctl list-units --type=service";
-        } else if (action == "status") {
-            command = "systemctl status " + service_name;
+        char field = path_template[++i];
+        if (field == 'p') {
+            path += std::to_string(getpid());
+        } else if (field == 'u') {
+            struct passwd* pw = getpwuid(getuid());
+            path += pw ? pw->pw_name : std::to_string(getuid());
+        } else if (field == 't') {
+            char stamp[32];
+            time_t now = time(nullptr);
+            strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime(&now));
+            path += stamp;
         } else {
-            command = "sudo systemctl " + action + " " + service_name;
-        }
-
-        // Use drawbox for the title
-        std::string drawbox_command = "drawbox \" Service Manager \" bold_white";
-        int result = system(drawbox_command.c_str());
-
-        if (result != 0) {
-            print_error("Failed to execute drawbox command.");
-            return;
+            path += '%';
+            path += field;
         }
-
-        //std::cout << "Executing: " << command << "\n";
-        int status = system(command.c_str());
-
-        if (status != 0) {
-			print_error("Failed to execute service command.");
-		} else {
-			print_alert("Service command executed successfully.");
-		}
     }
-    
-    void background_job_complete(pid_t pid) {
-		std::string message = "Background job " + std::to_string(pid) + " completed.";
-		print_alert(message);
-	}
-
-    void list_jobs() {
-		std::string drawbox_command = "drawbox \" Jobs \" bold_white";
-        int result = system(drawbox_command.c_str());
+    return path;
+}
 
-        if (result != 0) {
-            print_error("Failed to execute drawbox command.");
-            return;
-        }
-        //std::cout << "\nActive Jobs:";
-        for (const auto& job : jobs) {
-            std::cout << "PID: " << job.first << " - " << job.second << "\n";
-        }
+// Recording mode. Returns true in the session, which goes on to run the
+// shell and reports its command lines on report_fd; false in the relay
+// once the session has ended, or when recording cannot start (a session
+// that must be recorded does not run unrecorded), with exit_code set.
+static bool record_session(const std::string& path_template, int& report_fd, int& exit_code) {
+    std::string path = recording_path(path_template);
+    struct winsize size = {};
+    ioctl(STDOUT_FILENO, TIOCGWINSZ, &size);
+    SessionRecorder recorder;
+    if (!recorder.open(path, size.ws_col, size.ws_row)) {
+        std::cerr << "secshell: cannot create recording " << path << ": " << strerror(errno) << "\n";
+        exit_code = 1;
+        return false;
     }
-    
-    void execute_piped_commands(const std::vector<std::vector<std::string>>& commands) {
-		int num_commands = commands.size();
-		int pipes[num_commands - 1][2];
-
-		// Create pipes
-		for (int i = 0; i < num_commands - 1; ++i) {
-			if (pipe(pipes[i]) == -1) {
-				print_error("Failed to create pipe");
-				return;
-			}
-		}
-
-		for (int i = 0; i < num_commands; ++i) {
-			pid_t pid = fork();
-			if (pid == 0) { // Child process
-				if (i > 0) {
-					// Redirect stdin from the previous pipe
-					dup2(pipes[i - 1][0], STDIN_FILENO);
-				}
-				if (i < num_commands - 1) {
-					// Redirect stdout to the next pipe
-					dup2(pipes[i][1], STDOUT_FILENO);
-				}
-
-				// Close all pipe ends
-				for (int j = 0; j < num_commands - 1; ++j) {
-					close(pipes[j][0]);
-					close(pipes[j][1]);
-				}
-
-				// Modify grep commands to use --color=always
-				std::vector<std::string> modified_args = commands[i];
-				if (modified_args[0] == "grep") {
-					// Check if --color=always is already present
-					bool has_color_flag = false;
-					for (const auto& arg : modified_args) {
-						if (arg == "--color=always" || arg == "--color=auto") {
-							has_color_flag = true;
-							break;
-						}
-					}
-					// Add --color=always if not already present
-					if (!has_color_flag) {
-						modified_args.push_back("--color=always");
-					}
-				}
-
-				// Execute the command
-				std::vector<char*> argv;
-				for (const auto& arg : modified_args) {
-					argv.push_back(const_cast<char*>(arg.c_str()));
-				}
-				argv.push_back(nullptr);
-
-				if (execvp(argv[0], argv.data()) == -1) {
-					print_error("Command execution failed: " + std::string(strerror(errno)));
-					exit(EXIT_FAILURE);
-				}
-			} else if (pid > 0) { // Parent process
-				if (i > 0) {
-					close(pipes[i - 1][0]);
-					close(pipes[i - 1][1]);
-				}
-			} else {
-				print_error("Fork failed: " + std::string(strerror(errno)));
-				return;
-			}
-		}
-
-		// Wait for all child processes to finish
-		for (int i = 0; i < num_commands; ++i) {
-			wait(NULL);
-		}
-	}
-
-	void execute_system_command(const std::vector<std::string>& args, bool background = false) {
-		if (!is_command_allowed(args[0])) {
-			print_error("Command not permitted: " + args[0]);
-			return;
-		}
-
-		std::vector<std::string> modified_args = args;
-		int input_fd = -1, output_fd = -1;
-
-		// Handle input redirection (<)
-		auto input_redirect_pos = std::find(modified_args.begin(), modified_args.end(), "<");
-		if (input_redirect_pos != modified_args.end()) {
-			if (input_redirect_pos + 1 == modified_args.end()) {
-				print_error("Syntax error: No input file specified for redirection.");
-				return;
-			}
-			std::string input_file = *(input_redirect_pos + 1);
-			input_fd = open(input_file.c_str(), O_RDONLY);
-			if (input_fd == -1) {
-				print_error("Failed to open input file: " + input_file);
-				return;
-			}
-			// Remove the redirection tokens from args
-			modified_args.erase(input_redirect_pos, input_redirect_pos + 2);
-		}
-
-		// Handle output redirection (> or >>)
-		auto output_redirect_pos = std::find(modified_args.begin(), modified_args.end(), ">");
-		auto append_redirect_pos = std::find(modified_args.begin(), modified_args.end(), ">>");
-		if (output_redirect_pos != modified_args.end() || append_redirect_pos != modified_args.end()) {
-			auto redirect_pos = (output_redirect_pos != modified_args.end()) ? output_redirect_pos : append_redirect_pos;
-			if (redirect_pos + 1 == modified_args.end()) {
-				print_error("Syntax error: No output file specified for redirection.");
-				if (input_fd != -1) close(input_fd);
-				return;
-			}
-			std::string output_file = *(redirect_pos + 1);
-			int flags = (redirect_pos == output_redirect_pos) ? (O_WRONLY | O_CREAT | O_TRUNC) : (O_WRONLY | O_CREAT | O_APPEND);
-			output_fd = open(output_file.c_str(), flags, 0644);
-			if (output_fd == -1) {
-				print_error("Failed to open output file: " + output_file);
-				if (input_fd != -1) close(input_fd);
-				return;
-			}
-			// Remove the redirection tokens from args
-			modified_args.erase(redirect_pos, redirect_pos + 2);
-		}
-
-		// Add --color=always for grep
-		if (modified_args[0] == "grep") {
-			bool has_color_flag = false;
-			for (const auto& arg : modified_args) {
-				if (arg == "--color=always" || arg == "--color=auto") {
-					has_color_flag = true;
-					break;
-				}
-			}
-			if (!has_color_flag) {
-				modified_args.push_back("--color=always");
-			}
-		}
-
-		// Add --color=auto for ls
-		if (modified_args[0] == "ls") {
-			modified_args.push_back("--color=auto");
-		}
-
-		pid_t pid = fork();
-		if (pid == 0) { // Child process
-			// Redirect input if necessary
-			if (input_fd != -1) {
-				dup2(input_fd, STDIN_FILENO);
-				close(input_fd);
-			}
-
-			// Redirect output if necessary
-			if (output_fd != -1) {
-				dup2(output_fd, STDOUT_FILENO);
-				close(output_fd);
-			}
-
-			// Prepare arguments for execvp
-			std::vector<char*> argv;
-			for (const auto& arg : modified_args) {
-				argv.push_back(const_cast<char*>(arg.c_str()));
-			}
-			argv.push_back(nullptr);
-
-			// Execute the command
-			if (execvp(argv[0], argv.data()) == -1) {
-				print_error("Command execution failed: " + std::string(strerror(errno)));
-				exit(EXIT_FAILURE);
-			}
-		} else if (pid > 0) { // Parent process
-			// Close file descriptors in the parent process
-			if (input_fd != -1) close(input_fd);
-			if (output_fd != -1) close(output_fd);
-
-			// Track the job
-			jobs[pid] = args[0];
-			if (!background) {
-				int status;
-				waitpid(pid, &status, 0); // Wait for the child process to finish
-				if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
-					print_error("Command exited with status: " + std::to_string(WEXITSTATUS(status)));
-				}
-				jobs.erase(pid); // Remove the job from tracking
-			} else {
-				std::string message = "[" + std::to_string(pid) + "] " + args[0] + " running in background";
-				print_alert(message);
-			}
-		} else {
-			print_error("Fork failed: " + std::string(strerror(errno)));
-		}
-	}
-
-	void display_help() {
-		// Use the drawbox binary to draw the title box
-		std::string drawbox_command = "drawbox \" SecShell Help \" bold_white";
-		int result = system(drawbox_command.c_str());
-
-		if (result != 0) {
-			print_error("Failed to execute drawbox command.");
-			return;
-		}
-
-		std::cout <<
-			"\n\033[36mBuilt-in Commands:\033[0m\n"
-			"  \033[1mhelp\033[0m       - Show this help message\n"
-			"  \033[1mexit\033[0m       - Exit the shell\n"
-			"  \033[1mdrawbox\033[0m    - Create a text box\n"
-			"               Usage: drawbox \"Your text here\" [solid] [bg_color] [text_color]\n"
-			"  \033[1mservices\033[0m   - Manage system services\n"
-			"               Usage: services <start|stop|restart|status|list> <service_name>\n"
-			"  \033[1mjobs\033[0m      - List active background jobs\n"
-			"  \033[1mcd\033[0m        - Change directory\n"
-			"               Usage: cd [directory]\n"
-			"  \033[1mhistory\033[0m    - Show command history\n"
-			"  \033[1mexport\033[0m     - Set an environment variable\n"
-			"               Usage: export VAR=value\n"
-			"  \033[1menv\033[0m        - List all environment variables\n"
-			"  \033[1munset\033[0m      - Unset an environment variable\n"
-			"               Usage: unset VAR\n"
-			"  \033[1mreload\033[0m     - Reload the blacklist of commands\n" // Add the reload command
-			"\n\033[36mAllowed System Commands:\033[0m\n";
-
-		// Display whitelisted commands
-		for (const auto& cmd : ALLOWED_COMMANDS) {
-			std::cout << "  - " << cmd << "\n";
-		}
-
-		std::cout << "\n\033[36mSecurity Features:\033[0m\n"
-			"  - Command whitelisting\n"
-			"  - Input sanitization\n"
-			"  - Process isolation\n"
-			"  - Job tracking\n"
-			"  - Service Management\n"
-			"  - Background job execution\n"
-			"  - Piped command execution\n"
-			"  - Input/output redirection\n"
-			"\n\033[36mExamples:\033[0m\n"
-			"  > drawbox \"Security Alert\" solid green white\n"
-			"  > ls -l\n"
-			"  > jobs\n"
-			"  > services list\n"
-			"  > export MY_VAR=value\n"
-			"  > env\n"
-			"  > unset MY_VAR\n"
-			"  > history\n"
-			"  > blacklist\n"
-			"  > edit-blacklist\n"
-			"  > exit\n"
-			"\n\033[36mNote:\033[0m\n"
-			"\nAll commands are subject to security checks and sanitization.\n"
-			"Only executables from trusted directories are permitted.\n\033[0m";
-	}
-
-    bool is_command_allowed(const std::string& cmd) {
-        // Check if the command is blacklisted
-        if (std::find(BLACKLISTED_COMMANDS.begin(), BLACKLISTED_COMMANDS.end(), cmd)
-            != BLACKLISTED_COMMANDS.end()) {
-            return false; // Command is blacklisted
-        }
-
-        // If not blacklisted, check if it's in the allowed directories
-        for (const auto& dir : ALLOWED_DIRS) {
-            std::string path = dir + cmd;
-            if (access(path.c_str(), X_OK) == 0) {
-                return true;
-            }
-        }
+    PtyRelay relay;
+    int status;
+    if (relay.fork_session(recorder, PtyRelay::Options(), status)) {
+        report_fd = relay.command_fd();
+        return true;
+    }
+    if (status == -1) {
+        std::cerr << "secshell: cannot set up a pseudo-terminal for recording: " << strerror(errno) << "\n";
+        recorder.detach();
+        unlink(path.c_str());
+        exit_code = 1;
         return false;
     }
+    exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    return false;
+}
 
-    void print_alert(const std::string& message) {
-		std::string drawbox_command = "drawbox \"" + message + "\" bold_yellow";
-		int result = system(drawbox_command.c_str());
-		if (result != 0) {
-			std::cerr << "\033[33m[ALERT] " << message << "\033[0m\n"; // Fallback if drawbox fails
-		}
-	}
-
-	void print_error(const std::string& message) {
-		std::string drawbox_command = "drawbox \"" + message + "\" bold_red";
-		int result = system(drawbox_command.c_str());
-		if (result != 0) {
-			std::cerr << "\033[31m[ERROR] " << message << "\033[0m\n"; // Fallback if drawbox fails
-		}
-	}
-
-    std::vector<std::string> parse_arguments(const std::string& input) {
-		std::vector<std::string> args;
-		std::string arg;
-		bool in_quotes = false;
-		char quote_char = '\0';
-		bool escape = false;
-
-		for (size_t i = 0; i < input.length(); ++i) {
-			char c = input[i];
-
-			if (escape) {
-				arg += c;
-				escape = false;
-				continue;
-			}
-
-			if (c == '\\') {
-				escape = true;
-				continue;
-			}
-
-			if (c == '"' || c == '\'') {
-				if (in_quotes && c == quote_char) {
-					in_quotes = false;
-					quote_char = '\0';
-				} else if (!in_quotes) {
-					in_quotes = true;
-					quote_char = c;
-				} else {
-					arg += c;
-				}
-			} else if (c == '$' && !in_quotes) {
-				// Handle environment variable expansion
-				std::string var_name;
-				while (i + 1 < input.length() && (isalnum(input[i + 1]) || input[i + 1] == '_')) {
-					var_name += input[++i];
-				}
-				const char* var_value = getenv(var_name.c_str());
-				if (var_value) {
-					arg += var_value;
-				}
-			} else if (c == ' ' && !in_quotes) {
-				if (!arg.empty()) {
-					args.push_back(arg);
-					arg.clear();
-				}
-			} else {
-				arg += c;
-			}
-		}
-
-		if (!arg.empty()) {
-			args.push_back(arg);
-		}
-
-		return args;
-	}
-
-    static void signal_handler(int signum) {
-        std::cout << "\nReceived signal " << signum << ". Use 'exit' to quit. Press ENTER to continue...\n";
+static int run_invocation(SecShell& shell, const Invocation& invocation) {
+    if (invocation.have_command) {
+        return shell.run_command(invocation.command);
     }
-};
-
-// Define the load_blacklist function outside the class
-void SecShell::load_blacklist(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file) {
-        print_error("Failed to open blacklist file: " + filename);
-        return;
+    if (invocation.read_stdin) {
+        return shell.run_batch(std::cin);
     }
-
-    std::string command;
-    while (std::getline(file, command)) {
-        // Remove any leading/trailing whitespace from the command
-        command.erase(0, command.find_first_not_of(" \t\n\r\f\v"));
-        command.erase(command.find_last_not_of(" \t\n\r\f\v") + 1);
-
-        if (!command.empty()) {
-            BLACKLISTED_COMMANDS.push_back(command);
+    if (!invocation.script.empty()) {
+        std::ifstream file(invocation.script);
+        if (!file) {
+            std::cerr << "secshell: cannot open script: " << invocation.script << "\n";
+            return 127;
         }
+        return shell.run_batch(file);
     }
+
+    shell.run();
+    return 0;
 }
 
-// Function to get the directory of the executable
-std::string get_executable_directory() {
-    char exe_path[PATH_MAX];
-    ssize_t len = readlink("/proc/self/exe", exe_path, sizeof(exe_path) - 1);
-    if (len == -1) {
-        std::cerr << "Failed to get executable path." << std::endl;
-        return "";
+// secshelld: serves sessions until stopped. In each forked session this
+// returns the session's exit status, like main does for a standalone shell.
+static int run_daemon(const Invocation& invocation) {
+    std::string exe_dir = get_executable_directory();
+    if (exe_dir.empty()) {
+        return 1;
+    }
+    SecShell shell(exe_dir + "/.blacklist", SecShell::Zygote{});
+    SessionDaemon daemon(shell, invocation.socket_path);
+    SessionDaemon::Session session;
+    if (!daemon.serve(session)) {
+        return daemon.exit_status();
+    }
+
+    Invocation client;
+    if (!parse_invocation(session.args, client) || client.daemon || client.connect) {
+        print_usage("secshell");
+        session.finish(2);
+        return 2;
+    }
+    StartupTrace trace;
+    shell.begin_session(client.interactive());
+    trace.mark("begin_session");
+    if (client.interactive()) {
+        BoxRenderer::write_all(STDOUT_FILENO, session.clear);
+    }
+    if (client.startup_trace) {
+        trace.report();
     }
-    exe_path[len] = '\0';
-    return std::string(dirname(exe_path));
+    int status = run_invocation(shell, client);
+    session.finish(status);
+    return status;
 }
 
 int main(int argc, char* argv[]) {
+    Invocation invocation;
+    const char* base = strrchr(argv[0], '/');
+    invocation.daemon = std::string(base ? base + 1 : argv[0]) == "secshelld";
+    if (!parse_invocation(std::vector<std::string>(argv + 1, argv + argc), invocation)) {
+        print_usage(argv[0]);
+        return 2;
+    }
+    if (invocation.daemon) {
+        return run_daemon(invocation);
+    }
+    if (!invocation.replay_path.empty()) {
+        return run_replay(invocation);
+    }
+    int report_fd = -1;
+    const char* record_env = getenv("SECSHELL_RECORD");
+    std::string record_path = !invocation.record_path.empty() ? invocation.record_path : record_env ? record_env : "";
+    if (!record_path.empty() && invocation.interactive() && isatty(STDIN_FILENO)) {
+        int exit_code;
+        if (!record_session(record_path, report_fd, exit_code)) {
+            return exit_code;
+        }
+    }
+    if (invocation.connect) {
+        int status;
+        if (SessionClient(invocation.socket_path).run(invocation.session_args, status)) {
+            return status;
+        }
+    }
+    bool interactive = invocation.interactive();
+
+    if (interactive) {
 	#ifdef _WIN32
         system("cls");
     #elif defined(unix) || defined(__unix__) || defined(__unix)
         system("clear");
     #endif
-	
+    }
+
+    StartupTrace trace;
+
     // Get the directory of the executable
     std::string exe_dir = get_executable_directory();
     if (exe_dir.empty()) {
         return 1; // Exit if we couldn't get the executable directory
     }
+    trace.mark("exe-dir lookup");
 
     // Construct the path to the .blacklist file
     std::string blacklist_path = exe_dir + "/.blacklist";
 
-    // Create and run the shell
-    SecShell shell(blacklist_path);
-    shell.run();
-    return 0;
+    // Create the shell
+    SecShell shell(blacklist_path, interactive, invocation.startup_trace ? &trace : nullptr);
+    shell.report_commands(report_fd);
+    if (invocation.startup_trace) {
+        trace.report();
+    }
+
+    return run_invocation(shell, invocation);
 }
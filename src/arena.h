@@ -0,0 +1,68 @@
+#ifndef SECSHELL_ARENA_H
+#define SECSHELL_ARENA_H
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Bump allocator for per-command parse data. Everything allocated from it is
+// released together by reset(), which keeps the blocks for the next command;
+// only trivially destructible types belong here.
+class Arena {
+public:
+    explicit Arena(size_t block_size = 4096) : block_size(block_size) {}
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t align) {
+        for (;;) {
+            if (current < blocks.size()) {
+                size_t offset = (used + align - 1) & ~(align - 1);
+                if (offset + size <= blocks[current].size) {
+                    used = offset + size;
+                    return blocks[current].data.get() + offset;
+                }
+                ++current;
+                used = 0;
+                continue;
+            }
+            size_t size_needed = std::max(block_size, size + align);
+            blocks.push_back({std::unique_ptr<char[]>(new char[size_needed]), size_needed});
+        }
+    }
+
+    template <typename T>
+    T* make() {
+        static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T();
+    }
+
+    std::string_view copy(std::string_view text) {
+        char* data = static_cast<char*>(allocate(text.size() + 1, 1));
+        memcpy(data, text.data(), text.size());
+        data[text.size()] = '\0';
+        return std::string_view(data, text.size());
+    }
+
+    void reset() {
+        current = 0;
+        used = 0;
+    }
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+    size_t block_size;
+    std::vector<Block> blocks;
+    size_t current = 0;
+    size_t used = 0;
+};
+
+#endif
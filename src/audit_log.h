@@ -0,0 +1,409 @@
+#ifndef SECSHELL_AUDIT_LOG_H
+#define SECSHELL_AUDIT_LOG_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pwd.h>
+#include <sys/file.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "box_renderer.h"
+#include "helper_thread.h"
+
+// Asynchronous audit trail of policy decisions and executions. The shell
+// thread serializes each event into a slot of a single-producer ring and
+// returns; a background writer drains the ring in batches, appends them to
+// a compact binary log with one write(2) and one fsync per batch, and
+// rotates the file once it grows past max_bytes. tools/audit_decode.cpp
+// turns a log back into JSON lines.
+//
+// File layout: "SECAUDIT", u32 version, u32 uid, string user, then records.
+// A record is u32 size (including itself), u8 kind, u8 verdict, u16 argc,
+// i64 realtime ns, i32 session (shell pid), u32 uid, i32 pid, i32 status,
+// u64 wall us, u64 cpu us, string cwd and argc argv strings. Strings are u32
+// length plus bytes. Concurrent sessions, of any user, may share a log:
+// a new file is created mode 0622 so others can append but not read it,
+// every batch is one O_APPEND write under a shared flock, and the header
+// (which names only the user who created the file) and rotation are done
+// under an exclusive one. A writer whose file was rotated away by another
+// session notices by inode and reopens the path. Rotation renames files,
+// so the directory must be writable by every user sharing the log.
+//
+// The descriptor belongs to the writer. If reopening or a write fails, the
+// batch is lost, the writer retries with the next one, and take_error()
+// hands the errno to the shell to report.
+class AuditLog {
+public:
+    enum Kind : uint8_t { Decision = 0, Execution = 1 };
+    enum Verdict : uint8_t { Allowed = 0, Blacklisted = 1, NotPermitted = 2, Denied = 3 };
+
+    struct Record {
+        Kind kind = Decision;
+        Verdict verdict = Allowed;
+        int64_t time_ns = 0;
+        int32_t session = 0;
+        uint32_t uid = 0;
+        int32_t pid = 0;
+        int32_t status = 0;
+        uint64_t wall_us = 0;
+        uint64_t cpu_us = 0;
+        std::string cwd;
+        std::vector<std::string> argv;
+    };
+
+    struct Header {
+        uint32_t version = 0;
+        uint32_t uid = 0;
+        std::string user;
+    };
+
+    static const uint32_t VERSION = 2;
+    static const size_t RING_SLOTS = 1024;
+    static const int FLUSH_INTERVAL_MS = 200;
+    static const int KEEP_ROTATED = 5;
+
+    ~AuditLog() {
+        close();
+    }
+
+    bool enabled() const { return active; }
+
+    bool open(const std::string& log_path, uint64_t rotate_bytes) {
+        close();
+        path = log_path;
+        max_bytes = rotate_bytes;
+        uid = getuid();
+        session = getpid();
+        struct passwd* pw = getpwuid(uid);
+        user = pw ? pw->pw_name : std::to_string(uid);
+        char buffer[PATH_MAX];
+        cwd = getcwd(buffer, sizeof(buffer)) ? buffer : "";
+
+        if (!open_file() || pipe2(wake_pipe, O_CLOEXEC | O_NONBLOCK) == -1) {
+            close();
+            return false;
+        }
+        for (auto& slot : ring) slot.reserve(256);
+
+        writer = start_helper_thread([this] { write_loop(); });
+        active = true;
+        return true;
+    }
+
+    // Drains everything still queued, syncs and stops the writer.
+    void close() {
+        active = false;
+        if (writer.joinable()) {
+            stopping.store(true, std::memory_order_release);
+            wake();
+            writer.join();
+            stopping.store(false, std::memory_order_relaxed);
+        }
+        for (int& p : wake_pipe) {
+            if (p != -1) ::close(p);
+            p = -1;
+        }
+        if (fd != -1) ::close(fd);
+        fd = -1;
+    }
+
+    // Tracks the shell's working directory so the hot path never calls getcwd.
+    void set_cwd(const std::string& directory) { cwd = directory; }
+
+    void decision(Verdict verdict, const std::vector<std::string>& argv) {
+        if (!active) return;
+        push(Decision, verdict, session, 0, 0, 0, argv);
+    }
+
+    void execution(pid_t pid, int status, uint64_t wall_us, uint64_t cpu_us, const std::vector<std::string>& argv) {
+        if (!active) return;
+        push(Execution, Allowed, pid, status, wall_us, cpu_us, argv);
+    }
+
+    static uint64_t monotonic_us() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+    }
+
+    static uint64_t cpu_us(const struct rusage& usage) {
+        return static_cast<uint64_t>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 +
+               usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+    }
+
+    const std::string& file() const { return path; }
+
+    uint64_t records_written() const { return written.load(std::memory_order_relaxed); }
+    uint64_t batches_written() const { return batches.load(std::memory_order_relaxed); }
+    uint64_t producer_stalls() const { return stalls; }
+    uint64_t records_lost() const { return lost.load(std::memory_order_relaxed); }
+
+    // The errno of the first failed reopen or write since the last call, or 0
+    int take_error() { return error.exchange(0, std::memory_order_relaxed); }
+
+    // Offline decoding. read_header returns the offset of the first record,
+    // or 0 if data does not start with a valid header; read_record returns
+    // the offset just past the record, or 0 on a truncated or corrupt one.
+    static size_t read_header(const char* data, size_t size, Header& header) {
+        if (size < 8 || memcmp(data, MAGIC, 8) != 0) return 0;
+        size_t pos = 8;
+        if (!get(data, size, pos, header.version) || !get(data, size, pos, header.uid) ||
+            !get_string(data, size, pos, header.user)) {
+            return 0;
+        }
+        return pos;
+    }
+
+    static size_t read_record(const char* data, size_t size, size_t pos, Record& record) {
+        uint32_t length;
+        size_t start = pos;
+        if (!get(data, size, pos, length) || length < 4 || length > size - start) return 0;
+        size_t end = start + length;
+        uint8_t kind, verdict;
+        uint16_t argc;
+        if (!get(data, end, pos, kind) || !get(data, end, pos, verdict) || !get(data, end, pos, argc) ||
+            !get(data, end, pos, record.time_ns) || !get(data, end, pos, record.session) ||
+            !get(data, end, pos, record.uid) || !get(data, end, pos, record.pid) ||
+            !get(data, end, pos, record.status) || !get(data, end, pos, record.wall_us) ||
+            !get(data, end, pos, record.cpu_us) || !get_string(data, end, pos, record.cwd)) {
+            return 0;
+        }
+        record.kind = static_cast<Kind>(kind);
+        record.verdict = static_cast<Verdict>(verdict);
+        record.argv.resize(argc);
+        for (auto& arg : record.argv) {
+            if (!get_string(data, end, pos, arg)) return 0;
+        }
+        return end;
+    }
+
+private:
+    static constexpr const char* MAGIC = "SECAUDIT";
+
+    bool active = false;           // Shell thread only
+    int fd = -1;                   // Writer thread only, once it runs
+    std::string path;
+    uint64_t max_bytes = 0;
+    uint64_t file_bytes = 0;
+    uint64_t header_bytes = 0;
+    uid_t uid = 0;
+    pid_t session = 0;
+    std::string user;
+    std::string cwd;
+
+    // Single producer (the shell thread), single consumer (the writer).
+    std::string ring[RING_SLOTS];
+    std::atomic<size_t> head{0};   // Next slot to fill; written by the producer
+    std::atomic<size_t> tail{0};   // Next slot to drain; written by the writer
+    uint64_t stalls = 0;           // Times the producer found the ring full
+
+    std::thread writer;
+    int wake_pipe[2] = {-1, -1};
+    std::atomic<bool> stopping{false};
+    std::atomic<uint64_t> written{0};
+    std::atomic<uint64_t> batches{0};
+    std::atomic<uint64_t> lost{0};
+    std::atomic<int> error{0};
+
+    template <typename T>
+    static void put(std::string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    static void put_string(std::string& out, const std::string& value) {
+        put(out, static_cast<uint32_t>(value.size()));
+        out += value;
+    }
+
+    template <typename T>
+    static bool get(const char* data, size_t size, size_t& pos, T& value) {
+        if (size < pos || size - pos < sizeof(T)) return false;
+        memcpy(&value, data + pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+
+    static bool get_string(const char* data, size_t size, size_t& pos, std::string& value) {
+        uint32_t length;
+        if (!get(data, size, pos, length) || size - pos < length) return false;
+        value.assign(data + pos, length);
+        pos += length;
+        return true;
+    }
+
+    void wake() {
+        char c = 0;
+        (void)!write(wake_pipe[1], &c, 1);
+    }
+
+    void push(Kind kind, Verdict verdict, pid_t pid, int status, uint64_t wall_us, uint64_t cpu_us,
+              const std::vector<std::string>& argv) {
+        size_t slot = head.load(std::memory_order_relaxed);
+        // A full ring means the disk is far behind; wait rather than lose records
+        while (slot - tail.load(std::memory_order_acquire) >= RING_SLOTS) {
+            ++stalls;
+            wake();
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        std::string& out = ring[slot % RING_SLOTS];
+        out.clear();
+        put(out, uint32_t(0)); // Size, patched below
+        put(out, static_cast<uint8_t>(kind));
+        put(out, static_cast<uint8_t>(verdict));
+        put(out, static_cast<uint16_t>(std::min<size_t>(argv.size(), UINT16_MAX)));
+        put(out, static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec);
+        put(out, static_cast<int32_t>(session));
+        put(out, static_cast<uint32_t>(uid));
+        put(out, static_cast<int32_t>(pid));
+        put(out, static_cast<int32_t>(status));
+        put(out, wall_us);
+        put(out, cpu_us);
+        put_string(out, cwd);
+        for (size_t i = 0; i < argv.size() && i < UINT16_MAX; ++i) put_string(out, argv[i]);
+        uint32_t size = out.size();
+        memcpy(&out[0], &size, sizeof(size));
+
+        head.store(slot + 1, std::memory_order_release);
+        if (slot + 1 - tail.load(std::memory_order_relaxed) == RING_SLOTS / 2) wake();
+    }
+
+    // Opens path, creating it for every user to append to, and writes the
+    // header if the file is empty. The exclusive lock keeps two sessions
+    // that find it empty from both writing one.
+    bool open_file() {
+        fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+        if (fd == -1 && errno == ENOENT) {
+            fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_EXCL | O_CLOEXEC, 0622);
+            if (fd != -1) fchmod(fd, 0622); // Past the umask
+            else if (errno == EEXIST) fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+        }
+        if (fd == -1) return false;
+
+        std::string header(MAGIC, 8);
+        put(header, VERSION);
+        put(header, static_cast<uint32_t>(uid));
+        put_string(header, user);
+        header_bytes = header.size();
+        flock(fd, LOCK_EX);
+        struct stat st;
+        file_bytes = fstat(fd, &st) == 0 ? st.st_size : 0;
+        bool ok = file_bytes > 0 || BoxRenderer::write_all(fd, header);
+        int saved = errno;
+        flock(fd, LOCK_UN);
+        if (!ok) {
+            ::close(fd);
+            fd = -1;
+            errno = saved;
+            return false;
+        }
+        if (file_bytes == 0) file_bytes = header.size();
+        return true;
+    }
+
+    // Whether fd is still the file at path, rather than one another
+    // session rotated away
+    bool is_current() const {
+        struct stat mine, named;
+        return fstat(fd, &mine) == 0 && stat(path.c_str(), &named) == 0 && mine.st_dev == named.st_dev &&
+               mine.st_ino == named.st_ino;
+    }
+
+    // Opens the file at path if need be and takes a shared lock on it,
+    // reopening while other sessions rotate it away underneath.
+    bool lock_current() {
+        for (int tries = 0; tries < 3; ++tries) {
+            if (fd == -1 && !open_file()) return false;
+            flock(fd, LOCK_SH);
+            if (is_current()) return true;
+            ::close(fd);
+            fd = -1;
+        }
+        errno = ESTALE;
+        return false;
+    }
+
+    // Writer thread: keeps the first errno until the shell takes it
+    void failed(int err) {
+        int none = 0;
+        error.compare_exchange_strong(none, err ? err : EIO, std::memory_order_relaxed);
+    }
+
+    // Shifts path.N to path.N+1, dropping the oldest, and closes the file;
+    // the next lock_current() starts a new one. If another session got the
+    // exclusive lock first and rotated already, there is nothing to shift.
+    void rotate() {
+        flock(fd, LOCK_EX);
+        if (is_current()) {
+            fsync(fd);
+            for (int i = KEEP_ROTATED - 1; i >= 1; --i) {
+                rename((path + "." + std::to_string(i)).c_str(), (path + "." + std::to_string(i + 1)).c_str());
+            }
+            rename(path.c_str(), (path + ".1").c_str());
+        }
+        ::close(fd);
+        fd = -1;
+    }
+
+    void write_loop() {
+        struct pollfd wake_fd = {wake_pipe[0], POLLIN, 0};
+        std::string batch;
+        char drain[64];
+        for (;;) {
+            bool stop = stopping.load(std::memory_order_acquire);
+            if (!stop) {
+                poll(&wake_fd, 1, FLUSH_INTERVAL_MS);
+                while (read(wake_pipe[0], drain, sizeof(drain)) > 0) {}
+            }
+
+            size_t first = tail.load(std::memory_order_relaxed);
+            size_t last = head.load(std::memory_order_acquire);
+            batch.clear();
+            for (size_t i = first; i < last; ++i) batch += ring[i % RING_SLOTS];
+            tail.store(last, std::memory_order_release);
+
+            // Group commit: one write and one fsync for the whole batch
+            if (!batch.empty()) {
+                // A failed reopen is retried with every batch. Another
+                // session may have grown or rotated the file meanwhile.
+                bool ok = lock_current();
+                struct stat st;
+                if (ok && fstat(fd, &st) == 0) file_bytes = st.st_size;
+                if (ok && max_bytes > 0 && file_bytes > header_bytes && file_bytes + batch.size() > max_bytes) {
+                    rotate();
+                    ok = lock_current();
+                }
+                ok = ok && BoxRenderer::write_all(fd, batch);
+                if (ok) {
+                    fdatasync(fd);
+                    flock(fd, LOCK_UN);
+                    file_bytes += batch.size();
+                    written.fetch_add(last - first, std::memory_order_relaxed);
+                    batches.fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    failed(errno);
+                    if (fd != -1) flock(fd, LOCK_UN);
+                    lost.fetch_add(last - first, std::memory_order_relaxed);
+                }
+            }
+            if (stop) return;
+        }
+    }
+};
+
+#endif
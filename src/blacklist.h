@@ -0,0 +1,187 @@
+#ifndef SECSHELL_BLACKLIST_H
+#define SECSHELL_BLACKLIST_H
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "helper_thread.h"
+
+// Immutable set of blacklisted command names. Lookups probe a flat
+// open-addressed table; entries keep their file order for listing.
+class BlacklistSnapshot {
+public:
+    explicit BlacklistSnapshot(std::vector<std::string> commands) {
+        size_t capacity = 16;
+        while (capacity < commands.size() * 2) capacity <<= 1;
+        slots.assign(capacity, 0);
+
+        for (auto& command : commands) {
+            size_t slot = find_slot(command);
+            if (slots[slot] != 0) continue; // Duplicate line
+            entries.push_back(std::move(command));
+            slots[slot] = static_cast<uint32_t>(entries.size());
+        }
+    }
+
+    // Parses a blacklist file: one command per line, surrounding whitespace
+    // ignored. Returns nullptr if the file cannot be opened.
+    static std::shared_ptr<const BlacklistSnapshot> load(const std::string& filename) {
+        std::ifstream file(filename);
+        if (!file) return nullptr;
+
+        std::vector<std::string> commands;
+        std::string command;
+        while (std::getline(file, command)) {
+            // Remove any leading/trailing whitespace from the command
+            command.erase(0, command.find_first_not_of(" \t\n\r\f\v"));
+            command.erase(command.find_last_not_of(" \t\n\r\f\v") + 1);
+
+            if (!command.empty()) {
+                commands.push_back(command);
+            }
+        }
+        return std::make_shared<const BlacklistSnapshot>(std::move(commands));
+    }
+
+    bool contains(const std::string& command) const {
+        return slots[find_slot(command)] != 0;
+    }
+
+    const std::vector<std::string>& commands() const { return entries; }
+
+private:
+    std::vector<std::string> entries;
+    std::vector<uint32_t> slots; // 0 = empty, otherwise index into entries + 1
+
+    size_t find_slot(const std::string& command) const {
+        size_t mask = slots.size() - 1;
+        size_t slot = std::hash<std::string>{}(command) & mask;
+        while (slots[slot] != 0 && entries[slots[slot] - 1] != command) {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+};
+
+// Holds the active blacklist snapshot. A watcher thread re-parses the file
+// when it changes and publishes a new snapshot; the shell thread only pays
+// for an atomic generation check per lookup.
+class Blacklist {
+public:
+    Blacklist() : current(std::make_shared<const BlacklistSnapshot>(std::vector<std::string>())) {}
+
+    ~Blacklist() {
+        stop_watching();
+    }
+
+    void publish(std::shared_ptr<const BlacklistSnapshot> snapshot) {
+        std::atomic_store(&current, std::move(snapshot));
+        generation.fetch_add(1, std::memory_order_release);
+    }
+
+    // Shell thread only: refreshes the cached snapshot if a newer one was published.
+    const BlacklistSnapshot& snapshot() {
+        unsigned long latest = generation.load(std::memory_order_acquire);
+        if (!cached || latest != cached_generation) {
+            cached = std::atomic_load(&current);
+            cached_generation = latest;
+        }
+        return *cached;
+    }
+
+    bool contains(const std::string& command) {
+        return snapshot().contains(command);
+    }
+
+    unsigned long version() const {
+        return generation.load(std::memory_order_acquire);
+    }
+
+    // Watches the file's directory so editors that replace the file via
+    // rename are picked up too. A file that disappears keeps the old policy.
+    void watch(const std::string& filename) {
+        stop_watching();
+
+        std::string path = filename;
+        size_t slash = path.rfind('/');
+        std::string dir = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+        std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+
+        int inotify_fd = inotify_init1(IN_CLOEXEC);
+        if (inotify_fd == -1) return;
+        if (inotify_add_watch(inotify_fd, dir.c_str(),
+                IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MOVED_FROM) == -1 ||
+            pipe2(stop_pipe, O_CLOEXEC) == -1) {
+            close(inotify_fd);
+            return;
+        }
+
+        watcher = start_helper_thread([this, inotify_fd, filename, name] {
+            watch_loop(inotify_fd, filename, name);
+            close(inotify_fd);
+        });
+    }
+
+private:
+    std::shared_ptr<const BlacklistSnapshot> current;
+    std::atomic<unsigned long> generation{0};
+    std::shared_ptr<const BlacklistSnapshot> cached;
+    unsigned long cached_generation = 0;
+    std::thread watcher;
+    int stop_pipe[2] = {-1, -1};
+
+    void stop_watching() {
+        if (watcher.joinable()) {
+            char c = 0;
+            (void)!write(stop_pipe[1], &c, 1);
+            watcher.join();
+        }
+        for (int& fd : stop_pipe) {
+            if (fd != -1) close(fd);
+            fd = -1;
+        }
+    }
+
+    void watch_loop(int inotify_fd, const std::string& filename, const std::string& name) {
+        alignas(struct inotify_event) char buffer[4096];
+        struct pollfd fds[2] = {{inotify_fd, POLLIN, 0}, {stop_pipe[0], POLLIN, 0}};
+        bool pending = false;
+
+        for (;;) {
+            // Once a change is seen, wait briefly for the writer to finish
+            // before parsing so a half-written file is never published.
+            int ready = poll(fds, 2, pending ? 20 : -1);
+            if (ready < 0 && errno != EINTR) return;
+            if (fds[1].revents) return;
+
+            if (ready > 0 && fds[0].revents & POLLIN) {
+                ssize_t len = read(inotify_fd, buffer, sizeof(buffer));
+                for (char* p = buffer; len > 0 && p < buffer + len;) {
+                    auto* event = reinterpret_cast<struct inotify_event*>(p);
+                    if (event->mask & IN_Q_OVERFLOW || (event->len > 0 && name == event->name)) {
+                        pending = true;
+                    }
+                    p += sizeof(struct inotify_event) + event->len;
+                }
+            } else if (ready == 0 && pending) {
+                pending = false;
+                auto snapshot = BlacklistSnapshot::load(filename);
+                if (snapshot) publish(std::move(snapshot));
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,256 @@
+#ifndef SECSHELL_BOX_RENDERER_H
+#define SECSHELL_BOX_RENDERER_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+// Native replacement for the external drawbox binary. Frames are rendered
+// once per (text, style, terminal width) and written with a single write(2).
+class BoxRenderer {
+public:
+    // Display width of a UTF-8 string in terminal cells. ANSI escape
+    // sequences take no space; wide CJK/emoji code points take two cells.
+    static size_t display_width(const std::string& s) {
+        size_t width = 0;
+        size_t i = 0;
+        while (i < s.size()) {
+            if (s[i] == '\033') {
+                i = skip_escape(s, i);
+                continue;
+            }
+            char32_t cp;
+            i = decode_utf8(s, i, cp);
+            width += codepoint_width(cp);
+        }
+        return width;
+    }
+
+    // Returns the fully rendered frame, building and caching it on a miss.
+    const std::string& render(const std::string& text, const std::string& style, int term_width) {
+        std::string key = text;
+        key += '\0';
+        key += style;
+        key += '\0';
+        key += std::to_string(term_width);
+
+        auto it = cache.find(key);
+        if (it != cache.end()) return it->second;
+
+        if (cache.size() >= MAX_CACHED_FRAMES) cache.clear();
+        return cache.emplace(std::move(key), build_frame(text, style, term_width)).first->second;
+    }
+
+    // Renders the box and writes it to fd. Returns false if the write failed.
+    bool draw(int fd, const std::string& text, const std::string& style) {
+        return write_all(fd, render(text, style, terminal_width(fd)));
+    }
+
+    static int terminal_width(int fd) {
+        struct winsize ws;
+        if (ioctl(fd, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) {
+            return ws.ws_col;
+        }
+        const char* columns = getenv("COLUMNS");
+        if (columns && atoi(columns) > 0) return atoi(columns);
+        return 80;
+    }
+
+    static bool write_all(int fd, const std::string& data) {
+        size_t written = 0;
+        while (written < data.size()) {
+            ssize_t n = write(fd, data.data() + written, data.size() - written);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            written += n;
+        }
+        return true;
+    }
+
+private:
+    static const size_t MAX_CACHED_FRAMES = 256;
+    std::unordered_map<std::string, std::string> cache;
+
+    struct Style {
+        std::string border;   // SGR sequence for the frame
+        std::string text;     // SGR sequence for the message
+    };
+
+    static size_t skip_escape(const std::string& s, size_t i) {
+        ++i; // ESC
+        if (i < s.size() && s[i] == '[') {
+            ++i;
+            while (i < s.size() && !(s[i] >= 0x40 && s[i] <= 0x7e)) ++i;
+        }
+        return i < s.size() ? i + 1 : i;
+    }
+
+    // Decodes one code point starting at i and returns the next index.
+    // Malformed bytes decode as U+FFFD and consume a single byte.
+    static size_t decode_utf8(const std::string& s, size_t i, char32_t& cp) {
+        unsigned char c = s[i];
+        int len = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xe ? 3 : (c >> 3) == 0x1e ? 4 : 0;
+        if (len == 0 || i + len > s.size()) {
+            cp = 0xfffd;
+            return i + 1;
+        }
+        cp = len == 1 ? c : c & (0x7f >> len);
+        for (int k = 1; k < len; ++k) {
+            unsigned char cc = s[i + k];
+            if ((cc & 0xc0) != 0x80) {
+                cp = 0xfffd;
+                return i + 1;
+            }
+            cp = (cp << 6) | (cc & 0x3f);
+        }
+        return i + len;
+    }
+
+    static int codepoint_width(char32_t cp) {
+        struct Range { char32_t first, last; };
+        static const Range zero_width[] = {
+            {0x0300, 0x036f}, {0x0483, 0x0489}, {0x0591, 0x05bd}, {0x0610, 0x061a},
+            {0x064b, 0x065f}, {0x0e31, 0x0e3a}, {0x1ab0, 0x1aff}, {0x1dc0, 0x1dff},
+            {0x200b, 0x200f}, {0x202a, 0x202e}, {0x2060, 0x2064}, {0x20d0, 0x20ff},
+            {0xfe00, 0xfe0f}, {0xfe20, 0xfe2f}, {0xfeff, 0xfeff}, {0xe0100, 0xe01ef},
+        };
+        static const Range wide[] = {
+            {0x1100, 0x115f}, {0x2e80, 0x303e}, {0x3041, 0x33ff}, {0x3400, 0x4dbf},
+            {0x4e00, 0x9fff}, {0xa000, 0xa4cf}, {0xac00, 0xd7a3}, {0xf900, 0xfaff},
+            {0xfe30, 0xfe4f}, {0xff00, 0xff60}, {0xffe0, 0xffe6}, {0x1f300, 0x1f64f},
+            {0x1f900, 0x1f9ff}, {0x20000, 0x2fffd}, {0x30000, 0x3fffd},
+        };
+        if (cp < 0x20 || (cp >= 0x7f && cp < 0xa0)) return 0;
+        for (const auto& r : zero_width) {
+            if (cp >= r.first && cp <= r.last) return 0;
+        }
+        for (const auto& r : wide) {
+            if (cp >= r.first && cp <= r.last) return 2;
+        }
+        return 1;
+    }
+
+    static int color_code(const std::string& name) {
+        static const char* names[] = {"black", "red", "green", "yellow", "blue", "magenta", "cyan", "white"};
+        for (int i = 0; i < 8; ++i) {
+            if (name == names[i]) return i;
+        }
+        return -1;
+    }
+
+    // Accepts the same style arguments as drawbox: "bold_<color>",
+    // "<color>", or "solid <bg_color> <text_color>".
+    static Style parse_style(const std::string& spec) {
+        std::vector<std::string> tokens;
+        size_t pos = 0;
+        while (pos < spec.size()) {
+            size_t end = spec.find(' ', pos);
+            if (end == std::string::npos) end = spec.size();
+            if (end > pos) tokens.push_back(spec.substr(pos, end - pos));
+            pos = end + 1;
+        }
+
+        Style style;
+        if (tokens.empty()) return style;
+
+        if (tokens[0] == "solid") {
+            int bg = tokens.size() > 1 ? color_code(tokens[1]) : -1;
+            int fg = tokens.size() > 2 ? color_code(tokens[2]) : -1;
+            std::string sgr = "\033[";
+            if (bg >= 0) sgr += std::to_string(40 + bg);
+            if (fg >= 0) sgr += (bg >= 0 ? ";" : "") + std::to_string(30 + fg);
+            sgr += "m";
+            if (bg >= 0 || fg >= 0) style.border = style.text = sgr;
+        } else if (tokens[0].compare(0, 5, "bold_") == 0) {
+            int fg = color_code(tokens[0].substr(5));
+            style.border = style.text = fg >= 0 ? "\033[1;" + std::to_string(30 + fg) + "m" : "\033[1m";
+        } else {
+            int fg = color_code(tokens[0]);
+            if (fg >= 0) style.border = style.text = "\033[" + std::to_string(30 + fg) + "m";
+        }
+        return style;
+    }
+
+    // Greedy word wrap on display width; words wider than the box are split
+    // at code point boundaries.
+    static std::vector<std::string> wrap(const std::string& text, size_t max_width) {
+        std::vector<std::string> lines;
+        if (display_width(text) <= max_width) {
+            lines.push_back(text);
+            return lines;
+        }
+        std::string line;
+        size_t line_width = 0;
+        size_t i = 0;
+        while (i <= text.size()) {
+            size_t end = text.find(' ', i);
+            if (end == std::string::npos) end = text.size();
+            std::string word = text.substr(i, end - i);
+            size_t word_width = display_width(word);
+
+            if (line_width > 0 && line_width + 1 + word_width > max_width) {
+                lines.push_back(line);
+                line.clear();
+                line_width = 0;
+            }
+            while (word_width > max_width) {
+                size_t cut = 0, cut_width = 0;
+                while (cut < word.size()) {
+                    char32_t cp;
+                    size_t next = decode_utf8(word, cut, cp);
+                    if (cut_width + codepoint_width(cp) > max_width) break;
+                    cut_width += codepoint_width(cp);
+                    cut = next;
+                }
+                if (cut == 0) break;
+                lines.push_back(word.substr(0, cut));
+                word.erase(0, cut);
+                word_width -= cut_width;
+            }
+            if (line_width > 0) {
+                line += ' ';
+                ++line_width;
+            }
+            line += word;
+            line_width += word_width;
+            i = end + 1;
+        }
+        lines.push_back(line);
+        return lines;
+    }
+
+    static std::string build_frame(const std::string& text, const std::string& style_spec, int term_width) {
+        Style style = parse_style(style_spec);
+        const std::string reset = "\033[0m";
+        size_t max_inner = term_width > 8 ? term_width - 4 : 4;
+
+        std::vector<std::string> lines = wrap(text, max_inner);
+        size_t inner = 0;
+        for (const auto& line : lines) inner = std::max(inner, display_width(line));
+
+        std::string horizontal;
+        for (size_t i = 0; i < inner + 2; ++i) horizontal += "─";
+
+        std::string frame;
+        frame.reserve((inner + 8) * 3 * (lines.size() + 2));
+        frame += style.border + "┌" + horizontal + "┐" + reset + "\n";
+        for (const auto& line : lines) {
+            frame += style.border + "│" + style.text + " " + line;
+            frame.append(inner - display_width(line), ' ');
+            frame += " " + style.border + "│" + reset + "\n";
+        }
+        frame += style.border + "└" + horizontal + "┘" + reset + "\n";
+        return frame;
+    }
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef SECSHELL_BUFFERED_WRITER_H
+#define SECSHELL_BUFFERED_WRITER_H
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#include "box_renderer.h"
+
+// Collects output and hands it to write(2) in large chunks, for builtins
+// that can print thousands of lines.
+class BufferedWriter {
+public:
+    explicit BufferedWriter(int fd, size_t capacity = 65536) : fd(fd), capacity(capacity) {
+        buffer.reserve(capacity);
+    }
+
+    ~BufferedWriter() {
+        flush();
+    }
+
+    BufferedWriter& operator<<(std::string_view text) {
+        if (buffer.size() + text.size() > capacity) flush();
+        if (text.size() > capacity) {
+            BoxRenderer::write_all(fd, std::string(text));
+        } else {
+            buffer.append(text.data(), text.size());
+        }
+        return *this;
+    }
+
+    BufferedWriter& operator<<(unsigned long value) {
+        char digits[24];
+        int len = snprintf(digits, sizeof(digits), "%lu", value);
+        return *this << std::string_view(digits, len);
+    }
+
+    bool flush() {
+        bool ok = BoxRenderer::write_all(fd, buffer);
+        buffer.clear();
+        return ok;
+    }
+
+private:
+    int fd;
+    size_t capacity;
+    std::string buffer;
+};
+
+#endif
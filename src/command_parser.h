@@ -0,0 +1,349 @@
+#ifndef SECSHELL_COMMAND_PARSER_H
+#define SECSHELL_COMMAND_PARSER_H
+
+#include <cctype>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "arena.h"
+
+// Parsed command line. Nodes live in an Arena; text views point either into
+// the input line (plain words) or into the arena (words that needed quote
+// removal, escapes or variable expansion).
+struct WordNode {
+    std::string_view text;
+    bool quoted;          // Any part was quoted or escaped; never globbed or split
+    WordNode* next;
+};
+
+struct RedirectNode {
+    enum Kind { Input, Output, Append };
+    Kind kind;
+    std::string_view target;
+    bool quoted;          // As WordNode::quoted
+    RedirectNode* next;
+};
+
+struct CommandNode {
+    WordNode* words;
+    size_t word_count;
+    RedirectNode* redirects;
+    CommandNode* next;
+};
+
+struct PipelineNode {
+    CommandNode* commands;
+    size_t length;
+    bool background;
+};
+
+// Single-pass lexer and parser for SecShell's command grammar:
+//
+//   pipeline := command ('|' command)* ['&']
+//   command  := (word | redirect)+
+//   redirect := ('<' | '>' | '>>') word
+//
+// Single quotes are literal, double quotes allow \" \\ \$ and $VAR, and an
+// unquoted backslash escapes the next character. $NAME, ${NAME} and
+// ${NAME:-default} expand outside single quotes; an unquoted word that
+// expands to nothing is dropped. Pathname expansion is left to the shell
+// (GlobExpander), for words that are not quoted.
+class CommandParser {
+public:
+    using VariableLookup = std::function<const char*(const std::string& name)>;
+
+    explicit CommandParser(Arena& arena, VariableLookup lookup = nullptr)
+        : arena(arena), lookup(lookup ? std::move(lookup) : [](const std::string& name) { return getenv(name.c_str()); }) {}
+
+    // Returns nullptr and sets error on a syntax error. A blank line parses
+    // to a pipeline with no commands.
+    const PipelineNode* parse(std::string_view input, std::string& error) {
+        line = input;
+        pos = 0;
+        auto* pipeline = arena.make<PipelineNode>();
+        CommandNode** command_tail = &pipeline->commands;
+        CommandNode* command = nullptr;
+        WordNode** word_tail = nullptr;
+        RedirectNode** redirect_tail = nullptr;
+
+        Token token;
+        for (;;) {
+            if (!next_token(token, error)) return nullptr;
+            if (token.type == Token::End) break;
+
+            if (pipeline->background) {
+                error = "Syntax error: '&' must end the command.";
+                return nullptr;
+            }
+
+            if (token.type == Token::Pipe || token.type == Token::Background) {
+                if (!command) {
+                    error = std::string("Syntax error: Missing command before '") + (token.type == Token::Pipe ? "|" : "&") + "'.";
+                    return nullptr;
+                }
+                if (token.type == Token::Background) {
+                    pipeline->background = true;
+                }
+                command = nullptr;
+                if (token.type == Token::Pipe) {
+                    if (!next_token_is_command(error)) return nullptr;
+                }
+                continue;
+            }
+
+            if (!command) {
+                command = arena.make<CommandNode>();
+                *command_tail = command;
+                command_tail = &command->next;
+                word_tail = &command->words;
+                redirect_tail = &command->redirects;
+                ++pipeline->length;
+            }
+
+            if (token.type == Token::Word) {
+                auto* word = arena.make<WordNode>();
+                word->text = token.text;
+                word->quoted = token.quoted;
+                *word_tail = word;
+                word_tail = &word->next;
+                ++command->word_count;
+                continue;
+            }
+
+            // Redirection operator: the next token must be its target
+            RedirectNode::Kind kind = token.type == Token::Input ? RedirectNode::Input
+                                    : token.type == Token::Output ? RedirectNode::Output : RedirectNode::Append;
+            if (!next_token(token, error)) return nullptr;
+            if (token.type != Token::Word) {
+                error = kind == RedirectNode::Input ? "Syntax error: No input file specified for redirection."
+                                                    : "Syntax error: No output file specified for redirection.";
+                return nullptr;
+            }
+            auto* redirect = arena.make<RedirectNode>();
+            redirect->kind = kind;
+            redirect->target = token.text;
+            redirect->quoted = token.quoted;
+            *redirect_tail = redirect;
+            redirect_tail = &redirect->next;
+        }
+
+        for (CommandNode* c = pipeline->commands; c; c = c->next) {
+            if (c->word_count == 0) {
+                error = "Syntax error: Missing command.";
+                return nullptr;
+            }
+        }
+        return pipeline;
+    }
+
+    // Splits a line into words with the same quoting and expansion rules, but
+    // treats operators as ordinary words. Returns false on a syntax error.
+    bool split(std::string_view input, std::vector<std::string>& words, std::string& error) {
+        line = input;
+        pos = 0;
+        Token token;
+        while (next_token(token, error)) {
+            if (token.type == Token::End) return true;
+            words.emplace_back(token.text);
+        }
+        return false;
+    }
+
+private:
+    struct Token {
+        enum Type { Word, Pipe, Background, Input, Output, Append, End };
+        Type type = End;
+        std::string_view text;
+        bool quoted = false;
+    };
+
+    Arena& arena;
+    VariableLookup lookup;
+    std::string_view line;
+    size_t pos = 0;
+    std::string scratch; // Reused buffer for words that need rewriting
+
+    static bool is_operator(char c) {
+        return c == '|' || c == '&' || c == '<' || c == '>';
+    }
+
+    static bool is_name_char(char c) {
+        return isalnum(static_cast<unsigned char>(c)) || c == '_';
+    }
+
+    bool next_token_is_command(std::string& error) {
+        size_t saved = pos;
+        Token token;
+        if (!next_token(token, error)) return false;
+        pos = saved;
+        if (token.type == Token::End || token.type == Token::Pipe || token.type == Token::Background) {
+            error = "Syntax error: Missing command after '|'.";
+            return false;
+        }
+        return true;
+    }
+
+    bool next_token(Token& token, std::string& error) {
+        bool dropped;
+        do {
+            if (!read_token(token, error, dropped)) return false;
+        } while (dropped);
+        return true;
+    }
+
+    bool read_token(Token& token, std::string& error, bool& dropped) {
+        dropped = false;
+        while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t')) ++pos;
+        token.quoted = false;
+        if (pos == line.size()) {
+            token.type = Token::End;
+            token.text = std::string_view();
+            return true;
+        }
+
+        size_t start = pos;
+        char c = line[pos];
+        if (is_operator(c)) {
+            ++pos;
+            if (c == '|') token.type = Token::Pipe;
+            else if (c == '&') token.type = Token::Background;
+            else if (c == '<') token.type = Token::Input;
+            else if (pos < line.size() && line[pos] == '>') {
+                ++pos;
+                token.type = Token::Append;
+            } else {
+                token.type = Token::Output;
+            }
+            token.text = line.substr(start, pos - start);
+            return true;
+        }
+
+        // Fast path: plain words are a view straight into the input line
+        while (pos < line.size()) {
+            c = line[pos];
+            if (c == ' ' || c == '\t' || is_operator(c) || c == '\\' || c == '\'' || c == '"' || c == '$') break;
+            ++pos;
+        }
+        token.type = Token::Word;
+        if (pos == line.size() || line[pos] == ' ' || line[pos] == '\t' || is_operator(line[pos])) {
+            token.text = line.substr(start, pos - start);
+            return true;
+        }
+
+        // Slow path: rewrite the word into scratch, then copy it to the arena
+        scratch.assign(line.data() + start, pos - start);
+        bool expanded = false;
+        while (pos < line.size()) {
+            c = line[pos];
+            if (c == ' ' || c == '\t' || is_operator(c)) break;
+            if (c == '\\') {
+                token.quoted = true;
+                if (++pos < line.size()) scratch += line[pos++];
+            } else if (c == '\'') {
+                token.quoted = true;
+                size_t end = line.find('\'', pos + 1);
+                if (end == std::string_view::npos) {
+                    error = "Syntax error: Unterminated quote.";
+                    return false;
+                }
+                scratch.append(line.data() + pos + 1, end - pos - 1);
+                pos = end + 1;
+            } else if (c == '"') {
+                token.quoted = true;
+                ++pos;
+                while (pos < line.size() && line[pos] != '"') {
+                    if (line[pos] == '\\' && pos + 1 < line.size() &&
+                        (line[pos + 1] == '"' || line[pos + 1] == '\\' || line[pos + 1] == '$')) {
+                        scratch += line[pos + 1];
+                        pos += 2;
+                    } else if (line[pos] == '$') {
+                        if (!expand_variable(error)) return false;
+                    } else {
+                        scratch += line[pos++];
+                    }
+                }
+                if (pos == line.size()) {
+                    error = "Syntax error: Unterminated quote.";
+                    return false;
+                }
+                ++pos;
+            } else if (c == '$') {
+                if (!expand_variable(error)) return false;
+                expanded = true;
+            } else {
+                scratch += c;
+                ++pos;
+            }
+        }
+
+        if (scratch.empty() && expanded && !token.quoted) {
+            // An unquoted variable that expanded to nothing is not a word
+            dropped = true;
+            return true;
+        }
+        token.text = arena.copy(scratch);
+        return true;
+    }
+
+    // Appends the value of $NAME, ${NAME}, ${NAME:-default} (unset or
+    // empty) or ${NAME-default} (unset) at pos to scratch. A default may
+    // refer to $NAME itself. A '$' not followed by a name is kept literally.
+    bool expand_variable(std::string& error) {
+        size_t name_start = ++pos;
+        if (pos < line.size() && line[pos] == '{') {
+            size_t close = line.find('}', pos);
+            if (close == std::string_view::npos) {
+                error = "Syntax error: Missing '}' in variable expansion.";
+                return false;
+            }
+            std::string_view body = line.substr(pos + 1, close - pos - 1);
+            pos = close + 1;
+            size_t name_length = 0;
+            while (name_length < body.size() && is_name_char(body[name_length])) ++name_length;
+            std::string_view rest = body.substr(name_length);
+            bool colon = !rest.empty() && rest[0] == ':';
+            if (colon) rest.remove_prefix(1);
+            if (name_length == 0 || (!rest.empty() && rest[0] != '-') || (colon && rest.empty())) {
+                error = "Syntax error: Bad substitution: ${" + std::string(body) + "}";
+                return false;
+            }
+            const char* value = lookup(std::string(body.substr(0, name_length)));
+            if (value && (!colon || *value)) {
+                scratch += value;
+            } else if (!rest.empty()) {
+                expand_default(rest.substr(1));
+            }
+            return true;
+        }
+
+        while (pos < line.size() && is_name_char(line[pos])) ++pos;
+        if (pos == name_start) {
+            scratch += '$';
+            return true;
+        }
+        const char* value = lookup(std::string(line.data() + name_start, pos - name_start));
+        if (value) scratch += value;
+        return true;
+    }
+
+    void expand_default(std::string_view text) {
+        for (size_t i = 0; i < text.size();) {
+            size_t start = i + 1;
+            size_t end = start;
+            while (text[i] == '$' && end < text.size() && is_name_char(text[end])) ++end;
+            if (end == start) {
+                scratch += text[i++];
+                continue;
+            }
+            const char* value = lookup(std::string(text.substr(start, end - start)));
+            if (value) scratch += value;
+            i = end;
+        }
+    }
+};
+
+#endif
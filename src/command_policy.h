@@ -0,0 +1,76 @@
+#ifndef SECSHELL_COMMAND_POLICY_H
+#define SECSHELL_COMMAND_POLICY_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "blacklist.h"
+#include "executable_index.h"
+#include "policy_rules.h"
+
+// Whether a command may run: it must not be blacklisted and must resolve to
+// an executable in one of the allowed directories. Owns the blacklist and
+// the executable index both checks go through, so every caller (pipeline
+// stages, parallel, completion) applies the same policy. The argument-level
+// rules (PolicyRules) are checked separately through denied_by(), since
+// they need the whole command rather than its name.
+class CommandPolicy {
+public:
+    explicit CommandPolicy(std::vector<std::string> allowed_dirs) : dirs(std::move(allowed_dirs)) {}
+
+    CommandPolicy(const CommandPolicy&) = delete;
+    CommandPolicy& operator=(const CommandPolicy&) = delete;
+
+    // Returns true, and the binary to exec in resolved_path, if cmd may run.
+    bool allows(const std::string& cmd, std::string* resolved_path = nullptr) {
+        if (list.contains(cmd)) return false;
+        const std::string* path = index.lookup(cmd);
+        if (!path) return false;
+        if (resolved_path) *resolved_path = *path;
+        return true;
+    }
+
+    bool blacklisted(const std::string& cmd) { return list.contains(cmd); }
+
+    // Replaces the blacklist with the file's contents. A file that cannot
+    // be read leaves the policy already in force and returns false.
+    bool load_blacklist(const std::string& filename) {
+        auto snapshot = BlacklistSnapshot::load(filename);
+        if (!snapshot) return false;
+        list.publish(std::move(snapshot));
+        return true;
+    }
+
+    // Replaces the argument rules with the file's. Lines that do not parse
+    // are skipped and reported in errors. A file that exists but cannot be
+    // read leaves the rules in force and returns false.
+    bool load_rules(const std::string& filename, std::vector<std::string>& errors) {
+        PolicyRules loaded;
+        if (!loaded.load(filename, errors)) return false;
+        arg_rules = std::move(loaded);
+        return true;
+    }
+
+    // The rule denying this command with these redirection targets, or nullptr
+    const PolicyRules::Rule* denied_by(const std::vector<std::string>& args, const std::vector<std::string>& redirects,
+                                       const std::string& cwd) {
+        return arg_rules.check(args, redirects, cwd);
+    }
+
+    // (Re)scans the allowed directories
+    void index_executables(bool watch_changes = true) { index.build(dirs, watch_changes); }
+
+    Blacklist& blacklist() { return list; }
+    ExecutableIndex& executables() { return index; }
+    const PolicyRules& rules() const { return arg_rules; }
+    const std::vector<std::string>& allowed_dirs() const { return dirs; }
+
+private:
+    std::vector<std::string> dirs;
+    Blacklist list;
+    ExecutableIndex index;
+    PolicyRules arg_rules;
+};
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef SECSHELL_COMPLETION_H
+#define SECSHELL_COMPLETION_H
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+// Sorted, de-duplicated word list. All words sharing a prefix form one
+// contiguous run, found with two binary searches.
+class PrefixIndex {
+public:
+    using const_iterator = std::vector<std::string>::const_iterator;
+
+    void assign(std::vector<std::string> words) {
+        std::sort(words.begin(), words.end());
+        words.erase(std::unique(words.begin(), words.end()), words.end());
+        sorted = std::move(words);
+    }
+
+    std::pair<const_iterator, const_iterator> range(std::string_view prefix) const {
+        auto first = std::lower_bound(sorted.begin(), sorted.end(), prefix,
+            [](const std::string& word, std::string_view p) { return std::string_view(word) < p; });
+        auto last = std::partition_point(first, sorted.end(),
+            [prefix](const std::string& word) { return word.compare(0, prefix.size(), prefix.data(), prefix.size()) == 0; });
+        return {first, last};
+    }
+
+    size_t size() const { return sorted.size(); }
+
+private:
+    std::vector<std::string> sorted;
+};
+
+// Directory listings for argument completion. A listing is reused until the
+// directory's mtime changes, so repeated Tab presses in a large directory
+// cost one stat(2) instead of a full readdir and sort.
+class DirectoryCache {
+public:
+    static const size_t MAX_DIRECTORIES = 64;
+
+    struct Listing {
+        PrefixIndex visible;
+        PrefixIndex hidden;   // Dot files, offered only for a '.' prefix
+    };
+
+    // Returns the listing of dir, or nullptr if it cannot be read.
+    const Listing* get(const std::string& dir) {
+        struct stat st;
+        if (stat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) return nullptr;
+
+        auto it = entries.find(dir);
+        if (it != entries.end() && !it->second.racy && it->second.dev == st.st_dev && it->second.ino == st.st_ino &&
+            it->second.mtime.tv_sec == st.st_mtim.tv_sec && it->second.mtime.tv_nsec == st.st_mtim.tv_nsec) {
+            ++hits;
+            return &it->second.listing;
+        }
+
+        DIR* d = opendir(dir.c_str());
+        if (!d) return nullptr;
+        std::vector<std::string> visible, hidden;
+        while (struct dirent* entry = readdir(d)) {
+            const char* name = entry->d_name;
+            if (name[0] != '.') {
+                visible.emplace_back(name);
+            } else if (strcmp(name, ".") != 0 && strcmp(name, "..") != 0) {
+                hidden.emplace_back(name);
+            }
+        }
+        closedir(d);
+        ++reads;
+
+        if (it == entries.end()) {
+            if (entries.size() >= MAX_DIRECTORIES) entries.clear();
+            it = entries.emplace(dir, Entry()).first;
+        }
+        it->second.dev = st.st_dev;
+        it->second.ino = st.st_ino;
+        it->second.mtime = st.st_mtim;
+        // mtime has coarse granularity: a listing read in the same second
+        // the directory changed may have missed a later change in that tick
+        it->second.racy = time(nullptr) - st.st_mtim.tv_sec < 2;
+        it->second.listing.visible.assign(std::move(visible));
+        it->second.listing.hidden.assign(std::move(hidden));
+        return &it->second.listing;
+    }
+
+    unsigned long hit_count() const { return hits; }
+    unsigned long read_count() const { return reads; }
+
+private:
+    struct Entry {
+        dev_t dev = 0;
+        ino_t ino = 0;
+        struct timespec mtime = {};
+        bool racy = false;
+        Listing listing;
+    };
+    std::unordered_map<std::string, Entry> entries;
+    unsigned long hits = 0;
+    unsigned long reads = 0;
+};
+
+#endif
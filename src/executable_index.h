@@ -0,0 +1,144 @@
+#ifndef SECSHELL_EXECUTABLE_INDEX_H
+#define SECSHELL_EXECUTABLE_INDEX_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Maps command names to absolute paths inside the allowed directories.
+// Built once at startup and kept current from inotify events, so resolving
+// a command is a single hash probe and the checked path is the one exec'd.
+class ExecutableIndex {
+public:
+    ~ExecutableIndex() {
+        if (inotify_fd != -1) close(inotify_fd);
+    }
+
+    // Scans every directory and (re)creates the inotify watches. Earlier
+    // directories take precedence, matching the old access() loop order.
+    void build(const std::vector<std::string>& directories, bool watch_changes = true) {
+        dirs = directories;
+        paths.clear();
+        for (const auto& dir : dirs) {
+            DIR* d = opendir(dir.c_str());
+            if (!d) continue;
+            int dfd = dirfd(d);
+            while (struct dirent* entry = readdir(d)) {
+                if (entry->d_name[0] == '.') continue;
+                if (paths.count(entry->d_name)) continue;
+                if (is_executable(dfd, entry->d_name)) {
+                    paths.emplace(entry->d_name, dir + entry->d_name);
+                }
+            }
+            closedir(d);
+        }
+        ++rebuilds;
+        ++changes;
+        if (watch_changes) watch();
+    }
+
+    // Returns the resolved path, or nullptr if the command is not in any
+    // allowed directory. Names containing '/' never resolve.
+    const std::string* lookup(const std::string& name) {
+        auto it = paths.find(name);
+        if (it == paths.end()) {
+            ++misses;
+            return nullptr;
+        }
+        ++hits;
+        return &it->second;
+    }
+
+    // Applies pending inotify events without blocking.
+    void refresh() {
+        if (inotify_fd == -1) return;
+        alignas(struct inotify_event) char buffer[16384];
+        bool rebuild = false;
+        for (;;) {
+            ssize_t len = read(inotify_fd, buffer, sizeof(buffer));
+            if (len <= 0) break;
+            for (char* p = buffer; p < buffer + len;) {
+                auto* event = reinterpret_cast<struct inotify_event*>(p);
+                if (event->mask & (IN_Q_OVERFLOW | IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                    rebuild = true;
+                } else if (event->len > 0) {
+                    update_entry(event->name);
+                }
+                p += sizeof(struct inotify_event) + event->len;
+            }
+        }
+        if (rebuild) build(dirs);
+    }
+
+    // For a forked child: drops the inotify descriptor shared with the
+    // parent (events read by one would be lost to the other) and, if asked,
+    // watches the directories through a descriptor of its own.
+    void rewatch(bool watch_changes) {
+        if (inotify_fd != -1) close(inotify_fd);
+        inotify_fd = -1;
+        if (watch_changes) watch();
+    }
+
+    int fd() const { return inotify_fd; }
+    size_t size() const { return paths.size(); }
+    unsigned long hit_count() const { return hits; }
+    unsigned long miss_count() const { return misses; }
+    unsigned long rebuild_count() const { return rebuilds; }
+    unsigned long version() const { return changes; } // Bumped whenever any entry may have changed
+
+    std::vector<std::string> names() const {
+        std::vector<std::string> result;
+        result.reserve(paths.size());
+        for (const auto& entry : paths) result.push_back(entry.first);
+        return result;
+    }
+
+private:
+    std::vector<std::string> dirs;
+    std::unordered_map<std::string, std::string> paths;
+    int inotify_fd = -1;
+    unsigned long hits = 0;
+    unsigned long misses = 0;
+    unsigned long rebuilds = 0;
+    unsigned long changes = 0;
+
+    static bool is_executable(int dfd, const char* name) {
+        struct stat st;
+        if (fstatat(dfd, name, &st, 0) != 0 || !S_ISREG(st.st_mode)) return false;
+        return faccessat(dfd, name, X_OK, 0) == 0;
+    }
+
+    // Keeps one inotify descriptor for the life of the index so callers can
+    // poll it; re-adding a watch for the same directory just refreshes it.
+    void watch() {
+        if (inotify_fd == -1) {
+            inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        }
+        if (inotify_fd == -1) return;
+        for (const auto& dir : dirs) {
+            inotify_add_watch(inotify_fd, dir.c_str(),
+                IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB |
+                IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF);
+        }
+    }
+
+    // Re-resolves a single name after it changed in one of the directories.
+    void update_entry(const std::string& name) {
+        ++changes;
+        for (const auto& dir : dirs) {
+            if (is_executable(AT_FDCWD, (dir + name).c_str())) {
+                paths[name] = dir + name;
+                return;
+            }
+        }
+        paths.erase(name);
+    }
+};
+
+#endif
@@ -0,0 +1,863 @@
+#ifndef SECSHELL_FAST_PATH_H
+#define SECSHELL_FAST_PATH_H
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <limits.h>
+#include <locale.h>
+#include <pwd.h>
+#include <signal.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include <unistd.h>
+
+#include "box_renderer.h"
+
+// In-process versions of the common subsets of ls and cat, so the most
+// frequent commands skip fork+exec. Output matches GNU coreutils. Anything
+// outside the subset (an unknown flag, a name ls would quote, an unusual
+// environment) returns FALLBACK before a byte is written, and the caller
+// runs the real binary instead.
+class FastPath {
+public:
+    static const int FALLBACK = -1;
+
+    // Byte order is what strcoll gives in C/POSIX, without its overhead
+    FastPath() : collate(c_locale("LC_COLLATE") ? static_cast<locale_t>(0)
+                                                : newlocale(LC_COLLATE_MASK, "", static_cast<locale_t>(0))) {}
+
+    ~FastPath() {
+        if (collate) freelocale(collate);
+    }
+
+    // Picks up LC_ALL/LC_COLLATE/LANG again after the environment changed
+    void reload_locale() {
+        if (collate) freelocale(collate);
+        collate = c_locale("LC_COLLATE") ? static_cast<locale_t>(0)
+                                         : newlocale(LC_COLLATE_MASK, "", static_cast<locale_t>(0));
+    }
+
+    FastPath(const FastPath&) = delete;
+    FastPath& operator=(const FastPath&) = delete;
+
+    static bool handles(const std::string& name) {
+        return name == "ls" || name == "cat";
+    }
+
+    // True if path is the GNU-style program itself rather than, say, a
+    // busybox applet link whose output format differs.
+    static bool native(const std::string& path, const std::string& name) {
+        char resolved[PATH_MAX];
+        if (!realpath(path.c_str(), resolved)) return false;
+        const char* base = strrchr(resolved, '/');
+        return name == (base ? base + 1 : resolved);
+    }
+
+    // Called from the SIGINT handler; a running copy stops at its next chunk.
+    static void interrupt() { interrupted = 1; }
+
+    // Returns the exit status the real command would have, or FALLBACK.
+    int run(const std::vector<std::string>& args, int in_fd, int out_fd, int err_fd) {
+        interrupted = 0;
+        return args[0] == "ls" ? ls(args, out_fd, err_fd) : cat(args, in_fd, out_fd, err_fd);
+    }
+
+private:
+    static volatile sig_atomic_t interrupted;
+    static const size_t COPY_CHUNK = 1 << 20;
+    static const unsigned LONG_MASK = STATX_TYPE | STATX_MODE | STATX_NLINK | STATX_UID | STATX_GID |
+                                      STATX_SIZE | STATX_BLOCKS | STATX_MTIME;
+
+    // The statx fields a listing uses; entries stay small to sort and move
+    struct Stat {
+        uint64_t size = 0;
+        uint64_t blocks = 0;
+        int64_t mtime = 0;
+        uint32_t mode = 0, nlink = 0, uid = 0, gid = 0;
+    };
+
+    struct Entry {
+        std::string name;
+        unsigned char type = DT_UNKNOWN;
+        Stat st;
+        bool link_ok = false;    // Symlink target exists
+        mode_t link_mode = 0;    // Mode of the symlink target
+        std::string target;      // Symlink target, long format only
+        bool has_acl = false;
+        bool has_capability = false;
+    };
+
+    enum class Format { Columns, OnePerLine, Long };
+
+    struct LsOptions {
+        bool show_hidden = false;
+        bool show_dots = false;
+        bool human = false;
+        bool color = false;
+        bool tty = false;
+        Format format = Format::Columns;
+        int width = 80;
+        int tabsize = 8;
+    };
+
+    // LS_COLORS, as far as FastPath reproduces it. GNU's built-in table
+    // applies when the variable is unset; entries in it override.
+    struct Colors {
+        std::unordered_map<std::string, std::string> codes;
+        std::vector<std::pair<std::string, std::string>> suffixes;
+        bool link_as_target = false;
+
+        bool load(const std::string& spec) {
+            codes = {{"rs", "0"}, {"di", "01;34"}, {"ln", "01;36"}, {"pi", "33"}, {"so", "01;35"},
+                     {"bd", "01;33"}, {"cd", "01;33"}, {"ex", "01;32"}, {"do", "01;35"}, {"su", "37;41"},
+                     {"sg", "30;43"}, {"st", "37;44"}, {"ow", "34;42"}, {"tw", "30;42"}};
+            suffixes.clear();
+            link_as_target = false;
+            static const std::vector<std::string> known = {"rs", "fi", "di", "ln", "pi", "so", "bd", "cd", "mi",
+                                                           "or", "ex", "do", "su", "sg", "st", "ow", "tw", "ca",
+                                                           "mh", "cl"};
+            size_t pos = 0;
+            while (pos < spec.size()) {
+                size_t end = std::min(spec.find(':', pos), spec.size());
+                std::string item = spec.substr(pos, end - pos);
+                pos = end + 1;
+                if (item.empty()) continue;
+                size_t eq = item.find('=');
+                if (eq == std::string::npos) return false;
+                std::string key = item.substr(0, eq), value = item.substr(eq + 1);
+                if (value.find_first_of("\\^") != std::string::npos) return false; // Escapes are not decoded
+                if (key.size() > 1 && key[0] == '*') {
+                    suffixes.emplace_back(key.substr(1), value);
+                } else if (key == "ln" && value == "target") {
+                    link_as_target = true;
+                } else if (std::find(known.begin(), known.end(), key) != known.end()) {
+                    codes[key] = value;
+                } else {
+                    return false; // lc, rc, ec, no and anything unknown change every name
+                }
+            }
+            return true;
+        }
+
+        const std::string* get(const char* key) const {
+            auto it = codes.find(key);
+            if (it == codes.end() || it->second.empty() || it->second == "0" || it->second == "00") return nullptr;
+            return &it->second;
+        }
+
+        const std::string* suffix(const std::string& name) const {
+            for (auto it = suffixes.rbegin(); it != suffixes.rend(); ++it) {
+                const std::string& ext = it->first;
+                if (name.size() >= ext.size() && name.compare(name.size() - ext.size(), ext.size(), ext) == 0) {
+                    return it->second.empty() || it->second == "0" || it->second == "00" ? nullptr : &it->second;
+                }
+            }
+            return nullptr;
+        }
+    };
+
+    locale_t collate;
+    Colors colors;
+    std::string colors_spec;
+    bool colors_loaded = false;
+    bool colors_valid = false;
+    bool used_color = false;
+    std::unordered_map<uid_t, std::string> user_names;
+    std::unordered_map<gid_t, std::string> group_names;
+
+    // ls [-aAlh1] [--color[=WHEN]] [file ...]
+    int ls(const std::vector<std::string>& args, int out_fd, int err_fd) {
+        LsOptions opt;
+        int color_mode = 0; // 0 never, 1 auto, 2 always
+        std::vector<std::string> operands;
+        bool options_done = false;
+        for (size_t i = 1; i < args.size(); ++i) {
+            const std::string& arg = args[i];
+            if (options_done || arg.size() < 2 || arg[0] != '-') {
+                operands.push_back(arg);
+            } else if (arg == "--") {
+                options_done = true;
+            } else if (arg[1] == '-') {
+                if (arg == "--all") {
+                    opt.show_hidden = opt.show_dots = true;
+                } else if (arg == "--almost-all") {
+                    opt.show_hidden = true;
+                    opt.show_dots = false;
+                } else if (arg == "--human-readable") {
+                    opt.human = true;
+                } else if (arg == "--color" || arg == "--color=always" || arg == "--color=yes" || arg == "--color=force") {
+                    color_mode = 2;
+                } else if (arg == "--color=auto" || arg == "--color=tty" || arg == "--color=if-tty") {
+                    color_mode = 1;
+                } else if (arg == "--color=never" || arg == "--color=no" || arg == "--color=none") {
+                    color_mode = 0;
+                } else {
+                    return FALLBACK;
+                }
+            } else {
+                for (size_t j = 1; j < arg.size(); ++j) {
+                    switch (arg[j]) {
+                        case 'a': opt.show_hidden = opt.show_dots = true; break;
+                        case 'A': opt.show_hidden = true; opt.show_dots = false; break;
+                        case 'h': opt.human = true; break;
+                        case 'l': opt.format = Format::Long; break;
+                        case '1': if (opt.format != Format::Long) opt.format = Format::OnePerLine; break;
+                        default: return FALLBACK;
+                    }
+                }
+            }
+        }
+
+        // Environment that changes GNU's output in ways not reproduced here
+        for (const char* name : {"QUOTING_STYLE", "TIME_STYLE", "LS_BLOCK_SIZE", "BLOCK_SIZE", "BLOCKSIZE", "POSIXLY_CORRECT"}) {
+            if (getenv(name)) return FALLBACK;
+        }
+        if (const char* tabsize = getenv("TABSIZE")) {
+            char* end = nullptr;
+            long value = strtol(tabsize, &end, 10);
+            if (!*tabsize || *end || value < 0) return FALLBACK;
+            opt.tabsize = value;
+        }
+        bool long_format = opt.format == Format::Long;
+        if (long_format && (!plain_time_locale() || access("/sys/fs/selinux/enforce", F_OK) == 0)) return FALLBACK;
+
+        opt.tty = isatty(out_fd);
+        opt.color = color_mode == 2 || (color_mode == 1 && opt.tty);
+        if (opt.color && !load_colors()) return FALLBACK;
+        if (opt.color) opt.tabsize = 0; // GNU never mixes tabs with colour codes
+        if (opt.format == Format::Columns && !opt.tty) opt.format = Format::OnePerLine;
+        opt.width = BoxRenderer::terminal_width(out_fd);
+
+        unsigned mask = 0;
+        if (long_format) {
+            mask = LONG_MASK;
+        } else if (opt.color) {
+            mask = STATX_TYPE | STATX_MODE | (colors.get("mh") ? STATX_NLINK : 0);
+        }
+
+        // Command-line operands: errors first, then plain files, then directories
+        std::string errors;
+        int status = 0;
+        std::vector<Entry> files, dirs;
+        size_t operand_count = operands.size();
+        if (operands.empty()) operands.push_back(".");
+        for (const auto& operand : operands) {
+            if (opt.tty && needs_quoting(operand)) return FALLBACK;
+            Entry entry;
+            entry.name = operand;
+            int error = stat_entry(AT_FDCWD, operand.c_str(), operand, LONG_MASK, !long_format, opt, entry);
+            if (error == FALLBACK) return FALLBACK;
+            if (error != 0) {
+                errors += "ls: cannot access '" + operand + "': " + strerror(error) + "\n";
+                status = 2;
+            } else if (S_ISDIR(entry.st.mode)) {
+                dirs.push_back(std::move(entry));
+            } else {
+                files.push_back(std::move(entry));
+            }
+        }
+        sort_entries(files);
+        sort_entries(dirs);
+
+        // Everything is read and checked before the first write so that a
+        // fallback never follows partial output.
+        struct Section {
+            std::string name, header;
+            std::vector<Entry> entries;
+            int error = 0;
+        };
+        std::vector<Section> sections;
+        bool headers = !(files.empty() && operand_count <= 1 && dirs.size() == 1);
+        for (const auto& dir : dirs) {
+            Section section;
+            section.name = dir.name;
+            if (headers) section.header = dir.name + ":\n";
+            int error = read_directory(dir.name, mask, opt, section.entries);
+            if (error == FALLBACK) return FALLBACK;
+            section.error = error;
+            sort_entries(section.entries);
+            sections.push_back(std::move(section));
+        }
+        if (opt.tty) {
+            for (const auto& section : sections) {
+                for (const auto& entry : section.entries) {
+                    if (needs_quoting(entry.name) || (!entry.target.empty() && needs_quoting(entry.target))) return FALLBACK;
+                }
+            }
+        }
+
+        used_color = false;
+        std::string out;
+        if (!files.empty() && !format_entries(files, opt, false, out, &dirs)) return FALLBACK;
+        std::vector<std::pair<int, std::string>> chunks;
+        if (!errors.empty()) chunks.emplace_back(err_fd, errors);
+        bool first = files.empty();
+        for (auto& section : sections) {
+            if (!first) out += "\n";
+            first = false;
+            out += section.header;
+            if (section.error != 0) {
+                chunks.emplace_back(out_fd, std::move(out));
+                out.clear();
+                chunks.emplace_back(err_fd, "ls: cannot open directory '" + section.name + "': " + strerror(section.error) + "\n");
+                status = 2;
+                continue;
+            }
+            if (!format_entries(section.entries, opt, true, out)) return FALLBACK;
+        }
+        chunks.emplace_back(out_fd, std::move(out));
+
+        for (const auto& chunk : chunks) {
+            if (!BoxRenderer::write_all(chunk.first, chunk.second)) {
+                return errno == EPIPE ? 128 + SIGPIPE : 2;
+            }
+        }
+        return status;
+    }
+
+    // Stats one name relative to dirfd with the given mask, plus what the
+    // format needs on top: symlink targets, ACLs, file capabilities.
+    // Returns 0, an errno for a missing operand, or FALLBACK.
+    int stat_entry(int dirfd, const char* name, const std::string& path, unsigned mask, bool follow,
+                   const LsOptions& opt, Entry& entry) {
+        struct statx st;
+        int flags = follow ? 0 : AT_SYMLINK_NOFOLLOW;
+        if (statx(dirfd, name, flags, mask, &st) != 0) {
+            int error = errno;
+            // A dangling symlink on the command line is listed as the link
+            if (!follow || error != ENOENT || statx(dirfd, name, AT_SYMLINK_NOFOLLOW, mask, &st) != 0) {
+                return dirfd == AT_FDCWD ? error : FALLBACK;
+            }
+        }
+        entry.st.size = st.stx_size;
+        entry.st.blocks = st.stx_blocks;
+        entry.st.mtime = st.stx_mtime.tv_sec;
+        entry.st.mode = st.stx_mode;
+        entry.st.nlink = st.stx_nlink;
+        entry.st.uid = st.stx_uid;
+        entry.st.gid = st.stx_gid;
+        mode_t mode = st.stx_mode;
+        if (S_ISLNK(mode)) {
+            if (opt.format == Format::Long) {
+                char target[PATH_MAX];
+                ssize_t n = readlinkat(dirfd, name, target, sizeof(target));
+                if (n < 0 || n == sizeof(target)) return FALLBACK;
+                entry.target.assign(target, n);
+            }
+            // Like GNU, follow the link only when some indicator depends on it
+            bool check_target = opt.color && (colors.get("or") || (colors.get("ex") && colors.link_as_target) ||
+                                              (colors.get("mi") && opt.format == Format::Long));
+            if (check_target) {
+                struct statx target_st;
+                entry.link_ok = statx(dirfd, name, 0, STATX_TYPE | STATX_MODE, &target_st) == 0;
+                entry.link_mode = entry.link_ok ? target_st.stx_mode : 0;
+            }
+        } else if (opt.format == Format::Long) {
+            // More than the three base entries, or a default ACL on a directory
+            entry.has_acl = lgetxattr(path.c_str(), "system.posix_acl_access", nullptr, 0) > 28 ||
+                            (S_ISDIR(mode) && lgetxattr(path.c_str(), "system.posix_acl_default", nullptr, 0) > 0);
+        }
+        if (opt.color && S_ISREG(mode) && colors.get("ca")) {
+            entry.has_capability = lgetxattr(path.c_str(), "security.capability", nullptr, 0) > 0;
+        }
+        return 0;
+    }
+
+    // Reads a directory with getdents64, then stats the entries back to
+    // back against the open descriptor, skipping statx entirely when the
+    // format needs nothing beyond the name. Returns 0, an errno from
+    // opening it, or FALLBACK.
+    int read_directory(const std::string& path, unsigned mask, const LsOptions& opt, std::vector<Entry>& entries) {
+        int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd == -1) return errno;
+        static thread_local std::vector<char> buffer(1 << 16);
+        for (;;) {
+            ssize_t n = getdents64(fd, buffer.data(), buffer.size());
+            if (n == -1 && errno == EINTR) continue;
+            if (n == -1) {
+                close(fd);
+                return FALLBACK;
+            }
+            if (n == 0) break;
+            for (ssize_t pos = 0; pos < n;) {
+                const struct dirent64* dirent = reinterpret_cast<const struct dirent64*>(buffer.data() + pos);
+                pos += dirent->d_reclen;
+                const char* name = dirent->d_name;
+                if (name[0] == '.') {
+                    if (!opt.show_hidden) continue;
+                    bool dot = name[1] == '\0' || (name[1] == '.' && name[2] == '\0');
+                    if (dot && !opt.show_dots) continue;
+                }
+                Entry entry;
+                entry.name = name;
+                entry.type = dirent->d_type;
+                entries.push_back(std::move(entry));
+            }
+        }
+
+        if (mask) {
+            std::string base = path.back() == '/' ? path : path + "/";
+            for (auto& entry : entries) {
+                if (stat_entry(fd, entry.name.c_str(), base + entry.name, mask, false, opt, entry) != 0) {
+                    close(fd);
+                    return FALLBACK; // Vanished underneath us; let ls report it
+                }
+            }
+        }
+        close(fd);
+        return 0;
+    }
+
+    // Sorts through pointers; entries carry a whole statx each.
+    void sort_entries(std::vector<Entry>& entries) const {
+        std::vector<Entry*> order;
+        order.reserve(entries.size());
+        for (auto& entry : entries) order.push_back(&entry);
+        std::sort(order.begin(), order.end(), [this](const Entry* a, const Entry* b) {
+            return collate ? strcoll_l(a->name.c_str(), b->name.c_str(), collate) < 0 : a->name < b->name;
+        });
+        std::vector<Entry> sorted;
+        sorted.reserve(entries.size());
+        for (Entry* entry : order) sorted.push_back(std::move(*entry));
+        entries.swap(sorted);
+    }
+
+    // Appends one listing. Returns false if a coloured name would wrap the
+    // terminal, where GNU adds a clear-to-end-of-line that is not reproduced.
+    // Long-format columns are also sized over measured, as GNU sizes them
+    // over every command-line operand, directories included.
+    bool format_entries(const std::vector<Entry>& entries, const LsOptions& opt, bool directory, std::string& out,
+                        const std::vector<Entry>* measured = nullptr) {
+        if (opt.format == Format::Long) return format_long(entries, opt, directory, out, measured);
+        if (opt.format == Format::OnePerLine) {
+            for (const auto& entry : entries) {
+                if (opt.color && opt.tty && static_cast<int>(entry.name.size()) > opt.width) return false;
+                append_name(entry, false, opt, out);
+                out += '\n';
+            }
+            return true;
+        }
+
+        // GNU's column fitting: the most columns, filled top to bottom,
+        // whose widths (name plus two spaces) stay under the line length
+        size_t count = entries.size();
+        if (count == 0) return true;
+        size_t max_columns = std::min<size_t>(std::max(opt.width / 3 + (opt.width % 3 != 0), 1), count);
+        struct Layout {
+            bool valid = true;
+            size_t line_length;
+            std::vector<size_t> widths;
+        };
+        std::vector<Layout> layouts(max_columns);
+        for (size_t i = 0; i < max_columns; ++i) {
+            layouts[i].line_length = (i + 1) * 3;
+            layouts[i].widths.assign(i + 1, 3);
+        }
+        for (size_t file = 0; file < count; ++file) {
+            size_t length = entries[file].name.size();
+            for (size_t i = 0; i < max_columns; ++i) {
+                Layout& layout = layouts[i];
+                if (!layout.valid) continue;
+                size_t column = file / ((count + i) / (i + 1));
+                size_t real_length = length + (column == i ? 0 : 2);
+                if (layout.widths[column] < real_length) {
+                    layout.line_length += real_length - layout.widths[column];
+                    layout.widths[column] = real_length;
+                    layout.valid = layout.line_length < static_cast<size_t>(opt.width);
+                }
+            }
+        }
+        size_t columns = max_columns;
+        while (columns > 1 && !layouts[columns - 1].valid) --columns;
+
+        const std::vector<size_t>& widths = layouts[columns - 1].widths;
+        size_t rows = count / columns + (count % columns != 0);
+        for (size_t row = 0; row < rows; ++row) {
+            size_t position = 0;
+            for (size_t column = 0, file = row; file < count; ++column) {
+                append_name(entries[file], false, opt, out);
+                size_t from = position + entries[file].name.size();
+                file += rows;
+                if (file >= count) break;
+                position += widths[column];
+                // Tabs where they land exactly, as GNU does with the default TABSIZE
+                while (from < position) {
+                    if (opt.tabsize && position / opt.tabsize > (from + 1) / opt.tabsize) {
+                        out += '\t';
+                        from += opt.tabsize - from % opt.tabsize;
+                    } else {
+                        out += ' ';
+                        ++from;
+                    }
+                }
+            }
+            out += '\n';
+        }
+        return true;
+    }
+
+    bool format_long(const std::vector<Entry>& entries, const LsOptions& opt, bool directory, std::string& out,
+                     const std::vector<Entry>* measured) {
+        struct Row {
+            std::string mode, links, owner, group, size, date;
+            bool numeric_owner, numeric_group;
+        };
+        std::vector<Row> rows;
+        rows.reserve(entries.size());
+        size_t links_width = 0, owner_width = 0, group_width = 0, size_width = 0;
+        bool any_acl = false;
+        uint64_t blocks = 0;
+        time_t now = time(nullptr);
+        size_t total = entries.size() + (measured ? measured->size() : 0);
+        for (size_t i = 0; i < total; ++i) {
+            const Entry& entry = i < entries.size() ? entries[i] : (*measured)[i - entries.size()];
+            const Stat& st = entry.st;
+            if (S_ISBLK(st.mode) || S_ISCHR(st.mode)) return false; // major, minor columns
+            Row row;
+            row.mode = mode_string(st.mode);
+            row.links = std::to_string(st.nlink);
+            row.numeric_owner = !lookup_name(st.uid, user_names, true, row.owner);
+            row.numeric_group = !lookup_name(st.gid, group_names, false, row.group);
+            row.size = opt.human ? human_size(st.size) : std::to_string(st.size);
+            char date[64];
+            struct tm tm;
+            time_t mtime = st.mtime;
+            localtime_r(&mtime, &tm);
+            bool recent = mtime > now - 31556952 / 2 && mtime <= now;
+            strftime(date, sizeof(date), recent ? "%b %e %H:%M" : "%b %e  %Y", &tm);
+            row.date = date;
+            any_acl |= entry.has_acl;
+            blocks += st.blocks;
+            links_width = std::max(links_width, row.links.size());
+            owner_width = std::max(owner_width, row.owner.size());
+            group_width = std::max(group_width, row.group.size());
+            size_width = std::max(size_width, row.size.size());
+            if (i < entries.size()) rows.push_back(std::move(row));
+        }
+
+        if (directory) {
+            out += "total ";
+            out += opt.human ? human_size(blocks * 512) : std::to_string((blocks + 1) / 2);
+            out += '\n';
+        }
+        auto pad = [&out](const std::string& text, size_t width, bool right) {
+            if (right) out.append(width - text.size(), ' ');
+            out += text;
+            if (!right) out.append(width - text.size(), ' ');
+            out += ' ';
+        };
+        for (size_t i = 0; i < entries.size(); ++i) {
+            const Row& row = rows[i];
+            size_t line_start = out.size();
+            out += row.mode;
+            if (any_acl) out += entries[i].has_acl ? '+' : ' ';
+            out += ' ';
+            pad(row.links, links_width, true);
+            pad(row.owner, owner_width, row.numeric_owner);
+            pad(row.group, group_width, row.numeric_group);
+            pad(row.size, size_width, true);
+            out += row.date;
+            out += ' ';
+            size_t column = out.size() - line_start;
+            if (opt.color && opt.tty && column + entries[i].name.size() > static_cast<size_t>(opt.width)) return false;
+            append_name(entries[i], false, opt, out);
+            if (S_ISLNK(entries[i].st.mode)) {
+                out += " -> ";
+                append_name(entries[i], true, opt, out);
+            }
+            out += '\n';
+        }
+        return true;
+    }
+
+    void append_name(const Entry& entry, bool target, const LsOptions& opt, std::string& out) {
+        const std::string& name = target ? entry.target : entry.name;
+        const std::string* code = opt.color ? color_for(entry, target) : nullptr;
+        if (!code) {
+            out += name;
+            return;
+        }
+        std::string reset = "\033[" + colors.codes["rs"] + "m";
+        if (!used_color) {
+            used_color = true;
+            out += reset;
+        }
+        out += "\033[";
+        out += *code;
+        out += 'm';
+        out += name;
+        out += reset;
+    }
+
+    // GNU's indicator choice: special bits first, then type, then suffix
+    const std::string* color_for(const Entry& entry, bool target) const {
+        mode_t mode;
+        bool missing = false;
+        if (target) {
+            mode = entry.link_mode;
+            missing = !entry.link_ok;
+        } else {
+            mode = colors.link_as_target && entry.link_ok ? entry.link_mode : entry.st.mode;
+        }
+
+        const char* key;
+        const std::string* code = nullptr;
+        if (missing && colors.get("mi")) {
+            key = "mi";
+        } else if (S_ISREG(mode)) {
+            key = "fi";
+            if ((mode & S_ISUID) && colors.get("su")) key = "su";
+            else if ((mode & S_ISGID) && colors.get("sg")) key = "sg";
+            else if (entry.has_capability && !target && colors.get("ca")) key = "ca";
+            else if ((mode & (S_IXUSR | S_IXGRP | S_IXOTH)) && colors.get("ex")) key = "ex";
+            else if (entry.st.nlink > 1 && !target && colors.get("mh")) key = "mh";
+            else code = colors.suffix(target ? entry.target : entry.name);
+        } else if (S_ISDIR(mode)) {
+            key = "di";
+            if ((mode & S_ISVTX) && (mode & S_IWOTH) && colors.get("tw")) key = "tw";
+            else if ((mode & S_IWOTH) && colors.get("ow")) key = "ow";
+            else if ((mode & S_ISVTX) && colors.get("st")) key = "st";
+        } else if (S_ISLNK(mode)) {
+            key = !entry.link_ok && (colors.link_as_target || colors.get("or")) ? "or" : "ln";
+        } else if (S_ISFIFO(mode)) {
+            key = "pi";
+        } else if (S_ISSOCK(mode)) {
+            key = "so";
+        } else if (S_ISBLK(mode)) {
+            key = "bd";
+        } else if (S_ISCHR(mode)) {
+            key = "cd";
+        } else {
+            key = "or";
+        }
+        return code ? code : colors.get(key);
+    }
+
+    bool load_colors() {
+        const char* spec = getenv("LS_COLORS");
+        std::string value = spec ? spec : "";
+        if (!colors_loaded || value != colors_spec) {
+            colors_spec = value;
+            colors_valid = colors.load(value);
+            colors_loaded = true;
+        }
+        return colors_valid;
+    }
+
+    template <typename Id>
+    static bool lookup_name(Id id, std::unordered_map<Id, std::string>& cache, bool user, std::string& name) {
+        auto it = cache.find(id);
+        if (it == cache.end()) {
+            std::string resolved;
+            if (user) {
+                struct passwd* pw = getpwuid(id);
+                if (pw) resolved = pw->pw_name;
+            } else {
+                struct group* gr = getgrgid(id);
+                if (gr) resolved = gr->gr_name;
+            }
+            it = cache.emplace(id, resolved).first;
+        }
+        name = it->second.empty() ? std::to_string(id) : it->second;
+        return !it->second.empty();
+    }
+
+    static std::string mode_string(mode_t mode) {
+        std::string s = "?rwxrwxrwx";
+        if (S_ISREG(mode)) s[0] = '-';
+        else if (S_ISDIR(mode)) s[0] = 'd';
+        else if (S_ISLNK(mode)) s[0] = 'l';
+        else if (S_ISFIFO(mode)) s[0] = 'p';
+        else if (S_ISSOCK(mode)) s[0] = 's';
+        else if (S_ISBLK(mode)) s[0] = 'b';
+        else if (S_ISCHR(mode)) s[0] = 'c';
+        for (int i = 0; i < 9; ++i) {
+            if (!(mode & (0400 >> i))) s[i + 1] = '-';
+        }
+        if (mode & S_ISUID) s[3] = s[3] == 'x' ? 's' : 'S';
+        if (mode & S_ISGID) s[6] = s[6] == 'x' ? 's' : 'S';
+        if (mode & S_ISVTX) s[9] = s[9] == 'x' ? 't' : 'T';
+        return s;
+    }
+
+    // -h sizes: powers of 1024 rounded up, one decimal below 10
+    static std::string human_size(uint64_t bytes) {
+        if (bytes < 1024) return std::to_string(bytes);
+        static const char units[] = "KMGTPE";
+        unsigned __int128 divisor = 1024;
+        int unit = 0;
+        while (bytes / divisor >= 1024 && unit < 5) {
+            divisor *= 1024;
+            ++unit;
+        }
+        char text[32];
+        unsigned __int128 tenths = (static_cast<unsigned __int128>(bytes) * 10 + divisor - 1) / divisor;
+        if (tenths < 100) {
+            snprintf(text, sizeof(text), "%u.%u%c", static_cast<unsigned>(tenths / 10), static_cast<unsigned>(tenths % 10), units[unit]);
+            return text;
+        }
+        unsigned __int128 whole = (bytes + divisor - 1) / divisor;
+        if (whole >= 1024 && unit < 5) {
+            snprintf(text, sizeof(text), "1.0%c", units[unit + 1]);
+        } else {
+            snprintf(text, sizeof(text), "%u%c", static_cast<unsigned>(whole), units[unit]);
+        }
+        return text;
+    }
+
+    // Names GNU ls would quote on a terminal (shell-escape style), or whose
+    // display width differs from their length
+    static bool needs_quoting(const std::string& name) {
+        for (size_t i = 0; i < name.size(); ++i) {
+            unsigned char c = name[i];
+            if (isalnum(c) || strchr("%+,-./:@_", c)) continue;
+            if ((c == '#' || c == '~') && i > 0) continue;
+            return true;
+        }
+        return false;
+    }
+
+    // The locale in effect for category, resolved the way setlocale does
+    static std::string locale_name(const char* category) {
+        for (const char* name : {"LC_ALL", category, "LANG"}) {
+            const char* value = getenv(name);
+            if (value && *value) return value;
+        }
+        return "C";
+    }
+
+    static bool c_locale(const char* category) {
+        std::string locale = locale_name(category);
+        return locale == "C" || locale == "POSIX";
+    }
+
+    // Long listings use C-locale month names; other locales go to ls
+    static bool plain_time_locale() {
+        std::string locale = locale_name("LC_TIME");
+        return c_locale("LC_TIME") || locale.compare(0, 2, "C.") == 0 || locale.compare(0, 3, "en_") == 0;
+    }
+
+    // cat [-u] [file ...]
+    int cat(const std::vector<std::string>& args, int in_fd, int out_fd, int err_fd) {
+        std::vector<std::string> files;
+        bool options_done = false;
+        for (size_t i = 1; i < args.size(); ++i) {
+            const std::string& arg = args[i];
+            if (!options_done && arg == "--") {
+                options_done = true;
+            } else if (!options_done && arg == "-u") {
+                continue; // Output is never buffered anyway
+            } else if (!options_done && arg.size() > 1 && arg[0] == '-') {
+                return FALLBACK;
+            } else {
+                files.push_back(arg);
+            }
+        }
+        if (files.empty()) files.push_back("-");
+        // Reading a terminal in-process could not be interrupted
+        if (std::find(files.begin(), files.end(), "-") != files.end() && isatty(in_fd)) return FALLBACK;
+
+        struct stat out_st;
+        bool out_regular = fstat(out_fd, &out_st) == 0 && S_ISREG(out_st.st_mode);
+        bool out_pipe = !out_regular && S_ISFIFO(out_st.st_mode);
+        int status = 0;
+        for (const auto& file : files) {
+            bool is_stdin = file == "-";
+            int fd = is_stdin ? in_fd : open(file.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd == -1) {
+                BoxRenderer::write_all(err_fd, "cat: " + file + ": " + strerror(errno) + "\n");
+                status = 1;
+                continue;
+            }
+            struct stat st;
+            int error = fstat(fd, &st) == 0 ? 0 : errno;
+            if (error == 0 && S_ISDIR(st.st_mode)) {
+                error = EISDIR;
+            } else if (error == 0 && out_regular && st.st_dev == out_st.st_dev && st.st_ino == out_st.st_ino &&
+                       lseek(fd, 0, SEEK_CUR) < out_st.st_size) {
+                BoxRenderer::write_all(err_fd, "cat: " + file + ": input file is output file\n");
+                if (!is_stdin) close(fd);
+                status = 1;
+                continue;
+            }
+
+            bool write_failed = false;
+            if (error == 0) {
+                error = copy(fd, out_fd, S_ISREG(st.st_mode), out_pipe || S_ISFIFO(st.st_mode), write_failed);
+            }
+            if (!is_stdin) close(fd);
+            if (error == EINTR) return 128 + SIGINT;
+            if (write_failed) {
+                if (error == EPIPE) return 128 + SIGPIPE;
+                BoxRenderer::write_all(err_fd, std::string("cat: write error: ") + strerror(error) + "\n");
+                return 1;
+            }
+            if (error != 0) {
+                BoxRenderer::write_all(err_fd, "cat: " + file + ": " + strerror(error) + "\n");
+                status = 1;
+            }
+        }
+        return status;
+    }
+
+    // Copies in_fd to out_fd in the kernel where it can: sendfile from
+    // regular files, splice when either side is a pipe, read/write
+    // otherwise. Returns 0, EINTR if interrupted, or the failing errno
+    // with write_failed telling which side it came from.
+    static int copy(int in_fd, int out_fd, bool regular_input, bool any_pipe, bool& write_failed) {
+        bool use_sendfile = regular_input, use_splice = any_pipe;
+        static thread_local std::vector<char> buffer(1 << 17);
+        for (;;) {
+            if (interrupted) return EINTR;
+            ssize_t n;
+            if (use_sendfile) {
+                n = sendfile(out_fd, in_fd, nullptr, COPY_CHUNK);
+                if (n == -1 && (errno == EINVAL || errno == ENOSYS)) {
+                    use_sendfile = false;
+                    continue;
+                }
+            } else if (use_splice) {
+                n = splice(in_fd, nullptr, out_fd, nullptr, COPY_CHUNK, SPLICE_F_MORE);
+                if (n == -1 && (errno == EINVAL || errno == ENOSYS)) {
+                    use_splice = false;
+                    continue;
+                }
+            } else {
+                n = read(in_fd, buffer.data(), buffer.size());
+                for (ssize_t written = 0; n > 0 && written < n;) {
+                    ssize_t w = write(out_fd, buffer.data() + written, n - written);
+                    if (w == -1 && errno == EINTR) continue;
+                    if (w == -1) {
+                        write_failed = true;
+                        return errno;
+                    }
+                    written += w;
+                }
+            }
+            if (n == 0) return 0;
+            if (n == -1) {
+                if (errno == EINTR) continue;
+                int error = errno;
+                write_failed = error == EPIPE || error == ENOSPC || error == EDQUOT || error == EFBIG;
+                return error;
+            }
+        }
+    }
+};
+
+#endif
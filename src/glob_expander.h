@@ -0,0 +1,454 @@
+#ifndef SECSHELL_GLOB_EXPANDER_H
+#define SECSHELL_GLOB_EXPANDER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "work_stealing_pool.h"
+
+// Pathname expansion for unquoted words: {a,b} alternatives first, then
+// *, ?, [...] and ** (any number of directories, as bash's globstar) per
+// path component. A leading '.' must be matched explicitly, ** skips
+// hidden directories and never follows symlinks, and a pattern that
+// matches nothing stays as it was. Matches are sorted byte-wise within
+// each alternative.
+//
+// Directory listings come from getdents64 and are cached until the
+// directory's mtime changes, so repeated globs over a large log directory
+// cost one stat(2) plus the matching. Recursive walks and large listings
+// are split across a WorkStealingPool. Every expansion is capped by match
+// count and total bytes; past either cap expand() returns TooLarge rather
+// than building the list.
+class GlobExpander {
+public:
+    enum Result { NoMatch, Expanded, TooLarge };
+
+    static const size_t MAX_DIRECTORIES = 4096;      // Cached listings
+    static const size_t MAX_CACHED_NAMES = 1 << 21;  // Names across all cached listings
+    static const size_t PARALLEL_DIRECTORIES = 8;    // Fan out a walk level at this many directories
+    static const size_t PARALLEL_NAMES = 1 << 16;    // Split a listing this large across the pool
+
+    size_t max_results = 100000;
+    size_t max_bytes = 16 << 20;
+    size_t threads = 4;
+
+    // Whether expand() could change the word
+    static bool has_magic(std::string_view word) {
+        return word.find_first_of("*?[{") != std::string_view::npos;
+    }
+
+    // Appends the expansion of word to out. Relative patterns are walked
+    // from cwd and produce relative paths. On NoMatch the word itself is
+    // appended; on TooLarge nothing is.
+    Result expand(std::string_view word, const std::string& cwd, std::vector<std::string>& out) {
+        // Brace alternatives share the budget with the paths they match;
+        // a literal alternative is charged once, as it is built.
+        Budget budget{max_results, max_bytes};
+        std::vector<std::string> alternatives;
+        if (!expand_braces(std::string(word), budget, alternatives)) return TooLarge;
+
+        std::vector<std::string> expanded;
+        bool matched = false;
+        for (const auto& alternative : alternatives) {
+            if (alternative.find_first_of("*?[") == std::string::npos) {
+                expanded.push_back(alternative);
+                continue;
+            }
+            // A pattern's share goes to the paths it matches, or back to
+            // the pattern itself when nothing does
+            budget.refund(alternative.size());
+            std::vector<std::string> matches;
+            if (!match_path(alternative, cwd, budget, matches)) return TooLarge;
+            if (matches.empty()) {
+                if (!budget.take(alternative.size())) return TooLarge;
+                expanded.push_back(alternative);
+                continue;
+            }
+            matched = true;
+            if (!std::is_sorted(matches.begin(), matches.end())) std::sort(matches.begin(), matches.end());
+            for (auto& match : matches) expanded.push_back(std::move(match));
+        }
+        bool braces = alternatives.size() != 1 || alternatives[0] != word;
+        for (auto& path : expanded) out.push_back(std::move(path));
+        return matched || braces ? Expanded : NoMatch;
+    }
+
+    unsigned long hit_count() const { return hits.load(std::memory_order_relaxed); }
+    unsigned long read_count() const { return reads.load(std::memory_order_relaxed); }
+
+private:
+    // One directory's names, packed into a single buffer
+    struct Listing {
+        std::string names;              // Each name followed by a NUL
+        std::vector<uint32_t> offsets;  // Start of each name in names
+        std::vector<uint8_t> types;     // d_type of each name
+
+        size_t size() const { return offsets.size(); }
+        const char* name(size_t i) const { return names.data() + offsets[i]; }
+    };
+
+    struct CacheEntry {
+        dev_t dev = 0;
+        ino_t ino = 0;
+        struct timespec mtime = {};
+        bool racy = false;
+        std::shared_ptr<const Listing> listing;
+    };
+
+    // What one expansion may still produce
+    struct Budget {
+        size_t count;
+        size_t bytes;
+
+        bool take(size_t length) {
+            if (count == 0 || bytes < length + 1) return false;
+            --count;
+            bytes -= length + 1;
+            return true;
+        }
+
+        void refund(size_t length) {
+            ++count;
+            bytes += length + 1;
+        }
+    };
+
+    std::mutex cache_lock;
+    std::unordered_map<std::string, CacheEntry> cache;
+    size_t cached_names = 0;
+    std::atomic<unsigned long> hits{0};
+    std::atomic<unsigned long> reads{0};
+
+    // The first '{' with a matching '}' and a comma between them at depth 1
+    static bool find_brace_group(const std::string& word, size_t& open, size_t& close, std::vector<size_t>& commas) {
+        for (open = word.find('{'); open != std::string::npos; open = word.find('{', open + 1)) {
+            commas.clear();
+            int depth = 0;
+            for (close = open; close < word.size(); ++close) {
+                char c = word[close];
+                if (c == '{') {
+                    ++depth;
+                } else if (c == '}') {
+                    if (--depth == 0) break;
+                } else if (c == ',' && depth == 1) {
+                    commas.push_back(close);
+                }
+            }
+            if (close < word.size() && !commas.empty()) return true;
+        }
+        return false;
+    }
+
+    // {a,b,c} with nesting; a brace group without a top-level comma stays
+    // literal. Order is kept. Every word is charged to budget before it is
+    // stored; returns false once it runs out.
+    static bool expand_braces(const std::string& word, Budget& budget, std::vector<std::string>& out) {
+        size_t open, close;
+        std::vector<size_t> commas;
+        if (!find_brace_group(word, open, close, commas)) {
+            if (!budget.take(word.size())) return false;
+            out.push_back(word);
+            return true;
+        }
+        std::string prefix = word.substr(0, open), suffix = word.substr(close + 1);
+        size_t start = open + 1;
+        commas.push_back(close);
+        for (size_t comma : commas) {
+            if (!expand_braces(prefix + word.substr(start, comma - start) + suffix, budget, out)) return false;
+            start = comma + 1;
+        }
+        return true;
+    }
+
+    // Runs work(i) for i in [0, tasks), on the pool when there is enough to share
+    void for_each(size_t tasks, size_t parallel_at, const std::function<void(size_t)>& work) {
+        if (threads <= 1 || tasks < parallel_at) {
+            for (size_t i = 0; i < tasks; ++i) work(i);
+            return;
+        }
+        WorkStealingPool pool(std::min(threads, tasks));
+        pool.run(tasks, work);
+    }
+
+    // One path-component-at-a-time walk. prefixes hold the matched part of
+    // the path as it will be printed, "" or ending in '/'.
+    bool match_path(const std::string& pattern, const std::string& cwd, Budget& budget, std::vector<std::string>& matches) {
+        bool absolute = pattern[0] == '/';
+        bool directories_only = pattern.back() == '/';
+        std::vector<std::string> components;
+        for (size_t pos = 0; pos < pattern.size();) {
+            size_t slash = pattern.find('/', pos);
+            if (slash == std::string::npos) slash = pattern.size();
+            if (slash > pos) components.push_back(pattern.substr(pos, slash - pos));
+            pos = slash + 1;
+        }
+        if (components.empty()) return true;
+        if (components.back() == "**" && !directories_only) components.push_back("*"); // Trailing ** lists everything beneath
+
+        auto directory = [&](const std::string& prefix) {
+            return absolute ? prefix : prefix.empty() ? cwd : cwd + "/" + prefix;
+        };
+
+        std::vector<std::string> prefixes = {absolute ? "/" : ""};
+        bool verify = false; // A literal component after a wildcard must exist
+        for (size_t c = 0; c < components.size() && !prefixes.empty(); ++c) {
+            const std::string& component = components[c];
+            bool last = c + 1 == components.size();
+            bool want_directory = !last || directories_only;
+            std::vector<std::string> next;
+
+            if (component == "**") {
+                if (!descend(prefixes, directory, budget.count, next)) return false;
+            } else if (component.find_first_of("*?[") == std::string::npos) {
+                for (const auto& prefix : prefixes) next.push_back(prefix + component + (want_directory ? "/" : ""));
+                verify = verify || c > 0;
+            } else {
+                if (!match_component(prefixes, component, want_directory, directory, budget.count, next)) return false;
+                verify = false;
+            }
+            prefixes = std::move(next);
+        }
+
+        for (auto& path : prefixes) {
+            if (path.empty()) continue; // **/ from the working directory itself
+            if (verify) {
+                struct stat st;
+                std::string full = directory(path);
+                if (directories_only ? stat(full.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)
+                                     : lstat(full.c_str(), &st) != 0) {
+                    continue;
+                }
+            }
+            if (!budget.take(path.size())) return false;
+            matches.push_back(std::move(path));
+        }
+        return true;
+    }
+
+    // Every name in each prefix's directory that matches component. The
+    // directories are spread over the pool, and so is a single huge one, in
+    // chunks of its listing. Fails past limit matches.
+    template <typename DirectoryOf>
+    bool match_component(const std::vector<std::string>& prefixes, const std::string& component, bool want_directory,
+                         const DirectoryOf& directory, size_t limit, std::vector<std::string>& next) {
+        NameMatcher matcher(component);
+        std::vector<std::string> dirs;
+        std::vector<std::shared_ptr<const Listing>> listings;
+        for (const auto& prefix : prefixes) {
+            dirs.push_back(directory(prefix));
+            listings.push_back(prefixes.size() == 1 ? list(dirs.back()) : nullptr);
+        }
+        size_t chunks = threads > 1 && listings[0] && listings[0]->size() >= PARALLEL_NAMES ? threads * 4 : 1;
+
+        struct Task {
+            size_t prefix, begin, end;
+        };
+        std::vector<Task> tasks;
+        if (prefixes.size() == 1) {
+            size_t size = listings[0] ? listings[0]->size() : 0;
+            for (size_t chunk = 0; chunk < chunks; ++chunk) tasks.push_back({0, size * chunk / chunks, size * (chunk + 1) / chunks});
+        } else {
+            for (size_t p = 0; p < prefixes.size(); ++p) tasks.push_back({p, 0, SIZE_MAX});
+        }
+
+        std::vector<std::vector<std::string>> found(tasks.size());
+        std::atomic<size_t> total{0};
+        for_each(tasks.size(), tasks.size() == chunks && chunks > 1 ? 2 : PARALLEL_DIRECTORIES, [&](size_t t) {
+            const Task& task = tasks[t];
+            std::shared_ptr<const Listing> listing = listings[task.prefix] ? listings[task.prefix] : list(dirs[task.prefix]);
+            if (!listing) return;
+            size_t end = std::min(task.end, listing->size());
+            // Matched names are copied together so sorting them stays in cache,
+            // which is far cheaper than sorting the full paths afterwards
+            std::string matched;
+            std::vector<size_t> starts;
+            for (size_t i = task.begin; i < end; ++i) {
+                if (!matcher.matches(listing->name(i))) continue;
+                if (want_directory && !is_directory(dirs[task.prefix], *listing, i, true)) continue;
+                if (total.fetch_add(1, std::memory_order_relaxed) >= limit) return;
+                starts.push_back(matched.size());
+                matched.append(listing->name(i));
+            }
+            starts.push_back(matched.size());
+            std::vector<std::string_view> names;
+            for (size_t k = 0; k + 1 < starts.size(); ++k) {
+                names.emplace_back(matched.data() + starts[k], starts[k + 1] - starts[k]);
+            }
+            std::sort(names.begin(), names.end());
+            const std::string& prefix = prefixes[task.prefix];
+            for (std::string_view name : names) {
+                std::string path;
+                path.reserve(prefix.size() + name.size() + 1);
+                path.append(prefix).append(name);
+                if (want_directory) path += '/';
+                found[t].push_back(std::move(path));
+            }
+        });
+        if (total.load() > limit) return false;
+        for (auto& part : found) {
+            size_t middle = next.size();
+            for (auto& path : part) next.push_back(std::move(path));
+            if (chunks > 1) std::inplace_merge(next.begin(), next.begin() + middle, next.end()); // Chunks of one listing
+        }
+        return true;
+    }
+
+    // ** : each prefix and every non-hidden directory beneath it, walked a
+    // level at a time with the level's directories spread over the pool.
+    // Fails past limit directories.
+    template <typename DirectoryOf>
+    bool descend(const std::vector<std::string>& prefixes, const DirectoryOf& directory, size_t limit,
+                 std::vector<std::string>& next) {
+        std::vector<std::string> level = prefixes;
+        while (!level.empty()) {
+            for (const auto& prefix : level) next.push_back(prefix);
+            if (next.size() > limit) return false;
+            std::vector<std::vector<std::string>> children(level.size());
+            std::atomic<size_t> total{next.size()};
+            for_each(level.size(), PARALLEL_DIRECTORIES, [&](size_t d) {
+                std::string dir = directory(level[d]);
+                std::shared_ptr<const Listing> listing = list(dir);
+                if (!listing) return;
+                for (size_t i = 0; i < listing->size(); ++i) {
+                    if (listing->name(i)[0] == '.' || !is_directory(dir, *listing, i, false)) continue;
+                    if (total.fetch_add(1, std::memory_order_relaxed) >= limit) return;
+                    children[d].push_back(level[d] + listing->name(i) + "/");
+                }
+            });
+            if (total.load() > limit) return false;
+            level.clear();
+            for (auto& part : children) {
+                for (auto& path : part) level.push_back(std::move(path));
+            }
+        }
+        return true;
+    }
+
+    static bool is_directory(const std::string& dir, const Listing& listing, size_t i, bool follow) {
+        uint8_t type = listing.types[i];
+        if (type == DT_DIR) return true;
+        if (type != DT_UNKNOWN && (type != DT_LNK || !follow)) return false;
+        struct stat st;
+        std::string path = dir + (dir.back() == '/' ? "" : "/") + listing.name(i);
+        int rc = follow ? stat(path.c_str(), &st) : lstat(path.c_str(), &st);
+        return rc == 0 && S_ISDIR(st.st_mode);
+    }
+
+    // The cached listing of dir, re-read when its mtime changes; nullptr if
+    // it cannot be read. A listing read within two seconds of the
+    // directory's last change is not trusted, as mtime is coarse.
+    std::shared_ptr<const Listing> list(const std::string& dir) {
+        struct stat st;
+        if (stat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) return nullptr;
+        {
+            std::lock_guard<std::mutex> guard(cache_lock);
+            auto it = cache.find(dir);
+            if (it != cache.end() && !it->second.racy && it->second.dev == st.st_dev && it->second.ino == st.st_ino &&
+                it->second.mtime.tv_sec == st.st_mtim.tv_sec && it->second.mtime.tv_nsec == st.st_mtim.tv_nsec) {
+                hits.fetch_add(1, std::memory_order_relaxed);
+                return it->second.listing;
+            }
+        }
+
+        auto listing = std::make_shared<Listing>();
+        if (!read_directory(dir, *listing)) return nullptr;
+        reads.fetch_add(1, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> guard(cache_lock);
+        auto it = cache.find(dir);
+        if (it == cache.end()) {
+            if (cache.size() >= MAX_DIRECTORIES || cached_names + listing->size() > MAX_CACHED_NAMES) {
+                cache.clear();
+                cached_names = 0;
+            }
+            it = cache.emplace(dir, CacheEntry()).first;
+        } else {
+            cached_names -= it->second.listing->size();
+        }
+        it->second.dev = st.st_dev;
+        it->second.ino = st.st_ino;
+        it->second.mtime = st.st_mtim;
+        it->second.racy = time(nullptr) - st.st_mtim.tv_sec < 2;
+        it->second.listing = listing;
+        cached_names += listing->size();
+        return listing;
+    }
+
+    static bool read_directory(const std::string& dir, Listing& listing) {
+        int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd == -1) return false;
+        static thread_local std::vector<char> buffer(1 << 16);
+        for (;;) {
+            ssize_t n = getdents64(fd, buffer.data(), buffer.size());
+            if (n == -1 && errno == EINTR) continue;
+            if (n <= 0) {
+                close(fd);
+                return n == 0;
+            }
+            for (ssize_t pos = 0; pos < n;) {
+                const struct dirent64* dirent = reinterpret_cast<const struct dirent64*>(buffer.data() + pos);
+                pos += dirent->d_reclen;
+                const char* name = dirent->d_name;
+                if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+                listing.offsets.push_back(static_cast<uint32_t>(listing.names.size()));
+                listing.types.push_back(dirent->d_type);
+                listing.names.append(name, strlen(name) + 1);
+            }
+        }
+    }
+
+    // fnmatch with FNM_PERIOD, short-cutting the common *.log, app-* and
+    // *error* shapes to plain comparisons
+    class NameMatcher {
+    public:
+        explicit NameMatcher(const std::string& pattern) : pattern(pattern) {
+            size_t first = pattern[0] == '*' ? 1 : 0;
+            size_t last = pattern.size() > first && pattern.back() == '*' ? pattern.size() - 1 : pattern.size();
+            if (pattern.find_first_of("*?[\\", first) >= last) {
+                simple = true;
+                leading = first == 1;
+                trailing = last < pattern.size();
+                literal = pattern.substr(first, last - first);
+            }
+        }
+
+        bool matches(const char* name) const {
+            if (!simple) return fnmatch(pattern.c_str(), name, FNM_PERIOD) == 0;
+            if (leading && name[0] == '.') return false; // A leading '.' is only matched literally
+            if (!leading) {
+                if (strncmp(name, literal.c_str(), literal.size()) != 0) return false;
+                return trailing || name[literal.size()] == '\0';
+            }
+            if (trailing) return strstr(name, literal.c_str()) != nullptr;
+            size_t length = strlen(name);
+            return length >= literal.size() && memcmp(name + length - literal.size(), literal.data(), literal.size()) == 0;
+        }
+
+    private:
+        std::string pattern;
+        bool simple = false;
+        bool leading = false;
+        bool trailing = false;
+        std::string literal;
+    };
+};
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef SECSHELL_HELPER_THREAD_H
+#define SECSHELL_HELPER_THREAD_H
+
+#include <thread>
+#include <utility>
+
+#include <signal.h>
+
+// Starts a background thread with every signal blocked, so SIGCHLD, SIGINT
+// and friends are always delivered to the thread that started it (the
+// shell thread, or a session's relay thread) and never to a helper.
+template <typename F>
+std::thread start_helper_thread(F&& body) {
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &previous);
+    std::thread thread(std::forward<F>(body));
+    pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+    return thread;
+}
+
+#endif
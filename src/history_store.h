@@ -0,0 +1,240 @@
+#ifndef SECSHELL_HISTORY_STORE_H
+#define SECSHELL_HISTORY_STORE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "box_renderer.h"
+
+// Persistent per-user command history. Records are appended as
+// "<epoch>\t<command>\n" under an exclusive flock with O_APPEND, so
+// concurrent sessions never interleave. Reads go through a read-only
+// mapping that is extended when another session grows the file. Ctrl-R
+// search uses a trigram index built on first use and updated incrementally.
+class HistoryStore {
+public:
+    static const size_t npos = static_cast<size_t>(-1);
+
+    ~HistoryStore() {
+        unmap();
+        if (fd != -1) close(fd);
+    }
+
+    bool open(const std::string& path) {
+        fd = ::open(path.c_str(), O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+        if (fd == -1) return false;
+        refresh();
+        return true;
+    }
+
+    bool is_open() const { return fd != -1; }
+
+    bool append(std::string_view command) {
+        if (fd == -1) return false;
+        std::string record = std::to_string(time(nullptr)) + "\t";
+        record.append(command.data(), command.size());
+        std::replace(record.begin(), record.end(), '\n', ' ');
+        record += '\n';
+
+        flock(fd, LOCK_EX);
+        bool ok = BoxRenderer::write_all(fd, record);
+        flock(fd, LOCK_UN);
+        return ok;
+    }
+
+    // Number of complete records, picking up appends from other sessions.
+    size_t size() {
+        refresh();
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+
+    // The command text of a record. Valid until the next refresh.
+    std::string_view command(size_t index) const {
+        std::string_view record = this->record(index);
+        size_t tab = record.find('\t');
+        return tab == std::string_view::npos ? record : record.substr(tab + 1);
+    }
+
+    // Indexes of all records containing pattern, oldest first. One-off
+    // searches scan the mapping with memmem, which beats building the index;
+    // once Ctrl-R has built it, the index narrows the scan to a few blocks.
+    std::vector<uint32_t> search(std::string_view pattern) {
+        size_t count = size();
+        std::vector<uint32_t> matches;
+        if (pattern.empty()) {
+            for (size_t i = 0; i < count; ++i) matches.push_back(i);
+            return matches;
+        }
+        if (indexed > 0 && pattern.size() >= 3) {
+            update_index();
+            for (uint32_t block : candidate_blocks(pattern, count)) {
+                size_t last = std::min(count, (static_cast<size_t>(block) + 1) * BLOCK_RECORDS);
+                for (size_t id = block * BLOCK_RECORDS; id < last; ++id) {
+                    if (command(id).find(pattern) != std::string_view::npos) matches.push_back(id);
+                }
+            }
+            return matches;
+        }
+
+        const char* p = map;
+        const char* end = map + (count ? offsets[count] : 0);
+        while (p < end) {
+            const char* hit = static_cast<const char*>(memmem(p, end - p, pattern.data(), pattern.size()));
+            if (!hit) break;
+            size_t id = std::upper_bound(offsets.begin(), offsets.end(), static_cast<uint64_t>(hit - map)) - offsets.begin() - 1;
+            // The hit may sit in the timestamp or span two records
+            if (command(id).find(pattern) != std::string_view::npos) {
+                matches.push_back(id);
+                p = map + offsets[id + 1];
+            } else {
+                p = hit + 1;
+            }
+        }
+        return matches;
+    }
+
+    // Newest record before `before` containing pattern, or npos.
+    size_t find_before(std::string_view pattern, size_t before) {
+        size_t limit = std::min(before, size());
+        if (pattern.size() < 3) {
+            for (size_t id = limit; id-- > 0;) {
+                if (command(id).find(pattern) != std::string_view::npos) return id;
+            }
+            return npos;
+        }
+
+        update_index();
+        std::vector<uint32_t> blocks = candidate_blocks(pattern, limit);
+        for (auto it = blocks.rbegin(); it != blocks.rend(); ++it) {
+            size_t first = static_cast<size_t>(*it) * BLOCK_RECORDS;
+            for (size_t id = std::min(limit, first + BLOCK_RECORDS); id-- > first;) {
+                if (command(id).find(pattern) != std::string_view::npos) return id;
+            }
+        }
+        return npos;
+    }
+
+private:
+    int fd = -1;
+    const char* map = nullptr;
+    size_t mapped = 0;
+    std::vector<uint64_t> offsets;   // Start of each record plus one past the last
+    // Trigram index over blocks of records. Trigrams are hashed into a fixed
+    // bucket table; collisions only add candidates, which are verified anyway.
+    static const size_t BLOCK_RECORDS = 64;
+    static const int INDEX_BITS = 18;
+    size_t indexed = 0;              // Records covered by the trigram index
+    std::vector<std::vector<uint32_t>> buckets;
+
+    std::string_view record(size_t index) const {
+        return std::string_view(map + offsets[index], offsets[index + 1] - offsets[index] - 1);
+    }
+
+    static uint32_t bucket(const char* p) {
+        uint32_t trigram = (static_cast<uint32_t>(static_cast<unsigned char>(p[0])) << 16) |
+                           (static_cast<uint32_t>(static_cast<unsigned char>(p[1])) << 8) |
+                           static_cast<unsigned char>(p[2]);
+        return (trigram * 2654435761u) >> (32 - INDEX_BITS);
+    }
+
+    void unmap() {
+        if (map) munmap(const_cast<char*>(map), mapped);
+        map = nullptr;
+        mapped = 0;
+    }
+
+    void refresh() {
+        struct stat st;
+        if (fd == -1 || fstat(fd, &st) == -1 || static_cast<size_t>(st.st_size) == mapped) return;
+
+        // Hold a shared lock so a record being appended is never half-read
+        flock(fd, LOCK_SH);
+        fstat(fd, &st);
+        unmap();
+        if (st.st_size > 0) {
+            void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (p != MAP_FAILED) {
+                map = static_cast<const char*>(p);
+                mapped = st.st_size;
+            }
+        }
+        flock(fd, LOCK_UN);
+        if (!map) {
+            offsets.clear();
+            indexed = 0;
+            buckets.clear();
+            return;
+        }
+
+        // A file that shrank, or no longer ends a record where the last one
+        // ended, was truncated or rewritten: parse and index it afresh
+        if (!offsets.empty() && (offsets.back() > mapped || (offsets.back() > 0 && map[offsets.back() - 1] != '\n'))) {
+            offsets.clear();
+            indexed = 0;
+            buckets.clear();
+        }
+        if (offsets.empty()) offsets.push_back(0);
+        const char* p = map + offsets.back();
+        const char* end = map + mapped;
+        while (p < end) {
+            const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+            if (!newline) break; // Incomplete trailing record
+            p = newline + 1;
+            offsets.push_back(p - map);
+        }
+    }
+
+    // Blocks (ascending) below limit that may hold a record containing
+    // pattern, which must be at least three bytes long.
+    std::vector<uint32_t> candidate_blocks(std::string_view pattern, size_t limit) const {
+        std::vector<uint32_t> blocks;
+        std::vector<const std::vector<uint32_t>*> lists;
+        for (size_t i = 0; i + 3 <= pattern.size(); ++i) {
+            const std::vector<uint32_t>& postings = buckets[bucket(pattern.data() + i)];
+            if (postings.empty()) return blocks;
+            lists.push_back(&postings);
+        }
+        std::sort(lists.begin(), lists.end(), [](const std::vector<uint32_t>* a, const std::vector<uint32_t>* b) {
+            return a->size() < b->size();
+        });
+
+        // Intersect starting from the rarest trigram
+        for (uint32_t block : *lists[0]) {
+            if (static_cast<size_t>(block) * BLOCK_RECORDS >= limit) break;
+            blocks.push_back(block);
+        }
+        for (size_t l = 1; l < lists.size() && !blocks.empty(); ++l) {
+            std::vector<uint32_t> kept;
+            std::set_intersection(blocks.begin(), blocks.end(), lists[l]->begin(), lists[l]->end(), std::back_inserter(kept));
+            blocks.swap(kept);
+        }
+        return blocks;
+    }
+
+    void update_index() {
+        if (buckets.empty()) buckets.resize(size_t(1) << INDEX_BITS);
+        size_t count = offsets.empty() ? 0 : offsets.size() - 1;
+        for (; indexed < count; ++indexed) {
+            uint32_t block = indexed / BLOCK_RECORDS;
+            std::string_view text = command(indexed);
+            for (size_t i = 0; i + 3 <= text.size(); ++i) {
+                std::vector<uint32_t>& postings = buckets[bucket(text.data() + i)];
+                if (postings.empty() || postings.back() != block) postings.push_back(block);
+            }
+        }
+    }
+};
+
+#endif
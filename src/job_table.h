@@ -0,0 +1,98 @@
+#ifndef SECSHELL_JOB_TABLE_H
+#define SECSHELL_JOB_TABLE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/types.h>
+
+#include "resource_usage.h"
+
+// Background pipelines, keyed by the PID of their last stage (the ID the
+// user sees). Every process of a job is tracked until it is reaped; a job
+// is finished once all of its processes are.
+class JobTable {
+public:
+    struct Job {
+        std::string name;
+        std::vector<pid_t> pids;   // Stages not yet reaped
+        uint64_t start_us = 0;
+        int status = 0;            // Wait status of the last stage
+        ResourceUsage usage;       // Summed over the reaped stages
+    };
+
+    // One process of a job
+    struct Stage {
+        pid_t job = 0;
+        std::vector<std::string> args;
+        uint64_t start_us = 0;
+    };
+
+    // Starts a job; its processes are added with add_stage().
+    void add(pid_t id, const std::string& name, uint64_t start_us) {
+        Job& job = jobs[id];
+        job.name = name;
+        job.start_us = start_us;
+    }
+
+    void add_stage(pid_t id, pid_t pid, const std::vector<std::string>& args, uint64_t start_us) {
+        jobs[id].pids.push_back(pid);
+        stages[pid] = {id, args, start_us};
+    }
+
+    // Accounts a reaped process to its job. Returns false for a PID no job
+    // owns. Otherwise stage receives the process's stage and, if it was the
+    // job's last process, finished and finished_id the completed job
+    // (finished_id stays 0 while the job still runs).
+    bool reap(pid_t pid, int status, const struct rusage& usage, uint64_t now_us,
+              Stage& stage, Job& finished, pid_t& finished_id) {
+        finished_id = 0;
+        auto it = stages.find(pid);
+        if (it == stages.end()) return false;
+        stage = std::move(it->second);
+        stages.erase(it);
+        auto job_it = jobs.find(stage.job);
+        if (job_it == jobs.end()) return true;
+
+        Job& job = job_it->second;
+        job.usage.add(usage);
+        if (pid == job_it->first) job.status = status;
+        job.pids.erase(std::remove(job.pids.begin(), job.pids.end(), pid), job.pids.end());
+        if (job.pids.empty()) {
+            job.usage.wall_us = now_us - job.start_us;
+            finished = std::move(job);
+            finished_id = job_it->first;
+            jobs.erase(job_it);
+        }
+        return true;
+    }
+
+    // The stage a running process belongs to, or nullptr
+    const Stage* stage(pid_t pid) const {
+        auto it = stages.find(pid);
+        return it == stages.end() ? nullptr : &it->second;
+    }
+
+    // Running jobs, oldest first
+    std::vector<std::pair<pid_t, const Job*>> by_start() const {
+        std::vector<std::pair<pid_t, const Job*>> ordered;
+        for (const auto& job : jobs) ordered.emplace_back(job.first, &job.second);
+        std::sort(ordered.begin(), ordered.end(), [](const std::pair<pid_t, const Job*>& a, const std::pair<pid_t, const Job*>& b) {
+            return a.second->start_us < b.second->start_us;
+        });
+        return ordered;
+    }
+
+    size_t size() const { return jobs.size(); }
+
+private:
+    std::unordered_map<pid_t, Job> jobs;
+    std::unordered_map<pid_t, Stage> stages;
+};
+
+#endif
@@ -0,0 +1,323 @@
+#ifndef SECSHELL_METRICS_H
+#define SECSHELL_METRICS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "box_renderer.h"
+#include "helper_thread.h"
+
+// Log-linear histogram in the style of HdrHistogram: each power of two is
+// split into 16 linear sub-buckets, so a recorded value is known to within
+// 1/16 (values below 16 are exact). record() is three relaxed atomic adds
+// and a max update, safe from any thread without a lock. Readers see a
+// consistent-enough snapshot for reporting, not a transactional one.
+class Histogram {
+public:
+    static const int SUB_BUCKET_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const size_t BUCKETS = SUB_BUCKETS + (64 - SUB_BUCKET_BITS) * SUB_BUCKETS;
+
+    void record(uint64_t value) {
+        counts[index_of(value)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(value, std::memory_order_relaxed);
+        uint64_t seen = maximum.load(std::memory_order_relaxed);
+        while (value > seen && !maximum.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {}
+    }
+
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    uint64_t total_value() const { return sum.load(std::memory_order_relaxed); }
+    uint64_t max() const { return maximum.load(std::memory_order_relaxed); }
+
+    // The smallest bucket bound at or above the given fraction (0..1) of
+    // the recorded values; 0 when empty.
+    uint64_t percentile(double fraction) const {
+        uint64_t n = count();
+        if (n == 0) return 0;
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * n)));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            seen += counts[i].load(std::memory_order_relaxed);
+            if (seen >= rank) return std::min(upper_bound(i), max());
+        }
+        return max();
+    }
+
+    // Values recorded in buckets that lie entirely at or below bound, i.e.
+    // a Prometheus "le" bucket, exact to the histogram's precision.
+    uint64_t count_at_most(uint64_t bound) const {
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS && upper_bound(i) <= bound; ++i) {
+            seen += counts[i].load(std::memory_order_relaxed);
+        }
+        return seen;
+    }
+
+    void reset() {
+        for (auto& c : counts) c.store(0, std::memory_order_relaxed);
+        total.store(0, std::memory_order_relaxed);
+        sum.store(0, std::memory_order_relaxed);
+        maximum.store(0, std::memory_order_relaxed);
+    }
+
+    static size_t index_of(uint64_t value) {
+        if (value < static_cast<uint64_t>(SUB_BUCKETS)) return static_cast<size_t>(value);
+        int shift = 63 - __builtin_clzll(value) - SUB_BUCKET_BITS;
+        return SUB_BUCKETS + shift * SUB_BUCKETS + ((value >> shift) & (SUB_BUCKETS - 1));
+    }
+
+    // Largest value that lands in bucket index
+    static uint64_t upper_bound(size_t index) {
+        if (index < static_cast<size_t>(SUB_BUCKETS)) return index;
+        size_t shift = (index - SUB_BUCKETS) / SUB_BUCKETS;
+        uint64_t sub = (index - SUB_BUCKETS) % SUB_BUCKETS;
+        uint64_t lower = (SUB_BUCKETS + sub) << shift;
+        return lower + ((uint64_t(1) << shift) - 1);
+    }
+
+private:
+    std::atomic<uint64_t> counts[BUCKETS] = {};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> maximum{0};
+};
+
+// The shell's runtime counters and latency histograms, shown by `stats`
+// and rendered in the Prometheus text format for node_exporter's textfile
+// collector. Latencies are recorded in microseconds and exported in
+// seconds. Every update is lock-free, so parallel's worker threads record
+// spawns directly.
+class Metrics {
+public:
+    // Outcome of the policy checks for one command (pipeline stage), plus
+    // allowed commands whose spawn then failed
+    enum Outcome { Allowed, Blacklisted, NotPermitted, Denied, ExecFailure, OUTCOMES };
+    // How an allowed command ran
+    enum Kind { Builtin, External, InProcess, KINDS };
+
+    Histogram spawn_us;         // posix_spawn until the child has exec'd
+    Histogram command_us;       // One command line, parse to last stage reaped
+    Histogram readline_us;      // Waiting at the prompt for one line
+    Histogram prompt_us;        // Rendering the prompt, including any wait for slow segments
+    Histogram prompt_async_us;  // Computing the slow prompt segments on the worker
+    Histogram pipeline_depth;   // Stages per pipeline
+
+    void command(Outcome outcome) { outcomes[outcome].fetch_add(1, std::memory_order_relaxed); }
+    void execution(Kind kind) { kinds[kind].fetch_add(1, std::memory_order_relaxed); }
+    void job_started() { jobs_started.fetch_add(1, std::memory_order_relaxed); }
+    void job_finished() { jobs_finished.fetch_add(1, std::memory_order_relaxed); }
+    void service_task(bool cached) { (cached ? services_cached : services_run).fetch_add(1, std::memory_order_relaxed); }
+
+    uint64_t commands(Outcome outcome) const { return outcomes[outcome].load(std::memory_order_relaxed); }
+    uint64_t executions(Kind kind) const { return kinds[kind].load(std::memory_order_relaxed); }
+    uint64_t started_jobs() const { return jobs_started.load(std::memory_order_relaxed); }
+    uint64_t finished_jobs() const { return jobs_finished.load(std::memory_order_relaxed); }
+    uint64_t running_jobs() const {
+        uint64_t finished = finished_jobs(), started = started_jobs();
+        return started > finished ? started - finished : 0;
+    }
+    uint64_t service_tasks(bool cached) const { return (cached ? services_cached : services_run).load(std::memory_order_relaxed); }
+
+    void reset() {
+        for (auto& c : outcomes) c.store(0, std::memory_order_relaxed);
+        for (auto& c : kinds) c.store(0, std::memory_order_relaxed);
+        for (Histogram* h : {&spawn_us, &command_us, &readline_us, &prompt_us, &prompt_async_us, &pipeline_depth}) h->reset();
+        // Jobs still running keep counting, so finished never exceeds started
+        uint64_t running = running_jobs();
+        jobs_started.store(running, std::memory_order_relaxed);
+        jobs_finished.store(0, std::memory_order_relaxed);
+        services_run.store(0, std::memory_order_relaxed);
+        services_cached.store(0, std::memory_order_relaxed);
+    }
+
+    // Prometheus text exposition format. labels (e.g. pid="123") is added
+    // to every series.
+    std::string prometheus(const std::string& labels = "") const {
+        static const char* OUTCOME_NAMES[OUTCOMES] = {"allowed", "blacklisted", "not_permitted", "denied", "exec_failure"};
+        static const char* KIND_NAMES[KINDS] = {"builtin", "external", "in_process"};
+        std::string out;
+
+        header(out, "secshell_commands_total", "counter", "Commands checked against the policy, by outcome.");
+        for (int i = 0; i < OUTCOMES; ++i) {
+            sample(out, "secshell_commands_total", join("outcome=\"" + std::string(OUTCOME_NAMES[i]) + "\"", labels), commands(Outcome(i)));
+        }
+        header(out, "secshell_executions_total", "counter", "Allowed commands run, by kind.");
+        for (int i = 0; i < KINDS; ++i) {
+            sample(out, "secshell_executions_total", join("kind=\"" + std::string(KIND_NAMES[i]) + "\"", labels), executions(Kind(i)));
+        }
+
+        time_histogram(out, "secshell_spawn_seconds", "Time to fork and exec a command.", spawn_us, labels);
+        time_histogram(out, "secshell_command_seconds", "Time spent executing command lines.", command_us, labels);
+        time_histogram(out, "secshell_readline_seconds", "Time spent waiting at the prompt for a line.", readline_us, labels);
+        time_histogram(out, "secshell_prompt_seconds", "Time to render the prompt.", prompt_us, labels);
+        time_histogram(out, "secshell_prompt_async_seconds", "Time to compute the slow prompt segments.", prompt_async_us, labels);
+
+        header(out, "secshell_pipeline_depth", "histogram", "Stages per pipeline.");
+        for (uint64_t bound : DEPTH_BOUNDS) {
+            sample(out, "secshell_pipeline_depth_bucket", join("le=\"" + std::to_string(bound) + "\"", labels),
+                   pipeline_depth.count_at_most(bound));
+        }
+        sample(out, "secshell_pipeline_depth_bucket", join("le=\"+Inf\"", labels), pipeline_depth.count());
+        sample(out, "secshell_pipeline_depth_sum", labels, pipeline_depth.total_value());
+        sample(out, "secshell_pipeline_depth_count", labels, pipeline_depth.count());
+
+        header(out, "secshell_background_jobs_started_total", "counter", "Background jobs started.");
+        sample(out, "secshell_background_jobs_started_total", labels, started_jobs());
+        header(out, "secshell_background_jobs_finished_total", "counter", "Background jobs finished.");
+        sample(out, "secshell_background_jobs_finished_total", labels, finished_jobs());
+        header(out, "secshell_background_jobs", "gauge", "Background jobs running.");
+        sample(out, "secshell_background_jobs", labels, running_jobs());
+
+        header(out, "secshell_service_tasks_total", "counter", "services targets handled, by whether the cache answered.");
+        sample(out, "secshell_service_tasks_total", join("cached=\"false\"", labels), service_tasks(false));
+        sample(out, "secshell_service_tasks_total", join("cached=\"true\"", labels), service_tasks(true));
+        return out;
+    }
+
+private:
+    // Prometheus bucket bounds: latencies in microseconds, depth in stages
+    static constexpr uint64_t TIME_BOUNDS[] = {10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+                                               100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000,
+                                               30000000, 60000000, 300000000};
+    static constexpr uint64_t DEPTH_BOUNDS[] = {1, 2, 3, 4, 6, 8, 12, 16};
+
+    std::atomic<uint64_t> outcomes[OUTCOMES] = {};
+    std::atomic<uint64_t> kinds[KINDS] = {};
+    std::atomic<uint64_t> jobs_started{0};
+    std::atomic<uint64_t> jobs_finished{0};
+    std::atomic<uint64_t> services_run{0};
+    std::atomic<uint64_t> services_cached{0};
+
+    static std::string join(const std::string& a, const std::string& b) {
+        return a.empty() ? b : b.empty() ? a : a + "," + b;
+    }
+
+    static std::string seconds(uint64_t us) {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%g", us / 1e6);
+        return buffer;
+    }
+
+    static void header(std::string& out, const char* name, const char* type, const char* help) {
+        out += std::string("# HELP ") + name + " " + help + "\n# TYPE " + name + " " + type + "\n";
+    }
+
+    static void sample(std::string& out, const std::string& name, const std::string& labels, const std::string& value) {
+        out += name + (labels.empty() ? "" : "{" + labels + "}") + " " + value + "\n";
+    }
+
+    static void sample(std::string& out, const std::string& name, const std::string& labels, uint64_t value) {
+        sample(out, name, labels, std::to_string(value));
+    }
+
+    static void time_histogram(std::string& out, const std::string& name, const char* help, const Histogram& histogram,
+                               const std::string& labels) {
+        header(out, name.c_str(), "histogram", help);
+        for (uint64_t bound : TIME_BOUNDS) {
+            sample(out, name + "_bucket", join("le=\"" + seconds(bound) + "\"", labels), histogram.count_at_most(bound));
+        }
+        sample(out, name + "_bucket", join("le=\"+Inf\"", labels), histogram.count());
+        sample(out, name + "_sum", labels, seconds(histogram.total_value()));
+        sample(out, name + "_count", labels, histogram.count());
+    }
+};
+
+// Rewrites a Prometheus text file from a background thread every interval,
+// for node_exporter's textfile collector. Each write goes to a temporary
+// file renamed over the target, so the collector never reads half a file.
+// A "%p" in the path becomes the shell's PID, letting concurrent sessions
+// export side by side; their series then carry a pid label, and the file
+// is removed when the session ends.
+class MetricsExporter {
+public:
+    ~MetricsExporter() {
+        stop();
+    }
+
+    bool start(const Metrics& source, const std::string& path_template, int interval_seconds) {
+        stop();
+        metrics = &source;
+        path = path_template;
+        labels.clear();
+        size_t at = path.find("%p");
+        per_session = at != std::string::npos;
+        if (per_session) {
+            std::string pid = std::to_string(getpid());
+            path.replace(at, 2, pid);
+            labels = "pid=\"" + pid + "\"";
+        }
+        interval_ms = std::max(1, interval_seconds) * 1000;
+        if (!write_file() || pipe2(stop_pipe, O_CLOEXEC) == -1) {
+            stop();
+            return false;
+        }
+
+        writer = start_helper_thread([this] { write_loop(); });
+        return true;
+    }
+
+    // Writes a final snapshot (or removes a per-session file) and stops.
+    void stop() {
+        if (writer.joinable()) {
+            char c = 0;
+            (void)!write(stop_pipe[1], &c, 1);
+            writer.join();
+            if (per_session) {
+                unlink(path.c_str());
+            } else {
+                write_file();
+            }
+        }
+        for (int& fd : stop_pipe) {
+            if (fd != -1) close(fd);
+            fd = -1;
+        }
+    }
+
+    bool running() const { return writer.joinable(); }
+    const std::string& file() const { return path; }
+
+private:
+    const Metrics* metrics = nullptr;
+    std::string path;
+    std::string labels;
+    bool per_session = false;
+    int interval_ms = 15000;
+    std::thread writer;
+    int stop_pipe[2] = {-1, -1};
+
+    void write_loop() {
+        struct pollfd stop_fd = {stop_pipe[0], POLLIN, 0};
+        for (;;) {
+            int ready = poll(&stop_fd, 1, interval_ms);
+            if (ready > 0 || (ready < 0 && errno != EINTR)) return;
+            write_file();
+        }
+    }
+
+    bool write_file() const {
+        std::string temp = path + ".tmp";
+        int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd == -1) return false;
+        bool ok = BoxRenderer::write_all(fd, metrics->prometheus(labels));
+        ok = close(fd) == 0 && ok;
+        if (!ok || rename(temp.c_str(), path.c_str()) != 0) {
+            unlink(temp.c_str());
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif
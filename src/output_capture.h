@@ -0,0 +1,137 @@
+#ifndef SECSHELL_OUTPUT_CAPTURE_H
+#define SECSHELL_OUTPUT_CAPTURE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// Bounded capture of a background job's output. The most recent bytes stay
+// in a fixed in-memory ring; once more than that has been written, output
+// also goes to an unlinked temp file used as a larger ring of its own, so
+// a chatty job costs at most memory_bytes of RAM and spill_bytes of disk.
+// Bytes are addressed by their offset in the job's whole output stream.
+class OutputCapture {
+public:
+    OutputCapture(size_t memory_bytes, uint64_t spill_bytes)
+        : memory(std::max<size_t>(memory_bytes, 1)), spill_capacity(spill_bytes) {}
+
+    ~OutputCapture() {
+        if (spill_fd != -1) close(spill_fd);
+    }
+
+    OutputCapture(const OutputCapture&) = delete;
+    OutputCapture& operator=(const OutputCapture&) = delete;
+
+    void append(const char* data, size_t size) {
+        if (spill_fd == -1 && written + size > memory.size() && spill_capacity > memory.size()) {
+            start_spill();
+        }
+        if (spill_fd != -1) {
+            if (!ring_write(data, size)) {
+                close(spill_fd); // Disk full or similar; fall back to the memory tail
+                spill_fd = -1;
+            }
+        }
+        // Only the last memory.size() bytes can survive in memory
+        if (size > memory.size()) {
+            written += size - memory.size();
+            data += size - memory.size();
+            size = memory.size();
+        }
+        size_t pos = written % memory.size();
+        size_t first = std::min(size, memory.size() - pos);
+        memcpy(memory.data() + pos, data, first);
+        memcpy(memory.data(), data + first, size - first);
+        written += size;
+    }
+
+    uint64_t total() const { return written; }
+    bool spilled() const { return spill_fd != -1; }
+
+    // Oldest offset still retained; everything before it was dropped.
+    uint64_t first_available() const {
+        uint64_t kept = spill_fd != -1 ? spill_capacity : memory.size();
+        return written > kept ? written - kept : 0;
+    }
+
+    // Appends up to max bytes starting at offset to out and advances offset.
+    // An offset that has already been dropped moves to the oldest byte kept.
+    void read(uint64_t& offset, std::string& out, size_t max) const {
+        offset = std::max(offset, first_available());
+        size_t size = std::min<uint64_t>(max, written - offset);
+        if (size == 0) return;
+
+        size_t start = out.size();
+        out.resize(start + size);
+        char* dest = &out[start];
+        if (written - offset <= memory.size()) {
+            size_t pos = offset % memory.size();
+            size_t first = std::min(size, memory.size() - pos);
+            memcpy(dest, memory.data() + pos, first);
+            memcpy(dest + first, memory.data(), size - first);
+        } else {
+            size_t pos = offset % spill_capacity;
+            size_t first = std::min<uint64_t>(size, spill_capacity - pos);
+            if (pread(spill_fd, dest, first, pos) != static_cast<ssize_t>(first) ||
+                (size > first && pread(spill_fd, dest + first, size - first, 0) != static_cast<ssize_t>(size - first))) {
+                out.resize(start);
+                return;
+            }
+        }
+        offset += size;
+    }
+
+private:
+    std::vector<char> memory;
+    uint64_t spill_capacity;
+    uint64_t written = 0;
+    int spill_fd = -1;
+
+    // Moves what memory holds into a fresh temp file at its stream offsets.
+    void start_spill() {
+        const char* tmpdir = getenv("TMPDIR");
+        std::string dir = tmpdir && *tmpdir ? tmpdir : "/tmp";
+        spill_fd = open(dir.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+        if (spill_fd == -1) {
+            std::string path = dir + "/secshell-output.XXXXXX";
+            spill_fd = mkostemp(&path[0], O_CLOEXEC);
+            if (spill_fd == -1) return;
+            unlink(path.c_str());
+        }
+        std::string kept;
+        uint64_t offset = first_available();
+        uint64_t end = written;
+        int fd = spill_fd;
+        spill_fd = -1; // Read the existing bytes from memory
+        read(offset, kept, end - offset);
+        spill_fd = fd;
+        written -= kept.size();
+        if (!ring_write(kept.data(), kept.size())) {
+            close(spill_fd);
+            spill_fd = -1;
+        }
+        written += kept.size();
+    }
+
+    // Writes at the stream position written..written+size of the file ring.
+    bool ring_write(const char* data, size_t size) {
+        uint64_t offset = written;
+        if (size > spill_capacity) {
+            offset += size - spill_capacity;
+            data += size - spill_capacity;
+            size = spill_capacity;
+        }
+        size_t pos = offset % spill_capacity;
+        size_t first = std::min<uint64_t>(size, spill_capacity - pos);
+        return pwrite(spill_fd, data, first, pos) == static_cast<ssize_t>(first) &&
+               (size == first || pwrite(spill_fd, data + first, size - first, 0) == static_cast<ssize_t>(size - first));
+    }
+};
+
+#endif
@@ -0,0 +1,627 @@
+#ifndef SECSHELL_PATTERN_SET_H
+#define SECSHELL_PATTERN_SET_H
+
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Many patterns over short strings (command names, arguments, paths), each
+// tagged with a kind byte, matched against one string in a single pass no
+// matter how many patterns there are. A pattern matches the whole string.
+//
+// Globs shaped like literals (exact, prefix*, *suffix, *infix*) go into an
+// Aho-Corasick automaton fed "\x01" kind "\x03" text "\x02", the sentinels
+// turning anchored literals into plain substrings. Nothing ending in that
+// prefix is reported, so unanchored literals never match the kind byte;
+// literals holding a sentinel byte go to the NFA instead. Other globs and
+// /regexes/ are compiled into one Thompson NFA whose paths all start with
+// their kind byte; it runs as a DFA built lazily from the states actually
+// reached and cached, as in RE2, so hot strings cost one table lookup per
+// byte.
+class PatternSet {
+public:
+    static const size_t MAX_DFA_STATES = 4096; // Cache is flushed beyond this
+
+    // Glob syntax: * (any run of bytes, '/' included), ? (one byte), [a-z]
+    // and [!a-z] classes, and \ to escape. Returns false and sets error on a
+    // malformed pattern.
+    bool add_glob(uint8_t kind, const std::string& glob, int id, std::string& error) {
+        std::vector<Item> items;
+        if (!parse_glob(glob, items, error)) return false;
+        kinds.set(kind);
+
+        size_t first = 0, last = items.size();
+        bool leading = first < last && items[first].type == Item::Star;
+        if (leading) ++first;
+        bool trailing = last > first && items[last - 1].type == Item::Star;
+        if (trailing) --last;
+        bool literal = std::all_of(items.begin() + first, items.begin() + last,
+                                   [](const Item& item) { return item.type == Item::Byte && item.byte > 0x03; });
+        if (literal) {
+            if (first == last && (leading || trailing)) {
+                anys.push_back({kind, id}); // "*" matches everything
+                return true;
+            }
+            std::string text;
+            if (!leading) text += {'\x01', static_cast<char>(kind), '\x03'};
+            for (size_t i = first; i < last; ++i) text += static_cast<char>(items[i].byte);
+            if (!trailing) text += '\x02';
+            add_literal(text, kind, id);
+            return true;
+        }
+
+        Fragment fragment;
+        for (const Item& item : items) {
+            if (item.type == Item::Star) {
+                fragment = concat(fragment, any_run());
+            } else if (item.type == Item::Byte) {
+                fragment = concat(fragment, single(new_state(NfaState::Byte, item.byte)));
+            } else {
+                int state = new_state(NfaState::Class);
+                nfa[state].cls = intern_class(item.cls);
+                fragment = concat(fragment, single(state));
+            }
+        }
+        add_pattern(kind, fragment, id);
+        return true;
+    }
+
+    // Regex syntax: literals, ., [...] classes (ranges, ^ negation),
+    // \d \w \s and escaped metacharacters, * + ?, | and ( ). Matches
+    // anywhere in the string unless anchored with ^ and/or $ at its ends.
+    bool add_regex(uint8_t kind, const std::string& regex, int id, std::string& error) {
+        std::string body = regex;
+        bool anchor_start = !body.empty() && body[0] == '^';
+        if (anchor_start) body.erase(0, 1);
+        bool anchor_end = !body.empty() && body.back() == '$' && (body.size() < 2 || body[body.size() - 2] != '\\');
+        if (anchor_end) body.pop_back();
+
+        size_t mark = nfa.size();
+        RegexParser parser{*this, body, 0, error};
+        Fragment fragment;
+        if (!parser.parse_alternation(fragment)) {
+            nfa.resize(mark);
+            return false;
+        }
+        if (parser.pos != body.size()) {
+            error = "unexpected '" + std::string(1, body[parser.pos]) + "' in regex";
+            nfa.resize(mark);
+            return false;
+        }
+        kinds.set(kind);
+        if (!anchor_start) fragment = concat(any_run(), fragment);
+        if (!anchor_end) fragment = concat(fragment, any_run());
+        add_pattern(kind, fragment, id);
+        return true;
+    }
+
+    // Builds the Aho-Corasick links. Call once after the last add_*.
+    void compile() {
+        build_automaton();
+        reset_dfa();
+    }
+
+    bool has_kind(uint8_t kind) const { return kinds.test(kind); }
+
+    // Calls on_match(id) for every pattern of this kind matching text. An
+    // id may be reported more than once.
+    template <typename OnMatch>
+    void scan(uint8_t kind, std::string_view text, OnMatch&& on_match) {
+        if (!kinds.test(kind)) return;
+        for (const auto& any : anys) {
+            if (any.first == kind) on_match(any.second);
+        }
+
+        if (nodes.size() > 1) {
+            int node = 0;
+            auto feed = [&](uint8_t byte) {
+                node = next_node(node, byte);
+                for (int out = nodes[node].output; out != -1; out = nodes[out].dict) {
+                    for (uint32_t i = nodes[out].outputs_begin; i < nodes[out].outputs_end; ++i) {
+                        if (literals[outputs[i]].first == kind) on_match(literals[outputs[i]].second);
+                    }
+                }
+            };
+            for (uint8_t byte : {uint8_t(0x01), kind, uint8_t(0x03)}) node = next_node(node, byte);
+            for (char c : text) feed(static_cast<uint8_t>(c));
+            feed(0x02);
+        }
+
+        if (!starts.empty()) {
+            if (dstates.size() > MAX_DFA_STATES) reset_dfa();
+            int d = step(start_dstate, kind);
+            for (size_t i = 0; i < text.size() && d != DEAD; ++i) d = step(d, static_cast<uint8_t>(text[i]));
+            if (d != DEAD) {
+                for (int id : dstates[d].accepts) on_match(id);
+            }
+        }
+    }
+
+    size_t literal_count() const { return literals.size(); }
+    size_t nfa_size() const { return nfa.size(); }
+    size_t dfa_size() const { return dstates.size(); }
+    unsigned long dfa_flushes() const { return flushes; }
+
+private:
+    // ---- Glob parsing ----
+
+    struct Item {
+        enum Type { Byte, Star, Class } type;
+        uint8_t byte;
+        std::bitset<256> cls;
+    };
+
+    static bool parse_class(const std::string& text, size_t& pos, std::bitset<256>& cls, char negate_a, char negate_b,
+                            std::string& error) {
+        // pos is just past '['
+        bool negate = pos < text.size() && (text[pos] == negate_a || text[pos] == negate_b);
+        if (negate) ++pos;
+        bool first = true;
+        while (pos < text.size() && (text[pos] != ']' || first)) {
+            first = false;
+            uint8_t lo = static_cast<uint8_t>(text[pos]);
+            if (text[pos] == '\\' && pos + 1 < text.size()) lo = static_cast<uint8_t>(text[++pos]);
+            ++pos;
+            uint8_t hi = lo;
+            if (pos + 1 < text.size() && text[pos] == '-' && text[pos + 1] != ']') {
+                hi = static_cast<uint8_t>(text[pos + 1] == '\\' && pos + 2 < text.size() ? text[pos + 2] : text[pos + 1]);
+                pos += text[pos + 1] == '\\' ? 3 : 2;
+                if (hi < lo) {
+                    error = "reversed range in character class";
+                    return false;
+                }
+            }
+            for (int b = lo; b <= hi; ++b) cls.set(b);
+        }
+        if (pos >= text.size()) {
+            error = "unterminated character class";
+            return false;
+        }
+        ++pos; // ']'
+        if (negate) cls.flip();
+        return true;
+    }
+
+    static bool parse_glob(const std::string& glob, std::vector<Item>& items, std::string& error) {
+        for (size_t pos = 0; pos < glob.size();) {
+            char c = glob[pos++];
+            Item item{Item::Byte, static_cast<uint8_t>(c), {}};
+            if (c == '*') {
+                if (!items.empty() && items.back().type == Item::Star) continue; // ** is *
+                item.type = Item::Star;
+            } else if (c == '?') {
+                item.type = Item::Class;
+                item.cls.set();
+            } else if (c == '[') {
+                item.type = Item::Class;
+                if (!parse_class(glob, pos, item.cls, '!', '^', error)) return false;
+            } else if (c == '\\') {
+                if (pos >= glob.size()) {
+                    error = "trailing backslash";
+                    return false;
+                }
+                item.byte = static_cast<uint8_t>(glob[pos++]);
+            }
+            items.push_back(item);
+        }
+        return true;
+    }
+
+    // ---- Aho-Corasick ----
+
+    struct Node {
+        uint32_t edges_begin = 0, edges_end = 0; // Sorted (byte, child) pairs
+        int fail = 0;
+        int output = -1;     // This node if it ends a literal, else the nearest suffix that does
+        int dict = -1;       // Next node with outputs along the failure chain
+        uint32_t outputs_begin = 0, outputs_end = 0;
+    };
+
+    std::vector<std::pair<uint8_t, int>> edges;
+    std::vector<Node> nodes;
+    int root_next[256];
+    std::vector<int> outputs;                          // Indexes into literals
+    std::vector<std::pair<uint8_t, int>> literals;     // (kind, id)
+    // Trie under construction: text -> literal indexes
+    std::map<std::string, std::vector<int>> pending_literals;
+    std::vector<std::pair<uint8_t, int>> anys;
+    std::bitset<256> kinds;
+
+    void add_literal(const std::string& text, uint8_t kind, int id) {
+        pending_literals[text].push_back(static_cast<int>(literals.size()));
+        literals.push_back({kind, id});
+    }
+
+    int child(int node, uint8_t byte) const {
+        if (node == 0) return root_next[byte];
+        const Node& n = nodes[node];
+        for (uint32_t i = n.edges_begin; i < n.edges_end; ++i) {
+            if (edges[i].first == byte) return edges[i].second;
+            if (edges[i].first > byte) break;
+        }
+        return -1;
+    }
+
+    int next_node(int node, uint8_t byte) const {
+        for (;;) {
+            int next = child(node, byte);
+            if (next != -1) return next;
+            if (node == 0) return 0;
+            node = nodes[node].fail;
+        }
+    }
+
+    // The sorted literal map is walked depth first, so every node's
+    // children are created consecutively and each node's edges form one
+    // contiguous run.
+    void build_automaton() {
+        nodes.assign(1, Node());
+        edges.clear();
+        outputs.clear();
+        std::fill(std::begin(root_next), std::end(root_next), -1);
+        if (pending_literals.empty()) return;
+
+        // Trie with per-node child maps, then flattened
+        std::vector<std::map<uint8_t, int>> children(1);
+        std::vector<std::vector<int>> ends(1);
+        for (const auto& literal : pending_literals) {
+            int node = 0;
+            for (char c : literal.first) {
+                auto it = children[node].find(static_cast<uint8_t>(c));
+                if (it == children[node].end()) {
+                    int created = static_cast<int>(children.size());
+                    children[node][static_cast<uint8_t>(c)] = created;
+                    children.emplace_back();
+                    ends.emplace_back();
+                    node = created;
+                } else {
+                    node = it->second;
+                }
+            }
+            ends[node].insert(ends[node].end(), literal.second.begin(), literal.second.end());
+        }
+        nodes.assign(children.size(), Node());
+        for (size_t n = 0; n < children.size(); ++n) {
+            nodes[n].edges_begin = static_cast<uint32_t>(edges.size());
+            for (const auto& edge : children[n]) edges.push_back(edge);
+            nodes[n].edges_end = static_cast<uint32_t>(edges.size());
+            nodes[n].outputs_begin = static_cast<uint32_t>(outputs.size());
+            outputs.insert(outputs.end(), ends[n].begin(), ends[n].end());
+            nodes[n].outputs_end = static_cast<uint32_t>(outputs.size());
+            if (!ends[n].empty()) nodes[n].output = static_cast<int>(n);
+        }
+        for (const auto& edge : children[0]) root_next[edge.first] = edge.second;
+
+        // Breadth first: failure and dictionary links
+        std::vector<int> queue;
+        for (const auto& edge : children[0]) queue.push_back(edge.second);
+        for (size_t head = 0; head < queue.size(); ++head) {
+            int node = queue[head];
+            for (const auto& edge : children[node]) {
+                int target = edge.second;
+                int fail = nodes[node].fail;
+                int next;
+                while ((next = child(fail, edge.first)) == -1 && fail != 0) fail = nodes[fail].fail;
+                nodes[target].fail = next == -1 || next == target ? 0 : next;
+                int suffix = nodes[target].fail;
+                nodes[target].dict = nodes[suffix].output;
+                if (nodes[target].output == -1) nodes[target].output = nodes[target].dict;
+                queue.push_back(target);
+            }
+        }
+        pending_literals.clear();
+    }
+
+    // ---- Thompson NFA ----
+
+    struct NfaState {
+        enum Type : uint8_t { Byte, Class, Split, Match } type;
+        uint8_t byte = 0;
+        int cls = -1;
+        int out = -1, out1 = -1;
+        int id = -1; // Match only
+    };
+
+    struct Fragment {
+        int start = -1;
+        std::vector<std::pair<int, bool>> outs; // Dangling (state, out1?) links
+    };
+
+    std::vector<NfaState> nfa;
+    std::vector<std::bitset<256>> classes;
+    std::unordered_map<std::string, int> class_ids;
+    std::vector<int> starts;
+
+    int new_state(NfaState::Type type, uint8_t byte = 0) {
+        NfaState state;
+        state.type = type;
+        state.byte = byte;
+        nfa.push_back(state);
+        return static_cast<int>(nfa.size()) - 1;
+    }
+
+    int intern_class(const std::bitset<256>& cls) {
+        std::string key = cls.to_string();
+        auto it = class_ids.find(key);
+        if (it != class_ids.end()) return it->second;
+        classes.push_back(cls);
+        int id = static_cast<int>(classes.size()) - 1;
+        class_ids.emplace(std::move(key), id);
+        return id;
+    }
+
+    int any_class() {
+        std::bitset<256> all;
+        all.set();
+        return intern_class(all);
+    }
+
+    void patch(const std::vector<std::pair<int, bool>>& outs, int target) {
+        for (const auto& out : outs) (out.second ? nfa[out.first].out1 : nfa[out.first].out) = target;
+    }
+
+    Fragment single(int state) {
+        Fragment f;
+        f.start = state;
+        f.outs.push_back({state, false});
+        return f;
+    }
+
+    Fragment concat(Fragment a, const Fragment& b) {
+        if (a.start == -1) return b;
+        if (b.start == -1) return a;
+        patch(a.outs, b.start);
+        a.outs = b.outs;
+        return a;
+    }
+
+    // .* as a fragment
+    Fragment any_run() {
+        int split = new_state(NfaState::Split);
+        int any = new_state(NfaState::Class);
+        nfa[any].cls = any_class();
+        nfa[any].out = split;
+        nfa[split].out = any;
+        Fragment f;
+        f.start = split;
+        f.outs.push_back({split, true});
+        return f;
+    }
+
+    struct RegexParser {
+        PatternSet& set;
+        const std::string& text;
+        size_t pos;
+        std::string& error;
+
+        bool parse_alternation(Fragment& result) {
+            Fragment left;
+            if (!parse_concatenation(left)) return false;
+            while (pos < text.size() && text[pos] == '|') {
+                ++pos;
+                Fragment right;
+                if (!parse_concatenation(right)) return false;
+                int split = set.new_state(NfaState::Split);
+                Fragment joined;
+                joined.start = split;
+                if (left.start == -1) {
+                    joined.outs.push_back({split, false});
+                } else {
+                    set.nfa[split].out = left.start;
+                    joined.outs = left.outs;
+                }
+                if (right.start == -1) {
+                    joined.outs.push_back({split, true});
+                } else {
+                    set.nfa[split].out1 = right.start;
+                    joined.outs.insert(joined.outs.end(), right.outs.begin(), right.outs.end());
+                }
+                left = joined;
+            }
+            result = left;
+            return true;
+        }
+
+        bool parse_concatenation(Fragment& result) {
+            result = Fragment();
+            while (pos < text.size() && text[pos] != '|' && text[pos] != ')') {
+                Fragment atom;
+                if (!parse_repetition(atom)) return false;
+                result = set.concat(result, atom);
+            }
+            return true;
+        }
+
+        bool parse_repetition(Fragment& result) {
+            if (!parse_atom(result)) return false;
+            while (pos < text.size() && (text[pos] == '*' || text[pos] == '+' || text[pos] == '?')) {
+                char op = text[pos++];
+                int split = set.new_state(NfaState::Split);
+                set.nfa[split].out = result.start;
+                if (op == '?') {
+                    Fragment f;
+                    f.start = split;
+                    f.outs = result.outs;
+                    f.outs.push_back({split, true});
+                    result = f;
+                    continue;
+                }
+                set.patch(result.outs, split);
+                Fragment f;
+                f.start = op == '*' ? split : result.start;
+                f.outs.push_back({split, true});
+                result = f;
+            }
+            if (pos < text.size() && text[pos] == '{') {
+                error = "repetition counts are not supported";
+                return false;
+            }
+            return true;
+        }
+
+        bool parse_atom(Fragment& result) {
+            char c = text[pos++];
+            if (c == '(') {
+                if (!parse_alternation(result)) return false;
+                if (pos >= text.size() || text[pos] != ')') {
+                    error = "missing ')' in regex";
+                    return false;
+                }
+                ++pos;
+                if (result.start == -1) {
+                    // () matches the empty string
+                    int split = set.new_state(NfaState::Split);
+                    result = Fragment();
+                    result.start = split;
+                    result.outs.push_back({split, false});
+                }
+                return true;
+            }
+            if (c == '*' || c == '+' || c == '?') {
+                error = std::string("nothing to repeat before '") + c + "'";
+                return false;
+            }
+            if (c == '^' || c == '$') {
+                error = "anchors are only supported at the ends of a regex";
+                return false;
+            }
+            std::bitset<256> cls;
+            if (c == '.') {
+                cls.set();
+            } else if (c == '[') {
+                if (!parse_class(text, pos, cls, '^', '^', error)) return false;
+            } else if (c == '\\') {
+                if (pos >= text.size()) {
+                    error = "trailing backslash";
+                    return false;
+                }
+                char e = text[pos++];
+                if (e == 'd' || e == 'w' || e == 's') {
+                    for (int b = 0; b < 256; ++b) {
+                        if ((e == 'd' && isdigit(b)) || (e == 'w' && (isalnum(b) || b == '_')) || (e == 's' && isspace(b))) cls.set(b);
+                    }
+                } else {
+                    result = set.single(set.new_state(NfaState::Byte, static_cast<uint8_t>(e)));
+                    return true;
+                }
+            } else {
+                result = set.single(set.new_state(NfaState::Byte, static_cast<uint8_t>(c)));
+                return true;
+            }
+            int state = set.new_state(NfaState::Class);
+            set.nfa[state].cls = set.intern_class(cls);
+            result = set.single(state);
+            return true;
+        }
+    };
+
+    // kind byte, the pattern, then a Match state reporting id
+    void add_pattern(uint8_t kind, const Fragment& fragment, int id) {
+        Fragment whole = concat(single(new_state(NfaState::Byte, kind)), fragment);
+        int match = new_state(NfaState::Match);
+        nfa[match].id = id;
+        patch(whole.outs, match);
+        starts.push_back(whole.start);
+    }
+
+    // ---- Lazy DFA ----
+
+    static constexpr int UNKNOWN = -1;
+    static constexpr int DEAD = -2;
+
+    struct DState {
+        std::vector<int> states;   // NFA Byte/Class/Match states, sorted
+        std::vector<int> accepts;  // Ids of Match states
+    };
+
+    struct VectorHash {
+        size_t operator()(const std::vector<int>& v) const {
+            size_t h = v.size();
+            for (int x : v) h = h * 1000003 ^ static_cast<size_t>(x);
+            return h;
+        }
+    };
+
+    std::vector<DState> dstates;
+    std::vector<int> transitions; // 256 per DFA state
+    std::unordered_map<std::vector<int>, int, VectorHash> dstate_ids;
+    int start_dstate = 0;
+    std::vector<uint32_t> visited; // Closure marks, by generation
+    uint32_t generation = 0;
+    unsigned long flushes = 0;
+
+    void reset_dfa() {
+        if (!dstates.empty()) ++flushes;
+        dstates.clear();
+        transitions.clear();
+        dstate_ids.clear();
+        visited.assign(nfa.size(), 0);
+        generation = 0;
+        std::vector<int> set;
+        ++generation;
+        for (int s : starts) closure(s, set);
+        start_dstate = intern_dstate(std::move(set));
+    }
+
+    // Adds the non-split states reachable from s without consuming input
+    void closure(int s, std::vector<int>& set) {
+        std::vector<int> stack{s};
+        while (!stack.empty()) {
+            int state = stack.back();
+            stack.pop_back();
+            if (state < 0 || visited[state] == generation) continue;
+            visited[state] = generation;
+            const NfaState& n = nfa[state];
+            if (n.type == NfaState::Split) {
+                stack.push_back(n.out1);
+                stack.push_back(n.out);
+            } else {
+                set.push_back(state);
+            }
+        }
+    }
+
+    int intern_dstate(std::vector<int> set) {
+        if (set.empty()) return DEAD;
+        std::sort(set.begin(), set.end());
+        auto it = dstate_ids.find(set);
+        if (it != dstate_ids.end()) return it->second;
+        DState d;
+        for (int s : set) {
+            if (nfa[s].type == NfaState::Match) d.accepts.push_back(nfa[s].id);
+        }
+        d.states = set;
+        int id = static_cast<int>(dstates.size());
+        dstates.push_back(std::move(d));
+        transitions.resize(transitions.size() + 256, UNKNOWN);
+        dstate_ids.emplace(std::move(set), id);
+        return id;
+    }
+
+    int step(int d, uint8_t byte) {
+        int& cached = transitions[static_cast<size_t>(d) * 256 + byte];
+        if (cached != UNKNOWN) return cached;
+        std::vector<int> next;
+        if (++generation == 0) {
+            std::fill(visited.begin(), visited.end(), 0);
+            generation = 1;
+        }
+        for (int s : dstates[d].states) {
+            const NfaState& n = nfa[s];
+            if ((n.type == NfaState::Byte && n.byte == byte) || (n.type == NfaState::Class && classes[n.cls].test(byte))) {
+                closure(n.out, next);
+            }
+        }
+        int target = intern_dstate(std::move(next));
+        transitions[static_cast<size_t>(d) * 256 + byte] = target; // intern may have grown the table
+        return target;
+    }
+};
+
+#endif
@@ -0,0 +1,280 @@
+#ifndef SECSHELL_POLICY_RULES_H
+#define SECSHELL_POLICY_RULES_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "pattern_set.h"
+
+// Argument-level policy: deny rules over a command's name, its arguments,
+// the paths it names and its redirection targets. One rule per line:
+//
+//   deny <command> [arg:<pattern>] [path:<pattern>] [redirect:<pattern>] ...
+//
+//   deny tcpdump arg:-w path:/etc/*
+//   deny apt arg:remove
+//   deny * redirect:/etc/*
+//   deny curl arg:/169\.254\.169\.254/
+//
+// A rule denies a command when its command pattern matches the name and
+// each of its terms matches at least one token of that kind. Patterns are
+// globs, or regexes between slashes; quote a pattern that contains spaces.
+// Every argument that is not an option, and the value of --option=value,
+// is also checked as a path: made absolute against the working directory
+// and normalized lexically (".", ".." and repeated slashes), so ../../root
+// and /root//. both match path:/root. Symlinks are not resolved.
+//
+// All patterns of all rules compile into one PatternSet, so a check scans
+// each token once. Each rule is anchored on its rarest term and only
+// looked at when that term matched.
+class PolicyRules {
+public:
+    struct Rule {
+        int line = 0;
+        std::string text;
+        std::vector<int> terms;
+    };
+
+    // Token kinds in the PatternSet
+    static constexpr uint8_t COMMAND = 'c';
+    static constexpr uint8_t ARG = 'a';
+    static constexpr uint8_t PATH = 'p';
+    static constexpr uint8_t REDIRECT = 'r';
+
+    // Parses and compiles a rules file. Lines that do not parse are skipped
+    // and described in errors as "line N: message". Returns false if the
+    // file exists but cannot be read; a missing file means no rules.
+    bool load(const std::string& filename, std::vector<std::string>& errors) {
+        struct stat st;
+        if (stat(filename.c_str(), &st) != 0) {
+            compile();
+            return errno == ENOENT;
+        }
+        std::ifstream file(filename);
+        if (!S_ISREG(st.st_mode) || !file) return false;
+        std::stringstream text;
+        text << file.rdbuf();
+        parse(text.str(), errors);
+        return true;
+    }
+
+    void parse(const std::string& text, std::vector<std::string>& errors) {
+        std::istringstream lines(text);
+        std::string line;
+        int number = 0;
+        while (std::getline(lines, line)) {
+            ++number;
+            std::string error;
+            if (!add_rule(line, number, error)) errors.push_back("line " + std::to_string(number) + ": " + error);
+        }
+        compile();
+    }
+
+    // The first rule (in file order) that denies the command, or nullptr.
+    const Rule* check(const std::vector<std::string>& args, const std::vector<std::string>& redirects, const std::string& cwd) {
+        if (entries.empty() || args.empty()) return nullptr;
+        if (++epoch == 0) {
+            std::fill(term_epoch.begin(), term_epoch.end(), 0);
+            epoch = 1;
+        }
+        matched.clear();
+        auto on_match = [this](int term) {
+            if (term_epoch[term] == epoch) return;
+            term_epoch[term] = epoch;
+            matched.push_back(term);
+        };
+
+        patterns.scan(COMMAND, args[0], on_match);
+        bool paths = patterns.has_kind(PATH);
+        for (size_t i = 1; i < args.size(); ++i) {
+            const std::string& arg = args[i];
+            patterns.scan(ARG, arg, on_match);
+            if (!paths || arg.empty()) continue;
+            if (arg[0] != '-') {
+                patterns.scan(PATH, normalize_path(arg, cwd), on_match);
+            } else {
+                size_t equals = arg.find('=');
+                if (equals != std::string::npos && equals + 1 < arg.size()) {
+                    patterns.scan(PATH, normalize_path(arg.substr(equals + 1), cwd), on_match);
+                }
+            }
+        }
+        for (const auto& target : redirects) {
+            patterns.scan(REDIRECT, normalize_path(target, cwd), on_match);
+        }
+
+        const Rule* denied = nullptr;
+        for (int term : matched) {
+            for (int r : anchored[term]) {
+                const Rule& rule = entries[r];
+                if (denied && rule.line >= denied->line) continue;
+                if (std::all_of(rule.terms.begin(), rule.terms.end(), [this](int t) { return term_epoch[t] == epoch; })) {
+                    denied = &rule;
+                }
+            }
+        }
+        return denied;
+    }
+
+    // Makes path absolute against cwd and resolves ".", ".." and "//"
+    // without touching the file system.
+    static std::string normalize_path(const std::string& path, const std::string& cwd) {
+        std::string full = !path.empty() && path[0] == '/' ? path : cwd + "/" + path;
+        std::string result;
+        size_t pos = 0;
+        while (pos < full.size()) {
+            size_t end = full.find('/', pos);
+            if (end == std::string::npos) end = full.size();
+            size_t length = end - pos;
+            if (length == 0 || (length == 1 && full[pos] == '.')) {
+                // Empty or "." component
+            } else if (length == 2 && full[pos] == '.' && full[pos + 1] == '.') {
+                size_t slash = result.rfind('/');
+                result.erase(slash == std::string::npos ? 0 : slash);
+            } else {
+                result += '/';
+                result.append(full, pos, length);
+            }
+            pos = end + 1;
+        }
+        return result.empty() ? "/" : result;
+    }
+
+    const std::vector<Rule>& rules() const { return entries; }
+    size_t size() const { return entries.size(); }
+    size_t term_count() const { return term_rules.size(); }
+    const PatternSet& pattern_set() const { return patterns; }
+
+private:
+    std::vector<Rule> entries;
+    PatternSet patterns;
+    std::unordered_map<std::string, int> term_ids;  // kind + pattern -> term
+    std::vector<std::vector<int>> term_rules;       // Rules using each term
+    std::vector<std::vector<int>> anchored;         // Rules checked when the term matches
+    std::vector<uint32_t> term_epoch;               // Matched in the current check
+    uint32_t epoch = 0;
+    std::vector<int> matched;
+
+    // Splits a rule line on whitespace; double or single quotes group.
+    static bool split_words(const std::string& line, std::vector<std::string>& words, std::string& error) {
+        size_t pos = 0;
+        while (pos < line.size()) {
+            if (isspace(static_cast<unsigned char>(line[pos]))) {
+                ++pos;
+                continue;
+            }
+            if (line[pos] == '#') break;
+            std::string word;
+            while (pos < line.size() && !isspace(static_cast<unsigned char>(line[pos]))) {
+                char c = line[pos++];
+                if (c == '"' || c == '\'') {
+                    size_t close = line.find(c, pos);
+                    if (close == std::string::npos) {
+                        error = "unterminated quote";
+                        return false;
+                    }
+                    word.append(line, pos, close - pos);
+                    pos = close + 1;
+                } else {
+                    word += c;
+                }
+            }
+            words.push_back(std::move(word));
+        }
+        return true;
+    }
+
+    bool add_rule(const std::string& line, int number, std::string& error) {
+        std::vector<std::string> words;
+        if (!split_words(line, words, error)) return false;
+        if (words.empty()) return true;
+        if (words[0] != "deny") {
+            error = "expected 'deny', found '" + words[0] + "'";
+            return false;
+        }
+        if (words.size() < 2) {
+            error = "missing command pattern";
+            return false;
+        }
+
+        Rule rule;
+        rule.line = number;
+        size_t first = line.find_first_not_of(" \t");
+        size_t comment = line.find(" #");
+        rule.text = line.substr(first, comment == std::string::npos ? std::string::npos : comment - first);
+        rule.text.erase(rule.text.find_last_not_of(" \t\r") + 1);
+
+        std::vector<std::pair<uint8_t, std::string>> terms = {{COMMAND, words[1]}};
+        for (size_t i = 2; i < words.size(); ++i) {
+            size_t colon = words[i].find(':');
+            std::string field = words[i].substr(0, colon);
+            uint8_t kind = field == "arg" ? ARG : field == "path" ? PATH : field == "redirect" ? REDIRECT : 0;
+            if (colon == std::string::npos || kind == 0) {
+                error = "expected arg:, path: or redirect:, found '" + words[i] + "'";
+                return false;
+            }
+            terms.push_back({kind, words[i].substr(colon + 1)});
+        }
+        // Validate every pattern before adding any, so a bad line leaves nothing behind
+        for (const auto& term : terms) {
+            if (!valid_pattern(term.second, error)) return false;
+        }
+        for (const auto& term : terms) {
+            int id = intern_term(term.first, term.second, error);
+            if (id == -1) return false;
+            if (std::find(rule.terms.begin(), rule.terms.end(), id) == rule.terms.end()) rule.terms.push_back(id);
+        }
+        for (int term : rule.terms) term_rules[term].push_back(static_cast<int>(entries.size()));
+        entries.push_back(std::move(rule));
+        return true;
+    }
+
+    static bool is_regex(const std::string& pattern) {
+        return pattern.size() >= 2 && pattern.front() == '/' && pattern.back() == '/';
+    }
+
+    static bool valid_pattern(const std::string& pattern, std::string& error) {
+        PatternSet scratch;
+        return is_regex(pattern) ? scratch.add_regex(ARG, pattern.substr(1, pattern.size() - 2), 0, error)
+                                 : scratch.add_glob(ARG, pattern, 0, error);
+    }
+
+    int intern_term(uint8_t kind, const std::string& pattern, std::string& error) {
+        std::string key = std::string(1, static_cast<char>(kind)) + pattern;
+        auto it = term_ids.find(key);
+        if (it != term_ids.end()) return it->second;
+        int id = static_cast<int>(term_rules.size());
+        bool ok = is_regex(pattern) ? patterns.add_regex(kind, pattern.substr(1, pattern.size() - 2), id, error)
+                                    : patterns.add_glob(kind, pattern, id, error);
+        if (!ok) return -1;
+        term_ids.emplace(std::move(key), id);
+        term_rules.emplace_back();
+        return id;
+    }
+
+    // Anchors each rule on the term shared by the fewest rules
+    void compile() {
+        patterns.compile();
+        anchored.assign(term_rules.size(), {});
+        for (size_t r = 0; r < entries.size(); ++r) {
+            const Rule& rule = entries[r];
+            int anchor = *std::min_element(rule.terms.begin(), rule.terms.end(), [this](int a, int b) {
+                return term_rules[a].size() < term_rules[b].size();
+            });
+            anchored[anchor].push_back(static_cast<int>(r));
+        }
+        term_epoch.assign(term_rules.size(), 0);
+        epoch = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,364 @@
+#ifndef SECSHELL_PROMPT_RENDERER_H
+#define SECSHELL_PROMPT_RENDERER_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "helper_thread.h"
+#include "metrics.h"
+
+// The interactive prompt, built from the segments named in SECSHELL_PROMPT
+// (separated by spaces or commas, in display order):
+//
+//   user host cwd  cheap; rendered once and cached until set_context(),
+//                  which the shell calls on cd, export and unset
+//   status jobs    the last exit status and the background job count,
+//                  shown only when non-zero
+//   git load       slow; computed on a worker thread
+//
+// render() hands the slow segments to the worker and waits for them up to
+// deadline_ms. When they are late the prompt is drawn with the previous
+// values (or without them, after a cd), fd() becomes readable once they
+// arrive, and take_update() returns the finished prompt for the event
+// loop to patch into readline's line. Without start() the slow segments
+// are computed inline.
+//
+// The git segment reads .git/HEAD and never runs git: git executes
+// commands from a repository's own config (core.fsmonitor, for one), and
+// a prompt must not do that in every directory the user enters.
+//
+// Escape sequences are bracketed by \001 and \002 so readline counts only
+// the visible width when it places the cursor.
+class PromptRenderer {
+public:
+    enum Segment { User, Host, Cwd, Git, Jobs, Status, Load, SEGMENTS };
+
+    // Per-render inputs that change with every command
+    struct State {
+        int last_status = 0;
+        size_t jobs = 0;
+    };
+
+    static constexpr const char* DEFAULT_SEGMENTS = "user cwd git jobs status";
+
+    int deadline_ms = 20;                 // SECSHELL_PROMPT_DEADLINE_MS
+    Histogram* async_us = nullptr;        // Time to compute the slow segments, if set
+
+    PromptRenderer() {
+        std::string error;
+        configure(DEFAULT_SEGMENTS, error);
+    }
+
+    ~PromptRenderer() {
+        stop();
+    }
+
+    PromptRenderer(const PromptRenderer&) = delete;
+    PromptRenderer& operator=(const PromptRenderer&) = delete;
+
+    // Returns false, keeping the segments in use, if a name is unknown.
+    bool configure(const std::string& spec, std::string& error) {
+        static const char* NAMES[SEGMENTS] = {"user", "host", "cwd", "git", "jobs", "status", "load"};
+        std::vector<Segment> parsed;
+        size_t pos = 0;
+        while (pos < spec.size()) {
+            size_t end = std::min(spec.find_first_of(", ", pos), spec.size());
+            std::string name = spec.substr(pos, end - pos);
+            pos = end + 1;
+            if (name.empty()) continue;
+            int found = SEGMENTS;
+            for (int i = 0; i < SEGMENTS; ++i) {
+                if (name == NAMES[i]) found = i;
+            }
+            if (found == SEGMENTS) {
+                error = "unknown prompt segment '" + name + "'";
+                return false;
+            }
+            parsed.push_back(Segment(found));
+        }
+        if (parsed.empty()) {
+            error = "no prompt segments";
+            return false;
+        }
+        segments = std::move(parsed);
+        slow = false;
+        for (Segment segment : segments) slow = slow || segment == Git || segment == Load;
+        cache_context();
+        return true;
+    }
+
+    // Refreshes the cached segments. A new directory drops the git value
+    // shown until the worker has looked at it.
+    void set_context(const std::string& user_name, const std::string& host_name, const std::string& directory) {
+        if (directory != cwd) shown.git.clear();
+        user = user_name;
+        host = host_name;
+        cwd = directory;
+        cache_context();
+    }
+
+    // Starts the worker and returns the descriptor the event loop watches.
+    int start() {
+        if (worker.joinable()) return event_fd;
+        event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (event_fd == -1) return -1;
+        stopping = false;
+        worker = start_helper_thread([this] { work_loop(); });
+        return event_fd;
+    }
+
+    void stop() {
+        if (worker.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_one();
+            worker.join();
+        }
+        if (event_fd != -1) close(event_fd);
+        event_fd = -1;
+    }
+
+    int fd() const { return event_fd; }
+
+    std::string render(const State& state) {
+        last_state = state;
+        if (!slow) return compose(state);
+        if (!worker.joinable()) {
+            shown = compute(cwd);
+            return compose(state);
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        uint64_t id = ++requested;
+        request_cwd = cwd;
+        waiting = true;
+        wake.notify_one();
+        done.wait_for(lock, std::chrono::milliseconds(deadline_ms), [&] { return completed >= id; });
+        waiting = false;
+        if (completed >= id) shown = result;
+        lock.unlock();
+        return compose(state);
+    }
+
+    // After fd() became readable: the prompt with the late slow segments,
+    // or false if they did not change what the last render showed.
+    bool take_update(std::string& prompt) {
+        uint64_t count;
+        (void)!read(event_fd, &count, sizeof(count));
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (completed != requested || (result.git == shown.git && result.load == shown.load)) return false;
+            shown = result;
+        }
+        prompt = compose(last_state);
+        return true;
+    }
+
+    // Columns the text takes on screen: escapes between \001 and \002 are
+    // skipped and UTF-8 continuation bytes are not counted.
+    static size_t display_width(std::string_view text) {
+        size_t width = 0;
+        bool hidden = false;
+        for (char c : text) {
+            if (c == '\001' || c == '\002') {
+                hidden = c == '\001';
+            } else if (!hidden && (static_cast<unsigned char>(c) & 0xC0) != 0x80) {
+                ++width;
+            }
+        }
+        return width;
+    }
+
+    // Screen rows between the first line of prompt and the cursor, which
+    // sits after before_point on the prompt's last line.
+    static int rows_above_cursor(const std::string& prompt, std::string_view before_point, int columns) {
+        if (columns <= 0) columns = 80;
+        int rows = 0;
+        size_t start = 0, newline;
+        while ((newline = prompt.find('\n', start)) != std::string::npos) {
+            size_t width = display_width(std::string_view(prompt).substr(start, newline - start));
+            rows += width == 0 ? 1 : static_cast<int>((width - 1) / columns + 1);
+            start = newline + 1;
+        }
+        size_t last = display_width(std::string_view(prompt).substr(start)) + display_width(before_point);
+        return rows + static_cast<int>(last / columns);
+    }
+
+    // The branch checked out in the repository containing directory, as
+    // "branch", a short commit id when detached, with "|merge" or
+    // "|rebase" during one; empty outside a repository.
+    static std::string git_branch(const std::string& directory) {
+        std::string git_dir = find_git_dir(directory);
+        if (git_dir.empty()) return "";
+        std::string head = read_line(git_dir + "/HEAD");
+        std::string branch;
+        if (head.compare(0, 5, "ref: ") == 0) {
+            branch = head.substr(5);
+            if (branch.compare(0, 11, "refs/heads/") == 0) branch.erase(0, 11);
+        } else {
+            branch = head.substr(0, 7);
+        }
+        if (branch.empty()) return "";
+        if (exists(git_dir + "/rebase-merge") || exists(git_dir + "/rebase-apply")) {
+            branch += "|rebase";
+        } else if (exists(git_dir + "/MERGE_HEAD")) {
+            branch += "|merge";
+        }
+        return branch;
+    }
+
+    // The one-minute load average from /proc/loadavg
+    static std::string load_average() {
+        std::string line = read_line("/proc/loadavg");
+        return line.substr(0, line.find(' '));
+    }
+
+private:
+    struct SlowValues {
+        std::string git;
+        std::string load;
+    };
+
+    std::vector<Segment> segments;
+    bool slow = false;                    // Any of git and load in segments
+    std::string user = "unknown", host, cwd;
+    std::vector<std::string> cached;      // Per segment; empty for the uncached ones
+    State last_state;
+    SlowValues shown;                     // Used by the last render
+
+    // Shared with the worker
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    uint64_t requested = 0, completed = 0;
+    std::string request_cwd;
+    SlowValues result;
+    bool waiting = false;                 // render() is still waiting for the result
+    bool stopping = false;
+    std::thread worker;
+    int event_fd = -1;
+
+    static void add(std::string& out, const char* color, const std::string& text) {
+        out += " \001\033[";
+        out += color;
+        out += "m\002" + text + "\001\033[0m\002";
+    }
+
+    void cache_context() {
+        cached.assign(segments.size(), "");
+        for (size_t i = 0; i < segments.size(); ++i) {
+            if (segments[i] == User) add(cached[i], "1;34", "(" + user + ")");
+            if (segments[i] == Host) add(cached[i], "34", host);
+            if (segments[i] == Cwd) add(cached[i], "1;37", "[" + cwd + "]");
+        }
+    }
+
+    std::string compose(const State& state) const {
+        std::string out = "\001\033[32m\002┌─[SecShell]\001\033[0m\002";
+        for (size_t i = 0; i < segments.size(); ++i) {
+            switch (segments[i]) {
+                case Git:
+                    if (!shown.git.empty()) add(out, "35", "git:" + shown.git);
+                    break;
+                case Load:
+                    if (!shown.load.empty()) add(out, "36", "load:" + shown.load);
+                    break;
+                case Jobs:
+                    if (state.jobs) add(out, "33", "jobs:" + std::to_string(state.jobs));
+                    break;
+                case Status:
+                    if (state.last_status) add(out, "31", "exit:" + std::to_string(state.last_status));
+                    break;
+                default:
+                    out += cached[i];
+                    break;
+            }
+        }
+        out += "\n\001\033[32m\002└─\001\033[0m\002$ ";
+        return out;
+    }
+
+    SlowValues compute(const std::string& directory) const {
+        SlowValues values;
+        for (Segment segment : segments) {
+            if (segment == Git) values.git = git_branch(directory);
+            if (segment == Load) values.load = load_average();
+        }
+        return values;
+    }
+
+    // Serves the latest request; older ones that were overtaken are skipped.
+    void work_loop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this] { return stopping || requested > completed; });
+            if (stopping) return;
+            uint64_t id = requested;
+            std::string directory = request_cwd;
+            lock.unlock();
+            auto start = std::chrono::steady_clock::now();
+            SlowValues values = compute(directory);
+            if (async_us) {
+                async_us->record(std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - start).count());
+            }
+            lock.lock();
+            result = std::move(values);
+            completed = id;
+            if (waiting) {
+                done.notify_one();
+            } else if (completed == requested) {
+                uint64_t one = 1;
+                (void)!write(event_fd, &one, sizeof(one));
+            }
+        }
+    }
+
+    // The .git directory of the repository containing directory: a .git
+    // directory in it or a parent, or the one a .git file points to.
+    static std::string find_git_dir(const std::string& directory) {
+        std::string dir = directory;
+        while (!dir.empty()) {
+            std::string candidate = (dir == "/" ? "" : dir) + "/.git";
+            struct stat st;
+            if (stat(candidate.c_str(), &st) == 0) {
+                if (S_ISDIR(st.st_mode)) return candidate;
+                std::string link = read_line(candidate); // Worktrees and submodules: "gitdir: <path>"
+                if (link.compare(0, 8, "gitdir: ") != 0) return "";
+                std::string target = link.substr(8);
+                return !target.empty() && target[0] == '/' ? target : dir + "/" + target;
+            }
+            if (dir == "/") break;
+            size_t slash = dir.rfind('/');
+            dir = slash == 0 ? "/" : dir.substr(0, slash);
+        }
+        return "";
+    }
+
+    static std::string read_line(const std::string& path) {
+        std::ifstream file(path);
+        std::string line;
+        std::getline(file, line);
+        return line;
+    }
+
+    static bool exists(const std::string& path) {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0;
+    }
+};
+
+#endif
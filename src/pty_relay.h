@@ -0,0 +1,248 @@
+#ifndef SECSHELL_PTY_RELAY_H
+#define SECSHELL_PTY_RELAY_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/signalfd.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "box_renderer.h"
+#include "session_recording.h"
+
+// Recording mode: the session runs on a new pseudo-terminal and this
+// process relays between it and the real terminal, recording both
+// directions. fork_session() returns in the child, which carries on as the
+// shell with the pty slave as its controlling terminal, so readline, job
+// control and every command it runs behave as on the real terminal. The
+// parent puts the real terminal in raw mode and relays until the session
+// exits, in one thread: output is read from the pty master straight into
+// the recorder's chunk and written out from there, keystrokes are
+// recorded and forwarded, window size changes are passed on, and the
+// shell reports each command line on a pipe so the recording can index it.
+//
+// Keystrokes typed while the pty neither echoes nor is in raw mode (the
+// usual state at a password prompt) are recorded as a count, not bytes.
+//
+// A pty master hands out at most 4095 bytes per read, so the relay reads
+// with plain read(2): splicing through a pipe costs two extra syscalls per
+// block and measured slower (bench/record_bench.cpp).
+class PtyRelay {
+public:
+    struct Options {
+        int input_fd = STDIN_FILENO;
+        int output_fd = STDOUT_FILENO;
+    };
+
+    // Forks the session onto a new pty. In the child: returns true with
+    // stdin, stdout and stderr on the slave and command_fd() open for
+    // writing. In the parent: relays until the session exits, closes the
+    // recording and returns false with the session's exit status in
+    // status. Returns false with status -1 if the pty cannot be set up.
+    bool fork_session(SessionRecorder& recorder, const Options& relay_options, int& status) {
+        options = relay_options;
+        status = -1;
+        int master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+        if (master == -1 || grantpt(master) != 0 || unlockpt(master) != 0) {
+            if (master != -1) close(master);
+            return false;
+        }
+        char name[64];
+        if (ptsname_r(master, name, sizeof(name)) != 0) {
+            close(master);
+            return false;
+        }
+        int slave = open(name, O_RDWR | O_NOCTTY | O_CLOEXEC);
+        int marks[2];
+        if (slave == -1 || pipe2(marks, O_CLOEXEC) == -1) {
+            close(master);
+            if (slave != -1) close(slave);
+            return false;
+        }
+        // The session starts with the real terminal's settings and size
+        struct termios settings;
+        have_termios = tcgetattr(options.input_fd, &saved) == 0;
+        if (have_termios) tcsetattr(slave, TCSANOW, &saved);
+        struct winsize size = {};
+        if (ioctl(options.output_fd, TIOCGWINSZ, &size) == 0 || ioctl(options.input_fd, TIOCGWINSZ, &size) == 0) {
+            ioctl(slave, TIOCSWINSZ, &size);
+        }
+
+        // Blocked before the fork so an early SIGCHLD is not lost
+        sigset_t mask, previous;
+        sigemptyset(&mask);
+        for (int sig : {SIGCHLD, SIGWINCH, SIGHUP, SIGTERM, SIGINT, SIGQUIT}) sigaddset(&mask, sig);
+        sigprocmask(SIG_BLOCK, &mask, &previous);
+        child = fork();
+        if (child == -1) {
+            sigprocmask(SIG_SETMASK, &previous, nullptr);
+            for (int fd : {master, slave, marks[0], marks[1]}) close(fd);
+            return false;
+        }
+        if (child == 0) {
+            sigprocmask(SIG_SETMASK, &previous, nullptr);
+            recorder.detach();
+            close(master);
+            close(marks[0]);
+            setsid();
+            ioctl(slave, TIOCSCTTY, 0);
+            for (int fd = 0; fd <= 2; ++fd) dup2(slave, fd);
+            if (slave > 2) close(slave);
+            command_pipe = marks[1];
+            return true;
+        }
+
+        close(slave);
+        close(marks[1]);
+        int signals = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+        fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+        if (have_termios) {
+            settings = saved;
+            cfmakeraw(&settings);
+            tcsetattr(options.input_fd, TCSANOW, &settings);
+        }
+        status = relay(recorder, master, marks[0], signals);
+        if (have_termios) tcsetattr(options.input_fd, TCSANOW, &saved);
+        for (int fd : {master, marks[0], signals}) close(fd);
+        sigprocmask(SIG_SETMASK, &previous, nullptr);
+        recorder.close(status);
+        return false;
+    }
+
+    // The child's end of the command pipe; see report_command()
+    int command_fd() const { return command_pipe; }
+
+    // Called by the shell before it runs a command line. One write below
+    // PIPE_BUF, so it is atomic; longer lines are cut.
+    static void report_command(int fd, const std::string& line) {
+        uint32_t length = static_cast<uint32_t>(std::min<size_t>(line.size(), MAX_COMMAND));
+        std::string message(reinterpret_cast<const char*>(&length), sizeof(length));
+        message.append(line, 0, length);
+        (void)!write(fd, message.data(), message.size());
+    }
+
+    uint64_t output_bytes() const { return bytes_out; }
+    uint64_t input_bytes() const { return bytes_in; }
+
+private:
+    static const size_t MAX_COMMAND = 4000;
+    static const int TICK_MS = 1000;
+    static const int DRAIN_MS = 50;
+
+    Options options;
+    pid_t child = -1;
+    int command_pipe = -1;
+    bool have_termios = false;
+    struct termios saved;
+    uint64_t bytes_out = 0;
+    uint64_t bytes_in = 0;
+
+    // Returns the session's wait status once it has exited
+    int relay(SessionRecorder& recorder, int master, int marks, int signals) {
+        struct pollfd fds[4] = {{master, POLLIN, 0}, {options.input_fd, POLLIN, 0}, {marks, POLLIN, 0}, {signals, POLLIN, 0}};
+        int status = 0;
+        bool exited = false;
+        std::string pending;     // Command pipe bytes not yet a whole message
+        char buffer[4096];
+        while (!exited) {
+            int ready = poll(fds, 4, TICK_MS);
+            if (ready == -1 && errno != EINTR) break;
+            recorder.tick();
+
+            // Output first, so a command reported meanwhile starts after the output before it
+            if (fds[0].revents && !drain(recorder, master)) fds[0].fd = -1;
+            if (fds[1].revents) {
+                ssize_t n = read(options.input_fd, buffer, sizeof(buffer));
+                if (n > 0) {
+                    struct termios mode;
+                    bool hidden = tcgetattr(master, &mode) == 0 && !(mode.c_lflag & ECHO) && (mode.c_lflag & ICANON);
+                    if (hidden) {
+                        recorder.hidden_input(static_cast<uint32_t>(n));
+                    } else {
+                        recorder.frame(SessionRecording::Input, buffer, n);
+                    }
+                    write_all(master, buffer, n);
+                    bytes_in += n;
+                } else if (n == 0 || errno != EINTR) {
+                    fds[1].fd = -1; // End of input: the session keeps running until it exits
+                }
+            }
+            if (fds[2].revents) {
+                ssize_t n = read(marks, buffer, sizeof(buffer));
+                if (n > 0) {
+                    pending.append(buffer, n);
+                    uint32_t length;
+                    while (pending.size() >= sizeof(length) &&
+                           (memcpy(&length, pending.data(), sizeof(length)), pending.size() >= sizeof(length) + length)) {
+                        recorder.command(pending.substr(sizeof(length), length));
+                        pending.erase(0, sizeof(length) + length);
+                    }
+                } else if (n == 0 || errno != EINTR) {
+                    fds[2].fd = -1;
+                }
+            }
+            if (fds[3].revents) {
+                struct signalfd_siginfo info;
+                while (read(signals, &info, sizeof(info)) == sizeof(info)) {
+                    if (info.ssi_signo == SIGCHLD) {
+                        if (waitpid(child, &status, WNOHANG) == child) exited = true;
+                    } else if (info.ssi_signo == SIGWINCH) {
+                        struct winsize size;
+                        if (ioctl(options.output_fd, TIOCGWINSZ, &size) == 0 || ioctl(options.input_fd, TIOCGWINSZ, &size) == 0) {
+                            ioctl(master, TIOCSWINSZ, &size);
+                            recorder.resize(size.ws_col, size.ws_row);
+                        }
+                    } else {
+                        kill(child, info.ssi_signo);
+                    }
+                }
+            }
+        }
+        if (!exited) waitpid(child, &status, 0);
+        // The session's last output may still be on its way through the pty
+        struct pollfd last = {master, POLLIN, 0};
+        while (fds[0].fd != -1 && poll(&last, 1, DRAIN_MS) == 1 && drain(recorder, master)) {}
+        return status;
+    }
+
+    // Relays what the master has; false once it reports EIO (every slave
+    // descriptor closed) or another error
+    bool drain(SessionRecorder& recorder, int master) {
+        const char* data;
+        ssize_t n;
+        while ((n = recorder.read_frame(SessionRecording::Output, master, data)) > 0) {
+            write_all(options.output_fd, data, n);
+            bytes_out += n;
+        }
+        return n == -1 && (errno == EAGAIN || errno == EINTR);
+    }
+
+    // Also for non-blocking descriptors such as the pty master, whose input
+    // queue can be full
+    static void write_all(int fd, const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t n = write(fd, data, size);
+            if (n > 0) {
+                data += n;
+                size -= n;
+            } else if (n == -1 && errno == EAGAIN) {
+                struct pollfd out = {fd, POLLOUT, 0};
+                poll(&out, 1, 100);
+            } else if (n == -1 && errno != EINTR) {
+                return;
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef SECSHELL_RESOURCE_USAGE_H
+#define SECSHELL_RESOURCE_USAGE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include <sys/resource.h>
+
+// Resource usage of a process or a group of them, as reported by wait4 or
+// getrusage. Wall time is measured by the caller.
+struct ResourceUsage {
+    uint64_t wall_us = 0;
+    uint64_t user_us = 0;
+    uint64_t sys_us = 0;
+    long max_rss_kb = 0;
+    long voluntary_switches = 0;
+    long involuntary_switches = 0;
+
+    static uint64_t to_us(const struct timeval& tv) {
+        return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+    }
+
+    void add(const struct rusage& usage) {
+        user_us += to_us(usage.ru_utime);
+        sys_us += to_us(usage.ru_stime);
+        max_rss_kb = std::max(max_rss_kb, usage.ru_maxrss);
+        voluntary_switches += usage.ru_nvcsw;
+        involuntary_switches += usage.ru_nivcsw;
+    }
+
+    // The difference between two getrusage snapshots, for in-process builtins.
+    void add_delta(const struct rusage& before, const struct rusage& after) {
+        user_us += to_us(after.ru_utime) - to_us(before.ru_utime);
+        sys_us += to_us(after.ru_stime) - to_us(before.ru_stime);
+        voluntary_switches += after.ru_nvcsw - before.ru_nvcsw;
+        involuntary_switches += after.ru_nivcsw - before.ru_nivcsw;
+    }
+
+    void add(const ResourceUsage& other) {
+        user_us += other.user_us;
+        sys_us += other.sys_us;
+        max_rss_kb = std::max(max_rss_kb, other.max_rss_kb);
+        voluntary_switches += other.voluntary_switches;
+        involuntary_switches += other.involuntary_switches;
+    }
+
+    static std::string seconds(uint64_t us) {
+        char text[32];
+        snprintf(text, sizeof(text), "%llu.%03llus", static_cast<unsigned long long>(us / 1000000),
+                 static_cast<unsigned long long>(us % 1000000 / 1000));
+        return text;
+    }
+
+    // "real 1.204s, user 0.310s, sys 0.052s, max RSS 10240 KB, 12/3 ctx switches"
+    std::string summary() const {
+        return "real " + seconds(wall_us) + ", user " + seconds(user_us) + ", sys " + seconds(sys_us) +
+               ", max RSS " + std::to_string(max_rss_kb) + " KB, " + std::to_string(voluntary_switches) + "/" +
+               std::to_string(involuntary_switches) + " ctx switches";
+    }
+};
+
+#endif
@@ -0,0 +1,576 @@
+#ifndef SECSHELL_SANDBOX_H
+#define SECSHELL_SANDBOX_H
+
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/mount.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef CLONE_INTO_CGROUP
+#define CLONE_INTO_CGROUP 0x200000000ULL
+#endif
+
+// Per-command isolation (SECSHELL_SANDBOX=1). The expensive parts are
+// prepared once per session and reused by every command:
+//
+//   a mount namespace in which the whole tree is read-only except the
+//   writable paths (by default $HOME, /tmp, /var/tmp and /dev/shm), made
+//   by a short-lived helper and kept alive by an open descriptor. As a
+//   user other than root it lives in a user namespace that maps only the
+//   user's own ids, so files of other users show up as nobody.
+//
+//   a seccomp filter, compiled to BPF once, that refuses mounting,
+//   namespaces, module loading, ptrace, bpf, keyrings, io_uring, clock
+//   changes and TIOCSTI (typing into the shell's terminal) with EPERM.
+//   clone3 fails with ENOSYS so programs fall back to clone, whose flags
+//   the filter can check.
+//
+//   a cgroup v2 of its own, secshell-<pid> under the shell's cgroup (or
+//   Options::cgroup_parent), with the CPU, memory and process limits that
+//   were asked for. Without them the cgroup is optional: commands stay in
+//   the shell's cgroup if it cannot be created.
+//
+// A command then costs one clone3(CLONE_VM | CLONE_VFORK |
+// CLONE_INTO_CGROUP), which starts it directly in the cgroup without
+// copying the shell's page tables, and in the child two setns calls, a
+// chdir, the prebuilt filter and execve. Where clone3 or CLONE_INTO_CGROUP
+// is missing (kernels before 5.7, or not x86-64) the child is started with
+// clone() and writes itself into cgroup.procs.
+//
+// Redirections are opened by the shell before the command starts, so they
+// are governed by the argument rules (redirect:), not by the read-only
+// view. Commands run with no_new_privs, so set-user-ID programs such as
+// sudo do not gain privileges. The view does not contain root: a command
+// run as root can still write to devices.
+class Sandbox {
+public:
+    struct Options {
+        std::vector<std::string> writable;   // Left writable in the read-only view; missing paths are skipped
+        std::string cgroup_parent;           // Empty: the shell's own cgroup
+        std::string cpu_max;                 // For cpu.max, e.g. "50000 100000"; empty: no limit
+        std::string memory_max;              // For memory.max, in bytes
+        std::string pids_max;                // For pids.max
+    };
+
+    // target_fd in the command becomes a copy of fd
+    using Redirect = std::pair<int, int>;
+
+    Sandbox() = default;
+
+    ~Sandbox() {
+        release();
+    }
+
+    Sandbox(const Sandbox&) = delete;
+    Sandbox& operator=(const Sandbox&) = delete;
+
+    // Builds the template. On failure nothing is left behind and error
+    // says which part failed; commands must then not be run unconfined.
+    bool prepare(const Options& wanted, std::string& error) {
+        release();
+        options = wanted;
+        filter = compile_filter();
+        if (filter.empty()) {
+            error = "no seccomp filter for this architecture";
+            return false;
+        }
+        if (!make_namespace(error) || !make_cgroup(error)) {
+            release();
+            return false;
+        }
+        return true;
+    }
+
+    bool ready() const { return mount_ns != -1; }
+
+    // What prepare() did without, e.g. no cgroup of its own
+    const std::vector<std::string>& notes() const { return warnings; }
+
+    const Options& settings() const { return options; }
+    const std::string& cgroup() const { return cgroup_path; }
+    size_t filter_length() const { return filter.size(); }
+    bool clone_into_cgroup() const { return cgroup_fd != -1 && into_cgroup.load(); }
+
+    // Starts path in the sandbox. Returns 0 and sets pid, or the errno of
+    // the step that failed (the command is then not running). Safe to call
+    // from several threads at once.
+    int spawn(const std::string& path, const std::vector<std::string>& args, const std::vector<Redirect>& redirects,
+              pid_t& pid, char* const* envp) const {
+        if (!ready()) return EPERM;
+        char cwd[PATH_MAX];
+        if (!getcwd(cwd, sizeof(cwd))) return errno;
+        std::vector<char*> argv;
+        for (const auto& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+        argv.push_back(nullptr);
+        struct sock_fprog program = {static_cast<unsigned short>(filter.size()), const_cast<struct sock_filter*>(filter.data())};
+
+        Child child;
+        child.path = path.c_str();
+        child.argv = argv.data();
+        child.envp = envp;
+        child.redirects = redirects.data();
+        child.redirect_count = redirects.size();
+        child.cwd = cwd;
+        child.user_ns = user_ns;
+        child.mount_ns = mount_ns;
+        child.filter = &program;
+
+        // The child shares this stack frame's memory until it execs, like
+        // posix_spawn's. Nothing may run a signal handler in it meanwhile.
+        alignas(16) char stack[STACK_BYTES];
+        sigset_t all, previous;
+        sigfillset(&all);
+        pthread_sigmask(SIG_BLOCK, &all, &previous);
+        pid_t started = launch(child, stack);
+        pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+        if (started < 0) return -started;
+        if (child.error != 0) {
+            waitpid(started, nullptr, 0);
+            return child.error;
+        }
+        pid = started;
+        return 0;
+    }
+
+    // The seccomp program every command runs under
+    static std::vector<struct sock_filter> compile_filter() {
+#if defined(__x86_64__)
+        const uint32_t arch = AUDIT_ARCH_X86_64;
+#elif defined(__aarch64__)
+        const uint32_t arch = AUDIT_ARCH_AARCH64;
+#else
+        return {};
+#endif
+        static const long DENIED[] = {
+            SYS_mount, SYS_umount2, SYS_pivot_root, SYS_chroot, SYS_fsopen, SYS_fsconfig, SYS_fsmount, SYS_fspick,
+            SYS_move_mount, SYS_open_tree, SYS_mount_setattr, SYS_unshare, SYS_setns, SYS_init_module, SYS_finit_module,
+            SYS_delete_module, SYS_kexec_load, SYS_kexec_file_load, SYS_reboot, SYS_swapon, SYS_swapoff, SYS_acct,
+            SYS_ptrace, SYS_process_vm_readv, SYS_process_vm_writev, SYS_pidfd_getfd, SYS_bpf, SYS_perf_event_open,
+            SYS_userfaultfd, SYS_keyctl, SYS_add_key, SYS_request_key, SYS_open_by_handle_at, SYS_name_to_handle_at,
+            SYS_io_uring_setup, SYS_io_uring_enter, SYS_io_uring_register, SYS_settimeofday, SYS_clock_settime,
+            SYS_clock_adjtime, SYS_adjtimex, SYS_sethostname, SYS_setdomainname, SYS_quotactl, SYS_syslog, SYS_vhangup,
+#if defined(__x86_64__)
+            SYS_iopl, SYS_ioperm, SYS_uselib,
+#endif
+        };
+        const uint32_t NAMESPACES = CLONE_NEWNS | CLONE_NEWUTS | CLONE_NEWIPC | CLONE_NEWUSER | CLONE_NEWPID |
+                                    CLONE_NEWNET | CLONE_NEWCGROUP;
+        const uint32_t ALLOW = SECCOMP_RET_ALLOW;
+        const uint32_t REFUSE = SECCOMP_RET_ERRNO | (EPERM & SECCOMP_RET_DATA);
+        const uint32_t MISSING = SECCOMP_RET_ERRNO | (ENOSYS & SECCOMP_RET_DATA);
+        auto load = [](uint32_t offset) { return sock_filter BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offset); };
+        auto ret = [](uint32_t action) { return sock_filter BPF_STMT(BPF_RET | BPF_K, action); };
+        auto jump = [](uint16_t op, uint32_t k, uint8_t jt, uint8_t jf) { return sock_filter BPF_JUMP(BPF_JMP | op | BPF_K, k, jt, jf); };
+
+        // Each test is followed by its own return, so no jump reaches far
+        std::vector<struct sock_filter> code = {
+            load(offsetof(struct seccomp_data, arch)),
+            jump(BPF_JEQ, arch, 1, 0),
+            ret(SECCOMP_RET_KILL_PROCESS),
+            load(offsetof(struct seccomp_data, nr)),
+#if defined(__x86_64__)
+            jump(BPF_JSET, 0x40000000, 0, 1), // x32 system calls
+            ret(REFUSE),
+#endif
+            jump(BPF_JEQ, SYS_clone, 0, 4),
+            load(offsetof(struct seccomp_data, args[0])),   // Flags; the low half on little-endian machines
+            jump(BPF_JSET, NAMESPACES, 0, 1),
+            ret(REFUSE),
+            ret(ALLOW),
+            jump(BPF_JEQ, SYS_ioctl, 0, 5),
+            load(offsetof(struct seccomp_data, args[1])),
+            jump(BPF_JEQ, TIOCSTI, 2, 0),
+            jump(BPF_JEQ, TIOCLINUX, 1, 0),
+            ret(ALLOW),
+            ret(REFUSE),
+            jump(BPF_JEQ, SYS_clone3, 0, 1),
+            ret(MISSING),
+        };
+        for (long nr : DENIED) {
+            code.push_back(jump(BPF_JEQ, static_cast<uint32_t>(nr), 0, 1));
+            code.push_back(ret(REFUSE));
+        }
+        code.push_back(ret(ALLOW));
+        return code;
+    }
+
+    // Sets no_new_privs and installs filter on the calling thread
+    static bool install_filter(const std::vector<struct sock_filter>& filter) {
+        struct sock_fprog program = {static_cast<unsigned short>(filter.size()), const_cast<struct sock_filter*>(filter.data())};
+        return prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) == 0 && prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &program) == 0;
+    }
+
+    // In a fresh mount namespace: makes every mount read-only and private,
+    // then binds each writable path back writable. Does not allocate, so it
+    // can run in a child forked from a threaded process. On failure step
+    // names what failed and errno says why.
+    static bool make_read_only_view(const std::vector<std::string>& writable, const char*& step) {
+        struct mount_attr read_only = {};
+        read_only.attr_set = MOUNT_ATTR_RDONLY;
+        struct mount_attr read_write = {};
+        read_write.attr_clr = MOUNT_ATTR_RDONLY;
+        step = "making mounts private";
+        if (mount(nullptr, "/", nullptr, MS_REC | MS_PRIVATE, nullptr) != 0) return false;
+        step = "making / read-only";
+        if (mount_setattr(AT_FDCWD, "/", AT_RECURSIVE, &read_only, sizeof(read_only)) != 0) return false;
+        for (const auto& path : writable) {
+            struct stat st;
+            if (stat(path.c_str(), &st) != 0) continue;
+            step = path.c_str();
+            if (mount(path.c_str(), path.c_str(), nullptr, MS_BIND | MS_REC, nullptr) != 0 ||
+                mount_setattr(AT_FDCWD, path.c_str(), AT_RECURSIVE, &read_write, sizeof(read_write)) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // After unshare(CLONE_NEWUSER): maps uid and gid to themselves. Does
+    // not allocate.
+    static bool map_own_ids(uid_t uid, gid_t gid) {
+        char map[64];
+        snprintf(map, sizeof(map), "%u %u 1\n", static_cast<unsigned>(uid), static_cast<unsigned>(uid));
+        if (!write_file("/proc/self/uid_map", map) || !write_file("/proc/self/setgroups", "deny")) return false;
+        snprintf(map, sizeof(map), "%u %u 1\n", static_cast<unsigned>(gid), static_cast<unsigned>(gid));
+        return write_file("/proc/self/gid_map", map);
+    }
+
+    // The cgroup v2 hierarchy's mount point, or "" if there is none
+    static std::string cgroup2_mount() {
+        std::ifstream mounts("/proc/self/mountinfo");
+        std::string line;
+        while (std::getline(mounts, line)) {
+            // ... mount-point options [optional fields] - fstype source super-options
+            size_t dash = line.find(" - ");
+            if (dash == std::string::npos || line.compare(dash + 3, 8, "cgroup2 ") != 0) continue;
+            size_t start = 0;
+            for (int field = 0; field < 4 && start != std::string::npos; ++field) start = line.find(' ', start) + 1;
+            return line.substr(start, line.find(' ', start) - start);
+        }
+        return "";
+    }
+
+    // The shell's cgroup v2 path relative to the mount point ("0::/path")
+    static std::string own_cgroup() {
+        std::ifstream cgroups("/proc/self/cgroup");
+        std::string line;
+        while (std::getline(cgroups, line)) {
+            if (line.compare(0, 3, "0::") == 0) return line.substr(3);
+        }
+        return "";
+    }
+
+    // SECSHELL_SANDBOX_CPU, a percentage of one CPU, as cpu.max; "" if malformed
+    static std::string cpu_max(const std::string& percent) {
+        char* end;
+        double value = strtod(percent.c_str(), &end);
+        if (percent.empty() || *end || !(value >= 1) || value > 100000) return "";
+        return std::to_string(static_cast<long>(value * 1000)) + " 100000";
+    }
+
+    // A byte count with an optional K, M or G suffix; "" if malformed
+    static std::string bytes(const std::string& size) {
+        char* end;
+        unsigned long long value = strtoull(size.c_str(), &end, 10);
+        std::string suffix = end;
+        int shift = suffix.empty() ? 0 : suffix == "K" || suffix == "k" ? 10 : suffix == "M" || suffix == "m" ? 20
+                                   : suffix == "G" || suffix == "g" ? 30 : -1;
+        if (size.empty() || !isdigit(static_cast<unsigned char>(size[0])) || shift < 0 || value == 0 ||
+            value > (~0ULL >> shift)) {
+            return "";
+        }
+        return std::to_string(value << shift);
+    }
+
+private:
+    static const size_t STACK_BYTES = 32 << 10;
+
+    // Handed to the child; error is written back through the shared memory
+    struct Child {
+        const char* path = nullptr;
+        char* const* argv = nullptr;
+        char* const* envp = nullptr;
+        const Redirect* redirects = nullptr;
+        size_t redirect_count = 0;
+        const char* cwd = nullptr;
+        int user_ns = -1;
+        int mount_ns = -1;
+        int join_cgroup = -1;            // cgroup.procs to write, when not cloned into the cgroup
+        const struct sock_fprog* filter = nullptr;
+        volatile int error = 0;
+    };
+
+    // struct clone_args from linux/sched.h, whose macros clash with sched.h's
+    struct CloneArgs {
+        uint64_t flags;
+        uint64_t pidfd;
+        uint64_t child_tid;
+        uint64_t parent_tid;
+        uint64_t exit_signal;
+        uint64_t stack;
+        uint64_t stack_size;
+        uint64_t tls;
+        uint64_t set_tid;
+        uint64_t set_tid_size;
+        uint64_t cgroup;
+    };
+
+    Options options;
+    std::vector<struct sock_filter> filter;
+    std::vector<std::string> warnings;
+    int user_ns = -1;
+    int mount_ns = -1;
+    std::string cgroup_path;             // Created by prepare(), removed by release()
+    int cgroup_fd = -1;
+    int procs_fd = -1;
+    mutable std::atomic<bool> into_cgroup{true};
+
+    void release() {
+        for (int* fd : {&user_ns, &mount_ns, &cgroup_fd, &procs_fd}) {
+            if (*fd != -1) close(*fd);
+            *fd = -1;
+        }
+        if (!cgroup_path.empty()) rmdir(cgroup_path.c_str()); // Fails while background commands are in it
+        cgroup_path.clear();
+        warnings.clear();
+    }
+
+    static bool write_file(const char* path, const char* value) {
+        int fd = open(path, O_WRONLY | O_CLOEXEC);
+        if (fd == -1) return false;
+        ssize_t length = static_cast<ssize_t>(strlen(value));
+        bool ok = write(fd, value, length) == length;
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return ok;
+    }
+
+    // A helper process unshares the namespaces and builds the view; its
+    // namespaces outlive it through the descriptors opened here.
+    bool make_namespace(std::string& error) {
+        struct Report {
+            char step[128];
+            int error;
+        };
+        bool own_user_ns = geteuid() != 0;
+        uid_t uid = geteuid();
+        gid_t gid = getegid();
+        int report_pipe[2], hold_pipe[2];
+        if (pipe2(report_pipe, O_CLOEXEC) != 0) {
+            error = std::string("pipe: ") + strerror(errno);
+            return false;
+        }
+        if (pipe2(hold_pipe, O_CLOEXEC) != 0) {
+            error = std::string("pipe: ") + strerror(errno);
+            close(report_pipe[0]);
+            close(report_pipe[1]);
+            return false;
+        }
+        pid_t helper = fork();
+        if (helper == 0) {
+            close(report_pipe[0]);
+            close(hold_pipe[1]);
+            Report report = {};
+            const char* step = own_user_ns ? "creating a user and mount namespace" : "creating a mount namespace";
+            bool ok = unshare(CLONE_NEWNS | (own_user_ns ? CLONE_NEWUSER : 0)) == 0;
+            if (ok && own_user_ns) {
+                step = "mapping user ids";
+                ok = map_own_ids(uid, gid);
+            }
+            if (ok) ok = make_read_only_view(options.writable, step);
+            if (!ok) {
+                report.error = errno;
+                snprintf(report.step, sizeof(report.step), "%s", step);
+            }
+            (void)!write(report_pipe[1], &report, sizeof(report));
+            char hold;
+            (void)!read(hold_pipe[0], &hold, 1); // Until the namespaces are open
+            _exit(0);
+        }
+        close(report_pipe[1]);
+        close(hold_pipe[0]);
+        Report report = {};
+        bool reported = helper != -1 && read(report_pipe[0], &report, sizeof(report)) == sizeof(report);
+        close(report_pipe[0]);
+        if (reported && report.error == 0) {
+            std::string base = "/proc/" + std::to_string(helper) + "/ns/";
+            if (own_user_ns) user_ns = open((base + "user").c_str(), O_RDONLY | O_CLOEXEC);
+            mount_ns = open((base + "mnt").c_str(), O_RDONLY | O_CLOEXEC);
+            if (mount_ns == -1 || (own_user_ns && user_ns == -1)) report.error = errno;
+            snprintf(report.step, sizeof(report.step), "opening the namespaces");
+        }
+        close(hold_pipe[1]);
+        if (helper != -1) waitpid(helper, nullptr, 0);
+        if (!reported) {
+            error = helper == -1 ? std::string("fork: ") + strerror(errno) : "namespace helper failed";
+            return false;
+        }
+        if (report.error != 0) {
+            error = std::string(report.step) + ": " + strerror(report.error);
+            return false;
+        }
+        return true;
+    }
+
+    bool make_cgroup(std::string& error) {
+        bool limits = !options.cpu_max.empty() || !options.memory_max.empty() || !options.pids_max.empty();
+        auto unavailable = [&](const std::string& why) {
+            if (limits) {
+                error = why;
+                return false;
+            }
+            warnings.push_back("commands stay in the shell's cgroup: " + why);
+            return true;
+        };
+        std::string parent = options.cgroup_parent;
+        if (parent.empty()) {
+            std::string root = cgroup2_mount(), own = own_cgroup();
+            if (root.empty() || own.empty()) return unavailable("no cgroup v2 hierarchy");
+            parent = root + (own == "/" ? "" : own);
+        }
+        std::string path = parent + "/secshell-" + std::to_string(getpid());
+        if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+            return unavailable("cannot create " + path + ": " + strerror(errno));
+        }
+        cgroup_path = path;
+
+        const std::pair<const char*, const std::string*> LIMITS[] = {
+            {"cpu", &options.cpu_max}, {"memory", &options.memory_max}, {"pids", &options.pids_max}};
+        for (const auto& limit : LIMITS) {
+            if (limit.second->empty()) continue;
+            std::string controller = limit.first;
+            std::string file = path + "/" + controller + ".max";
+            // Controllers have to be enabled in the parent first
+            if (access(file.c_str(), F_OK) != 0 && !write_file((parent + "/cgroup.subtree_control").c_str(), ("+" + controller).c_str())) {
+                return unavailable("cannot enable the " + controller + " controller in " + parent + ": " + strerror(errno));
+            }
+            if (!write_file(file.c_str(), limit.second->c_str())) {
+                return unavailable("cannot set " + file + " to " + *limit.second + ": " + strerror(errno));
+            }
+        }
+        cgroup_fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        procs_fd = open((path + "/cgroup.procs").c_str(), O_WRONLY | O_CLOEXEC);
+        if (cgroup_fd == -1 || procs_fd == -1) {
+            std::string why = "cannot open " + path + ": " + strerror(errno);
+            for (int* fd : {&cgroup_fd, &procs_fd}) {
+                if (*fd != -1) close(*fd);
+                *fd = -1;
+            }
+            rmdir(path.c_str());
+            cgroup_path.clear();
+            return unavailable(why);
+        }
+        return true;
+    }
+
+    pid_t launch(Child& child, char* stack) const {
+#if defined(__x86_64__)
+        if (cgroup_fd != -1 && into_cgroup.load()) {
+            CloneArgs args = {};
+            args.flags = CLONE_VM | CLONE_VFORK | CLONE_INTO_CGROUP;
+            args.exit_signal = SIGCHLD;
+            args.stack = reinterpret_cast<uintptr_t>(stack);
+            args.stack_size = STACK_BYTES;
+            args.cgroup = static_cast<uint64_t>(cgroup_fd);
+            long pid = clone3_vm(&args, child_main, &child);
+            if (pid != -ENOSYS && pid != -EINVAL && pid != -E2BIG) return static_cast<pid_t>(pid);
+            into_cgroup = false; // Older kernel: the child joins the cgroup itself
+        }
+#endif
+        child.join_cgroup = procs_fd;
+        pid_t pid = clone(child_main, stack + STACK_BYTES, CLONE_VM | CLONE_VFORK | SIGCHLD, &child);
+        return pid == -1 ? -errno : pid;
+    }
+
+#if defined(__x86_64__)
+    // clone3 with the child calling fn(arg) on the stack in args and exiting
+    // with its result; glibc has no clone3 wrapper that takes a function.
+    // Returns the child's PID or -errno.
+    static long clone3_vm(CloneArgs* args, int (*fn)(void*), void* arg) {
+        register long rax asm("rax") = SYS_clone3;
+        register CloneArgs* rdi asm("rdi") = args;
+        register long rsi asm("rsi") = sizeof(CloneArgs);
+        register int (*r12)(void*) asm("r12") = fn;
+        register void* r13 asm("r13") = arg;
+        asm volatile(
+            "syscall\n\t"
+            "test %%rax, %%rax\n\t"
+            "jnz 1f\n\t"
+            "xor %%ebp, %%ebp\n\t"   // The child, on its own stack
+            "mov %%r13, %%rdi\n\t"
+            "call *%%r12\n\t"
+            "mov %%eax, %%edi\n\t"
+            "mov $60, %%eax\n\t"     // exit
+            "syscall\n\t"
+            "hlt\n"
+            "1:"
+            : "+r"(rax)
+            : "r"(rdi), "r"(rsi), "r"(r12), "r"(r13)
+            : "rcx", "r11", "memory", "cc");
+        return rax;
+    }
+#endif
+
+    // Runs in the child, in the parent's memory: system calls only.
+    static int child_main(void* data) {
+        Child& child = *static_cast<Child*>(data);
+        // As Spawner: default dispositions and an empty mask. Handlers go
+        // first so none runs here once signals are unblocked.
+        struct sigaction default_action = {};
+        default_action.sa_handler = SIG_DFL;
+        for (int sig = 1; sig < NSIG; ++sig) {
+            struct sigaction current;
+            if (sigaction(sig, nullptr, &current) != 0) continue;
+            bool reset = sig == SIGINT || sig == SIGQUIT || sig == SIGTSTP || sig == SIGTTIN || sig == SIGTTOU ||
+                         sig == SIGPIPE || sig == SIGCHLD;
+            if (reset || (current.sa_handler != SIG_IGN && current.sa_handler != SIG_DFL)) sigaction(sig, &default_action, nullptr);
+        }
+        for (size_t i = 0; i < child.redirect_count; ++i) {
+            const Redirect& redirect = child.redirects[i];
+            if (redirect.first != redirect.second && dup2(redirect.first, redirect.second) == -1) fail(child);
+        }
+        if (child.join_cgroup != -1 && write(child.join_cgroup, "0", 1) != 1) fail(child);
+        if (child.user_ns != -1 && setns(child.user_ns, CLONE_NEWUSER) != 0) fail(child);
+        if (setns(child.mount_ns, CLONE_NEWNS) != 0 || chdir(child.cwd) != 0) fail(child);
+        if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) != 0 || prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, child.filter) != 0) {
+            fail(child);
+        }
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, nullptr);
+        execve(child.path, child.argv, child.envp);
+        fail(child);
+        return 127;
+    }
+
+    [[noreturn]] static void fail(Child& child) {
+        child.error = errno;
+        _exit(127);
+    }
+};
+
+#endif
@@ -0,0 +1,556 @@
+#ifndef SECSHELL_SECSHELL_H
+#define SECSHELL_SECSHELL_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <istream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <poll.h>
+#include <pwd.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <readline/history.h>
+#include <readline/readline.h>
+
+#include "arena.h"
+#include "audit_log.h"
+#include "box_renderer.h"
+#include "buffered_writer.h"
+#include "command_parser.h"
+#include "command_policy.h"
+#include "completion.h"
+#include "fast_path.h"
+#include "glob_expander.h"
+#include "history_store.h"
+#include "job_table.h"
+#include "metrics.h"
+#include "output_capture.h"
+#include "prompt_renderer.h"
+#include "pty_relay.h"
+#include "resource_usage.h"
+#include "spawner.h"
+#include "startup_trace.h"
+#include "variable_store.h"
+#include "work_stealing_pool.h"
+
+extern char** environ;
+
+class SecShell {
+	// Background pipelines; a job is reported once every one of its stages has exited
+	JobTable jobs;
+    bool running = true;
+
+    // Security whitelists
+    const std::vector<std::string> ALLOWED_COMMANDS = {"ls", "ps", "netstat", "tcpdump","cd","clear","ifconfig","apk","apt","pacman","brew"};
+    const std::vector<std::string> BUILTIN_COMMANDS = {"services", "drawbox", "jobs", "help", "cd", "history", "export", "env",
+                                                       "unset", "reload", "rehash", "blacklist", "edit-blacklist", "exit", "time",
+                                                       "output", "follow", "parallel", "stats", "rules", "sandbox"};
+    std::string BLACKLIST=".blacklist";
+    std::string blacklist_stamp; // secshelld: the .blacklist version loaded
+    std::string RULES;           // Argument-level deny rules; .rules next to .blacklist unless SECSHELL_RULES is set
+    std::string rules_stamp;     // The RULES version loaded
+    std::string working_directory; // Relative paths in rules checks are resolved against it
+
+    // Box drawing for alerts, errors and section titles
+    BoxRenderer box_renderer;
+    bool use_external_drawbox = false;
+    FastPath fast_path;
+    VariableStore variables;
+    bool use_fast_path = true;   // SECSHELL_FASTPATH=0 always execs ls and cat
+    GlobExpander glob;           // Pathname expansion of unquoted words, with cached listings
+    bool use_glob = true;        // SECSHELL_GLOB=0 passes patterns through unexpanded
+    PromptRenderer prompt;       // Segments from SECSHELL_PROMPT, slow ones on a worker thread
+    std::string prompt_spec;     // The SECSHELL_PROMPT value in force
+    std::string current_prompt;  // What readline is showing
+    
+    // Blacklist (reloaded automatically when the file changes) and the
+    // executables resolved in the allowed directories
+    CommandPolicy policy{{"/usr/bin/", "/bin/", "/opt/"}};
+
+    bool interactive = true;
+    int last_status = 0; // Exit status of the last command, as in $?
+    int pipe_size = 0;   // F_SETPIPE_SZ for pipeline pipes; 0 keeps the kernel default
+
+    // Persistent history shared by all of the user's sessions
+    HistoryStore history_store;
+    static const size_t RECALL_HISTORY = 1000; // Entries preloaded for Up/Down
+    std::string search_pattern;
+    size_t search_position = 0;
+
+    // Tab completion caches
+    PrefixIndex command_completions;     // Allowed, non-blacklisted executables and builtins
+    unsigned long completion_exec_version = 0;
+    unsigned long completion_blacklist_version = 0;
+    DirectoryCache directory_cache;
+    PrefixIndex service_units;
+    time_t service_units_loaded = 0;
+    static const int SERVICE_UNITS_TTL = 30; // Seconds
+    static const PrefixIndex SERVICE_ACTIONS;
+
+    // services builtin
+    std::string systemctl_override; // SECSHELL_SYSTEMCTL, e.g. a stub for testing
+    int services_jobs = 8;          // SECSHELL_SERVICES_JOBS: concurrent systemctl processes
+    static const int SERVICE_CACHE_TTL = 5; // Seconds status and list results are reused
+    struct ServiceTask {
+        std::string unit;
+        std::vector<std::string> args;
+        int status = -1;     // Exit status once finished
+        std::string output;  // stdout and stderr together
+        bool cached = false;
+
+        ServiceTask(std::string unit, std::vector<std::string> args) : unit(std::move(unit)), args(std::move(args)) {}
+    };
+    struct CachedServiceResult {
+        time_t at;
+        int status;
+        std::string output;
+    };
+    std::unordered_map<std::string, CachedServiceResult> service_cache; // Keyed by action '\0' unit
+
+    // Backs the parse tree of the command being executed
+    Arena command_arena;
+
+    // Audit trail; enabled by SECSHELL_AUDIT_LOG
+    AuditLog audit;
+    static const uint64_t AUDIT_ROTATE_BYTES = 16 << 20;
+
+    // Counters and latency histograms for `stats`; also exported to a
+    // Prometheus textfile when SECSHELL_METRICS_FILE is set
+    Metrics metrics;
+    MetricsExporter metrics_exporter;
+    std::string metrics_file;
+    int metrics_interval = 15; // SECSHELL_METRICS_INTERVAL, seconds
+
+    // Per-command isolation (SECSHELL_SANDBOX=1), prepared once in
+    // start_services. If it cannot be prepared, external commands are refused.
+    Sandbox sandbox;
+    Sandbox::Options sandbox_options;
+    bool use_sandbox = false;
+    std::string sandbox_error;
+
+    // Background output capture (SECSHELL_CAPTURE_OUTPUT=1, interactive only)
+    struct CapturedJob {
+        CapturedJob(const std::string& name, size_t memory_bytes, uint64_t spill_bytes)
+            : name(name), output(memory_bytes, spill_bytes) {}
+        std::string name;
+        OutputCapture output;
+        int fd = -1;            // Pipe read end; -1 once the job's output has ended
+    };
+    bool capture_background = false;
+    size_t capture_memory_bytes = 256 << 10;      // SECSHELL_CAPTURE_BUFFER
+    uint64_t capture_spill_bytes = 64ULL << 20;   // SECSHELL_CAPTURE_SPILL
+    static const size_t CAPTURE_READ_BUDGET = 256 << 10;
+    static const size_t MAX_FINISHED_CAPTURES = 16;
+    std::map<pid_t, std::unique_ptr<CapturedJob>> captures;
+    std::unordered_map<int, pid_t> capture_fds;
+    std::deque<pid_t> finished_captures;          // Oldest first; trimmed to MAX_FINISHED_CAPTURES
+
+    // Per-stage usage of a foreground pipeline, for the time builtin
+    struct StageTiming {
+        std::string name;
+        ResourceUsage usage;
+    };
+
+    // One stage of a pipeline, ready to spawn or run in-process
+    struct PipelineStage {
+        std::vector<std::string> args;
+        std::string exec_path;   // Resolved binary; empty for builtins
+        std::string input_file;
+        std::string output_file;
+        bool append = false;
+        int in_fd = -1;          // Redirection or pipe read end; -1 inherits stdin
+        int out_fd = -1;         // Redirection or pipe write end; -1 inherits stdout
+        int err_fd = -1;         // Output capture pipe; -1 inherits stderr
+        pid_t pid = -1;
+        uint64_t start_us = 0;   // Launch time
+        ResourceUsage usage;
+        bool fast = false;       // ls/cat served by FastPath, exec_path kept for fallback
+
+        bool in_process() const { return exec_path.empty() || fast; }
+    };
+
+    // Event loop state
+    static SecShell* active_shell;
+    int epoll_fd = -1;
+    int signal_fd = -1;
+    bool stdin_always_ready = false;
+    bool prompt_installed = false;
+    bool prompt_suspended = false;
+    std::string saved_line;
+    int saved_point = 0;
+    std::string pending_line;
+    bool line_ready = false;
+    int command_report_fd = -1;   // Recording relay's command pipe, in a recorded session
+    
+    // Function to load blacklisted commands from a file
+    void load_blacklist(const std::string& filename);
+
+    std::string repeat_string(const std::string& str, int n);
+
+public:
+    // Non-interactive shells (-c, -s, scripts) skip the file watchers, report
+    // errors as plain lines on stderr and never touch readline.
+    SecShell(const std::string& blacklist_path, bool interactive_mode = true, StartupTrace* trace = nullptr);
+
+    // secshelld's zygote: loads the policy, the executable index and the
+    // completion table once and starts no threads, so ready sessions can be
+    // forked from it. Each forked session then calls begin_session().
+    struct Zygote {};
+    SecShell(const std::string& blacklist_path, Zygote);
+
+    // Zygote only, before each fork: applies .blacklist and .rules edits and
+    // pending executable changes so the session starts with the current policy.
+    void refresh_policy();
+
+    // In a session forked from the zygote, once the client's environment
+    // and working directory are in place: reads the client's settings and
+    // starts what a standalone shell starts in its constructor.
+    void begin_session(bool interactive_mode);
+
+    // The bytes `clear` prints for a terminal type, so secshelld can clear a
+    // client's screen without running it for every session.
+    std::string clear_sequence(const std::string& term);
+
+private:
+    // Settings read from the environment
+    void configure();
+
+    // The prompt caches its cheap segments; configure, cd, export and unset
+    // refresh them, and pick up a changed SECSHELL_PROMPT.
+    void refresh_prompt_context();
+
+    // SECSHELL_SANDBOX and its limits; malformed limits are reported and
+    // leave the sandbox unprepared, so commands are refused rather than
+    // run without them.
+    void configure_sandbox();
+
+    // A file in the same directory as path
+    static std::string sibling_path(const std::string& path, const std::string& name);
+
+    // Compiles RULES into the policy. Lines that do not parse are reported
+    // and skipped; if the file cannot be read the rules in force stay.
+    void load_rules();
+
+    // Reloads the rules if the file (or its path) changed since they were loaded
+    void refresh_rules();
+
+    // The sandbox template, then the audit writer, the metrics exporter and
+    // the blacklist watcher, all threads
+    void start_services(StartupTrace* trace);
+
+    // Identifies a version of a file by inode, size and mtime
+    static std::string file_stamp(const std::string& path);
+
+public:
+    // In a session recorded by PtyRelay: each command line read at the
+    // prompt is reported on fd before it runs, to index the recording.
+    void report_commands(int fd);
+
+    // Runs one command line and returns its exit status.
+    int run_command(const std::string& line);
+
+    // Runs commands line by line from a script or stdin. Blank lines and
+    // '#' comments (including a #! line) are skipped; 'exit' stops early.
+    int run_batch(std::istream& in);
+
+    void run();
+
+public:
+    // The prompt for the current directory, user and last status. Slow
+    // segments that miss the deadline are patched in by repaint_prompt().
+    std::string build_prompt();
+
+private:
+    // The run loop multiplexes stdin, SIGCHLD/SIGWINCH (via signalfd) and the
+    // executable index's inotify descriptor on one epoll instance. Readline
+    // runs in callback mode so a finished background job can be reported
+    // while the user is still typing.
+    bool setup_event_loop();
+
+    void wait_for_events();
+
+    void install_prompt();
+
+    // Slow segments arrived after the prompt was drawn: moves the cursor
+    // back to the prompt's first line and redraws prompt and line there.
+    void repaint_prompt();
+
+    // Takes readline off the terminal so asynchronous output does not land in
+    // the middle of the line being edited. resume_prompt() redraws it below.
+    void suspend_prompt();
+
+    void resume_prompt();
+
+    static void line_handler(char* line);
+
+    void handle_signals();
+
+    // Collects every exited child without blocking and hands it to
+    // background_stage_exited. A foreground pipeline reaps its own stages
+    // with wait4(-1) before control returns here, passing any other child
+    // that exits meanwhile to background_stage_exited the same way, so
+    // anything reaped here is a background job or an untracked helper.
+    void reap_children();
+
+    // Starts draining a captured job's output pipe from the event loop.
+    void add_capture(pid_t id, const std::string& name, int fd);
+
+    // Reads what is available without blocking. Each call takes at most
+    // CAPTURE_READ_BUDGET bytes so a busy job cannot starve the prompt.
+    void drain_capture(int fd);
+
+    CapturedJob* find_capture(const std::vector<std::string>& args, const std::string& usage);
+
+    // output        - list captured jobs
+    // output <pid>  - everything still retained for a job
+    void show_output(const std::vector<std::string>& args);
+
+    // follow <pid>: prints the last lines of a job's output, then streams new
+    // output as it arrives until the job's output ends or Enter / Ctrl-C.
+    // The event loop keeps running meanwhile, so other jobs are still drained.
+    void follow_output(const std::vector<std::string>& args);
+
+    // One instance of a parallel command line.
+    struct ParallelTask {
+        std::vector<std::string> args;
+        std::string exec_path;   // Empty if the policy checks refused it
+        std::string output;      // stdout and stderr, or the refusal message
+        int status = 0;
+        pid_t pid = -1;
+        ResourceUsage usage;
+    };
+
+    // parallel [-j N] [-k] <command template> [::: arg ...]
+    // Runs the template once per argument, substituting {} (or appending
+    // the argument), over N worker threads. Without ::: the arguments are
+    // read from stdin, one per line. Each task's output is buffered and
+    // printed whole as it finishes, or in argument order with -k. A summary
+    // of failures and timings goes to stderr.
+    void parallel_command(const std::vector<std::string>& args);
+
+    // Worker thread: spawns one instance with stdin from /dev/null and
+    // collects its combined output. Touches nothing but the task itself and
+    // the lock-free metrics. sandbox, when set, is only read.
+    static void run_parallel_task(ParallelTask& task, char* const* envp, const Sandbox* sandbox, Metrics& metrics);
+
+    // Accounts a reaped background process to its job and reports the job
+    // once its last process is gone. Untracked helpers are ignored.
+    void background_stage_exited(pid_t pid, int status, const struct rusage& usage);
+
+    std::string sanitize_input(const std::string& input);
+
+    void change_directory(const std::vector<std::string>& args);
+
+    // history            - every entry
+    // history N          - the last N entries
+    // history search PAT - entries containing PAT
+    void display_history(const std::vector<std::string>& args);
+
+    // $SECSHELL_HISTFILE, else ~/.secshell_history
+    static std::string history_path();
+
+    // Preloads recent entries so Up/Down recall works across sessions.
+    void load_recent_history();
+
+    // Ctrl-R: replaces the line with the newest entry containing the text
+    // typed so far; pressing it again steps further back.
+    static int reverse_search(int, int);
+    // Tab completion. Command position offers allowed, non-blacklisted
+    // executables and builtins; `services <action>` offers unit names; any
+    // other word completes against the cached listing of its directory.
+    static char** complete(const char* text, int start, int);
+
+    // Builds readline's match array directly: the common prefix of all
+    // matches, then each match, then NULL. Input runs are already sorted.
+    static char** make_matches(const std::string& lead, PrefixIndex::const_iterator first, PrefixIndex::const_iterator last);
+
+    // Rebuilt only when the executable index or the blacklist has changed.
+    const PrefixIndex& completion_commands();
+
+    // Service unit names, refreshed from systemctl at most every SERVICE_UNITS_TTL seconds.
+    const PrefixIndex& completion_services();
+
+    // Runs a helper (not a user command) and collects its stdout. stderr is discarded.
+    static bool capture_output(const std::string& path, const std::vector<std::string>& args, std::string& output,
+                               char* const* envp);
+    
+    // export NAME=value ... sets and exports; export NAME ... exports an
+    // existing shell variable. SECSHELL_ENV_ALLOW limits which names can be.
+    void export_variable(const std::vector<std::string>& args);
+	
+	// env     - the environment children receive
+	// env -a  - every shell variable, marking those children do not see
+	void list_env_variables(const std::vector<std::string>& args);
+
+	void unset_env_variable(const std::vector<std::string>& args);
+	
+	void reload_blacklist();
+	
+	void edit_blacklist();
+
+	void list_blacklist_commands();
+
+	// Runs one command line and records how long it took
+	void process_command(const std::string& input);
+
+	void execute_command_line(const std::string& input);
+
+	// time <pipeline>: runs the pipeline, then reports its wall time and the
+	// summed rusage of every stage on stderr, per stage when there are several.
+	void run_timed(const PipelineNode& pipeline);
+
+	bool is_builtin(const std::string& name) const;
+
+	// Runs a builtin in the current process. Returns false if args[0] is not one.
+	bool run_builtin(const std::vector<std::string>& args);
+
+    // services <action> [unit|pattern ...]
+    // Every target gets its own systemctl process (no /bin/sh), at most
+    // services_jobs at a time; results are gathered into one table. status
+    // and list results are reused for SERVICE_CACHE_TTL seconds, and any
+    // start/stop/restart invalidates them.
+    void manage_services(const std::vector<std::string>& args);
+
+    // SECSHELL_SYSTEMCTL, or systemctl from the allowed directories.
+    std::string systemctl_path();
+
+    // Literal names pass through; names with glob characters are matched
+    // against the known units, with or without the ".service" suffix.
+    // Anything that looks like an option is refused.
+    bool expand_service_targets(const std::vector<std::string>& targets, std::vector<std::string>& units);
+
+    // Runs the tasks with at most services_jobs children alive, collecting
+    // stdout and stderr of each through its own pipe.
+    void run_service_tasks(const std::string& program, std::vector<ServiceTask>& tasks);
+
+    // SERVICE  ACTION  RESULT  DETAIL, one row per target. The detail is the
+    // "Active:" line for status, otherwise the first line systemctl printed.
+    void print_service_table(BufferedWriter& out, const std::string& action, const std::vector<ServiceTask>& tasks);
+    
+    void background_job_complete(pid_t pid, const JobTable::Job& job);
+
+    // stats [prometheus | reset]: this session's command counts and latency percentiles
+    void show_stats(const std::vector<std::string>& args);
+
+	// rules                        - the deny rules in force, in file order
+	// rules check <command> [args]  - the rule that would deny the command, if any
+	void show_rules(const std::vector<std::string>& args);
+
+	// sandbox: whether commands run isolated, what stays writable, and the
+	// session cgroup's limits and usage
+	void show_sandbox(const std::vector<std::string>& args);
+
+	// 412us, 12.3ms, 1.20s
+	static std::string format_latency(uint64_t us);
+
+    // jobs     - one line per job with its running time
+    // jobs -l  - every process of every job with live state, CPU and RSS
+    void list_jobs(const std::vector<std::string>& args);
+
+    struct ProcessStat {
+        char state = '?';
+        uint64_t cpu_us = 0;     // User plus system time so far
+        unsigned long rss_kb = 0;
+    };
+
+    // Reads state, utime, stime and rss from /proc/<pid>/stat.
+    static bool read_process_stat(pid_t pid, ProcessStat& stat);
+    
+	// Executes a pipeline of one or more stages. Every stage passes the same
+	// blacklist and whitelist checks and may carry its own redirections.
+	// External stages are spawned first. The last builtin stage of a
+	// foreground pipeline then runs in-process writing into its pipe; other
+	// builtin stages, and all of them in background pipelines, run in a
+	// forked child so the shell never blocks on them.
+	void execute_pipeline(const PipelineNode& pipeline, std::vector<StageTiming>* timings = nullptr);
+
+	void glob_too_large(std::string_view pattern);
+
+	// Every policy decision goes to the audit log and the metrics
+	void record_decision(AuditLog::Verdict verdict, const std::vector<std::string>& args);
+
+	// Materializes a parsed command into a stage, expanding globs, and
+	// applies the policy checks to the expanded words. Builtins are left
+	// with an empty exec_path.
+	bool prepare_stage(const CommandNode& command, PipelineStage& stage);
+
+	// Opens redirection targets and connects neighbouring stages with pipes.
+	// A stage's own redirection wins over the pipe, as in other shells.
+	bool open_stage_fds(std::vector<PipelineStage>& stages, std::vector<int>& fds);
+
+	static void close_fds(std::vector<int>& fds);
+
+	// Runs a builtin with fd 0 and fd 1 pointed at in_fd and out_fd. Output
+	// written through std::cout and straight to the descriptor (boxes) both
+	// land there; builtins that read input (parallel) see the pipe.
+	void run_builtin_redirected(const std::vector<std::string>& args, int in_fd, int out_fd);
+
+	// Runs an ls or cat stage through FastPath. If it declines, the real
+	// binary is spawned on the same descriptors and reaped with the rest.
+	void run_fast_stage(PipelineStage& stage, bool last);
+
+	// Background pipelines run builtin stages in a child of their own.
+	pid_t fork_builtin_stage(const PipelineStage& stage, const std::vector<int>& fds);
+
+	static void add_color_flags(std::vector<std::string>& args);
+
+	void display_help();
+
+    // Maps a wait status to a shell exit status (128 + signal when killed).
+    static int exit_status(int status);
+
+    void rehash();
+
+    // Draws a framed message on stdout. The in-process renderer is used unless
+    // SECSHELL_DRAWBOX=external opts back into the drawbox binary.
+    bool draw_box(const std::string& text, const std::string& style);
+
+	bool run_external_drawbox(const std::string& text, const std::string& style);
+
+	void drawbox_command(const std::vector<std::string>& args);
+
+    void print_alert(const std::string& message);
+
+	void print_error(const std::string& message);
+
+	// One line on stderr, coloured only for an interactive shell whose
+	// stderr is a terminal; -c, -s, scripts and redirects get plain text.
+	void print_tagged(const char* color, const char* tag, const std::string& message);
+
+public:
+    // Splits a line into words without the pipeline grammar
+    std::vector<std::string> parse_arguments(const std::string& input);
+
+private:
+    static void signal_handler(int signum);
+};
+
+// Directory of the running executable, where .blacklist lives
+std::string get_executable_directory();
+
+#endif
@@ -0,0 +1,42 @@
+// Static data and free functions of the secshell_core library. SecShell's
+// member functions are defined in the shell_*.cpp files beside this one; the
+// other components are header-only.
+#include <libgen.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <string>
+
+#include "secshell.h"
+#include "session_daemon.h"
+
+volatile sig_atomic_t FastPath::interrupted = 0;
+
+SecShell* SecShell::active_shell = nullptr;
+const PrefixIndex SecShell::SERVICE_ACTIONS = [] {
+    PrefixIndex actions;
+    actions.assign({"start", "stop", "restart", "status", "list"});
+    return actions;
+}();
+
+// Define the load_blacklist function outside the class
+void SecShell::load_blacklist(const std::string& filename) {
+    if (!policy.load_blacklist(filename)) {
+        print_error("Failed to open blacklist file: " + filename); // The policy already in force stays
+    }
+}
+
+// Function to get the directory of the executable
+std::string get_executable_directory() {
+    char exe_path[PATH_MAX];
+    ssize_t len = readlink("/proc/self/exe", exe_path, sizeof(exe_path) - 1);
+    if (len == -1) {
+        std::cerr << "Failed to get executable path." << std::endl;
+        return "";
+    }
+    exe_path[len] = '\0';
+    return std::string(dirname(exe_path));
+}
+
+int SessionClient::conn = -1;
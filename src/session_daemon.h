@@ -0,0 +1,576 @@
+#ifndef SECSHELL_SESSION_DAEMON_H
+#define SECSHELL_SESSION_DAEMON_H
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <pwd.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "helper_thread.h"
+#include "secshell.h"
+
+extern char** environ;
+
+// secshelld keeps one warm zygote SecShell (policy, executable index,
+// completion table) and forks a ready session for each client, so SSH
+// sessions skip the cold start. The exchange runs over a SOCK_SEQPACKET
+// Unix socket, which delivers every message whole:
+//   client -> daemon  one request: a RequestHeader, then the cwd, argv and
+//                     environment strings, each NUL terminated, with the
+//                     client's stdin, stdout and stderr attached (SCM_RIGHTS)
+//   client -> daemon  one byte per terminal signal to forward
+//   daemon -> client  Reply{Ready} once the session is set up and
+//                     Reply{Exit, status} when it ends
+// Sessions run as the connecting user (SO_PEERCRED). A root daemon drops
+// privileges in each session; any other daemon serves only its own user.
+class SessionDaemon {
+public:
+    struct RequestHeader {
+        static const uint32_t MAGIC = 0x53534431; // "SSD1"
+        uint32_t magic = MAGIC;
+        uint32_t argc = 0;
+        uint32_t envc = 0;
+    };
+
+    struct Reply {
+        enum Kind : uint32_t { Ready = 1, Exit = 2 };
+        uint32_t kind;
+        int32_t status;
+    };
+
+    static const size_t MAX_REQUEST = 128 << 10;
+    static const size_t MAX_PENDING = 64;     // Accepted connections still to send their request
+    static const size_t MAX_SESSIONS = 1024;
+    static const int REQUEST_TIMEOUT = 5;     // Seconds a connection may take to send its request
+    static const size_t MAX_CLEAR_SEQUENCES = 32;
+
+    // Signals a client forwards; anything else on the wire is ignored
+    static bool forwarded(int sig) {
+        return sig == SIGINT || sig == SIGQUIT || sig == SIGTSTP || sig == SIGWINCH || sig == SIGHUP || sig == SIGTERM;
+    }
+
+    static std::string default_socket_path() {
+        const char* path = getenv("SECSHELL_SOCKET");
+        return path && *path ? path : "/run/secshelld.sock";
+    }
+
+    static std::string encode_request(const std::string& cwd, const std::vector<std::string>& args, char** envp) {
+        RequestHeader header;
+        std::string body = cwd + '\0';
+        for (const auto& arg : args) {
+            body += arg;
+            body += '\0';
+            ++header.argc;
+        }
+        for (char** entry = envp; *entry; ++entry) {
+            body += *entry;
+            body += '\0';
+            ++header.envc;
+        }
+        return std::string(reinterpret_cast<const char*>(&header), sizeof(header)) + body;
+    }
+
+    // The forked session, as main sees it. The relay thread turns forwarded
+    // signal bytes into kill(0, sig) for the session's process group, the
+    // way the terminal would signal its foreground group.
+    class Session {
+    public:
+        std::vector<std::string> args;
+        std::string clear;   // What `clear` prints on the client's terminal
+
+        ~Session() {
+            finish(1);
+        }
+
+        bool start(int connection) {
+            conn = connection;
+            relay = start_helper_thread([this] { relay_loop(); });
+            return send_reply(Reply::Ready, 0);
+        }
+
+        // Reports the exit status and stops relaying
+        void finish(int status) {
+            if (conn == -1) return;
+            ending.store(true, std::memory_order_release);
+            send_reply(Reply::Exit, status);
+            shutdown(conn, SHUT_RDWR);
+            if (relay.joinable()) relay.join();
+            close(conn);
+            conn = -1;
+        }
+
+    private:
+        int conn = -1;
+        std::thread relay;
+        std::atomic<bool> ending{false};
+
+        bool send_reply(Reply::Kind kind, int status) {
+            Reply reply{kind, status};
+            return send(conn, &reply, sizeof(reply), MSG_NOSIGNAL) == sizeof(reply);
+        }
+
+        void relay_loop() {
+            unsigned char sig;
+            for (;;) {
+                ssize_t n = recv(conn, &sig, 1, 0);
+                if (n == 1) {
+                    if (forwarded(sig)) kill(0, sig);
+                } else if (n == -1 && errno == EINTR) {
+                    continue;
+                } else {
+                    // The client went away without the session ending: hang up
+                    if (!ending.load(std::memory_order_acquire)) kill(0, SIGHUP);
+                    return;
+                }
+            }
+        }
+    };
+
+    SessionDaemon(SecShell& zygote, const std::string& socket_path) : shell(zygote), path(socket_path) {}
+
+    ~SessionDaemon() {
+        shut_down();
+    }
+
+    SessionDaemon(const SessionDaemon&) = delete;
+    SessionDaemon& operator=(const SessionDaemon&) = delete;
+
+    // Accepts clients until SIGTERM, SIGINT or SIGHUP. Returns false when the
+    // daemon stops (exit_status() says how) and true in a freshly forked
+    // session that is ready for main to run.
+    bool serve(Session& session) {
+        if (!listen_on_socket() || !setup_loop()) {
+            status = 1;
+            return false;
+        }
+        std::cerr << "secshelld: listening on " << path << "\n";
+
+        bool stopping = false;
+        while (!stopping) {
+            struct epoll_event events[16];
+            int n = epoll_wait(epoll_fd, events, 16, 1000);
+            if (n == -1 && errno != EINTR) break;
+            for (int i = 0; i < n; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == signal_fd) {
+                    stopping = handle_signals();
+                } else if (fd == listen_fd) {
+                    accept_clients();
+                } else if (start_session(fd, session)) {
+                    return true; // In the session
+                }
+            }
+            expire_pending();
+        }
+        shut_down();
+        return false;
+    }
+
+    int exit_status() const { return status; }
+
+private:
+    SecShell& shell;
+    std::string path;
+    int listen_fd = -1;
+    int epoll_fd = -1;
+    int signal_fd = -1;
+    bool owner = false;              // This process created the socket file
+    sigset_t saved_mask;
+    int status = 0;
+    std::unordered_map<int, time_t> pending; // Connection fd -> accept time
+    std::unordered_map<pid_t, time_t> sessions;  // Running session -> start time
+    std::unordered_map<std::string, std::string> clear_sequences; // By TERM
+
+    struct Request {
+        std::string cwd;
+        std::vector<std::string> args;
+        std::vector<std::string> env;
+        int fds[3] = {-1, -1, -1};
+        struct ucred cred = {};
+    };
+
+    bool listen_on_socket() {
+        struct sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path)) {
+            std::cerr << "secshelld: socket path too long: " << path << "\n";
+            return false;
+        }
+        memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+        listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+        if (listen_fd == -1) {
+            std::cerr << "secshelld: socket: " << strerror(errno) << "\n";
+            return false;
+        }
+        // A socket file nobody answers on is left over from a dead daemon
+        int probe = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (probe != -1 && connect(probe, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0) {
+            close(probe);
+            std::cerr << "secshelld: already running on " << path << "\n";
+            return false;
+        }
+        if (probe != -1) close(probe);
+        unlink(path.c_str());
+
+        mode_t previous = umask(077);
+        int bound = bind(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+        umask(previous);
+        if (bound == -1 || listen(listen_fd, 128) == -1) {
+            std::cerr << "secshelld: cannot listen on " << path << ": " << strerror(errno) << "\n";
+            return false;
+        }
+        owner = true;
+        // Everyone may connect to a root daemon; sessions run as the caller
+        chmod(path.c_str(), geteuid() == 0 ? 0666 : 0600);
+        return true;
+    }
+
+    bool setup_loop() {
+        sigset_t mask;
+        sigemptyset(&mask);
+        for (int sig : {SIGCHLD, SIGTERM, SIGINT, SIGHUP}) sigaddset(&mask, sig);
+        if (sigprocmask(SIG_BLOCK, &mask, &saved_mask) == -1) return false;
+        signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (signal_fd == -1 || epoll_fd == -1) return false;
+
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = signal_fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, signal_fd, &ev) == -1) return false;
+        ev.data.fd = listen_fd;
+        return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) == 0;
+    }
+
+    // Reaps finished sessions; returns true on a request to stop
+    bool handle_signals() {
+        struct signalfd_siginfo info;
+        bool stop = false;
+        while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+            if (info.ssi_signo != SIGCHLD) stop = true;
+        }
+        pid_t pid;
+        while ((pid = waitpid(-1, nullptr, WNOHANG)) > 0) sessions.erase(pid);
+        return stop;
+    }
+
+    void accept_clients() {
+        int fd;
+        while ((fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK)) != -1) {
+            struct ucred cred;
+            socklen_t len = sizeof(cred);
+            // A daemon that is not root can only serve its own user
+            if (pending.size() >= MAX_PENDING || sessions.size() >= MAX_SESSIONS ||
+                getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1 ||
+                (geteuid() != 0 && cred.uid != geteuid())) {
+                close(fd);
+                continue;
+            }
+            struct epoll_event ev = {};
+            ev.events = EPOLLIN;
+            ev.data.fd = fd;
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+                close(fd);
+                continue;
+            }
+            pending[fd] = time(nullptr);
+        }
+    }
+
+    void expire_pending() {
+        time_t now = time(nullptr);
+        for (auto it = pending.begin(); it != pending.end();) {
+            if (now - it->second > REQUEST_TIMEOUT) {
+                close(it->first);
+                it = pending.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void drop_pending(int fd) {
+        pending.erase(fd);
+        close(fd);
+    }
+
+    // Reads the request from a pending connection and forks its session.
+    // Returns true only in the forked child.
+    bool start_session(int fd, Session& session) {
+        Request request;
+        bool valid = receive_request(fd, request);
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        if (!valid) {
+            drop_pending(fd);
+            for (int received : request.fds) if (received != -1) close(received);
+            return false;
+        }
+
+        shell.refresh_policy();
+        std::string clear = clear_for(request.env);
+        pid_t pid = fork();
+        if (pid == 0) {
+            pending.erase(fd);
+            become_session(fd, request, session);
+            session.clear = std::move(clear);
+            return true;
+        }
+        if (pid > 0) {
+            sessions[pid] = time(nullptr);
+        } else {
+            std::cerr << "secshelld: fork: " << strerror(errno) << "\n";
+        }
+        drop_pending(fd);
+        for (int received : request.fds) close(received);
+        return false;
+    }
+
+    static bool receive_request(int fd, Request& request) {
+        std::vector<char> buffer(MAX_REQUEST);
+        alignas(struct cmsghdr) char control[CMSG_SPACE(3 * sizeof(int))];
+        struct iovec iov = {buffer.data(), buffer.size()};
+        struct msghdr msg = {};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        ssize_t n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC | MSG_DONTWAIT);
+        if (n <= 0) return false;
+
+        for (struct cmsghdr* c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+            if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS) {
+                size_t count = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                for (size_t i = 0; i < count; ++i) {
+                    int received;
+                    memcpy(&received, CMSG_DATA(c) + i * sizeof(int), sizeof(int));
+                    if (i < 3 && request.fds[i] == -1) {
+                        request.fds[i] = received;
+                    } else {
+                        close(received);
+                    }
+                }
+            }
+        }
+        if (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) return false;
+        for (int received : request.fds) if (received == -1) return false;
+
+        socklen_t len = sizeof(request.cred);
+        if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &request.cred, &len) == -1) return false;
+
+        RequestHeader header;
+        if (static_cast<size_t>(n) < sizeof(header)) return false;
+        memcpy(&header, buffer.data(), sizeof(header));
+        if (header.magic != RequestHeader::MAGIC) return false;
+
+        // Strings follow the header, each NUL terminated
+        const char* p = buffer.data() + sizeof(header);
+        const char* end = buffer.data() + n;
+        auto next = [&p, end](std::string& out) {
+            const char* nul = static_cast<const char*>(memchr(p, '\0', end - p));
+            if (!nul) return false;
+            out.assign(p, nul);
+            p = nul + 1;
+            return true;
+        };
+        if (!next(request.cwd)) return false;
+        if (header.argc > MAX_REQUEST || header.envc > MAX_REQUEST) return false;
+        request.args.resize(header.argc);
+        for (auto& arg : request.args) if (!next(arg)) return false;
+        request.env.resize(header.envc);
+        for (auto& entry : request.env) if (!next(entry)) return false;
+        return p == end;
+    }
+
+    // Cached per TERM; only plain terminal names are looked up
+    std::string clear_for(const std::vector<std::string>& env) {
+        std::string term;
+        for (const auto& entry : env) {
+            if (entry.compare(0, 5, "TERM=") == 0) term = entry.substr(5);
+        }
+        if (term.empty() || term.size() > 64 || !std::all_of(term.begin(), term.end(), [](char c) {
+                return isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || c == '.' || c == '+';
+            })) {
+            return "";
+        }
+        auto it = clear_sequences.find(term);
+        if (it != clear_sequences.end()) return it->second;
+        std::string sequence = shell.clear_sequence(term);
+        if (clear_sequences.size() < MAX_CLEAR_SEQUENCES) clear_sequences.emplace(term, sequence);
+        return sequence;
+    }
+
+    // In the forked child: leaves the daemon behind, becomes the client's
+    // user, takes over its terminal, environment and working directory.
+    void become_session(int conn, Request& request, Session& session) {
+        for (const auto& entry : pending) close(entry.first);
+        pending.clear();
+        sessions.clear();
+        close(listen_fd);
+        close(epoll_fd);
+        close(signal_fd);
+        listen_fd = epoll_fd = signal_fd = -1;
+        owner = false;
+        sigprocmask(SIG_SETMASK, &saved_mask, nullptr);
+        setsid();
+
+        if (geteuid() == 0 && request.cred.uid != 0) {
+            struct passwd* pw = getpwuid(request.cred.uid);
+            if (!pw || initgroups(pw->pw_name, pw->pw_gid) != 0 || setgid(pw->pw_gid) != 0 ||
+                setuid(request.cred.uid) != 0 || getuid() != request.cred.uid) {
+                _exit(126); // The client sees no Ready and runs standalone
+            }
+        }
+
+        for (int i = 0; i < 3; ++i) {
+            dup2(request.fds[i], i);
+        }
+        for (int received : request.fds) if (received > 2) close(received);
+
+        clearenv();
+        for (const auto& entry : request.env) {
+            size_t eq = entry.find('=');
+            if (eq != std::string::npos && eq > 0) setenv(entry.substr(0, eq).c_str(), entry.c_str() + eq + 1, 1);
+        }
+        if (chdir(request.cwd.c_str()) != 0) {
+            const char* home = getenv("HOME");
+            if (!home || chdir(home) != 0) (void)!chdir("/");
+        }
+
+        session.args = std::move(request.args);
+        fcntl(conn, F_SETFL, fcntl(conn, F_GETFL) & ~O_NONBLOCK); // The relay blocks on it
+        if (!session.start(conn)) _exit(1);
+    }
+
+    void shut_down() {
+        for (const auto& entry : pending) close(entry.first);
+        pending.clear();
+        for (int* fd : {&listen_fd, &epoll_fd, &signal_fd}) {
+            if (*fd != -1) close(*fd);
+            *fd = -1;
+        }
+        if (owner) unlink(path.c_str());
+        owner = false;
+    }
+};
+
+// The thin client for secshelld: hands this process's terminal to a
+// session in the daemon, forwards terminal signals to it and waits for its
+// exit status. run() returns false, with nothing changed, when no daemon
+// took the session; the caller then runs the shell itself.
+class SessionClient {
+public:
+    explicit SessionClient(const std::string& socket_path) : path(socket_path) {}
+
+    bool run(const std::vector<std::string>& args, int& status) {
+        struct sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path)) return false;
+        memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+        int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (fd == -1) return false;
+        if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == -1) {
+            close(fd);
+            return false;
+        }
+
+        char cwd[PATH_MAX];
+        std::string request = SessionDaemon::encode_request(getcwd(cwd, sizeof(cwd)) ? cwd : "/", args, environ);
+        if (request.size() > SessionDaemon::MAX_REQUEST || !send_request(fd, request)) {
+            close(fd);
+            return false;
+        }
+
+        struct termios saved;
+        bool have_termios = tcgetattr(STDIN_FILENO, &saved) == 0;
+        conn = fd;
+        struct sigaction action = {}, previous[6];
+        action.sa_handler = forward;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESTART;
+        const int signals[6] = {SIGINT, SIGQUIT, SIGTSTP, SIGWINCH, SIGHUP, SIGTERM};
+        for (int i = 0; i < 6; ++i) sigaction(signals[i], &action, &previous[i]);
+
+        bool ready = false, exited = false;
+        SessionDaemon::Reply reply;
+        ssize_t n;
+        while ((n = recv(fd, &reply, sizeof(reply), 0)) != 0) {
+            if (n == -1) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            if (n != sizeof(reply)) continue;
+            if (reply.kind == SessionDaemon::Reply::Ready) {
+                ready = true;
+            } else if (reply.kind == SessionDaemon::Reply::Exit) {
+                status = reply.status;
+                exited = true;
+                break;
+            }
+        }
+
+        for (int i = 0; i < 6; ++i) sigaction(signals[i], &previous[i], nullptr);
+        conn = -1;
+        close(fd);
+        if (ready && !exited) {
+            // The session died; leave the terminal as it was found
+            if (have_termios) tcsetattr(STDIN_FILENO, TCSANOW, &saved);
+            status = 1;
+        }
+        return ready;
+    }
+
+private:
+    std::string path;
+    static int conn;
+
+    static bool send_request(int fd, const std::string& request) {
+        int fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+        alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(fds))] = {};
+        struct iovec iov = {const_cast<char*>(request.data()), request.size()};
+        struct msghdr msg = {};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        struct cmsghdr* c = CMSG_FIRSTHDR(&msg);
+        c->cmsg_level = SOL_SOCKET;
+        c->cmsg_type = SCM_RIGHTS;
+        c->cmsg_len = CMSG_LEN(sizeof(fds));
+        memcpy(CMSG_DATA(c), fds, sizeof(fds));
+        ssize_t n;
+        while ((n = sendmsg(fd, &msg, MSG_NOSIGNAL)) == -1 && errno == EINTR) {}
+        return n == static_cast<ssize_t>(request.size());
+    }
+
+    static void forward(int sig) {
+        unsigned char byte = sig;
+        if (conn != -1) (void)!send(conn, &byte, 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+};
+
+#endif
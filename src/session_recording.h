@@ -0,0 +1,791 @@
+#ifndef SECSHELL_SESSION_RECORDING_H
+#define SECSHELL_SESSION_RECORDING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <pwd.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(SECSHELL_WITH_ZSTD)
+#include <zstd.h>
+#elif defined(SECSHELL_WITH_LZ4)
+#include <lz4.h>
+#endif
+
+#include "box_renderer.h"
+#include "helper_thread.h"
+
+// Chunk compression for session recordings. CMake defines SECSHELL_WITH_ZSTD
+// or SECSHELL_WITH_LZ4 when it finds the library; without either, chunks use
+// a built-in compressor for the LZ4 block format, so every build can write
+// and read Lz4 chunks. A chunk is stored as is when compression would not
+// shrink it.
+class RecordingCodec {
+public:
+    enum Kind : uint8_t { Stored = 0, Lz4 = 1, Zstd = 2 };
+
+    static Kind preferred() {
+#if defined(SECSHELL_WITH_ZSTD)
+        return Zstd;
+#else
+        return Lz4;
+#endif
+    }
+
+    static bool available(Kind kind) {
+#if defined(SECSHELL_WITH_ZSTD)
+        if (kind == Zstd) return true;
+#endif
+        return kind == Stored || kind == Lz4;
+    }
+
+    static const char* name(Kind kind) {
+        return kind == Zstd ? "zstd" : kind == Lz4 ? "lz4" : "stored";
+    }
+
+    // Compresses into out (replacing it) and returns the kind used.
+    static Kind compress(Kind kind, const char* data, size_t size, std::string& out) {
+        out.clear();
+        if (kind == Zstd && available(Zstd)) {
+#if defined(SECSHELL_WITH_ZSTD)
+            out.resize(ZSTD_compressBound(size));
+            size_t n = ZSTD_compress(&out[0], out.size(), data, size, 3);
+            if (!ZSTD_isError(n) && n < size) {
+                out.resize(n);
+                return Zstd;
+            }
+#endif
+        } else if (kind == Lz4) {
+            out.resize(size + size / 255 + 16);
+#if defined(SECSHELL_WITH_LZ4)
+            int n = size <= static_cast<size_t>(LZ4_MAX_INPUT_SIZE)
+                        ? LZ4_compress_default(data, &out[0], static_cast<int>(size), static_cast<int>(out.size()))
+                        : 0;
+            size_t used = n > 0 ? static_cast<size_t>(n) : size;
+#else
+            size_t used = lz4_compress(reinterpret_cast<const uint8_t*>(data), size, reinterpret_cast<uint8_t*>(&out[0]));
+#endif
+            if (used < size) {
+                out.resize(used);
+                return Lz4;
+            }
+        }
+        out.assign(data, size);
+        return Stored;
+    }
+
+    // Replaces out with the raw_size bytes data decompresses to; false on a
+    // corrupt chunk or a codec this build lacks.
+    static bool decompress(Kind kind, const char* data, size_t size, size_t raw_size, std::string& out) {
+        out.resize(raw_size);
+        if (kind == Stored) {
+            if (size != raw_size) return false;
+            if (size) memcpy(&out[0], data, size);
+            return true;
+        }
+        if (kind == Lz4) {
+            return lz4_decompress(reinterpret_cast<const uint8_t*>(data), size, reinterpret_cast<uint8_t*>(&out[0]), raw_size);
+        }
+#if defined(SECSHELL_WITH_ZSTD)
+        if (kind == Zstd) {
+            size_t n = ZSTD_decompress(&out[0], raw_size, data, size);
+            return !ZSTD_isError(n) && n == raw_size;
+        }
+#endif
+        return false;
+    }
+
+    // LZ4 block format, greedy single-probe matching. dst must hold
+    // size + size / 255 + 16 bytes; returns the bytes written.
+    static size_t lz4_compress(const uint8_t* src, size_t size, uint8_t* dst) {
+        const size_t MIN_MATCH = 4, LAST_LITERALS = 5, MATCH_LIMIT = 12;
+        const int HASH_BITS = 13;
+        std::unique_ptr<uint32_t[]> table(new uint32_t[1 << HASH_BITS]()); // Position + 1; 0 is empty
+        uint8_t* op = dst;
+        size_t ip = 0, anchor = 0;
+        if (size > MATCH_LIMIT) {
+            size_t limit = size - MATCH_LIMIT;
+            while (ip < limit) {
+                uint32_t sequence = read32(src + ip);
+                uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+                size_t candidate = table[hash];
+                table[hash] = static_cast<uint32_t>(ip + 1);
+                if (candidate == 0 || ip - (candidate - 1) > 65535 || read32(src + candidate - 1) != sequence) {
+                    ip += 1 + ((ip - anchor) >> 6); // Skip faster through incompressible data
+                    continue;
+                }
+                size_t match = candidate - 1;
+                size_t length = MIN_MATCH;
+                size_t longest = size - LAST_LITERALS - ip;
+                while (length < longest && src[match + length] == src[ip + length]) ++length;
+                op = lz4_sequence(op, src + anchor, ip - anchor, static_cast<uint16_t>(ip - match), length - MIN_MATCH);
+                ip += length;
+                anchor = ip;
+            }
+        }
+        return lz4_sequence(op, src + anchor, size - anchor, 0, 0) - dst;
+    }
+
+    static bool lz4_decompress(const uint8_t* src, size_t size, uint8_t* dst, size_t raw_size) {
+        size_t ip = 0, op = 0;
+        while (ip < size) {
+            uint8_t token = src[ip++];
+            size_t literals = token >> 4;
+            if (literals == 15 && !lz4_length(src, size, ip, literals)) return false;
+            if (literals > size - ip || literals > raw_size - op) return false;
+            memcpy(dst + op, src + ip, literals);
+            ip += literals;
+            op += literals;
+            if (ip == size) break; // The last sequence has no match
+            if (size - ip < 2) return false;
+            size_t offset = src[ip] | (src[ip + 1] << 8);
+            ip += 2;
+            size_t length = token & 15;
+            if (length == 15 && !lz4_length(src, size, ip, length)) return false;
+            length += 4;
+            if (offset == 0 || offset > op || length > raw_size - op) return false;
+            for (size_t i = 0; i < length; ++i, ++op) dst[op] = dst[op - offset]; // May overlap
+        }
+        return op == raw_size;
+    }
+
+private:
+    static uint32_t read32(const uint8_t* p) {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    static uint8_t* lz4_sequence(uint8_t* op, const uint8_t* literals, size_t count, uint16_t offset, size_t match) {
+        uint8_t* token = op++;
+        *token = static_cast<uint8_t>(std::min<size_t>(count, 15) << 4);
+        if (count >= 15) {
+            size_t rest = count - 15;
+            for (; rest >= 255; rest -= 255) *op++ = 255;
+            *op++ = static_cast<uint8_t>(rest);
+        }
+        memcpy(op, literals, count);
+        op += count;
+        if (offset == 0) return op;
+        *op++ = static_cast<uint8_t>(offset);
+        *op++ = static_cast<uint8_t>(offset >> 8);
+        *token |= static_cast<uint8_t>(std::min<size_t>(match, 15));
+        if (match >= 15) {
+            size_t rest = match - 15;
+            for (; rest >= 255; rest -= 255) *op++ = 255;
+            *op++ = static_cast<uint8_t>(rest);
+        }
+        return op;
+    }
+
+    static bool lz4_length(const uint8_t* src, size_t size, size_t& ip, size_t& length) {
+        uint8_t byte;
+        do {
+            if (ip >= size) return false;
+            byte = src[ip++];
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+};
+
+// Session recording file: timestamped terminal frames, compressed in
+// chunks on a background thread, with an index of chunks and commands at
+// the end so a player can seek without decoding what it skips.
+//
+// File layout: "SECREC01", u32 version, i64 realtime ns at the start, u16
+// columns, u16 rows, string user, then chunks. A chunk is u32 "CHNK", u8
+// codec, u32 raw size, u32 stored size, u64 first frame us, then the
+// stored bytes. Raw chunk data is frames: u8 type, u64 us since the start,
+// u32 length and the data. After the last chunk: the index (u32 chunk
+// count, per chunk u64 offset and u64 first us; u32 command count, per
+// command u64 us, u32 chunk and string text; u64 duration us, i32 exit
+// status) and a trailer of u64 index offset and "SECRECIX". Strings are
+// u32 length plus bytes. A recording cut short has no index; the reader
+// then rebuilds it by walking the chunks.
+class SessionRecording {
+public:
+    enum FrameType : uint8_t {
+        Output = 1,       // Bytes written to the terminal
+        Input = 2,        // Keystrokes
+        HiddenInput = 3,  // Keystrokes while the terminal did not echo; data is the u32 count only
+        Resize = 4,       // u16 columns, u16 rows
+        Command = 5,      // A command line the shell is about to run; starts a chunk
+        Exit = 6,         // i32 wait status of the session
+    };
+
+    static const uint32_t VERSION = 1;
+    static const size_t FRAME_HEADER = 13;
+
+protected:
+    static constexpr const char* MAGIC = "SECREC01";
+    static constexpr const char* TRAILER_MAGIC = "SECRECIX";
+    static const uint32_t CHUNK_MAGIC = 0x4B4E4843; // "CHNK"
+    static const size_t CHUNK_HEADER = 21;
+
+    template <typename T>
+    static void put(std::string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    static void put_string(std::string& out, const std::string& value) {
+        put(out, static_cast<uint32_t>(value.size()));
+        out += value;
+    }
+
+    template <typename T>
+    static bool get(const char* data, size_t size, size_t& pos, T& value) {
+        if (size < pos || size - pos < sizeof(T)) return false;
+        memcpy(&value, data + pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+
+    static bool get_string(const char* data, size_t size, size_t& pos, std::string& value) {
+        uint32_t length;
+        if (!get(data, size, pos, length) || size - pos < length) return false;
+        value.assign(data + pos, length);
+        pos += length;
+        return true;
+    }
+};
+
+// Writes a recording. The relay appends frames from one thread; output is
+// read from the pty straight into the chunk being built, consecutive
+// output within COALESCE_US shares a frame, and full chunks go to a
+// writer thread that compresses and appends them. If the writer falls
+// MAX_QUEUED chunks behind, the relay waits rather than drop output.
+// Until open() (or after close()) frames are dropped, and read_frame()
+// still reads into the chunk buffer.
+class SessionRecorder : public SessionRecording {
+public:
+    static const size_t CHUNK_BYTES = 256 << 10;
+    static const size_t MAX_READ = 64 << 10;
+    static const size_t MAX_QUEUED = 16;
+    static const uint64_t COALESCE_US = 10000;
+    static const uint64_t FLUSH_US = 2000000;   // A chunk older than this is written out by tick()
+
+    ~SessionRecorder() {
+        close(0);
+    }
+
+    // Creates the file (mode 0600, failing if it exists) and writes the header.
+    bool open(const std::string& file_path, uint16_t columns, uint16_t rows, RecordingCodec::Kind codec_kind = RecordingCodec::preferred()) {
+        fd = ::open(file_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        if (fd == -1) return false;
+        path = file_path;
+        codec = codec_kind;
+        start_us = monotonic_us();
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        struct passwd* pw = getpwuid(getuid());
+
+        std::string header(MAGIC, 8);
+        put(header, VERSION);
+        put(header, static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec);
+        put(header, columns);
+        put(header, rows);
+        put_string(header, pw ? pw->pw_name : std::to_string(getuid()));
+        if (!BoxRenderer::write_all(fd, header)) {
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+        offset = header.size();
+        return true;
+    }
+
+    // In a forked child that must not touch the parent's recording
+    void detach() {
+        if (fd != -1) ::close(fd);
+        fd = -1;
+    }
+
+    bool is_open() const { return fd != -1; }
+
+    // Reads up to MAX_READ bytes from source into an Output (or Input)
+    // frame. Returns read()'s result; data points at the bytes read.
+    ssize_t read_frame(FrameType type, int source, const char*& data) {
+        if (fd == -1) {
+            data = building(0).data.get();
+            return read(source, const_cast<char*>(data), MAX_READ);
+        }
+        uint64_t now = elapsed_us();
+        bool extend = open_frame != SIZE_MAX && open_type == type && now - open_us < COALESCE_US;
+        if (!extend && current && current->size + FRAME_HEADER + MAX_READ > current->capacity) seal();
+        Chunk& chunk = building(now);
+        size_t at = chunk.size + (extend ? 0 : FRAME_HEADER);
+        ssize_t n = read(source, chunk.data.get() + at, MAX_READ);
+        if (n <= 0) return n;
+        data = chunk.data.get() + at;
+        if (extend) {
+            uint32_t length;
+            memcpy(&length, chunk.data.get() + open_frame + 9, sizeof(length));
+            length += static_cast<uint32_t>(n);
+            memcpy(chunk.data.get() + open_frame + 9, &length, sizeof(length));
+        } else {
+            write_header(chunk.data.get() + chunk.size, type, now, static_cast<uint32_t>(n));
+            open_frame = chunk.size;
+            open_type = type;
+            open_us = now;
+        }
+        chunk.size = at + n;
+        if (chunk.size >= CHUNK_BYTES) seal();
+        return n;
+    }
+
+    void frame(FrameType type, const char* data, size_t size) {
+        frame_at(type, data, size, elapsed_us());
+    }
+
+    void hidden_input(uint32_t count) { frame(HiddenInput, reinterpret_cast<const char*>(&count), sizeof(count)); }
+
+    void resize(uint16_t columns, uint16_t rows) {
+        uint16_t size[2] = {columns, rows};
+        frame(Resize, reinterpret_cast<const char*>(size), sizeof(size));
+    }
+
+    // Starts a chunk with the command, so seeking to it decodes from there
+    void command(const std::string& text) {
+        if (fd == -1) return;
+        seal();
+        uint64_t now = elapsed_us();
+        commands.push_back({now, static_cast<uint32_t>(chunks_sealed), text});
+        frame_at(Command, text.data(), text.size(), now);
+    }
+
+    // Hands an idle chunk to the writer so a crash loses at most FLUSH_US
+    void tick() {
+        if (current && current->size && elapsed_us() - current->first_us >= FLUSH_US) seal();
+    }
+
+    // Records the exit status, writes the rest and the index, and closes.
+    bool close(int status) {
+        if (fd == -1) return true;
+        frame(Exit, reinterpret_cast<const char*>(&status), sizeof(status));
+        seal();
+        stop_writer();
+
+        std::string index;
+        put(index, static_cast<uint32_t>(chunk_index.size()));
+        for (const auto& entry : chunk_index) {
+            put(index, entry.first);
+            put(index, entry.second);
+        }
+        put(index, static_cast<uint32_t>(commands.size()));
+        for (const auto& entry : commands) {
+            put(index, entry.us);
+            put(index, entry.chunk);
+            put_string(index, entry.text);
+        }
+        put(index, elapsed_us());
+        put(index, static_cast<int32_t>(status));
+        put(index, offset);
+        index.append(TRAILER_MAGIC, 8);
+        bool ok = !failed && BoxRenderer::write_all(fd, index) && fsync(fd) == 0;
+        ::close(fd);
+        fd = -1;
+        return ok;
+    }
+
+    uint64_t raw_bytes() const { return raw_total; }
+    uint64_t file_bytes() const { return offset; }
+    uint64_t producer_stalls() const { return stalls; }
+    const std::string& file() const { return path; }
+
+    static uint64_t monotonic_us() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+    }
+
+private:
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t size = 0;
+        size_t capacity = 0;
+        uint64_t first_us = 0;
+    };
+    struct CommandEntry {
+        uint64_t us;
+        uint32_t chunk;
+        std::string text;
+    };
+
+    int fd = -1;
+    std::string path;
+    RecordingCodec::Kind codec = RecordingCodec::Lz4;
+    uint64_t start_us = 0;
+    uint64_t offset = 0;                  // File size; the writer's after start
+    std::unique_ptr<Chunk> current;
+    size_t open_frame = SIZE_MAX;         // Offset of the frame read_frame() may extend
+    FrameType open_type = Output;
+    uint64_t open_us = 0;
+    size_t chunks_sealed = 0;
+    uint64_t raw_total = 0;
+    uint64_t stalls = 0;
+    std::vector<CommandEntry> commands;
+    std::vector<std::pair<uint64_t, uint64_t>> chunk_index;   // Offset, first us; the writer's
+
+    // Shared with the writer thread
+    std::mutex mutex;
+    std::condition_variable ready, drained;
+    std::deque<std::unique_ptr<Chunk>> queue;
+    std::vector<std::unique_ptr<Chunk>> spare;
+    bool stopping = false;
+    bool failed = false;
+    std::thread writer;
+
+    uint64_t elapsed_us() const { return monotonic_us() - start_us; }
+
+    void frame_at(FrameType type, const char* data, size_t size, uint64_t now) {
+        if (fd == -1) return;
+        if (current && current->size + FRAME_HEADER + size > current->capacity) seal();
+        Chunk& chunk = building(now, FRAME_HEADER + size);
+        write_header(chunk.data.get() + chunk.size, type, now, static_cast<uint32_t>(size));
+        if (size) memcpy(chunk.data.get() + chunk.size + FRAME_HEADER, data, size);
+        chunk.size += FRAME_HEADER + size;
+        open_frame = SIZE_MAX;
+        if (chunk.size >= CHUNK_BYTES) seal();
+    }
+
+    static void write_header(char* at, FrameType type, uint64_t us, uint32_t length) {
+        at[0] = static_cast<char>(type);
+        memcpy(at + 1, &us, sizeof(us));
+        memcpy(at + 9, &length, sizeof(length));
+    }
+
+    Chunk& building(uint64_t now, size_t need = 0) {
+        if (!current) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!spare.empty()) {
+                current = std::move(spare.back());
+                spare.pop_back();
+            } else {
+                current.reset(new Chunk);
+            }
+        }
+        size_t capacity = std::max(CHUNK_BYTES + FRAME_HEADER + MAX_READ, need);
+        if (current->capacity < capacity) {
+            current->data.reset(new char[capacity]);
+            current->capacity = capacity;
+        }
+        if (current->size == 0) current->first_us = now;
+        return *current;
+    }
+
+    void seal() {
+        open_frame = SIZE_MAX;
+        if (!current || current->size == 0) return;
+        if (!writer.joinable()) start_writer();
+        raw_total += current->size;
+        ++chunks_sealed;
+        std::unique_lock<std::mutex> lock(mutex);
+        if (queue.size() >= MAX_QUEUED) {
+            ++stalls;
+            drained.wait(lock, [this] { return queue.size() < MAX_QUEUED; });
+        }
+        queue.push_back(std::move(current));
+        ready.notify_one();
+    }
+
+    void start_writer() {
+        writer = start_helper_thread([this] { write_loop(); });
+    }
+
+    void stop_writer() {
+        if (!writer.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        ready.notify_one();
+        writer.join();
+        stopping = false;
+    }
+
+    void write_loop() {
+        std::string stored, block;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            ready.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) return;
+            std::unique_ptr<Chunk> chunk = std::move(queue.front());
+            queue.pop_front();
+            drained.notify_one();
+            lock.unlock();
+
+            RecordingCodec::Kind used = RecordingCodec::compress(codec, chunk->data.get(), chunk->size, stored);
+            block.clear();
+            put(block, CHUNK_MAGIC);
+            put(block, static_cast<uint8_t>(used));
+            put(block, static_cast<uint32_t>(chunk->size));
+            put(block, static_cast<uint32_t>(stored.size()));
+            put(block, chunk->first_us);
+            block += stored;
+            bool ok = BoxRenderer::write_all(fd, block);
+            chunk_index.push_back({offset, chunk->first_us});
+            offset += block.size();
+            chunk->size = 0;
+
+            lock.lock();
+            failed = failed || !ok;
+            spare.push_back(std::move(chunk));
+        }
+    }
+};
+
+// Reads a recording: the index (rebuilt by walking the chunks when the
+// recording was cut short) and chunks decoded on demand.
+class RecordingReader : public SessionRecording {
+public:
+    struct Frame {
+        FrameType type;
+        uint64_t us;
+        std::string_view data;   // Valid until the next read_chunk()
+    };
+    struct CommandEntry {
+        uint64_t us;
+        uint32_t chunk;
+        std::string text;
+    };
+
+    ~RecordingReader() {
+        if (fd != -1) ::close(fd);
+    }
+
+    bool open(const std::string& file_path, std::string& error) {
+        fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (fd == -1 || fstat(fd, &st) != 0) {
+            error = file_path + ": " + strerror(errno);
+            return false;
+        }
+        size = st.st_size;
+        std::string head = read_at(0, 4096);
+        size_t pos = 8;
+        uint32_t version;
+        if (head.size() < 8 || head.compare(0, 8, MAGIC) != 0 || !get(head.data(), head.size(), pos, version) ||
+            !get(head.data(), head.size(), pos, start_ns) || !get(head.data(), head.size(), pos, columns) ||
+            !get(head.data(), head.size(), pos, rows) || !get_string(head.data(), head.size(), pos, user)) {
+            error = file_path + ": not a SecShell recording";
+            return false;
+        }
+        if (version != VERSION) {
+            error = file_path + ": unsupported recording version " + std::to_string(version);
+            return false;
+        }
+        data_start = pos;
+        if (!read_index()) rebuild_index();
+        return true;
+    }
+
+    int64_t started_ns() const { return start_ns; }
+    uint16_t initial_columns() const { return columns; }
+    uint16_t initial_rows() const { return rows; }
+    const std::string& recorded_by() const { return user; }
+    bool complete() const { return indexed; }          // Closed normally, with an index
+    uint64_t duration_us() const { return duration; }
+    int exit_status() const { return status; }
+    size_t chunk_count() const { return chunks.size(); }
+    uint64_t chunk_start_us(size_t chunk) const { return chunks[chunk].second; }
+    const std::vector<CommandEntry>& commands() const { return command_list; }
+
+    // The last chunk starting at or before us
+    size_t chunk_at(uint64_t us) const {
+        auto it = std::upper_bound(chunks.begin(), chunks.end(), us,
+                                   [](uint64_t value, const std::pair<uint64_t, uint64_t>& chunk) { return value < chunk.second; });
+        return it == chunks.begin() ? 0 : static_cast<size_t>(it - chunks.begin()) - 1;
+    }
+
+    bool read_chunk(size_t chunk, std::vector<Frame>& frames, std::string& error) {
+        frames.clear();
+        uint8_t kind;
+        uint32_t raw_size, stored_size;
+        if (!read_chunk_header(chunks[chunk].first, kind, raw_size, stored_size)) {
+            error = "chunk " + std::to_string(chunk) + ": truncated";
+            return false;
+        }
+        if (!RecordingCodec::available(RecordingCodec::Kind(kind))) {
+            error = "chunk " + std::to_string(chunk) + ": compressed with " + RecordingCodec::name(RecordingCodec::Kind(kind)) +
+                    ", which this build lacks";
+            return false;
+        }
+        std::string stored = read_at(chunks[chunk].first + CHUNK_HEADER, stored_size);
+        if (stored.size() != stored_size ||
+            !RecordingCodec::decompress(RecordingCodec::Kind(kind), stored.data(), stored.size(), raw_size, raw)) {
+            error = "chunk " + std::to_string(chunk) + ": corrupt";
+            return false;
+        }
+        size_t pos = 0;
+        while (pos < raw.size()) {
+            uint8_t type;
+            uint64_t us;
+            uint32_t length;
+            if (!get(raw.data(), raw.size(), pos, type) || !get(raw.data(), raw.size(), pos, us) ||
+                !get(raw.data(), raw.size(), pos, length) || raw.size() - pos < length) {
+                error = "chunk " + std::to_string(chunk) + ": corrupt frame";
+                return false;
+            }
+            frames.push_back({FrameType(type), us, std::string_view(raw.data() + pos, length)});
+            pos += length;
+        }
+        return true;
+    }
+
+private:
+    int fd = -1;
+    uint64_t size = 0;
+    uint64_t data_start = 0;
+    int64_t start_ns = 0;
+    uint16_t columns = 0, rows = 0;
+    std::string user;
+    bool indexed = false;
+    uint64_t duration = 0;
+    int status = 0;
+    std::vector<std::pair<uint64_t, uint64_t>> chunks;   // Offset, first us
+    std::vector<CommandEntry> command_list;
+    std::string raw;
+
+    std::string read_at(uint64_t at, size_t length) const {
+        std::string out(length, '\0');
+        size_t got = 0;
+        while (got < length) {
+            ssize_t n = pread(fd, &out[got], length - got, at + got);
+            if (n <= 0) break;
+            got += n;
+        }
+        out.resize(got);
+        return out;
+    }
+
+    bool read_chunk_header(uint64_t at, uint8_t& kind, uint32_t& raw_size, uint32_t& stored_size) const {
+        std::string header = read_at(at, CHUNK_HEADER);
+        size_t pos = 0;
+        uint32_t magic;
+        return get(header.data(), header.size(), pos, magic) && magic == CHUNK_MAGIC &&
+               get(header.data(), header.size(), pos, kind) && get(header.data(), header.size(), pos, raw_size) &&
+               get(header.data(), header.size(), pos, stored_size) && size - at - CHUNK_HEADER >= stored_size;
+    }
+
+    bool read_index() {
+        if (size < data_start + 16) return false;
+        std::string trailer = read_at(size - 16, 16);
+        uint64_t index_at;
+        size_t pos = 0;
+        if (trailer.compare(8, 8, TRAILER_MAGIC) != 0 || !get(trailer.data(), trailer.size(), pos, index_at) ||
+            index_at < data_start || index_at > size - 16) {
+            return false;
+        }
+        std::string index = read_at(index_at, size - 16 - index_at);
+        const char* p = index.data();
+        pos = 0;
+        uint32_t count;
+        if (!get(p, index.size(), pos, count)) return false;
+        for (uint32_t i = 0; i < count; ++i) {
+            std::pair<uint64_t, uint64_t> chunk;
+            if (!get(p, index.size(), pos, chunk.first) || !get(p, index.size(), pos, chunk.second)) return false;
+            chunks.push_back(chunk);
+        }
+        if (!get(p, index.size(), pos, count)) return false;
+        for (uint32_t i = 0; i < count; ++i) {
+            CommandEntry entry;
+            if (!get(p, index.size(), pos, entry.us) || !get(p, index.size(), pos, entry.chunk) ||
+                !get_string(p, index.size(), pos, entry.text) || entry.chunk >= chunks.size()) {
+                return false;
+            }
+            command_list.push_back(std::move(entry));
+        }
+        int32_t exit_status;
+        if (!get(p, index.size(), pos, duration) || !get(p, index.size(), pos, exit_status)) return false;
+        status = exit_status;
+        indexed = true;
+        return true;
+    }
+
+    // Walks the chunk headers of a recording without an index, decoding
+    // each to find its commands. Stops at the first damaged chunk.
+    void rebuild_index() {
+        chunks.clear();
+        command_list.clear();
+        uint64_t at = data_start;
+        std::vector<Frame> frames;
+        std::string error;
+        uint8_t kind;
+        uint32_t raw_size, stored_size;
+        while (at + CHUNK_HEADER <= size && read_chunk_header(at, kind, raw_size, stored_size)) {
+            uint64_t first_us;
+            std::string header = read_at(at + CHUNK_HEADER - 8, 8);
+            memcpy(&first_us, header.data(), 8);
+            chunks.push_back({at, first_us});
+            if (!read_chunk(chunks.size() - 1, frames, error)) {
+                chunks.pop_back();
+                break;
+            }
+            for (const Frame& frame : frames) {
+                if (frame.type == Command) {
+                    command_list.push_back({frame.us, static_cast<uint32_t>(chunks.size() - 1), std::string(frame.data)});
+                } else if (frame.type == Exit && frame.data.size() == sizeof(int32_t)) {
+                    memcpy(&status, frame.data.data(), sizeof(int32_t));
+                }
+                duration = frame.us;
+            }
+            at += CHUNK_HEADER + stored_size;
+        }
+    }
+};
+
+// Plays a recording's output in real time, scaled by speed (0 plays it
+// without pauses), with pauses longer than idle_limit_us cut short.
+// Playback from a later point decodes from the chunk that holds it;
+// output before that point is not reproduced.
+class RecordingPlayer {
+public:
+    double speed = 1.0;
+    uint64_t idle_limit_us = 2000000;    // 0 keeps every pause
+    int output_fd = STDOUT_FILENO;
+
+    bool play(RecordingReader& reader, uint64_t start_us, std::string& error) {
+        std::vector<RecordingReader::Frame> frames;
+        uint64_t previous_us = start_us;
+        uint64_t playback_us = 0;        // Recorded time since start_us, pauses cut
+        uint64_t started = SessionRecorder::monotonic_us();
+        for (size_t chunk = reader.chunk_at(start_us); chunk < reader.chunk_count(); ++chunk) {
+            if (!reader.read_chunk(chunk, frames, error)) return false;
+            for (const auto& frame : frames) {
+                if (frame.type != SessionRecording::Output || frame.us < start_us) continue;
+                uint64_t pause = frame.us - std::min(frame.us, previous_us);
+                playback_us += idle_limit_us ? std::min(pause, idle_limit_us) : pause;
+                previous_us = frame.us;
+                if (speed > 0) {
+                    uint64_t due = started + static_cast<uint64_t>(playback_us / speed);
+                    uint64_t now = SessionRecorder::monotonic_us();
+                    if (due > now) usleep(static_cast<useconds_t>(std::min<uint64_t>(due - now, 10000000)));
+                }
+                if (!BoxRenderer::write_all(output_fd, std::string(frame.data))) {
+                    error = strerror(errno);
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+};
+
+#endif
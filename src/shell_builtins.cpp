@@ -0,0 +1,957 @@
+// Builtin commands other than the job and history ones, and the alert
+// and error output they share.
+#include "secshell.h"
+
+std::string SecShell::repeat_string(const std::string& str, int n) {
+    std::string result;
+    for (int i = 0; i < n; ++i) {
+        result += str;
+    }
+    return result;
+}
+
+void SecShell::parallel_command(const std::vector<std::string>& args) {
+    const std::string usage = "Usage: parallel [-j N] [-k] <command> [{}] [::: arg ...]";
+    size_t workers = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+    bool keep_order = false;
+    size_t i = 1;
+    for (; i < args.size() && args[i].size() > 1 && args[i][0] == '-'; ++i) {
+        if (args[i] == "-k") {
+            keep_order = true;
+        } else if (args[i].compare(0, 2, "-j") == 0) {
+            std::string count = args[i].size() > 2 ? args[i].substr(2) : (i + 1 < args.size() ? args[++i] : "");
+            char* end = nullptr;
+            long n = strtol(count.c_str(), &end, 10);
+            if (count.empty() || *end != '\0' || n < 1) {
+                print_error(usage);
+                last_status = 2;
+                return;
+            }
+            workers = n;
+        } else {
+            print_error(usage);
+            last_status = 2;
+            return;
+        }
+    }
+
+    auto separator = std::find(args.begin() + i, args.end(), ":::");
+    std::vector<std::string> command(args.begin() + i, separator);
+    std::vector<std::string> inputs;
+    if (separator != args.end()) {
+        inputs.assign(separator + 1, args.end());
+    } else {
+        std::string input;
+        char buffer[65536];
+        ssize_t n;
+        while ((n = read(STDIN_FILENO, buffer, sizeof(buffer))) > 0 || (n == -1 && errno == EINTR)) {
+            if (n > 0) input.append(buffer, n);
+        }
+        size_t pos = 0;
+        while (pos < input.size()) {
+            size_t eol = std::min(input.find('\n', pos), input.size());
+            if (eol > pos) inputs.push_back(input.substr(pos, eol - pos));
+            pos = eol + 1;
+        }
+    }
+    if (command.empty() || inputs.empty()) {
+        print_error(usage);
+        last_status = 2;
+        return;
+    }
+
+    // Expand and check every instance on this thread: the policy objects
+    // and the audit log are not shared with the workers.
+    bool has_placeholder = std::any_of(command.begin(), command.end(),
+        [](const std::string& word) { return word.find("{}") != std::string::npos; });
+    std::vector<ParallelTask> tasks(inputs.size());
+    for (size_t t = 0; t < inputs.size(); ++t) {
+        ParallelTask& task = tasks[t];
+        for (const auto& word : command) {
+            std::string expanded = word;
+            for (size_t at = expanded.find("{}"); at != std::string::npos; at = expanded.find("{}", at + inputs[t].size())) {
+                expanded.replace(at, 2, inputs[t]);
+            }
+            task.args.push_back(std::move(expanded));
+        }
+        if (!has_placeholder) task.args.push_back(inputs[t]);
+
+        const std::string& name = task.args[0];
+        if (policy.blacklisted(name)) {
+            record_decision(AuditLog::Blacklisted, task.args);
+            task.output = "Command is blacklisted: " + name + "\n";
+            task.status = 126;
+        } else if (const PolicyRules::Rule* rule = policy.denied_by(task.args, {}, working_directory)) {
+            record_decision(AuditLog::Denied, task.args);
+            task.output = "Command denied by policy rule (line " + std::to_string(rule->line) + "): " + rule->text + "\n";
+            task.status = 126;
+        } else if (is_builtin(name)) {
+            record_decision(AuditLog::NotPermitted, task.args);
+            task.output = "parallel runs external commands only: " + name + "\n";
+            task.status = 126;
+        } else if (!policy.allows(name, &task.exec_path)) {
+            record_decision(AuditLog::NotPermitted, task.args);
+            task.output = "Command not permitted: " + name + "\n";
+            task.status = 126;
+        } else if (use_sandbox && !sandbox.ready()) {
+            record_decision(AuditLog::NotPermitted, task.args);
+            task.exec_path.clear();
+            task.output = "Sandbox unavailable, not running: " + name + "\n";
+            task.status = 126;
+        } else {
+            record_decision(AuditLog::Allowed, task.args);
+            add_color_flags(task.args);
+        }
+    }
+
+    std::cout.flush();
+    std::mutex output_lock;
+    std::vector<bool> done(tasks.size(), false);
+    size_t next_to_print = 0;
+    auto emit = [&](size_t t) {
+        std::lock_guard<std::mutex> guard(output_lock);
+        if (!keep_order) {
+            BoxRenderer::write_all(STDOUT_FILENO, tasks[t].output);
+            return;
+        }
+        done[t] = true;
+        for (; next_to_print < tasks.size() && done[next_to_print]; ++next_to_print) {
+            BoxRenderer::write_all(STDOUT_FILENO, tasks[next_to_print].output);
+        }
+    };
+
+    char* const* envp = variables.envp();
+    uint64_t start = AuditLog::monotonic_us();
+    WorkStealingPool pool(std::min(workers, tasks.size()));
+    pool.run(tasks.size(), [&](size_t t) {
+        if (!tasks[t].exec_path.empty()) run_parallel_task(tasks[t], envp, use_sandbox ? &sandbox : nullptr, metrics);
+        emit(t);
+    });
+    uint64_t wall = AuditLog::monotonic_us() - start;
+
+    // Summary: counts, wall time, then one line per failed instance
+    size_t failures = 0;
+    uint64_t busiest = 0, total = 0;
+    std::string report;
+    for (const auto& task : tasks) {
+        if (task.pid > 0) {
+            audit.execution(task.pid, task.status, task.usage.wall_us, task.usage.user_us + task.usage.sys_us, task.args);
+        }
+        total += task.usage.wall_us;
+        busiest = std::max(busiest, task.usage.wall_us);
+        if (task.status == 0) continue;
+        ++failures;
+        std::string line = "  status " + std::to_string(task.status) + "  " + ResourceUsage::seconds(task.usage.wall_us) + " ";
+        for (const auto& arg : task.args) line += " " + arg;
+        report += line + "\n";
+    }
+    report = "parallel: " + std::to_string(tasks.size()) + " tasks on " + std::to_string(std::min(workers, tasks.size())) +
+             " workers, " + std::to_string(tasks.size() - failures) + " succeeded, " + std::to_string(failures) +
+             " failed in " + ResourceUsage::seconds(wall) + " (task avg " + ResourceUsage::seconds(total / tasks.size()) +
+             ", max " + ResourceUsage::seconds(busiest) + ", " + std::to_string(pool.steal_count()) + " steals)\n" + report;
+    BoxRenderer::write_all(STDERR_FILENO, report);
+    last_status = failures ? 1 : 0;
+}
+
+void SecShell::run_parallel_task(ParallelTask& task, char* const* envp, const Sandbox* sandbox, Metrics& metrics) {
+    int pipe_fds[2];
+    int null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (pipe2(pipe_fds, O_CLOEXEC) == -1) {
+        if (null_fd != -1) close(null_fd);
+        task.output = std::string("Failed to create pipe: ") + strerror(errno) + "\n";
+        task.status = 127;
+        return;
+    }
+
+    Spawner spawner;
+    spawner.isolate(sandbox);
+    if (null_fd != -1) spawner.redirect(null_fd, STDIN_FILENO);
+    spawner.redirect(pipe_fds[1], STDOUT_FILENO);
+    spawner.redirect(pipe_fds[1], STDERR_FILENO);
+    uint64_t start = AuditLog::monotonic_us();
+    int err = spawner.spawn(task.exec_path, task.args, task.pid, envp);
+    close(pipe_fds[1]);
+    if (null_fd != -1) close(null_fd);
+    if (err != 0) {
+        metrics.command(Metrics::ExecFailure);
+        close(pipe_fds[0]);
+        task.pid = -1;
+        task.output = "Command execution failed: " + std::string(strerror(err)) + "\n";
+        task.status = 127;
+        return;
+    }
+
+    metrics.spawn_us.record(AuditLog::monotonic_us() - start);
+    metrics.execution(Metrics::External);
+
+    char buffer[16384];
+    ssize_t n;
+    while ((n = read(pipe_fds[0], buffer, sizeof(buffer))) > 0 || (n == -1 && errno == EINTR)) {
+        if (n > 0) task.output.append(buffer, n);
+    }
+    close(pipe_fds[0]);
+
+    int status;
+    struct rusage usage;
+    while (wait4(task.pid, &status, 0, &usage) == -1) {
+        if (errno != EINTR) {
+            task.status = 127;
+            return;
+        }
+    }
+    task.status = exit_status(status);
+    task.usage.wall_us = AuditLog::monotonic_us() - start;
+    task.usage.add(usage);
+}
+
+void SecShell::change_directory(const std::vector<std::string>& args) {
+    std::string dir;
+
+    if (args.size() < 2) {
+        // If no directory is provided, default to the home directory
+        const char* home = getenv("HOME");
+        if (!home) {
+            print_error("cd failed: HOME environment variable not set");
+            last_status = 1;
+            return;
+        }
+        dir = home;
+    } else {
+        dir = args[1];
+    }
+
+    if (chdir(dir.c_str()) != 0) {
+        print_error("cd failed: " + std::string(strerror(errno)));
+        last_status = 1;
+        return;
+    }
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, sizeof(cwd))) {
+        working_directory = cwd;
+        if (audit.enabled()) audit.set_cwd(cwd);
+    }
+    refresh_prompt_context();
+}
+
+bool SecShell::capture_output(const std::string& path, const std::vector<std::string>& args, std::string& output, char* const* envp) {
+    int pipe_fds[2];
+    if (pipe2(pipe_fds, O_CLOEXEC) == -1) return false;
+    int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+
+    Spawner spawner;
+    spawner.redirect(pipe_fds[1], STDOUT_FILENO);
+    if (null_fd != -1) spawner.redirect(null_fd, STDERR_FILENO);
+    pid_t pid;
+    int err = spawner.spawn(path, args, pid, envp);
+    close(pipe_fds[1]);
+    if (null_fd != -1) close(null_fd);
+    if (err != 0) {
+        close(pipe_fds[0]);
+        return false;
+    }
+
+    char buffer[65536];
+    ssize_t n;
+    while ((n = read(pipe_fds[0], buffer, sizeof(buffer))) > 0 || (n == -1 && errno == EINTR)) {
+        if (n > 0) output.append(buffer, n);
+    }
+    close(pipe_fds[0]);
+    int status;
+    while (waitpid(pid, &status, 0) == -1 && errno == EINTR) {}
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+void SecShell::export_variable(const std::vector<std::string>& args) {
+	if (args.size() < 2) {
+		print_error("Usage: export VAR=value | export VAR");
+		last_status = 1;
+		return;
+	}
+
+	for (size_t i = 1; i < args.size(); ++i) {
+		std::string var = args[i];
+		std::string value;
+		size_t equals_pos = var.find('=');
+		bool assign = equals_pos != std::string::npos;
+		if (assign) {
+			value = var.substr(equals_pos + 1);
+			var = var.substr(0, equals_pos);
+		}
+		if (!VariableStore::valid_name(var)) {
+			print_error("Invalid export syntax. Use VAR=value");
+			last_status = 1;
+			continue;
+		}
+		if (!assign && !variables.get(var)) {
+			print_error("export: " + var + " is not set");
+			last_status = 1;
+			continue;
+		}
+		if (!(assign ? variables.set(var, value, true) : variables.export_name(var))) {
+			print_error("Not exported: " + var + " is not in SECSHELL_ENV_ALLOW" + (assign ? "; set as a shell variable" : ""));
+			last_status = 1;
+			continue;
+		}
+		print_alert("Exported: " + var + "=" + variables.get(var));
+	}
+	refresh_prompt_context();
+}
+
+void SecShell::list_env_variables(const std::vector<std::string>& args) {
+	bool all = args.size() > 1 && args[1] == "-a";
+	if (args.size() > 1 && !all) {
+		print_error("Usage: env [-a]");
+		last_status = 2;
+		return;
+	}
+	if (!draw_box(" Environment Variable ", "bold_white")) {
+        print_error("Failed to draw title box.");
+        return;
+    }
+	if (!all) {
+		for (char* const* env = variables.envp(); *env; env++) {
+			std::cout << *env << "\n";
+		}
+		return;
+	}
+	std::vector<std::pair<std::string, const VariableStore::Variable*>> sorted;
+	for (const auto& variable : variables.all()) sorted.emplace_back(variable.first, &variable.second);
+	std::sort(sorted.begin(), sorted.end(),
+	          [](const std::pair<std::string, const VariableStore::Variable*>& a,
+	             const std::pair<std::string, const VariableStore::Variable*>& b) { return a.first < b.first; });
+	for (const auto& variable : sorted) {
+		std::cout << variable.first << "=" << variable.second->value << (variable.second->exported ? "" : "  (not exported)") << "\n";
+	}
+}
+
+void SecShell::unset_env_variable(const std::vector<std::string>& args) {
+	if (args.size() < 2) {
+		print_error("Usage: unset VAR");
+		last_status = 1;
+		return;
+	}
+	for (size_t i = 1; i < args.size(); ++i) {
+		variables.unset(args[i]);
+		print_alert("Unset: " + args[i]);
+	}
+	refresh_prompt_context();
+}
+
+void SecShell::reload_blacklist() {
+    	load_blacklist(BLACKLIST); // Reload the blacklist from the file
+    	load_rules();
+    	print_alert("Blacklist and rules reloaded.");
+	}
+
+void SecShell::edit_blacklist() {
+
+ 	std::string command = "nano " + BLACKLIST;
+	system(command.c_str());
+	return;
+
+}
+
+void SecShell::list_blacklist_commands() {
+     if (!draw_box(" Blacklisted Commands ", "bold_white")) {
+            print_error("Failed to draw title box.");
+            return;
+    }
+    // Print the policy currently in force
+    int line_number = 0;
+    for (const auto& command : policy.blacklist().snapshot().commands()) {
+	line_number += 1;
+        std::cout << " " << line_number << ". " << command << "\n";
+    }
+}
+
+bool SecShell::is_builtin(const std::string& name) const {
+	return std::find(BUILTIN_COMMANDS.begin(), BUILTIN_COMMANDS.end(), name) != BUILTIN_COMMANDS.end();
+}
+
+bool SecShell::run_builtin(const std::vector<std::string>& args) {
+	if (args[0] == "services") {
+		manage_services(args);
+	} else if (args[0] == "drawbox") {
+		drawbox_command(args);
+	} else if (args[0] == "jobs") {
+		list_jobs(args);
+	} else if (args[0] == "output") {
+		show_output(args);
+	} else if (args[0] == "follow") {
+		follow_output(args);
+	} else if (args[0] == "parallel") {
+		parallel_command(args);
+	} else if (args[0] == "stats") {
+		show_stats(args);
+	} else if (args[0] == "rules") {
+		show_rules(args);
+	} else if (args[0] == "sandbox") {
+		show_sandbox(args);
+	} else if (args[0] == "time") {
+		print_error("time must start the command line: time <command> [| command ...]");
+		last_status = 2;
+	} else if (args[0] == "help") {
+		display_help();
+	} else if (args[0] == "cd") {
+		change_directory(args);
+	} else if (args[0] == "history") {
+		display_history(args);
+	} else if (args[0] == "export") {
+		export_variable(args);
+	} else if (args[0] == "env") {
+		list_env_variables(args);
+	} else if (args[0] == "unset") {
+		unset_env_variable(args);
+	} else if (args[0] == "reload") {
+		reload_blacklist();
+	} else if (args[0] == "rehash") {
+		rehash();
+	} else if (args[0] == "blacklist") {
+		list_blacklist_commands();
+	} else if (args[0] == "edit-blacklist") {
+		edit_blacklist();
+	} else if (args[0] == "exit") {
+		running = false;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+void SecShell::manage_services(const std::vector<std::string>& args) {
+    if (args.size() < 2) {
+        print_error("Usage: services <start|stop|restart|status|list> [service|pattern ...]");
+        last_status = 2;
+        return;
+    }
+
+    std::string action = args[1];
+    if (action != "start" && action != "stop" && action != "restart" && action != "status" && action != "list") {
+        print_error("Invalid action. Use start, stop, restart, status, or list.");
+        last_status = 2;
+        return;
+    }
+
+    std::string systemctl = systemctl_path();
+    if (systemctl.empty()) {
+        print_error("systemctl not found in the allowed directories; set SECSHELL_SYSTEMCTL.");
+        last_status = 1;
+        return;
+    }
+
+    std::vector<std::string> units;
+    if (action != "list") {
+        if (!expand_service_targets(std::vector<std::string>(args.begin() + 2, args.end()), units)) return;
+        if (units.empty()) {
+            print_error("Usage: services " + action + " <service|pattern> ...");
+            last_status = 2;
+            return;
+        }
+    }
+
+    // Mutating actions go through sudo unless we are root. Credentials are
+    // validated once up front so the parallel children never prompt.
+    bool mutating = action != "status" && action != "list";
+    std::vector<std::string> prefix;
+    if (mutating && geteuid() != 0) {
+        const std::string* sudo = policy.executables().lookup("sudo");
+        if (!sudo) {
+            print_error("sudo is required to " + action + " services.");
+            last_status = 1;
+            return;
+        }
+        pid_t pid;
+        int status;
+        Spawner spawner;
+        if (spawner.spawn(*sudo, {"sudo", "-v"}, pid, variables.envp()) != 0 || waitpid(pid, &status, 0) != pid || exit_status(status) != 0) {
+            print_error("sudo authentication failed.");
+            last_status = 1;
+            return;
+        }
+        prefix = {*sudo, "sudo", "-n"};
+    }
+
+    std::vector<ServiceTask> tasks;
+    if (action == "list") {
+        tasks.emplace_back("", std::vector<std::string>{"systemctl", "list-units", "--type=service", "--no-pager"});
+    } else {
+        for (const auto& unit : units) {
+            ServiceTask task(unit, {"systemctl", action});
+            if (action == "status") task.args.push_back("--no-pager");
+            task.args.push_back("--");  // A unit is never read as an option
+            task.args.push_back(unit);
+            tasks.push_back(std::move(task));
+        }
+    }
+    std::string program = systemctl;
+    if (!prefix.empty()) {
+        program = prefix[0];
+        for (auto& task : tasks) {
+            task.args[0] = systemctl;
+            task.args.insert(task.args.begin(), prefix.begin() + 1, prefix.end());
+        }
+    }
+
+    time_t now = time(nullptr);
+    if (!mutating) {
+        for (auto& task : tasks) {
+            auto it = service_cache.find(action + '\0' + task.unit);
+            if (it != service_cache.end() && now - it->second.at < SERVICE_CACHE_TTL) {
+                task.status = it->second.status;
+                task.output = it->second.output;
+                task.cached = true;
+            }
+        }
+    }
+
+    run_service_tasks(program, tasks);
+
+    for (const auto& task : tasks) {
+        if (!mutating && !task.cached) {
+            service_cache[action + '\0' + task.unit] = {now, task.status, task.output};
+        } else if (mutating) {
+            service_cache.erase("status" + std::string(1, '\0') + task.unit);
+            service_cache.erase("list" + std::string(1, '\0'));
+        }
+    }
+
+    if (!draw_box(" Service Manager ", "bold_white")) {
+        print_error("Failed to draw title box.");
+        return;
+    }
+    std::cout.flush();
+    BufferedWriter out(STDOUT_FILENO);
+    if (action == "list" || tasks.size() == 1) {
+        out << tasks[0].output;
+        if (!tasks[0].output.empty() && tasks[0].output.back() != '\n') out << "\n";
+    }
+    if (action != "list") print_service_table(out, action, tasks);
+    out.flush();
+
+    bool failed = std::any_of(tasks.begin(), tasks.end(), [](const ServiceTask& task) { return task.status != 0; });
+    if (failed) {
+        print_error("Failed to execute service command.");
+        last_status = 1;
+    } else {
+        print_alert("Service command executed successfully.");
+    }
+}
+
+std::string SecShell::systemctl_path() {
+    if (!systemctl_override.empty()) return systemctl_override;
+    const std::string* path = policy.executables().lookup("systemctl");
+    return path ? *path : "";
+}
+
+bool SecShell::expand_service_targets(const std::vector<std::string>& targets, std::vector<std::string>& units) {
+    for (const auto& target : targets) {
+        if (target.empty() || target[0] == '-') {
+            print_error("Invalid service name '" + target + "'.");
+            last_status = 2;
+            return false;
+        }
+        if (target.find_first_of("*?[") == std::string::npos) {
+            if (std::find(units.begin(), units.end(), target) == units.end()) units.push_back(target);
+            continue;
+        }
+        const PrefixIndex& known = completion_services();
+        auto all = known.range("");
+        size_t matched = 0;
+        for (auto it = all.first; it != all.second; ++it) {
+            if (fnmatch(target.c_str(), it->c_str(), 0) != 0 && fnmatch(target.c_str(), (*it + ".service").c_str(), 0) != 0) {
+                continue;
+            }
+            ++matched;
+            if (std::find(units.begin(), units.end(), *it) == units.end()) units.push_back(*it);
+        }
+        if (matched == 0) {
+            print_error("No services match '" + target + "'.");
+            last_status = 1;
+            return false;
+        }
+    }
+    return true;
+}
+
+void SecShell::run_service_tasks(const std::string& program, std::vector<ServiceTask>& tasks) {
+    struct Running {
+        size_t task;
+        pid_t pid;
+        int fd;
+        uint64_t start_us;
+    };
+    std::vector<Running> running;
+    size_t next = 0;
+    int null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+    for (;;) {
+        while (next < tasks.size() && running.size() < static_cast<size_t>(std::max(1, services_jobs))) {
+            ServiceTask& task = tasks[next];
+            size_t index = next++;
+            metrics.service_task(task.cached);
+            if (task.cached) continue;
+
+            int pipe_fds[2];
+            if (pipe2(pipe_fds, O_CLOEXEC) == -1) {
+                task.status = 127;
+                task.output = strerror(errno);
+                continue;
+            }
+            Spawner spawner;
+            if (null_fd != -1) spawner.redirect(null_fd, STDIN_FILENO);
+            spawner.redirect(pipe_fds[1], STDOUT_FILENO);
+            spawner.redirect(pipe_fds[1], STDERR_FILENO);
+            pid_t pid;
+            uint64_t start_us = AuditLog::monotonic_us();
+            int err = spawner.spawn(program, task.args, pid, variables.envp());
+            close(pipe_fds[1]);
+            if (err != 0) {
+                close(pipe_fds[0]);
+                task.status = 127;
+                task.output = program + ": " + strerror(err);
+                continue;
+            }
+            metrics.spawn_us.record(AuditLog::monotonic_us() - start_us);
+            running.push_back({index, pid, pipe_fds[0], start_us});
+        }
+        if (running.empty()) break;
+
+        std::vector<struct pollfd> fds;
+        for (const auto& child : running) fds.push_back({child.fd, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), -1) == -1) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        char buffer[16384];
+        for (size_t i = fds.size(); i-- > 0;) {
+            if (!fds[i].revents) continue;
+            Running& child = running[i];
+            ServiceTask& task = tasks[child.task];
+            ssize_t n = read(child.fd, buffer, sizeof(buffer));
+            if (n > 0) {
+                task.output.append(buffer, n);
+                continue;
+            }
+            if (n == -1 && errno == EINTR) continue;
+
+            // End of output: the child has exited or is about to
+            close(child.fd);
+            int status;
+            struct rusage usage;
+            if (wait4(child.pid, &status, 0, &usage) == child.pid) {
+                task.status = exit_status(status);
+                std::vector<std::string> argv = task.args;
+                argv[0] = program;
+                audit.execution(child.pid, task.status, AuditLog::monotonic_us() - child.start_us,
+                                AuditLog::cpu_us(usage), argv);
+            }
+            running.erase(running.begin() + i);
+        }
+    }
+    if (null_fd != -1) close(null_fd);
+}
+
+void SecShell::print_service_table(BufferedWriter& out, const std::string& action, const std::vector<ServiceTask>& tasks) {
+    struct Row {
+        std::string unit, result, detail;
+        bool ok;
+    };
+    std::vector<Row> rows;
+    size_t unit_width = 7, result_width = 6;
+    for (const auto& task : tasks) {
+        Row row{task.unit, task.status == 0 ? "ok" : "exit " + std::to_string(task.status), "", task.status == 0};
+        std::string_view output(task.output);
+        size_t active = action == "status" ? output.find("Active:") : std::string_view::npos;
+        size_t begin = active != std::string_view::npos ? active + 7 : output.find_first_not_of(" \t\n");
+        if (begin != std::string_view::npos) {
+            output.remove_prefix(begin);
+            output.remove_prefix(std::min(output.find_first_not_of(" \t"), output.size()));
+            row.detail = std::string(output.substr(0, output.find('\n')));
+        }
+        if (task.cached) row.detail += " (cached)";
+        unit_width = std::max(unit_width, row.unit.size());
+        result_width = std::max(result_width, row.result.size());
+        rows.push_back(std::move(row));
+    }
+
+    bool color = isatty(STDOUT_FILENO);
+    size_t action_width = std::max<size_t>(action.size(), 6);
+    auto pad = [](const std::string& text, size_t width) { return text + std::string(width - text.size() + 2, ' '); };
+    out << "\n" << pad("SERVICE", unit_width) << pad("ACTION", action_width) << pad("RESULT", result_width) << "DETAIL\n";
+    for (const auto& row : rows) {
+        out << pad(row.unit, unit_width) << pad(action, action_width);
+        if (color) out << (row.ok ? "\033[32m" : "\033[31m");
+        out << row.result;
+        if (color) out << "\033[0m";
+        out << std::string(result_width - row.result.size() + 2, ' ') << row.detail << "\n";
+    }
+}
+
+void SecShell::show_stats(const std::vector<std::string>& args) {
+	if (args.size() > 2 || (args.size() == 2 && args[1] != "prometheus" && args[1] != "reset")) {
+		print_error("Usage: stats [prometheus | reset]");
+		last_status = 2;
+		return;
+	}
+	if (args.size() == 2 && args[1] == "reset") {
+		metrics.reset();
+		print_alert("Statistics reset.");
+		return;
+	}
+	std::cout.flush();
+	BufferedWriter out(STDOUT_FILENO);
+	if (args.size() == 2) {
+		out << metrics.prometheus();
+		return;
+	}
+	if (!draw_box(" Statistics ", "bold_white")) {
+		print_error("Failed to draw title box.");
+		return;
+	}
+
+	auto count = [](const char* label, uint64_t value) { return std::string(label) + " " + std::to_string(value); };
+	out << "Commands     " << count("allowed", metrics.commands(Metrics::Allowed)) << ", "
+	    << count("blacklisted", metrics.commands(Metrics::Blacklisted)) << ", "
+	    << count("not permitted", metrics.commands(Metrics::NotPermitted)) << ", "
+	    << count("denied by rule", metrics.commands(Metrics::Denied)) << ", "
+	    << count("exec failures", metrics.commands(Metrics::ExecFailure)) << "\n"
+	    << "Executions   " << count("builtin", metrics.executions(Metrics::Builtin)) << ", "
+	    << count("external", metrics.executions(Metrics::External)) << ", "
+	    << count("in-process", metrics.executions(Metrics::InProcess)) << "\n"
+	    << "Jobs         " << count("started", metrics.started_jobs()) << ", "
+	    << count("finished", metrics.finished_jobs()) << ", " << count("running", metrics.running_jobs()) << "\n"
+	    << "Services     " << count("run", metrics.service_tasks(false)) << ", "
+	    << count("cached", metrics.service_tasks(true)) << "\n\n";
+
+	char line[160];
+	snprintf(line, sizeof(line), "%-16s %8s %9s %9s %9s %9s %9s\n", "LATENCY", "COUNT", "P50", "P90", "P99", "MAX", "TOTAL");
+	out << line;
+	const std::pair<const char*, const Histogram*> latencies[] = {
+		{"spawn", &metrics.spawn_us}, {"command", &metrics.command_us}, {"readline", &metrics.readline_us},
+		{"prompt", &metrics.prompt_us}, {"prompt (async)", &metrics.prompt_async_us}};
+	for (const auto& latency : latencies) {
+		const Histogram& h = *latency.second;
+		snprintf(line, sizeof(line), "%-16s %8llu %9s %9s %9s %9s %9s\n", latency.first,
+		         static_cast<unsigned long long>(h.count()), format_latency(h.percentile(0.5)).c_str(),
+		         format_latency(h.percentile(0.9)).c_str(), format_latency(h.percentile(0.99)).c_str(),
+		         format_latency(h.max()).c_str(), format_latency(h.total_value()).c_str());
+		out << line;
+	}
+	const Histogram& depth = metrics.pipeline_depth;
+	snprintf(line, sizeof(line), "%-16s %8llu %9llu %9llu %9llu %9llu\n", "pipeline depth",
+	         static_cast<unsigned long long>(depth.count()), static_cast<unsigned long long>(depth.percentile(0.5)),
+	         static_cast<unsigned long long>(depth.percentile(0.9)), static_cast<unsigned long long>(depth.percentile(0.99)),
+	         static_cast<unsigned long long>(depth.max()));
+	out << line;
+	if (metrics_exporter.running()) {
+		out << "\nExporting to " << metrics_exporter.file() << " every " << std::to_string(std::max(1, metrics_interval)) << "s\n";
+	}
+}
+
+void SecShell::show_rules(const std::vector<std::string>& args) {
+	if (args.size() >= 2 && args[1] == "check") {
+		if (args.size() < 3) {
+			print_error("Usage: rules check <command> [args ...]");
+			last_status = 2;
+			return;
+		}
+		std::vector<std::string> command(args.begin() + 2, args.end());
+		if (const PolicyRules::Rule* rule = policy.denied_by(command, {}, working_directory)) {
+			std::cout << "Denied by line " << rule->line << ": " << rule->text << "\n";
+			last_status = 1;
+		} else {
+			std::cout << "Not denied by any rule\n";
+		}
+		return;
+	}
+	if (args.size() > 1) {
+		print_error("Usage: rules [check <command> [args ...]]");
+		last_status = 2;
+		return;
+	}
+	if (!draw_box(" Policy Rules ", "bold_white")) {
+		print_error("Failed to draw title box.");
+		return;
+	}
+	const PolicyRules& rules = policy.rules();
+	for (const auto& rule : rules.rules()) {
+		std::cout << " " << rule.line << ". " << rule.text << "\n";
+	}
+	const PatternSet& patterns = rules.pattern_set();
+	std::cout << "\n" << rules.size() << " rules, " << rules.term_count() << " patterns ("
+	          << patterns.literal_count() << " literal, " << patterns.nfa_size() << " automaton states) from "
+	          << RULES << "\n";
+}
+
+void SecShell::show_sandbox(const std::vector<std::string>& args) {
+	if (args.size() > 1) {
+		print_error("Usage: sandbox");
+		last_status = 2;
+		return;
+	}
+	if (!use_sandbox) {
+		std::cout << "Commands run unconfined (SECSHELL_SANDBOX=1 isolates them)\n";
+		return;
+	}
+	if (!sandbox.ready()) {
+		std::cout << "Unavailable, external commands are refused: " << sandbox_error << "\n";
+		last_status = 1;
+		return;
+	}
+	if (!draw_box(" Sandbox ", "bold_white")) {
+		print_error("Failed to draw title box.");
+		return;
+	}
+	std::cout << "Read-only    everything but";
+	for (const auto& path : sandbox.settings().writable) std::cout << " " << path;
+	std::cout << "\nFilter       " << sandbox.filter_length() << " BPF instructions, no_new_privs\n";
+	for (const auto& note : sandbox.notes()) std::cout << "Note         " << note << "\n";
+	if (sandbox.cgroup().empty()) return;
+	std::cout << "Cgroup       " << sandbox.cgroup()
+	          << (sandbox.clone_into_cgroup() ? " (clone3 into cgroup)" : " (joined after clone)") << "\n";
+	auto read_line = [&](const char* file) {
+		std::ifstream in(sandbox.cgroup() + "/" + file);
+		std::string line;
+		return std::getline(in, line) ? line : std::string("-");
+	};
+	std::cout << "Limits       cpu.max " << read_line("cpu.max") << ", memory.max " << read_line("memory.max")
+	          << ", pids.max " << read_line("pids.max") << "\n"
+	          << "Usage        memory " << read_line("memory.current") << ", pids " << read_line("pids.current")
+	          << ", " << read_line("cpu.stat") << "\n";
+}
+
+void SecShell::display_help() {
+	if (!draw_box(" SecShell Help ", "bold_white")) {
+		print_error("Failed to draw title box.");
+		return;
+	}
+
+	std::cout <<
+		"\n\033[36mBuilt-in Commands:\033[0m\n"
+		"  \033[1mhelp\033[0m       - Show this help message\n"
+		"  \033[1mexit\033[0m       - Exit the shell\n"
+		"  \033[1mdrawbox\033[0m    - Create a text box\n"
+		"               Usage: drawbox \"Your text here\" [solid] [bg_color] [text_color]\n"
+		"  \033[1mservices\033[0m   - Manage system services\n"
+		"               Usage: services <start|stop|restart|status|list> [service|pattern ...]\n"
+		"  \033[1mjobs\033[0m      - List active background jobs\n"
+		"               Usage: jobs [-l]   (-l: per-process state, CPU and RSS)\n"
+		"  \033[1moutput\033[0m     - Show the captured output of a background job\n"
+		"               Usage: output [pid]   (needs SECSHELL_CAPTURE_OUTPUT=1)\n"
+		"  \033[1mfollow\033[0m     - Stream a background job's captured output, like tail -f\n"
+		"               Usage: follow <pid>   (Enter or Ctrl-C stops)\n"
+		"  \033[1mparallel\033[0m   - Run a command once per argument, N at a time\n"
+		"               Usage: parallel [-j N] [-k] <command> [{}] [::: arg ...]   (args from stdin without :::)\n"
+		"  \033[1mstats\033[0m      - Show command counts and latency percentiles for this session\n"
+		"               Usage: stats [prometheus | reset]\n"
+		"  \033[1mrules\033[0m      - List the argument-level deny rules, or test a command against them\n"
+		"               Usage: rules [check <command> [args ...]]\n"
+		"  \033[1msandbox\033[0m    - Show how commands are isolated (SECSHELL_SANDBOX=1)\n"
+		"  \033[1mtime\033[0m       - Run a command and report its time and resource usage\n"
+		"               Usage: time <command> [| command ...]\n"
+		"  \033[1mcd\033[0m        - Change directory\n"
+		"               Usage: cd [directory]\n"
+		"  \033[1mhistory\033[0m    - Show command history\n"
+		"               Usage: history [N | search <pattern>]\n"
+		"  \033[1mexport\033[0m     - Set an environment variable, or export a shell variable\n"
+		"               Usage: export VAR=value | export VAR   (VAR=value alone sets a shell variable)\n"
+		"  \033[1menv\033[0m        - List the environment passed to commands\n"
+		"               Usage: env [-a]   (-a: every shell variable, including unexported ones)\n"
+		"  \033[1munset\033[0m      - Unset a shell or environment variable\n"
+		"               Usage: unset VAR [VAR ...]\n"
+		"  \033[1mreload\033[0m     - Reload the blacklist of commands and the policy rules\n" // Add the reload command
+		"  \033[1mrehash\033[0m     - Rebuild the index of allowed executables\n"
+		"\n\033[36mAllowed System Commands:\033[0m\n";
+
+	// Display whitelisted commands
+	for (const auto& cmd : ALLOWED_COMMANDS) {
+		std::cout << "  - " << cmd << "\n";
+	}
+
+	std::cout << "\n\033[36mSecurity Features:\033[0m\n"
+		"  - Command whitelisting\n"
+		"  - Input sanitization\n"
+		"  - Process isolation\n"
+		"  - Job tracking\n"
+		"  - Service Management\n"
+		"  - Background job execution\n"
+		"  - Piped command execution\n"
+		"  - Input/output redirection\n"
+		"\n\033[36mExamples:\033[0m\n"
+		"  > drawbox \"Security Alert\" solid green white\n"
+		"  > ls -l\n"
+		"  > jobs\n"
+		"  > services list\n"
+		"  > export MY_VAR=value\n"
+		"  > env\n"
+		"  > unset MY_VAR\n"
+		"  > history\n"
+		"  > blacklist\n"
+		"  > edit-blacklist\n"
+		"  > exit\n"
+		"\n\033[36mNote:\033[0m\n"
+		"\nAll commands are subject to security checks and sanitization.\n"
+		"Only executables from trusted directories are permitted.\n\033[0m";
+}
+
+bool SecShell::draw_box(const std::string& text, const std::string& style) {
+	std::cout.flush(); // Keep ordering with anything already buffered
+	if (use_external_drawbox) {
+		return run_external_drawbox(text, style);
+	}
+	return box_renderer.draw(STDOUT_FILENO, text, style);
+}
+
+bool SecShell::run_external_drawbox(const std::string& text, const std::string& style) {
+	std::vector<std::string> args = {"drawbox", text};
+	std::vector<std::string> style_args = parse_arguments(style);
+	args.insert(args.end(), style_args.begin(), style_args.end());
+
+	char* const* envp = variables.envp();
+	pid_t pid = fork();
+	if (pid == 0) {
+		std::vector<char*> argv;
+		for (const auto& arg : args) {
+			argv.push_back(const_cast<char*>(arg.c_str()));
+		}
+		argv.push_back(nullptr);
+		execvpe(argv[0], argv.data(), envp);
+		_exit(127);
+	} else if (pid < 0) {
+		return false;
+	}
+	int status;
+	if (waitpid(pid, &status, 0) == -1) return false;
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+void SecShell::drawbox_command(const std::vector<std::string>& args) {
+	if (args.size() < 2) {
+		print_error("Usage: drawbox \"Your text here\" [solid] [bg_color] [text_color]");
+		last_status = 2;
+		return;
+	}
+	std::string style;
+	for (size_t i = 2; i < args.size(); ++i) {
+		if (!style.empty()) style += " ";
+		style += args[i];
+	}
+	draw_box(args[1], style);
+}
+
+void SecShell::print_alert(const std::string& message) {
+	if (!interactive || !draw_box(message, "bold_yellow")) print_tagged("\033[33m", "[ALERT] ", message);
+}
+
+void SecShell::print_error(const std::string& message) {
+	if (!interactive || !draw_box(message, "bold_red")) print_tagged("\033[31m", "[ERROR] ", message);
+}
+
+void SecShell::print_tagged(const char* color, const char* tag, const std::string& message) {
+	if (interactive && isatty(STDERR_FILENO)) {
+		std::cerr << color << tag << message << "\033[0m\n";
+	} else {
+		std::cerr << tag << message << "\n";
+	}
+}
@@ -0,0 +1,260 @@
+// Background jobs: reaping, captured output, completion notices and the
+// jobs builtin.
+#include "secshell.h"
+
+void SecShell::reap_children() {
+    int status;
+    pid_t pid;
+    struct rusage usage;
+    while ((pid = wait4(-1, &status, WNOHANG, &usage)) > 0) {
+        background_stage_exited(pid, status, usage);
+    }
+}
+
+void SecShell::add_capture(pid_t id, const std::string& name, int fd) {
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        close(fd);
+        return;
+    }
+    auto capture = std::make_unique<CapturedJob>(name, capture_memory_bytes, capture_spill_bytes);
+    capture->fd = fd;
+    captures[id] = std::move(capture);
+    capture_fds[fd] = id;
+}
+
+void SecShell::drain_capture(int fd) {
+    auto it = capture_fds.find(fd);
+    if (it == capture_fds.end()) return;
+    CapturedJob& capture = *captures[it->second];
+    char buffer[16384];
+    for (size_t budget = 0; budget < CAPTURE_READ_BUDGET;) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n > 0) {
+            capture.output.append(buffer, n);
+            budget += n;
+            continue;
+        }
+        if (n == -1 && (errno == EAGAIN || errno == EINTR)) return;
+
+        // Every writer is gone: the job (or at least its output) is done
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        capture.fd = -1;
+        finished_captures.push_back(it->second);
+        capture_fds.erase(it);
+        while (finished_captures.size() > MAX_FINISHED_CAPTURES) {
+            captures.erase(finished_captures.front());
+            finished_captures.pop_front();
+        }
+        return;
+    }
+}
+
+SecShell::CapturedJob* SecShell::find_capture(const std::vector<std::string>& args, const std::string& usage) {
+    char* end = nullptr;
+    long id = args.size() == 2 ? strtol(args[1].c_str(), &end, 10) : 0;
+    if (args.size() != 2 || *end != '\0' || id <= 0) {
+        print_error(usage);
+        last_status = 2;
+        return nullptr;
+    }
+    auto it = captures.find(static_cast<pid_t>(id));
+    if (it == captures.end()) {
+        print_error("No captured output for job " + args[1] + ".");
+        last_status = 1;
+        return nullptr;
+    }
+    return it->second.get();
+}
+
+void SecShell::show_output(const std::vector<std::string>& args) {
+    std::cout.flush();
+    if (args.size() == 1) {
+        BufferedWriter out(STDOUT_FILENO);
+        if (captures.empty()) out << "No captured output.\n";
+        for (const auto& entry : captures) {
+            const CapturedJob& capture = *entry.second;
+            out << "PID: " << std::to_string(entry.first) << " - " << capture.name << " ("
+                << static_cast<unsigned long>(capture.output.total()) << " bytes"
+                << (capture.output.spilled() ? ", spilled to disk" : "")
+                << (capture.fd == -1 ? ", finished" : ", running") << ")\n";
+        }
+        return;
+    }
+
+    CapturedJob* capture = find_capture(args, "Usage: output [pid]");
+    if (!capture) return;
+    BufferedWriter out(STDOUT_FILENO);
+    uint64_t offset = 0;
+    if (capture->output.first_available() > 0) {
+        out << "[... " << static_cast<unsigned long>(capture->output.first_available()) << " earlier bytes dropped ...]\n";
+    }
+    std::string chunk;
+    while (offset < capture->output.total()) {
+        chunk.clear();
+        capture->output.read(offset, chunk, 65536);
+        if (chunk.empty()) break;
+        out << chunk;
+    }
+}
+
+void SecShell::follow_output(const std::vector<std::string>& args) {
+    CapturedJob* capture = find_capture(args, "Usage: follow <pid>");
+    if (!capture) return;
+    pid_t id = static_cast<pid_t>(strtol(args[1].c_str(), nullptr, 10));
+
+    // Start ten lines from the end, like tail -f
+    std::string tail;
+    uint64_t offset = capture->output.total() > 4096 ? capture->output.total() - 4096 : 0;
+    capture->output.read(offset, tail, 4096);
+    size_t start = tail.size();
+    if (start > 0 && tail[start - 1] == '\n') --start;
+    for (int lines = 0; start > 0; --start) {
+        if (tail[start - 1] == '\n' && ++lines == 10) break;
+    }
+    std::cout.flush();
+    BoxRenderer::write_all(STDOUT_FILENO, tail.substr(start));
+
+    std::string chunk;
+    for (;;) {
+        auto it = captures.find(id);
+        if (it == captures.end()) return;
+        chunk.clear();
+        it->second->output.read(offset, chunk, 65536);
+        if (!chunk.empty()) {
+            BoxRenderer::write_all(STDOUT_FILENO, chunk);
+            continue;
+        }
+        if (it->second->fd == -1) return;
+
+        struct epoll_event events[8];
+        int n = epoll_wait(epoll_fd, events, 8, -1);
+        if (n == -1) return; // Ctrl-C
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == signal_fd) {
+                handle_signals();
+            } else if (fd == policy.executables().fd()) {
+                policy.executables().refresh();
+            } else if (fd == STDIN_FILENO) {
+                char discard[256];
+                if (read(STDIN_FILENO, discard, sizeof(discard)) >= 0) return;
+            } else {
+                drain_capture(fd);
+            }
+        }
+    }
+}
+
+void SecShell::background_stage_exited(pid_t pid, int status, const struct rusage& usage) {
+    uint64_t now = AuditLog::monotonic_us();
+    JobTable::Stage stage;
+    JobTable::Job finished;
+    pid_t id;
+    if (!jobs.reap(pid, status, usage, now, stage, finished, id)) return;
+    audit.execution(pid, exit_status(status), now - stage.start_us, AuditLog::cpu_us(usage), stage.args);
+    if (id == 0) return;
+    metrics.job_finished();
+    background_job_complete(id, finished);
+}
+
+void SecShell::background_job_complete(pid_t pid, const JobTable::Job& job) {
+	std::string message = "Background job " + std::to_string(pid) + " (" + job.name + ") completed";
+	if (WIFEXITED(job.status)) {
+		message += " with status " + std::to_string(WEXITSTATUS(job.status)) + ".";
+	} else if (WIFSIGNALED(job.status)) {
+		message += ": killed by signal " + std::to_string(WTERMSIG(job.status)) + ".";
+	} else {
+		message += ".";
+	}
+	message += " (" + job.usage.summary() + ")";
+	suspend_prompt();
+	print_alert(message);
+	resume_prompt();
+}
+
+std::string SecShell::format_latency(uint64_t us) {
+	char text[32];
+	if (us < 1000) {
+		snprintf(text, sizeof(text), "%lluus", static_cast<unsigned long long>(us));
+	} else if (us < 1000000) {
+		snprintf(text, sizeof(text), "%.1fms", us / 1e3);
+	} else {
+		snprintf(text, sizeof(text), "%.2fs", us / 1e6);
+	}
+	return text;
+}
+
+void SecShell::list_jobs(const std::vector<std::string>& args) {
+	bool detailed = args.size() > 1 && args[1] == "-l";
+	if (args.size() > 1 && !detailed) {
+		print_error("Usage: jobs [-l]");
+		last_status = 2;
+		return;
+	}
+	if (!draw_box(" Jobs ", "bold_white")) {
+        print_error("Failed to draw title box.");
+        return;
+    }
+
+	std::vector<std::pair<pid_t, const JobTable::Job*>> ordered = jobs.by_start();
+
+	uint64_t now = AuditLog::monotonic_us();
+	std::cout.flush();
+	BufferedWriter out(STDOUT_FILENO);
+	if (detailed && !ordered.empty()) {
+		char line[160];
+		snprintf(line, sizeof(line), "%-8s %-8s %-5s %10s %10s %10s  %s\n", "JOB", "PID", "STATE", "CPU", "RSS", "ELAPSED", "COMMAND");
+		out << line;
+	}
+	for (const auto& entry : ordered) {
+		const JobTable::Job& job = *entry.second;
+		std::string elapsed = ResourceUsage::seconds(now - job.start_us);
+		if (!detailed) {
+			out << "PID: " << std::to_string(entry.first) << " - " << job.name << " (running " << elapsed << ")\n";
+			continue;
+		}
+		for (pid_t pid : job.pids) {
+			ProcessStat stat;
+			const JobTable::Stage* stage = jobs.stage(pid);
+			std::string command = stage ? stage->args[0] : job.name;
+			char line[160];
+			if (read_process_stat(pid, stat)) {
+				snprintf(line, sizeof(line), "%-8d %-8d %-5c %10s %7lu KB %10s  ", entry.first, pid, stat.state,
+				         ResourceUsage::seconds(stat.cpu_us).c_str(), stat.rss_kb, elapsed.c_str());
+			} else {
+				snprintf(line, sizeof(line), "%-8d %-8d %-5s %10s %10s %10s  ", entry.first, pid, "?", "-", "-", elapsed.c_str());
+			}
+			out << line << command << "\n";
+		}
+	}
+}
+
+bool SecShell::read_process_stat(pid_t pid, ProcessStat& stat) {
+    char path[64], buffer[1024];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return false;
+    ssize_t n = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if (n <= 0) return false;
+    buffer[n] = '\0';
+
+    // comm may contain spaces and parentheses; fields resume after the last ')'
+    const char* p = strrchr(buffer, ')');
+    if (!p) return false;
+    unsigned long long utime, stime;
+    long rss;
+    if (sscanf(p + 1, " %c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu %*d %*d %*d %*d %*d %*d %*u %*u %ld",
+               &stat.state, &utime, &stime, &rss) != 4) {
+        return false;
+    }
+    static const long ticks = sysconf(_SC_CLK_TCK);
+    static const long page_kb = sysconf(_SC_PAGESIZE) / 1024;
+    stat.cpu_us = (utime + stime) * 1000000 / ticks;
+    stat.rss_kb = rss * page_kb;
+    return true;
+}
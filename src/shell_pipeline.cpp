@@ -0,0 +1,564 @@
+// From a command line to running processes: parsing, the policy checks
+// every stage passes, and the pipeline engine that spawns, forks or runs
+// each stage in-process and reaps it.
+#include "secshell.h"
+
+std::string SecShell::sanitize_input(const std::string& input) {
+    std::string sanitized = input;
+    const std::string forbidden = ";`";
+    sanitized.erase(std::remove_if(sanitized.begin(), sanitized.end(),
+        [&forbidden](char c) { return forbidden.find(c) != std::string::npos; }), sanitized.end());
+    return sanitized;
+}
+
+void SecShell::process_command(const std::string& input) {
+	uint64_t start = AuditLog::monotonic_us();
+	execute_command_line(input);
+	metrics.command_us.record(AuditLog::monotonic_us() - start);
+}
+
+void SecShell::execute_command_line(const std::string& input) {
+	last_status = 0;
+	command_arena.reset(); // Releases the previous command's parse tree
+	refresh_rules();
+
+	std::string error;
+	CommandParser parser(command_arena, [this](const std::string& name) { return variables.get(name); });
+	const PipelineNode* pipeline = parser.parse(input, error);
+	if (!pipeline) {
+		print_error(error);
+		last_status = 2;
+		return;
+	}
+	if (pipeline->length == 0) return;
+
+	// NAME=value on its own sets a shell variable (kept exported if it was)
+	const CommandNode* only = pipeline->commands;
+	if (pipeline->length == 1 && only->word_count == 1 && !only->redirects && !pipeline->background) {
+		std::string_view word = only->words->text;
+		size_t equals = word.find('=');
+		if (equals != std::string_view::npos && VariableStore::valid_name(std::string(word.substr(0, equals)))) {
+			variables.set(std::string(word.substr(0, equals)), std::string(word.substr(equals + 1)));
+			refresh_prompt_context();
+			return;
+		}
+	}
+
+	// time <command>: drop the keyword and time the rest of the pipeline
+	bool timed = pipeline->commands->words && pipeline->commands->words->text == "time" && !pipeline->commands->words->quoted;
+	if (timed) {
+		const CommandNode* timed_command = pipeline->commands;
+		if (policy.blacklisted("time")) {
+			record_decision(AuditLog::Blacklisted, {"time"});
+			print_error("Command is blacklisted: time");
+			last_status = 126;
+			return;
+		}
+		if (!timed_command->words->next) {
+			print_error("Usage: time <command> [| command ...]");
+			last_status = 2;
+			return;
+		}
+		CommandNode* command = command_arena.make<CommandNode>();
+		*command = *timed_command;
+		command->words = timed_command->words->next;
+		--command->word_count;
+		PipelineNode* rest = command_arena.make<PipelineNode>();
+		*rest = *pipeline;
+		rest->commands = command;
+		pipeline = rest;
+	}
+
+	// Special handling for 'cat' without arguments
+	const CommandNode* first = pipeline->commands;
+	if (pipeline->length == 1 && first->word_count == 1 && !first->redirects && first->words->text == "cat") {
+		print_error("Usage: cat <file>");
+		last_status = 2;
+		return;
+	}
+
+	if (timed) {
+		run_timed(*pipeline);
+	} else {
+		execute_pipeline(*pipeline);
+	}
+}
+
+void SecShell::run_timed(const PipelineNode& pipeline) {
+	std::vector<StageTiming> timings;
+	uint64_t start = AuditLog::monotonic_us();
+	execute_pipeline(pipeline, &timings);
+	if (pipeline.background || timings.empty()) return; // Background jobs report their usage when they finish
+
+	ResourceUsage total;
+	total.wall_us = AuditLog::monotonic_us() - start;
+	for (const auto& timing : timings) total.add(timing.usage);
+
+	std::string report = "\nreal\t" + ResourceUsage::seconds(total.wall_us) +
+	                     "\nuser\t" + ResourceUsage::seconds(total.user_us) +
+	                     "\nsys\t" + ResourceUsage::seconds(total.sys_us) +
+	                     "\nmaxrss\t" + std::to_string(total.max_rss_kb) + " KB" +
+	                     "\nctxsw\t" + std::to_string(total.voluntary_switches) + " voluntary, " +
+	                     std::to_string(total.involuntary_switches) + " involuntary\n";
+	if (timings.size() > 1) {
+		for (size_t i = 0; i < timings.size(); ++i) {
+			report += "  [" + std::to_string(i + 1) + "] " + timings[i].name + ": " + timings[i].usage.summary() + "\n";
+		}
+	}
+	std::cout.flush();
+	BoxRenderer::write_all(STDERR_FILENO, report);
+}
+
+void SecShell::execute_pipeline(const PipelineNode& pipeline, std::vector<StageTiming>* timings) {
+	metrics.pipeline_depth.record(pipeline.length);
+	bool background = pipeline.background;
+	std::vector<PipelineStage> stages(pipeline.length);
+	size_t i = 0;
+	for (const CommandNode* command = pipeline.commands; command; command = command->next) {
+		if (!prepare_stage(*command, stages[i++])) return;
+	}
+	// Only the last in-process stage runs on this thread; the others are
+	// forked, which costs more than spawning ls or cat, so a fast path
+	// may only take a stage when nothing else in the pipeline is in-process.
+	// A forked fast path falls back to a plain exec, outside the sandbox,
+	// so background pipelines under it spawn ls and cat like any command.
+	if ((background && use_sandbox) ||
+	    std::count_if(stages.begin(), stages.end(), [](const PipelineStage& stage) { return stage.in_process(); }) > 1) {
+		for (auto& stage : stages) stage.fast = false;
+	}
+
+	// Every descriptor the shell opens here is close-on-exec, so spawned
+	// children only keep the copies dup'd onto their stdin/stdout.
+	std::vector<int> fds;
+	if (!open_stage_fds(stages, fds)) {
+		close_fds(fds);
+		return;
+	}
+
+	// Captured background jobs send stderr, and the last stage's stdout
+	// unless redirected, into one pipe the event loop drains.
+	int capture_fd = -1;
+	if (background && capture_background && epoll_fd != -1) {
+		int pipe_fds[2];
+		if (pipe2(pipe_fds, O_CLOEXEC) == 0) {
+			fcntl(pipe_fds[0], F_SETFL, O_NONBLOCK);
+			capture_fd = pipe_fds[0];
+			fds.push_back(pipe_fds[1]);
+			for (auto& stage : stages) stage.err_fd = pipe_fds[1];
+			if (stages.back().out_fd == -1) stages.back().out_fd = pipe_fds[1];
+		}
+	}
+
+	bool failed = false;
+	for (auto& stage : stages) {
+		if (stage.in_process()) continue;
+		Spawner spawner;
+		if (use_sandbox) spawner.isolate(&sandbox);
+		if (stage.in_fd != -1) spawner.redirect(stage.in_fd, STDIN_FILENO);
+		if (stage.out_fd != -1) spawner.redirect(stage.out_fd, STDOUT_FILENO);
+		if (stage.err_fd != -1) spawner.redirect(stage.err_fd, STDERR_FILENO);
+		stage.start_us = AuditLog::monotonic_us();
+		int err = spawner.spawn(stage.exec_path, stage.args, stage.pid, variables.envp());
+		if (err != 0) {
+			metrics.command(Metrics::ExecFailure);
+			print_error("Command execution failed: " + std::string(strerror(err)));
+			last_status = 127;
+			failed = true;
+			break;
+		}
+		metrics.spawn_us.record(AuditLog::monotonic_us() - stage.start_us);
+		metrics.execution(Metrics::External);
+	}
+
+	if (!failed) {
+		if (background) {
+			for (auto& stage : stages) {
+				if (!stage.in_process()) continue;
+				stage.start_us = AuditLog::monotonic_us();
+				stage.pid = fork_builtin_stage(stage, fds);
+				metrics.execution(stage.fast ? Metrics::InProcess : Metrics::Builtin);
+			}
+			close_fds(fds);
+		} else {
+			// Builtin stages before the last one get a child each, as in
+			// the background: run in turn on this thread, one writing more
+			// than a pipe holds into a later one would never finish.
+			auto last_in_process = std::find_if(stages.rbegin(), stages.rend(),
+			                                    [](const PipelineStage& stage) { return stage.in_process(); });
+			for (auto& stage : stages) {
+				if (!stage.in_process() || &stage == &*last_in_process) continue;
+				stage.start_us = AuditLog::monotonic_us();
+				stage.pid = fork_builtin_stage(stage, fds);
+				metrics.execution(Metrics::Builtin);
+				if (stage.pid < 0) {
+					last_status = 1;
+					failed = true;
+				}
+			}
+
+			// Keep only what the last in-process stage reads and writes; a
+			// reader that exits early then gives it EPIPE instead of a full pipe.
+			std::vector<int> builtin_fds;
+			if (!failed && last_in_process != stages.rend()) {
+				if (last_in_process->in_fd != -1) builtin_fds.push_back(last_in_process->in_fd);
+				if (last_in_process->out_fd != -1) builtin_fds.push_back(last_in_process->out_fd);
+			}
+			for (int fd : fds) {
+				if (std::find(builtin_fds.begin(), builtin_fds.end(), fd) == builtin_fds.end()) close(fd);
+			}
+			fds = builtin_fds;
+
+			for (auto& stage : stages) {
+				if (!stage.in_process() || stage.pid != -1 || failed) continue;
+				last_status = 0;
+				struct rusage before, after;
+				stage.start_us = AuditLog::monotonic_us();
+				getrusage(RUSAGE_THREAD, &before);
+				if (stage.fast) {
+					run_fast_stage(stage, &stage == &stages.back());
+				} else {
+					metrics.execution(Metrics::Builtin);
+					run_builtin_redirected(stage.args, stage.in_fd, stage.out_fd);
+				}
+				getrusage(RUSAGE_THREAD, &after);
+				if (stage.pid <= 0) {
+					stage.usage.wall_us = AuditLog::monotonic_us() - stage.start_us;
+					stage.usage.add_delta(before, after);
+					audit.execution(getpid(), last_status, stage.usage.wall_us,
+					                stage.usage.user_us + stage.usage.sys_us, stage.args);
+				}
+				for (int fd : {stage.in_fd, stage.out_fd}) {
+					if (fd == -1) continue;
+					close(fd);
+					fds.erase(std::find(fds.begin(), fds.end(), fd));
+				}
+			}
+		}
+	}
+	close_fds(fds);
+
+	if (background && !failed) {
+		std::string name;
+		for (const auto& stage : stages) {
+			name += (name.empty() ? "" : " | ") + stage.args[0];
+		}
+		pid_t id = stages.back().pid;
+		if (id > 0) {
+			// The job is known by its last stage; every stage is accounted to it
+			jobs.add(id, name, stages.front().start_us);
+			metrics.job_started();
+			for (const auto& stage : stages) {
+				if (stage.pid > 0) jobs.add_stage(id, stage.pid, stage.args, stage.start_us);
+			}
+			if (capture_fd != -1) {
+				add_capture(id, name, capture_fd);
+				capture_fd = -1;
+			}
+			print_alert("[" + std::to_string(id) + "] " + name + " running in background" +
+			            (captures.count(id) ? "; output captured (output " + std::to_string(id) + ")" : ""));
+		}
+		if (capture_fd != -1) close(capture_fd);
+		return;
+	}
+	if (capture_fd != -1) close(capture_fd);
+
+	// Reap stages in whatever order they exit so each one's wall time is
+	// exact. Background jobs finishing meanwhile are accounted as usual.
+	size_t remaining = std::count_if(stages.begin(), stages.end(), [](const PipelineStage& stage) { return stage.pid > 0; });
+	while (remaining > 0) {
+		int status;
+		struct rusage usage;
+		pid_t pid = wait4(-1, &status, 0, &usage);
+		if (pid == -1) {
+			if (errno == EINTR) continue;
+			break;
+		}
+		auto stage = std::find_if(stages.begin(), stages.end(), [pid](const PipelineStage& s) { return s.pid == pid; });
+		if (stage == stages.end()) {
+			background_stage_exited(pid, status, usage);
+			continue;
+		}
+		--remaining;
+		stage->usage.wall_us = AuditLog::monotonic_us() - stage->start_us;
+		stage->usage.add(usage);
+		audit.execution(pid, exit_status(status), stage->usage.wall_us, AuditLog::cpu_us(usage), stage->args);
+		if (&*stage == &stages.back() && !failed) {
+			if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+				print_error("Command exited with status: " + std::to_string(WEXITSTATUS(status)));
+			}
+			last_status = exit_status(status);
+		}
+	}
+
+	if (timings) {
+		for (const auto& stage : stages) timings->push_back({stage.args[0], stage.usage});
+	}
+}
+
+void SecShell::glob_too_large(std::string_view pattern) {
+	print_error("Glob expansion of " + std::string(pattern) + " exceeds " + std::to_string(glob.max_results) +
+	            " matches or " + std::to_string(glob.max_bytes) + " bytes");
+	last_status = 1;
+}
+
+void SecShell::record_decision(AuditLog::Verdict verdict, const std::vector<std::string>& args) {
+	if (int err = audit.take_error()) {
+		print_error("Audit log " + audit.file() + ": " + strerror(err) + " (" + std::to_string(audit.records_lost()) +
+		            " records lost so far)");
+	}
+	audit.decision(verdict, args);
+	metrics.command(verdict == AuditLog::Blacklisted ? Metrics::Blacklisted
+	                : verdict == AuditLog::NotPermitted ? Metrics::NotPermitted
+	                : verdict == AuditLog::Denied ? Metrics::Denied : Metrics::Allowed);
+}
+
+bool SecShell::prepare_stage(const CommandNode& command, PipelineStage& stage) {
+	stage.args.reserve(command.word_count + 1);
+	for (const WordNode* word = command.words; word; word = word->next) {
+		if (!use_glob || word->quoted || !GlobExpander::has_magic(word->text)) {
+			stage.args.emplace_back(word->text);
+		} else if (glob.expand(word->text, working_directory, stage.args) == GlobExpander::TooLarge) {
+			glob_too_large(word->text);
+			return false;
+		}
+	}
+	std::vector<std::string> targets;
+	for (const RedirectNode* redirect = command.redirects; redirect; redirect = redirect->next) {
+		std::vector<std::string> expanded;
+		if (!use_glob || redirect->quoted || !GlobExpander::has_magic(redirect->target)) {
+			expanded.emplace_back(redirect->target);
+		} else if (glob.expand(redirect->target, working_directory, expanded) == GlobExpander::TooLarge) {
+			glob_too_large(redirect->target);
+			return false;
+		}
+		if (expanded.size() != 1) {
+			print_error("Ambiguous redirect: " + std::string(redirect->target));
+			last_status = 1;
+			return false;
+		}
+		if (redirect->kind == RedirectNode::Input) {
+			stage.input_file = expanded[0];
+		} else {
+			stage.output_file = expanded[0];
+			stage.append = redirect->kind == RedirectNode::Append;
+		}
+		targets.push_back(std::move(expanded[0]));
+	}
+
+	// Check if the command is blacklisted
+	const std::string& name = stage.args[0];
+	if (policy.blacklisted(name)) {
+		record_decision(AuditLog::Blacklisted, stage.args);
+		print_error("Command is blacklisted: " + name);
+		last_status = 126;
+		return false;
+	}
+	if (const PolicyRules::Rule* rule = policy.denied_by(stage.args, targets, working_directory)) {
+		record_decision(AuditLog::Denied, stage.args);
+		print_error("Command denied by policy rule (line " + std::to_string(rule->line) + "): " + rule->text);
+		last_status = 126;
+		return false;
+	}
+	if (is_builtin(name)) {
+		record_decision(AuditLog::Allowed, stage.args);
+		return true;
+	}
+	if (!policy.allows(name, &stage.exec_path)) {
+		record_decision(AuditLog::NotPermitted, stage.args);
+		print_error("Command not permitted: " + name);
+		last_status = 126;
+		return false;
+	}
+	if (use_sandbox && !sandbox.ready()) {
+		record_decision(AuditLog::NotPermitted, stage.args);
+		print_error("Sandbox unavailable, not running: " + name);
+		last_status = 126;
+		return false;
+	}
+	record_decision(AuditLog::Allowed, stage.args);
+	stage.fast = use_fast_path && FastPath::handles(name) && FastPath::native(stage.exec_path, name);
+	add_color_flags(stage.args); // May reallocate args, and with it name
+	return true;
+}
+
+bool SecShell::open_stage_fds(std::vector<PipelineStage>& stages, std::vector<int>& fds) {
+	for (auto& stage : stages) {
+		if (!stage.input_file.empty()) {
+			stage.in_fd = open(stage.input_file.c_str(), O_RDONLY | O_CLOEXEC);
+			if (stage.in_fd == -1) {
+				print_error("Failed to open input file: " + stage.input_file);
+				last_status = 1;
+				return false;
+			}
+			fds.push_back(stage.in_fd);
+		}
+		if (!stage.output_file.empty()) {
+			int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (stage.append ? O_APPEND : O_TRUNC);
+			stage.out_fd = open(stage.output_file.c_str(), flags, 0644);
+			if (stage.out_fd == -1) {
+				print_error("Failed to open output file: " + stage.output_file);
+				last_status = 1;
+				return false;
+			}
+			fds.push_back(stage.out_fd);
+		}
+	}
+
+	for (size_t i = 0; i + 1 < stages.size(); ++i) {
+		int pipe_fds[2];
+		if (pipe2(pipe_fds, O_CLOEXEC) == -1) {
+			print_error("Failed to create pipe");
+			last_status = 1;
+			return false;
+		}
+		fds.push_back(pipe_fds[0]);
+		fds.push_back(pipe_fds[1]);
+		if (pipe_size > 0) {
+			// Best effort: the kernel caps unprivileged sizes at fs.pipe-max-size
+			fcntl(pipe_fds[1], F_SETPIPE_SZ, pipe_size);
+		}
+		if (stages[i].out_fd == -1) stages[i].out_fd = pipe_fds[1];
+		if (stages[i + 1].in_fd == -1) stages[i + 1].in_fd = pipe_fds[0];
+	}
+	return true;
+}
+
+void SecShell::close_fds(std::vector<int>& fds) {
+	for (int fd : fds) close(fd);
+	fds.clear();
+}
+
+void SecShell::run_builtin_redirected(const std::vector<std::string>& args, int in_fd, int out_fd) {
+	if (in_fd == -1 && out_fd == -1) {
+		run_builtin(args);
+		return;
+	}
+	int saved_stdin = -1;
+	if (in_fd != -1) {
+		saved_stdin = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 0);
+		dup2(in_fd, STDIN_FILENO);
+	}
+	if (out_fd == -1) {
+		run_builtin(args);
+	} else {
+		std::cout.flush();
+		int saved_stdout = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+		struct sigaction ignore = {}, previous;
+		ignore.sa_handler = SIG_IGN;
+		sigaction(SIGPIPE, &ignore, &previous); // A reader that quits early must not kill the shell
+		dup2(out_fd, STDOUT_FILENO);
+
+		run_builtin(args);
+
+		std::cout.flush();
+		std::cout.clear(); // A broken pipe leaves the stream in a failed state
+		dup2(saved_stdout, STDOUT_FILENO);
+		close(saved_stdout);
+		sigaction(SIGPIPE, &previous, nullptr);
+	}
+	if (saved_stdin != -1) {
+		dup2(saved_stdin, STDIN_FILENO);
+		close(saved_stdin);
+	}
+}
+
+void SecShell::run_fast_stage(PipelineStage& stage, bool last) {
+	std::cout.flush();
+	struct sigaction ignore = {}, previous;
+	ignore.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &ignore, &previous);
+	int status = fast_path.run(stage.args, stage.in_fd == -1 ? STDIN_FILENO : stage.in_fd,
+	                           stage.out_fd == -1 ? STDOUT_FILENO : stage.out_fd, STDERR_FILENO);
+	sigaction(SIGPIPE, &previous, nullptr);
+	if (status != FastPath::FALLBACK) {
+		metrics.execution(Metrics::InProcess);
+		if (last && status > 0 && status < 128) print_error("Command exited with status: " + std::to_string(status));
+		last_status = status;
+		return;
+	}
+
+	Spawner spawner;
+	if (use_sandbox) spawner.isolate(&sandbox);
+	if (stage.in_fd != -1) spawner.redirect(stage.in_fd, STDIN_FILENO);
+	if (stage.out_fd != -1) spawner.redirect(stage.out_fd, STDOUT_FILENO);
+	uint64_t start = AuditLog::monotonic_us();
+	int err = spawner.spawn(stage.exec_path, stage.args, stage.pid, variables.envp());
+	if (err != 0) {
+		metrics.command(Metrics::ExecFailure);
+		print_error("Command execution failed: " + std::string(strerror(err)));
+		stage.pid = -1;
+		last_status = 127;
+		return;
+	}
+	metrics.spawn_us.record(AuditLog::monotonic_us() - start);
+	metrics.execution(Metrics::External);
+}
+
+pid_t SecShell::fork_builtin_stage(const PipelineStage& stage, const std::vector<int>& fds) {
+	std::cout.flush();
+	char* const* envp = variables.envp();
+	pid_t pid = fork();
+	if (pid == 0) {
+		if (stage.in_fd != -1) dup2(stage.in_fd, STDIN_FILENO);
+		if (stage.out_fd != -1) dup2(stage.out_fd, STDOUT_FILENO);
+		if (stage.err_fd != -1) dup2(stage.err_fd, STDERR_FILENO);
+		for (int fd : fds) close(fd);
+		sigset_t none;
+		sigemptyset(&none);
+		sigprocmask(SIG_SETMASK, &none, nullptr);
+		if (stage.fast) {
+			int status = fast_path.run(stage.args, STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO);
+			if (status != FastPath::FALLBACK) _exit(status);
+			std::vector<char*> argv;
+			for (const auto& arg : stage.args) argv.push_back(const_cast<char*>(arg.c_str()));
+			argv.push_back(nullptr);
+			execve(stage.exec_path.c_str(), argv.data(), envp);
+			_exit(127);
+		}
+		last_status = 0;
+		run_builtin(stage.args);
+		std::cout.flush();
+		_exit(last_status);
+	} else if (pid < 0) {
+		print_error("Fork failed: " + std::string(strerror(errno)));
+	}
+	return pid;
+}
+
+void SecShell::add_color_flags(std::vector<std::string>& args) {
+	// Add --color=always for grep
+	if (args[0] == "grep") {
+		bool has_color_flag = false;
+		for (const auto& arg : args) {
+			if (arg == "--color=always" || arg == "--color=auto") {
+				has_color_flag = true;
+				break;
+			}
+		}
+		if (!has_color_flag) {
+			args.push_back("--color=always");
+		}
+	}
+
+	// Add --color=auto for ls
+	if (args[0] == "ls") {
+		args.push_back("--color=auto");
+	}
+}
+
+int SecShell::exit_status(int status) {
+    if (WIFEXITED(status)) return WEXITSTATUS(status);
+    if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+    return 1;
+}
+
+std::vector<std::string> SecShell::parse_arguments(const std::string& input) {
+	std::vector<std::string> args;
+	std::string error;
+	Arena arena(256);
+	CommandParser parser(arena, [this](const std::string& name) { return variables.get(name); });
+	if (!parser.split(input, args, error)) {
+		print_error(error);
+	}
+	return args;
+}
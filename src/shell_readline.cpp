@@ -0,0 +1,221 @@
+// The readline side of the shell: persistent history, Ctrl-R search and
+// tab completion.
+#include "secshell.h"
+
+void SecShell::display_history(const std::vector<std::string>& args) {
+	if (!history_store.is_open() && !history_store.open(history_path())) {
+		print_error("Failed to open history file: " + history_path());
+		last_status = 1;
+		return;
+	}
+
+	std::vector<uint32_t> matches;
+	size_t count = history_store.size();
+	size_t first = 0;
+	bool searching = args.size() > 1 && args[1] == "search";
+	if (searching) {
+		if (args.size() < 3) {
+			print_error("Usage: history [N | search <pattern>]");
+			last_status = 2;
+			return;
+		}
+		matches = history_store.search(args[2]);
+	} else if (args.size() > 1) {
+		char* end;
+		unsigned long n = strtoul(args[1].c_str(), &end, 10);
+		if (*end != '\0' || args[1].empty()) {
+			print_error("Usage: history [N | search <pattern>]");
+			last_status = 2;
+			return;
+		}
+		first = n < count ? count - n : 0;
+	}
+
+	if (!draw_box(" Command History ", "bold_white")) {
+        print_error("Failed to draw title box.");
+        return;
+    }
+
+	std::cout.flush();
+	BufferedWriter out(STDOUT_FILENO);
+	if (searching) {
+		for (uint32_t id : matches) {
+			out << "  " << static_cast<unsigned long>(id + 1) << ". " << history_store.command(id) << "\n";
+		}
+	} else if (count == 0) {
+		out << "No command history available.\n";
+	} else {
+		for (size_t i = first; i < count; ++i) {
+			out << "  " << static_cast<unsigned long>(i + 1) << ". " << history_store.command(i) << "\n";
+		}
+	}
+}
+
+std::string SecShell::history_path() {
+    const char* path = getenv("SECSHELL_HISTFILE");
+    if (path && *path) return path;
+    const char* home = getenv("HOME");
+    if (!home || !*home) {
+        struct passwd* pw = getpwuid(getuid());
+        home = pw ? pw->pw_dir : "/tmp";
+    }
+    return std::string(home) + "/.secshell_history";
+}
+
+void SecShell::load_recent_history() {
+    if (!history_store.open(history_path())) return;
+    size_t count = history_store.size();
+    for (size_t i = count > RECALL_HISTORY ? count - RECALL_HISTORY : 0; i < count; ++i) {
+        add_history(std::string(history_store.command(i)).c_str());
+    }
+}
+
+int SecShell::reverse_search(int, int) {
+    SecShell* shell = active_shell;
+    if (rl_last_func != reverse_search) {
+        shell->search_pattern.assign(rl_line_buffer, rl_end);
+        shell->search_position = shell->history_store.size();
+    }
+    if (shell->search_pattern.empty()) {
+        rl_ding();
+        return 0;
+    }
+
+    std::string_view current(rl_line_buffer, rl_end);
+    for (;;) {
+        size_t match = shell->history_store.find_before(shell->search_pattern, shell->search_position);
+        if (match == HistoryStore::npos) {
+            rl_ding();
+            return 0;
+        }
+        shell->search_position = match;
+        std::string_view text = shell->history_store.command(match);
+        if (text == current) continue; // Skip repeats of what is already shown
+        rl_replace_line(std::string(text).c_str(), 0);
+        rl_point = rl_end;
+        return 0;
+    }
+}
+
+char** SecShell::complete(const char* text, int start, int) {
+    rl_attempted_completion_over = 1; // Never fall back to readline's own filename completion
+    SecShell* shell = active_shell;
+
+    // Words before the one being completed, within the current pipeline
+    // stage. A plain whitespace split: the line may end inside a quote.
+    std::string_view before(rl_line_buffer, start);
+    size_t stage_start = before.find_last_of("|&");
+    if (stage_start != std::string_view::npos) before.remove_prefix(stage_start + 1);
+    std::vector<std::string> words;
+    for (size_t pos = before.find_first_not_of(" \t"); pos != std::string_view::npos;
+         pos = before.find_first_not_of(" \t", pos)) {
+        size_t end = std::min(before.find_first_of(" \t", pos), before.size());
+        words.emplace_back(before.substr(pos, end - pos));
+        pos = end;
+    }
+
+    std::string_view word(text);
+    if (words.empty()) {
+        if (word.find('/') != std::string_view::npos) return nullptr; // Paths never resolve
+        auto range = shell->completion_commands().range(word);
+        return make_matches("", range.first, range.second);
+    }
+    if (words[0] == "services") {
+        if (words.size() == 1) {
+            auto range = SERVICE_ACTIONS.range(word);
+            return make_matches("", range.first, range.second);
+        }
+        if (words.size() == 2 && words[1] != "list") {
+            auto range = shell->completion_services().range(word);
+            return make_matches("", range.first, range.second);
+        }
+        return nullptr;
+    }
+
+    // Arguments: split into the directory as typed and the name prefix
+    size_t slash = word.rfind('/');
+    std::string lead(slash == std::string_view::npos ? std::string_view() : word.substr(0, slash + 1));
+    std::string_view name = word.substr(lead.size());
+    std::string dir = ".";
+    if (!lead.empty()) {
+        char* expanded = tilde_expand(lead.c_str());
+        dir = expanded;
+        free(expanded);
+    }
+    const DirectoryCache::Listing* listing = shell->directory_cache.get(dir);
+    if (!listing) return nullptr;
+    rl_filename_completion_desired = 1; // Basename display, '/' after directories, quoting
+    const PrefixIndex& names = !name.empty() && name[0] == '.' ? listing->hidden : listing->visible;
+    auto range = names.range(name);
+    return make_matches(lead, range.first, range.second);
+}
+
+char** SecShell::make_matches(const std::string& lead, PrefixIndex::const_iterator first, PrefixIndex::const_iterator last) {
+    size_t count = last - first;
+    if (count == 0) return nullptr;
+    char** matches = static_cast<char**>(malloc((count + 2) * sizeof(char*)));
+    size_t i = 1;
+    for (auto it = first; it != last; ++it) {
+        char* match = static_cast<char*>(malloc(lead.size() + it->size() + 1));
+        memcpy(match, lead.data(), lead.size());
+        memcpy(match + lead.size(), it->c_str(), it->size() + 1);
+        matches[i++] = match;
+    }
+    matches[i] = nullptr;
+
+    // The first and last of a sorted run share the run's common prefix
+    const std::string& front = *first;
+    const std::string& back = *(last - 1);
+    size_t common = 0;
+    while (common < front.size() && common < back.size() && front[common] == back[common]) ++common;
+    matches[0] = strdup((lead + front.substr(0, common)).c_str());
+    return matches;
+}
+
+const PrefixIndex& SecShell::completion_commands() {
+    policy.executables().refresh();
+    unsigned long exec_version = policy.executables().version();
+    unsigned long blacklist_version = policy.blacklist().version();
+    if (command_completions.size() == 0 || exec_version != completion_exec_version ||
+        blacklist_version != completion_blacklist_version) {
+        std::vector<std::string> names = policy.executables().names();
+        names.insert(names.end(), BUILTIN_COMMANDS.begin(), BUILTIN_COMMANDS.end());
+        const BlacklistSnapshot& blocked = policy.blacklist().snapshot();
+        names.erase(std::remove_if(names.begin(), names.end(),
+            [&blocked](const std::string& name) { return blocked.contains(name); }), names.end());
+        command_completions.assign(std::move(names));
+        completion_exec_version = exec_version;
+        completion_blacklist_version = blacklist_version;
+    }
+    return command_completions;
+}
+
+const PrefixIndex& SecShell::completion_services() {
+    time_t now = time(nullptr);
+    if (service_units_loaded != 0 && now - service_units_loaded < SERVICE_UNITS_TTL) return service_units;
+    service_units_loaded = now;
+
+    std::vector<std::string> units;
+    std::string output;
+    std::string systemctl = systemctl_path();
+    if (!systemctl.empty() && capture_output(systemctl, {"systemctl", "list-units", "--type=service", "--all",
+                                                 "--no-legend", "--plain", "--no-pager"}, output, variables.envp())) {
+        size_t pos = 0;
+        while (pos < output.size()) {
+            size_t eol = output.find('\n', pos);
+            if (eol == std::string::npos) eol = output.size();
+            std::string_view line(output.data() + pos, eol - pos);
+            size_t begin = line.find_first_not_of(" \t");
+            if (begin != std::string_view::npos) {
+                line.remove_prefix(begin);
+                std::string_view unit = line.substr(0, line.find_first_of(" \t"));
+                if (unit.size() > 8 && unit.substr(unit.size() - 8) == ".service") {
+                    units.emplace_back(unit.substr(0, unit.size() - 8));
+                }
+            }
+            pos = eol + 1;
+        }
+    }
+    service_units.assign(std::move(units));
+    return service_units;
+}
@@ -0,0 +1,423 @@
+// SecShell's lifecycle: construction and configuration, the services it
+// starts, the command loop with its readline prompt and event loop, and
+// the batch and daemon entry points.
+#include "secshell.h"
+
+SecShell::SecShell(const std::string& blacklist_path, bool interactive_mode, StartupTrace* trace)
+    : BLACKLIST(blacklist_path), interactive(interactive_mode) {
+    configure();
+
+    load_blacklist(BLACKLIST); // Load blacklisted commands from file
+    if (trace) trace->mark("load_blacklist");
+    load_rules();
+    if (trace) trace->mark("load_rules");
+
+    policy.index_executables(interactive);
+    if (trace) trace->mark("index build");
+
+    start_services(trace);
+}
+
+SecShell::SecShell(const std::string& blacklist_path, Zygote)
+    : BLACKLIST(blacklist_path), RULES(sibling_path(blacklist_path, ".rules")), interactive(false) {
+    load_blacklist(BLACKLIST);
+    blacklist_stamp = file_stamp(BLACKLIST);
+    load_rules();
+    policy.index_executables();
+    completion_commands();
+}
+
+void SecShell::refresh_policy() {
+    policy.executables().refresh();
+    std::string stamp = file_stamp(BLACKLIST);
+    if (stamp != blacklist_stamp) {
+        load_blacklist(BLACKLIST);
+        blacklist_stamp = stamp;
+    }
+    refresh_rules();
+}
+
+void SecShell::begin_session(bool interactive_mode) {
+    interactive = interactive_mode;
+    variables = VariableStore();
+    configure();
+    fast_path.reload_locale();
+    policy.executables().rewatch(interactive); // The inherited inotify descriptor is the daemon's
+    start_services(nullptr);
+    if (interactive && file_stamp(BLACKLIST) != blacklist_stamp) {
+        load_blacklist(BLACKLIST); // Edited between the fork and the watch
+    }
+    refresh_rules(); // SECSHELL_RULES may name another file
+}
+
+std::string SecShell::clear_sequence(const std::string& term) {
+    std::string output;
+    const std::string* path = policy.executables().lookup("clear");
+    if (!path) return output;
+    std::string term_entry = "TERM=" + term;
+    char* envp[] = {const_cast<char*>(term_entry.c_str()), nullptr};
+    if (!capture_output(*path, {"clear"}, output, envp)) output.clear();
+    return output;
+}
+
+void SecShell::configure() {
+    const char* allow_env = getenv("SECSHELL_ENV_ALLOW");
+    variables.import(environ, allow_env ? allow_env : "");
+    const char* drawbox_mode = getenv("SECSHELL_DRAWBOX");
+    use_external_drawbox = drawbox_mode && std::string(drawbox_mode) == "external";
+    const char* fast_path_env = getenv("SECSHELL_FASTPATH");
+    use_fast_path = !fast_path_env || std::string(fast_path_env) != "0";
+    const char* pipe_size_env = getenv("SECSHELL_PIPE_SIZE");
+    if (pipe_size_env) pipe_size = atoi(pipe_size_env);
+    const char* systemctl_env = getenv("SECSHELL_SYSTEMCTL");
+    if (systemctl_env) systemctl_override = systemctl_env;
+    const char* services_jobs_env = getenv("SECSHELL_SERVICES_JOBS");
+    if (services_jobs_env) services_jobs = atoi(services_jobs_env);
+    const char* capture_env = getenv("SECSHELL_CAPTURE_OUTPUT");
+    capture_background = capture_env && std::string(capture_env) == "1";
+    const char* capture_buffer_env = getenv("SECSHELL_CAPTURE_BUFFER");
+    if (capture_buffer_env) capture_memory_bytes = strtoull(capture_buffer_env, nullptr, 10);
+    const char* capture_spill_env = getenv("SECSHELL_CAPTURE_SPILL");
+    if (capture_spill_env) capture_spill_bytes = strtoull(capture_spill_env, nullptr, 10);
+    const char* metrics_file_env = getenv("SECSHELL_METRICS_FILE");
+    metrics_file = metrics_file_env ? metrics_file_env : "";
+    const char* metrics_interval_env = getenv("SECSHELL_METRICS_INTERVAL");
+    if (metrics_interval_env) metrics_interval = atoi(metrics_interval_env);
+    const char* glob_env = getenv("SECSHELL_GLOB");
+    use_glob = !glob_env || std::string(glob_env) != "0";
+    const char* glob_max_env = getenv("SECSHELL_GLOB_MAX");
+    if (glob_max_env) glob.max_results = strtoull(glob_max_env, nullptr, 10);
+    const char* glob_bytes_env = getenv("SECSHELL_GLOB_MAX_BYTES");
+    if (glob_bytes_env) glob.max_bytes = strtoull(glob_bytes_env, nullptr, 10);
+    const char* glob_jobs_env = getenv("SECSHELL_GLOB_JOBS");
+    if (glob_jobs_env) glob.threads = std::max(1, atoi(glob_jobs_env));
+    const char* rules_env = getenv("SECSHELL_RULES");
+    RULES = rules_env && *rules_env ? rules_env : sibling_path(BLACKLIST, ".rules");
+    const char* prompt_deadline_env = getenv("SECSHELL_PROMPT_DEADLINE_MS");
+    if (prompt_deadline_env) prompt.deadline_ms = std::max(0, atoi(prompt_deadline_env));
+    configure_sandbox();
+    prompt.async_us = &metrics.prompt_async_us;
+    char cwd[PATH_MAX];
+    working_directory = getcwd(cwd, sizeof(cwd)) ? cwd : "/";
+    refresh_prompt_context();
+}
+
+void SecShell::refresh_prompt_context() {
+    const char* spec = variables.get("SECSHELL_PROMPT");
+    std::string wanted = spec && *spec ? spec : PromptRenderer::DEFAULT_SEGMENTS;
+    if (wanted != prompt_spec) {
+        std::string error;
+        if (!prompt.configure(wanted, error)) print_error("SECSHELL_PROMPT: " + error);
+        prompt_spec = wanted;
+    }
+    const char* user = variables.get("USER");
+    char host[256];
+    if (gethostname(host, sizeof(host)) != 0) strcpy(host, "?");
+    host[sizeof(host) - 1] = '\0';
+    prompt.set_context(user ? user : "unknown", host, working_directory);
+}
+
+void SecShell::configure_sandbox() {
+    const char* sandbox_env = getenv("SECSHELL_SANDBOX");
+    use_sandbox = sandbox_env && std::string(sandbox_env) == "1";
+    sandbox_options = Sandbox::Options();
+    sandbox_error.clear();
+    if (!use_sandbox) return;
+    const char* writable_env = getenv("SECSHELL_SANDBOX_WRITABLE");
+    const char* home = getenv("HOME");
+    std::string writable = writable_env ? writable_env : std::string(home ? home : "") + ":/tmp:/var/tmp:/dev/shm";
+    for (size_t start = 0; start <= writable.size();) {
+        size_t colon = std::min(writable.find(':', start), writable.size());
+        std::string path = writable.substr(start, colon - start);
+        std::vector<std::string>& paths = sandbox_options.writable;
+        if (!path.empty() && path[0] == '/' && std::find(paths.begin(), paths.end(), path) == paths.end()) paths.push_back(path);
+        start = colon + 1;
+    }
+    const char* cgroup_env = getenv("SECSHELL_SANDBOX_CGROUP");
+    if (cgroup_env) sandbox_options.cgroup_parent = cgroup_env;
+    const char* cpu_env = getenv("SECSHELL_SANDBOX_CPU");
+    const char* memory_env = getenv("SECSHELL_SANDBOX_MEMORY");
+    const char* pids_env = getenv("SECSHELL_SANDBOX_PIDS");
+    if (cpu_env && *cpu_env && (sandbox_options.cpu_max = Sandbox::cpu_max(cpu_env)).empty()) {
+        sandbox_error = "SECSHELL_SANDBOX_CPU is not a percentage: " + std::string(cpu_env);
+    }
+    if (memory_env && *memory_env && (sandbox_options.memory_max = Sandbox::bytes(memory_env)).empty()) {
+        sandbox_error = "SECSHELL_SANDBOX_MEMORY is not a size: " + std::string(memory_env);
+    }
+    if (pids_env && *pids_env && (sandbox_options.pids_max = Sandbox::bytes(pids_env)).empty()) {
+        sandbox_error = "SECSHELL_SANDBOX_PIDS is not a number: " + std::string(pids_env);
+    }
+}
+
+std::string SecShell::sibling_path(const std::string& path, const std::string& name) {
+    size_t slash = path.rfind('/');
+    return slash == std::string::npos ? name : path.substr(0, slash + 1) + name;
+}
+
+void SecShell::load_rules() {
+    std::vector<std::string> errors;
+    if (!policy.load_rules(RULES, errors)) {
+        print_error("Failed to open rules file: " + RULES);
+    }
+    for (const auto& error : errors) print_error(RULES + ": " + error);
+    rules_stamp = RULES + "\n" + file_stamp(RULES);
+}
+
+void SecShell::refresh_rules() {
+    if (RULES + "\n" + file_stamp(RULES) != rules_stamp) load_rules();
+}
+
+void SecShell::start_services(StartupTrace* trace) {
+    if (use_sandbox) {
+        if (sandbox_error.empty() && !sandbox.prepare(sandbox_options, sandbox_error)) {
+            sandbox_error = "cannot prepare the sandbox: " + sandbox_error;
+        }
+        if (!sandbox_error.empty()) print_error(sandbox_error + "; external commands are refused");
+        for (const auto& note : sandbox.notes()) print_alert("Sandbox: " + note);
+        if (trace) trace->mark("sandbox");
+    }
+
+    const char* audit_path = getenv("SECSHELL_AUDIT_LOG");
+    if (audit_path && *audit_path) {
+        const char* rotate_env = getenv("SECSHELL_AUDIT_MAX_BYTES");
+        uint64_t rotate_bytes = rotate_env ? strtoull(rotate_env, nullptr, 10) : AUDIT_ROTATE_BYTES;
+        if (!audit.open(audit_path, rotate_bytes)) {
+            print_error("Failed to open audit log " + std::string(audit_path) + ": " + strerror(errno));
+        }
+        if (trace) trace->mark("audit log");
+    }
+
+    if (!metrics_file.empty()) {
+        if (!metrics_exporter.start(metrics, metrics_file, metrics_interval)) {
+            print_error("Failed to write metrics file " + metrics_file + ": " + strerror(errno));
+        }
+        if (trace) trace->mark("metrics exporter");
+    }
+
+    if (interactive) {
+        policy.blacklist().watch(BLACKLIST);
+        if (trace) trace->mark("blacklist watch");
+    }
+}
+
+std::string SecShell::file_stamp(const std::string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return "";
+    return std::to_string(st.st_ino) + ":" + std::to_string(st.st_size) + ":" +
+           std::to_string(st.st_mtim.tv_sec) + "." + std::to_string(st.st_mtim.tv_nsec);
+}
+
+void SecShell::report_commands(int fd) { command_report_fd = fd; }
+
+int SecShell::run_command(const std::string& line) {
+    process_command(sanitize_input(line));
+    return last_status;
+}
+
+int SecShell::run_batch(std::istream& in) {
+    std::string line;
+    while (running && std::getline(in, line)) {
+        size_t first = line.find_first_not_of(" \t");
+        if (first == std::string::npos || line[first] == '#') continue;
+        process_command(sanitize_input(line));
+    }
+    return last_status;
+}
+
+void SecShell::run() {
+    // Register signal handlers
+    signal(SIGINT, signal_handler);
+    signal(SIGTSTP, signal_handler);
+
+    if (!setup_event_loop()) {
+        print_error("Failed to set up event loop: " + std::string(strerror(errno)));
+        return;
+    }
+
+    uint64_t waiting_since = AuditLog::monotonic_us();
+    while (running) {
+        if (!prompt_installed && !prompt_suspended) {
+            install_prompt();
+        }
+        wait_for_events();
+        if (line_ready) {
+            line_ready = false;
+            metrics.readline_us.record(AuditLog::monotonic_us() - waiting_since);
+            if (command_report_fd != -1 && !pending_line.empty()) {
+                PtyRelay::report_command(command_report_fd, pending_line);
+            }
+            process_command(pending_line);
+            waiting_since = AuditLog::monotonic_us();
+        }
+    }
+
+    if (prompt_installed) {
+        rl_callback_handler_remove();
+        prompt_installed = false;
+    }
+}
+
+std::string SecShell::build_prompt() {
+    return prompt.render({last_status, jobs.size()});
+}
+
+bool SecShell::setup_event_loop() {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGWINCH);
+    if (sigprocmask(SIG_BLOCK, &mask, nullptr) == -1) return false;
+
+    signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (signal_fd == -1 || epoll_fd == -1) return false;
+
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = signal_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, signal_fd, &ev) == -1) return false;
+    if (policy.executables().fd() != -1) {
+        ev.data.fd = policy.executables().fd();
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, policy.executables().fd(), &ev);
+    }
+    if (prompt.start() != -1) {
+        ev.data.fd = prompt.fd();
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, prompt.fd(), &ev);
+    }
+
+    // Regular files cannot be polled; they are always readable anyway
+    ev.data.fd = STDIN_FILENO;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, STDIN_FILENO, &ev) == -1) {
+        if (errno != EPERM) return false;
+        stdin_always_ready = true;
+    }
+
+    active_shell = this;
+    rl_catch_sigwinch = 0; // SIGWINCH arrives through the signalfd instead
+    rl_bind_keyseq("\\C-r", reverse_search);
+    rl_attempted_completion_function = complete;
+    rl_completer_quote_characters = "\"'";
+    rl_filename_quote_characters = " \t\"'\\|&<>$";
+    load_recent_history();
+    return true;
+}
+
+void SecShell::wait_for_events() {
+    struct epoll_event events[8];
+    int n = epoll_wait(epoll_fd, events, 8, stdin_always_ready ? 0 : -1);
+    if (n == -1) {
+        if (errno != EINTR) running = false;
+        return;
+    }
+
+    bool stdin_ready = stdin_always_ready;
+    for (int i = 0; i < n; ++i) {
+        int fd = events[i].data.fd;
+        if (fd == signal_fd) {
+            handle_signals();
+        } else if (fd == policy.executables().fd()) {
+            policy.executables().refresh();
+        } else if (fd == prompt.fd()) {
+            repaint_prompt();
+        } else if (fd == STDIN_FILENO) {
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) stdin_ready = true;
+        } else {
+            drain_capture(fd);
+        }
+    }
+
+    if (stdin_ready && prompt_installed) {
+        rl_callback_read_char();
+    }
+}
+
+void SecShell::install_prompt() {
+    uint64_t start = AuditLog::monotonic_us();
+    current_prompt = build_prompt();
+    metrics.prompt_us.record(AuditLog::monotonic_us() - start);
+    rl_callback_handler_install(current_prompt.c_str(), line_handler);
+    prompt_installed = true;
+}
+
+void SecShell::repaint_prompt() {
+    std::string updated;
+    if (!prompt.take_update(updated) || !prompt_installed) return;
+    int rows, columns;
+    rl_get_screen_size(&rows, &columns);
+    int up = PromptRenderer::rows_above_cursor(current_prompt, std::string_view(rl_line_buffer, rl_point), columns);
+    std::cout.flush();
+    BoxRenderer::write_all(STDOUT_FILENO, "\r" + (up ? "\033[" + std::to_string(up) + "A" : std::string()) + "\033[J");
+    current_prompt = std::move(updated);
+    rl_set_prompt(current_prompt.c_str());
+    rl_forced_update_display();
+}
+
+void SecShell::suspend_prompt() {
+    if (!prompt_installed) return;
+    saved_line.assign(rl_line_buffer, rl_end);
+    saved_point = rl_point;
+    rl_callback_handler_remove();
+    prompt_installed = false;
+    prompt_suspended = true;
+    std::cout << "\n";
+}
+
+void SecShell::resume_prompt() {
+    if (!prompt_suspended) return;
+    prompt_suspended = false;
+    install_prompt();
+    rl_replace_line(saved_line.c_str(), 0);
+    rl_point = saved_point;
+    rl_redisplay();
+}
+
+void SecShell::line_handler(char* line) {
+    SecShell* shell = active_shell;
+    rl_callback_handler_remove();
+    shell->prompt_installed = false;
+
+    if (!line) {
+        // EOF behaves like 'exit', including when 'exit' is blacklisted
+        std::cout << "\n";
+        if (isatty(STDIN_FILENO) && shell->policy.blacklisted("exit")) {
+            shell->print_error("Command is blacklisted: exit");
+        } else {
+            shell->running = false;
+        }
+        return;
+    }
+
+    if (*line) {
+        add_history(line);
+        shell->history_store.append(line);
+    }
+    shell->pending_line = shell->sanitize_input(line);
+    shell->line_ready = true;
+    free(line);
+}
+
+void SecShell::handle_signals() {
+    struct signalfd_siginfo info;
+    bool child_exited = false;
+    while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+        if (info.ssi_signo == SIGCHLD) {
+            child_exited = true;
+        } else if (info.ssi_signo == SIGWINCH && prompt_installed) {
+            rl_resize_terminal();
+        }
+    }
+    if (child_exited) {
+        reap_children();
+    }
+}
+
+void SecShell::rehash() {
+    policy.index_executables();
+    print_alert("Executable index rebuilt: " + std::to_string(policy.executables().size()) + " commands (hits: " +
+        std::to_string(policy.executables().hit_count()) + ", misses: " + std::to_string(policy.executables().miss_count()) + ")");
+}
+
+void SecShell::signal_handler(int signum) {
+    if (signum == SIGINT) FastPath::interrupt();
+    std::cout << "\nReceived signal " << signum << ". Use 'exit' to quit. Press ENTER to continue...\n";
+}
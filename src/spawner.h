@@ -0,0 +1,83 @@
+#ifndef SECSHELL_SPAWNER_H
+#define SECSHELL_SPAWNER_H
+
+#include <string>
+#include <vector>
+
+#include <signal.h>
+#include <spawn.h>
+
+#include "sandbox.h"
+
+extern char** environ;
+
+// Launches children with posix_spawn. glibc implements it with
+// clone(CLONE_VM|CLONE_VFORK), so unlike fork() the cost does not grow
+// with the shell's resident size. Redirections and pipe wiring are
+// expressed as file actions applied in the child before exec. With
+// isolate(), children start in a Sandbox instead, with the same wiring.
+class Spawner {
+public:
+    Spawner() {
+        posix_spawn_file_actions_init(&actions);
+        posix_spawnattr_init(&attr);
+
+        // Children start with an empty signal mask and default dispositions,
+        // whatever the shell itself blocks or ignores.
+        sigset_t mask, defaults;
+        sigemptyset(&mask);
+        sigemptyset(&defaults);
+        for (int sig : {SIGINT, SIGQUIT, SIGTSTP, SIGTTIN, SIGTTOU, SIGPIPE, SIGCHLD}) {
+            sigaddset(&defaults, sig);
+        }
+        posix_spawnattr_setsigmask(&attr, &mask);
+        posix_spawnattr_setsigdefault(&attr, &defaults);
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+    }
+
+    ~Spawner() {
+        posix_spawn_file_actions_destroy(&actions);
+        posix_spawnattr_destroy(&attr);
+    }
+
+    Spawner(const Spawner&) = delete;
+    Spawner& operator=(const Spawner&) = delete;
+
+    // Makes target_fd in the child refer to fd. Source descriptors are
+    // expected to be O_CLOEXEC so they vanish from the child at exec.
+    void redirect(int fd, int target_fd) {
+        if (fd != target_fd) {
+            posix_spawn_file_actions_adddup2(&actions, fd, target_fd);
+            redirects.emplace_back(fd, target_fd);
+        }
+    }
+
+    // Later spawns start in sandbox, which must outlive them; nullptr
+    // goes back to posix_spawn
+    void isolate(const Sandbox* use) {
+        sandbox = use;
+    }
+
+    // Returns 0 and sets pid on success, otherwise the errno from the
+    // failed file action or exec. envp goes to the child as is.
+    int spawn(const std::string& path, const std::vector<std::string>& args, pid_t& pid,
+              char* const* envp = environ) const {
+        if (sandbox) {
+            return sandbox->spawn(path, args, redirects, pid, envp);
+        }
+        std::vector<char*> argv;
+        for (const auto& arg : args) {
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+        return posix_spawn(&pid, path.c_str(), &actions, &attr, argv.data(), envp);
+    }
+
+private:
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    std::vector<Sandbox::Redirect> redirects;
+    const Sandbox* sandbox = nullptr;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef SECSHELL_STARTUP_TRACE_H
+#define SECSHELL_STARTUP_TRACE_H
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Times the startup phases for --startup-trace. Each mark() records the time
+// since the previous one; report() prints the phases to stderr.
+class StartupTrace {
+public:
+    StartupTrace() : start(clock::now()), last(start) {}
+
+    void mark(const std::string& phase) {
+        clock::time_point now = clock::now();
+        phases.emplace_back(phase, now - last);
+        last = now;
+    }
+
+    void report() const {
+        for (const auto& phase : phases) {
+            fprintf(stderr, "startup: %-18s %9.3f ms\n", phase.first.c_str(), to_ms(phase.second));
+        }
+        fprintf(stderr, "startup: %-18s %9.3f ms\n", "total", to_ms(last - start));
+    }
+
+private:
+    using clock = std::chrono::steady_clock;
+    clock::time_point start;
+    clock::time_point last;
+    std::vector<std::pair<std::string, clock::duration>> phases;
+
+    static double to_ms(clock::duration d) {
+        return std::chrono::duration<double, std::milli>(d).count();
+    }
+};
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef SECSHELL_VARIABLE_STORE_H
+#define SECSHELL_VARIABLE_STORE_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fnmatch.h>
+
+// Shell variables, shell-local and exported, in one hash table so $NAME
+// expansion is a single lookup. Children get an envp array built from the
+// exported variables and cached until an export changes. With an allowlist
+// (SECSHELL_ENV_ALLOW) only matching names are ever exported, so children
+// see a small, predictable environment. The process's own environ mirrors
+// every variable that came from it or was exported, for in-process readers
+// such as cd's $HOME and the ls fast path's $LS_COLORS.
+class VariableStore {
+public:
+    struct Variable {
+        std::string value;
+        bool exported = false;
+    };
+
+    // Imports the inherited environment. allow is a list of names or glob
+    // patterns separated by ':' or ','; empty allows every name.
+    void import(char** env, const std::string& allow) {
+        allowlist.clear();
+        size_t pos = 0;
+        while (pos < allow.size()) {
+            size_t end = std::min(allow.find_first_of(":, ", pos), allow.size());
+            if (end > pos) allowlist.push_back(allow.substr(pos, end - pos));
+            pos = end + 1;
+        }
+        for (char** entry = env; *entry; ++entry) {
+            const char* equals = strchr(*entry, '=');
+            if (!equals) continue;
+            std::string name(*entry, equals - *entry);
+            Variable& variable = variables[name];
+            variable.value = equals + 1;
+            variable.exported = allowed(name);
+        }
+        dirty = true;
+    }
+
+    bool allowed(const std::string& name) const {
+        if (allowlist.empty()) return true;
+        for (const auto& pattern : allowlist) {
+            if (fnmatch(pattern.c_str(), name.c_str(), 0) == 0) return true;
+        }
+        return false;
+    }
+
+    const char* get(const std::string& name) const {
+        auto it = variables.find(name);
+        return it == variables.end() ? nullptr : it->second.value.c_str();
+    }
+
+    // Sets a variable. An exported one stays exported. Returns false if
+    // export was asked for a name outside the allowlist; the variable is
+    // then set shell-local.
+    bool set(const std::string& name, const std::string& value, bool exported = false) {
+        bool permitted = !exported || allowed(name);
+        Variable& variable = variables[name];
+        variable.value = value;
+        variable.exported = variable.exported || (exported && permitted);
+        if (variable.exported) dirty = true;
+        if (variable.exported || getenv(name.c_str())) setenv(name.c_str(), value.c_str(), 1);
+        return permitted;
+    }
+
+    // Exports an existing variable. Returns false if it does not exist or
+    // the allowlist refuses it.
+    bool export_name(const std::string& name) {
+        auto it = variables.find(name);
+        if (it == variables.end() || !allowed(name)) return false;
+        if (!it->second.exported) {
+            it->second.exported = true;
+            dirty = true;
+            setenv(name.c_str(), it->second.value.c_str(), 1);
+        }
+        return true;
+    }
+
+    bool unset(const std::string& name) {
+        auto it = variables.find(name);
+        if (it == variables.end()) return false;
+        if (it->second.exported) dirty = true;
+        variables.erase(it);
+        unsetenv(name.c_str());
+        return true;
+    }
+
+    // The environment for execve/posix_spawn, sorted by name. Rebuilt only
+    // after an exported variable changed.
+    char* const* envp() {
+        if (dirty) {
+            entries.clear();
+            for (const auto& variable : variables) {
+                if (variable.second.exported) entries.push_back(variable.first + "=" + variable.second.value);
+            }
+            std::sort(entries.begin(), entries.end());
+            pointers.clear();
+            for (auto& entry : entries) pointers.push_back(&entry[0]);
+            pointers.push_back(nullptr);
+            dirty = false;
+            ++rebuilds;
+        }
+        return pointers.data();
+    }
+
+    const std::unordered_map<std::string, Variable>& all() const { return variables; }
+    unsigned long rebuild_count() const { return rebuilds; }
+    bool restricted() const { return !allowlist.empty(); }
+
+    static bool valid_name(const std::string& name) {
+        if (name.empty() || isdigit(static_cast<unsigned char>(name[0]))) return false;
+        return std::all_of(name.begin(), name.end(), [](char c) { return isalnum(static_cast<unsigned char>(c)) || c == '_'; });
+    }
+
+private:
+    std::unordered_map<std::string, Variable> variables;
+    std::vector<std::string> allowlist;
+    std::vector<std::string> entries;   // "NAME=value" strings envp points into
+    std::vector<char*> pointers;
+    bool dirty = true;
+    unsigned long rebuilds = 0;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef SECSHELL_WORK_STEALING_POOL_H
+#define SECSHELL_WORK_STEALING_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "helper_thread.h"
+
+// Runs a fixed set of tasks on N threads. Each worker owns a deque seeded
+// round-robin with task indexes and takes from its front; an idle worker
+// steals from the back of another's, so a few slow tasks never leave the
+// remaining work stuck behind one thread.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(size_t workers) : queues(std::max<size_t>(workers, 1)) {}
+
+    void run(size_t tasks, const std::function<void(size_t task)>& work) {
+        for (size_t i = 0; i < tasks; ++i) {
+            queues[i % queues.size()].tasks.push_back(i);
+        }
+
+        std::vector<std::thread> threads;
+        for (size_t w = 0; w < queues.size(); ++w) {
+            threads.push_back(start_helper_thread([this, w, &work] {
+                size_t task;
+                while (take(w, task)) work(task);
+            }));
+        }
+        for (auto& thread : threads) thread.join();
+    }
+
+    unsigned long steal_count() const { return steals.load(std::memory_order_relaxed); }
+
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<size_t> tasks;
+    };
+    std::vector<Queue> queues;
+    std::atomic<unsigned long> steals{0};
+
+    // No task is ever added once running, so every queue empty means done.
+    bool take(size_t self, size_t& task) {
+        {
+            std::lock_guard<std::mutex> guard(queues[self].lock);
+            if (!queues[self].tasks.empty()) {
+                task = queues[self].tasks.front();
+                queues[self].tasks.pop_front();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < queues.size(); ++i) {
+            Queue& victim = queues[(self + i) % queues.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.tasks.empty()) {
+                task = victim.tasks.back();
+                victim.tasks.pop_back();
+                steals.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+#endif
@@ -0,0 +1,60 @@
+#include "../src/audit_log.h"
+#include "test.h"
+
+#include <fstream>
+
+namespace {
+
+// Records in one log file, or -1 if it does not decode to the end
+int count_records(const std::string& path) {
+    std::ifstream file(path);
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    AuditLog::Header header;
+    size_t pos = AuditLog::read_header(data.data(), data.size(), header);
+    if (pos == 0) return -1;
+    int records = 0;
+    while (pos < data.size()) {
+        AuditLog::Record record;
+        pos = AuditLog::read_record(data.data(), data.size(), pos, record);
+        if (pos == 0) return -1;
+        ++records;
+    }
+    return records;
+}
+
+} // namespace
+
+TEST(audit_log_shared_between_sessions) {
+    test::TempDir temp("audit_test");
+    std::string path = temp.dir + "/audit";
+    AuditLog first, second;
+    CHECK(first.open(path, 4096));
+    CHECK(second.open(path, 4096));
+    struct stat st;
+    CHECK(stat(path.c_str(), &st) == 0 && (st.st_mode & 0777) == 0622);
+
+    // Both writers flush every round, and rotate the file from under each other
+    for (int round = 0; round < 4; ++round) {
+        for (int i = 0; i < 10; ++i) {
+            first.decision(AuditLog::Allowed, {"echo", "first", std::to_string(round), std::to_string(i)});
+            second.decision(AuditLog::Denied, {"echo", "second", std::to_string(round), std::to_string(i)});
+        }
+        usleep((AuditLog::FLUSH_INTERVAL_MS + 100) * 1000);
+    }
+    first.close();
+    second.close();
+    CHECK_EQ(first.records_written() + second.records_written(), uint64_t(80));
+
+    // Every file starts with one header and decodes to the end; nothing
+    // was appended to a file after it was rotated away
+    int total = 0;
+    for (int i = 0; i <= AuditLog::KEEP_ROTATED; ++i) {
+        std::string name = i == 0 ? path : path + "." + std::to_string(i);
+        if (access(name.c_str(), F_OK) != 0) continue;
+        int records = count_records(name);
+        CHECK(records >= 0);
+        total += records;
+    }
+    CHECK(access((path + ".1").c_str(), F_OK) == 0);
+    CHECK_EQ(total, 80);
+}
@@ -0,0 +1,132 @@
+#include "../src/glob_expander.h"
+#include "test.h"
+
+#include <fstream>
+
+#include <sys/stat.h>
+
+namespace {
+
+// logs/app-1.log app-2.log app-10.log error.txt .hidden.log
+// logs/2024/jan.log logs/2024/.cache/x.log, src/main.cpp src/util/io.cpp
+struct GlobFixture {
+    test::TempDir temp{"glob_test"};
+    std::string dir = temp.dir;
+    GlobExpander glob;
+
+    GlobFixture() {
+        for (const char* sub : {"/logs", "/logs/2024", "/logs/2024/.cache", "/src", "/src/util"}) {
+            mkdir((dir + sub).c_str(), 0755);
+        }
+        for (const char* file : {"/logs/app-1.log", "/logs/app-2.log", "/logs/app-10.log", "/logs/error.txt",
+                                 "/logs/.hidden.log", "/logs/2024/jan.log", "/logs/2024/.cache/x.log",
+                                 "/src/main.cpp", "/src/util/io.cpp"}) {
+            std::ofstream(dir + file) << "x\n";
+        }
+    }
+
+    std::vector<std::string> expand(const std::string& word, GlobExpander::Result expected = GlobExpander::Expanded) {
+        std::vector<std::string> out;
+        CHECK_EQ(glob.expand(word, dir, out), expected);
+        return out;
+    }
+};
+
+using Words = std::vector<std::string>;
+
+} // namespace
+
+TEST(glob_wildcards) {
+    GlobFixture fixture;
+    CHECK(fixture.expand("logs/*.log") == Words({"logs/app-1.log", "logs/app-10.log", "logs/app-2.log"}));
+    CHECK(fixture.expand("logs/app-?.log") == Words({"logs/app-1.log", "logs/app-2.log"}));
+    CHECK(fixture.expand("logs/app-[!2]*") == Words({"logs/app-1.log", "logs/app-10.log"}));
+    CHECK(fixture.expand("logs/*error*") == Words({"logs/error.txt"}));
+    CHECK(fixture.expand("logs/.*.log") == Words({"logs/.hidden.log"}));
+    CHECK(fixture.expand("*/") == Words({"logs/", "src/"}));
+    CHECK(fixture.expand("*/util") == Words({"src/util"}));
+    CHECK(fixture.expand(fixture.dir + "/src/*.cpp") == Words({fixture.dir + "/src/main.cpp"}));
+}
+
+TEST(glob_no_match_stays_literal) {
+    GlobFixture fixture;
+    CHECK(fixture.expand("logs/*.gz", GlobExpander::NoMatch) == Words({"logs/*.gz"}));
+    CHECK(fixture.expand("missing/*", GlobExpander::NoMatch) == Words({"missing/*"}));
+    CHECK(fixture.expand("*/nothing", GlobExpander::NoMatch) == Words({"*/nothing"}));
+    CHECK(fixture.expand("{x}", GlobExpander::NoMatch) == Words({"{x}"}));
+    CHECK(!GlobExpander::has_magic("plain/path.txt"));
+    CHECK(GlobExpander::has_magic("a{b,c}"));
+}
+
+TEST(glob_braces) {
+    GlobFixture fixture;
+    CHECK(fixture.expand("{b,a}.conf") == Words({"b.conf", "a.conf"}));
+    CHECK(fixture.expand("x{1,{2,3}y}") == Words({"x1", "x2y", "x3y"}));
+    CHECK(fixture.expand("logs/{error.txt,*-1.log}") == Words({"logs/error.txt", "logs/app-1.log"}));
+    CHECK(fixture.expand("src/{*.cpp,*.h}") == Words({"src/main.cpp", "src/*.h"}));
+}
+
+TEST(glob_recursive) {
+    GlobFixture fixture;
+    CHECK(fixture.expand("**/*.log") == Words({"logs/2024/jan.log", "logs/app-1.log", "logs/app-10.log", "logs/app-2.log"}));
+    CHECK(fixture.expand("src/**") == Words({"src/main.cpp", "src/util", "src/util/io.cpp"}));
+    CHECK(fixture.expand("**/") == Words({"logs/", "logs/2024/", "src/", "src/util/"}));
+
+    // Wide trees fan out over the pool with the same result
+    for (int i = 0; i < 40; ++i) {
+        std::string sub = fixture.dir + "/wide/d" + std::to_string(i);
+        mkdir((fixture.dir + "/wide").c_str(), 0755);
+        mkdir(sub.c_str(), 0755);
+        std::ofstream(sub + "/f.log") << "x\n";
+    }
+    fixture.glob.threads = 4;
+    Words parallel = fixture.expand("wide/**/*.log");
+    fixture.glob.threads = 1;
+    CHECK_EQ(parallel.size(), size_t(40));
+    CHECK(parallel == fixture.expand("wide/**/*.log"));
+}
+
+TEST(glob_limits) {
+    GlobFixture fixture;
+    fixture.glob.max_results = 2;
+    std::vector<std::string> out;
+    CHECK_EQ(fixture.glob.expand("logs/*.log", fixture.dir, out), GlobExpander::TooLarge);
+    CHECK(out.empty());
+    CHECK_EQ(fixture.glob.expand("**/*.log", fixture.dir, out), GlobExpander::TooLarge);
+    CHECK_EQ(fixture.glob.expand("{a,b,c}", fixture.dir, out), GlobExpander::TooLarge);
+    CHECK_EQ(fixture.glob.expand("logs/app-?.log", fixture.dir, out), GlobExpander::Expanded);
+    fixture.glob.max_results = 100;
+    fixture.glob.max_bytes = 20;
+    out.clear();
+    CHECK_EQ(fixture.glob.expand("logs/app-?.log", fixture.dir, out), GlobExpander::TooLarge);
+
+    // Few alternatives, but each carries a long suffix: stopped on bytes
+    // while they are built, not after
+    fixture.glob.max_results = 100000;
+    fixture.glob.max_bytes = 1 << 20;
+    std::string word;
+    for (int i = 0; i < 16; ++i) word += "{a,b}";
+    word += std::string(30000, 'x');
+    out.clear();
+    CHECK_EQ(fixture.glob.expand(word, fixture.dir, out), GlobExpander::TooLarge);
+    CHECK(out.empty());
+    CHECK_EQ(fixture.glob.expand("{a,b}" + std::string(1000, 'x'), fixture.dir, out), GlobExpander::Expanded);
+    CHECK_EQ(out.size(), size_t(2));
+}
+
+TEST(glob_listing_cache) {
+    GlobFixture fixture;
+    // An old mtime, so the listing is trusted until the directory changes
+    std::string logs = fixture.dir + "/logs";
+    struct timespec old[2] = {{1000000000, 0}, {1000000000, 0}};
+    CHECK_EQ(utimensat(AT_FDCWD, logs.c_str(), old, 0), 0);
+    fixture.expand("logs/*.log");
+    unsigned long reads = fixture.glob.read_count();
+    fixture.expand("logs/*.txt");
+    CHECK_EQ(fixture.glob.read_count(), reads);
+    CHECK(fixture.glob.hit_count() >= 1);
+
+    std::ofstream(logs + "/app-3.log") << "x\n";
+    CHECK_EQ(fixture.expand("logs/*-3.log"), Words({"logs/app-3.log"}));
+    CHECK(fixture.glob.read_count() > reads);
+}
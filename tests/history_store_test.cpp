@@ -0,0 +1,42 @@
+#include "../src/history_store.h"
+#include "test.h"
+
+#include <fstream>
+
+TEST(history_store_search_sees_appends_after_indexing) {
+    test::TempDir temp("history_test");
+    HistoryStore history;
+    CHECK(history.open(temp.dir + "/history"));
+    CHECK(history.append("git status"));
+    CHECK(history.append("make all"));
+    CHECK_EQ(history.find_before("status", HistoryStore::npos), size_t(0)); // Builds the index
+
+    // Only the new record has these trigrams; the index must catch up first
+    CHECK(history.append("git stash"));
+    CHECK(history.search("stash") == std::vector<uint32_t>({2}));
+    CHECK(history.search("git") == std::vector<uint32_t>({0, 2}));
+}
+
+TEST(history_store_reparses_truncated_file) {
+    test::TempDir temp("history_test");
+    std::string path = temp.dir + "/history";
+    HistoryStore history;
+    CHECK(history.open(path));
+    for (const char* command : {"ls -l", "make all", "git status"}) CHECK(history.append(command));
+    CHECK_EQ(history.size(), size_t(3));
+    CHECK_EQ(history.find_before("status", HistoryStore::npos), size_t(2));
+
+    // Shrunk below the last record
+    CHECK(truncate(path.c_str(), 0) == 0);
+    CHECK(history.append("pwd"));
+    CHECK_EQ(history.size(), size_t(1));
+    CHECK(history.command(0) == "pwd");
+    CHECK(history.find_before("status", HistoryStore::npos) == HistoryStore::npos);
+
+    // Rewritten past the old end with a record that straddles it
+    std::ofstream(path, std::ios::trunc) << "1\techo " << std::string(64, 'x') << "\n";
+    CHECK_EQ(history.size(), size_t(1));
+    CHECK(history.command(0) == "echo " + std::string(64, 'x'));
+    CHECK(history.search("xxx") == std::vector<uint32_t>({0}));
+    CHECK(history.search("pwd").empty());
+}
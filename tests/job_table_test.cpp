@@ -0,0 +1,52 @@
+#include "../src/job_table.h"
+#include "test.h"
+
+TEST(job_table_finishes_after_last_stage) {
+    JobTable jobs;
+    jobs.add(200, "producer | consumer", 1000);
+    jobs.add_stage(200, 100, {"producer"}, 1000);
+    jobs.add_stage(200, 200, {"consumer"}, 1000);
+    CHECK_EQ(jobs.size(), 1u);
+    CHECK(jobs.stage(100) && jobs.stage(100)->job == 200);
+
+    struct rusage usage = {};
+    usage.ru_utime.tv_usec = 500;
+    JobTable::Stage stage;
+    JobTable::Job finished;
+    pid_t finished_id = -1;
+
+    // The last stage exits first: its status is the job's
+    CHECK(jobs.reap(200, 3 << 8, usage, 1500, stage, finished, finished_id));
+    CHECK(stage.args == std::vector<std::string>({"consumer"}));
+    CHECK_EQ(finished_id, 0);
+    CHECK_EQ(jobs.size(), 1u);
+
+    CHECK(jobs.reap(100, 0, usage, 2500, stage, finished, finished_id));
+    CHECK_EQ(finished_id, 200);
+    CHECK_EQ(finished.status, 3 << 8);
+    CHECK_EQ(finished.usage.wall_us, 1500u);
+    CHECK_EQ(jobs.size(), 0u);
+    CHECK(jobs.stage(100) == nullptr);
+}
+
+TEST(job_table_unknown_pid) {
+    JobTable jobs;
+    struct rusage usage = {};
+    JobTable::Stage stage;
+    JobTable::Job finished;
+    pid_t finished_id = -1;
+    CHECK(!jobs.reap(42, 0, usage, 0, stage, finished, finished_id));
+    CHECK_EQ(finished_id, 0);
+}
+
+TEST(job_table_by_start) {
+    JobTable jobs;
+    jobs.add(30, "newest", 300);
+    jobs.add(10, "oldest", 100);
+    jobs.add(20, "middle", 200);
+    auto ordered = jobs.by_start();
+    CHECK_EQ(ordered.size(), 3u);
+    CHECK_EQ(ordered[0].first, 10);
+    CHECK_EQ(ordered[1].second->name, std::string("middle"));
+    CHECK_EQ(ordered[2].first, 30);
+}
@@ -0,0 +1,18 @@
+// Runs the unit tests: secshell_tests [name-filter]
+#include "test.h"
+
+#include <cstring>
+
+int main(int argc, char* argv[]) {
+    const char* filter = argc > 1 ? argv[1] : "";
+    int run = 0;
+    for (const auto& c : test::cases()) {
+        if (!strstr(c.name, filter)) continue;
+        int before = test::failures();
+        c.body();
+        printf("%s %s\n", test::failures() == before ? "PASS" : "FAIL", c.name);
+        ++run;
+    }
+    printf("%d tests, %d failed checks\n", run, test::failures());
+    return test::failures() == 0 && run > 0 ? 0 : 1;
+}
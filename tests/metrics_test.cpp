@@ -0,0 +1,134 @@
+#include "../src/metrics.h"
+#include "test.h"
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+std::string read_file(const std::string& path) {
+    std::ifstream file(path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+bool has_line(const std::string& text, const std::string& line) {
+    return ("\n" + text).find("\n" + line + "\n") != std::string::npos;
+}
+
+} // namespace
+
+TEST(histogram_buckets) {
+    // Small values are exact; every value lands in a bucket that holds it
+    for (uint64_t v = 0; v < 16; ++v) CHECK_EQ(Histogram::upper_bound(Histogram::index_of(v)), v);
+    for (uint64_t v : {16ULL, 17ULL, 31ULL, 32ULL, 1000ULL, 123456789ULL, ~0ULL}) {
+        size_t index = Histogram::index_of(v);
+        CHECK(index < Histogram::BUCKETS);
+        CHECK(Histogram::upper_bound(index) >= v);
+        CHECK(index == 0 || Histogram::upper_bound(index - 1) < v);
+        // Precision: the bucket is no wider than 1/16 of its values
+        CHECK(Histogram::upper_bound(index) - v <= v / 16);
+    }
+}
+
+TEST(histogram_percentiles) {
+    Histogram h;
+    CHECK_EQ(h.percentile(0.5), 0u);
+    for (uint64_t v = 1; v <= 100; ++v) h.record(v * 1000);
+    CHECK_EQ(h.count(), 100u);
+    CHECK_EQ(h.total_value(), 5050000u);
+    CHECK_EQ(h.max(), 100000u);
+    uint64_t p50 = h.percentile(0.5), p99 = h.percentile(0.99);
+    CHECK(p50 >= 50000 && p50 <= 50000 + 50000 / 16);
+    CHECK(p99 >= 99000 && p99 <= 100000);
+    CHECK_EQ(h.percentile(1.0), 100000u);
+    CHECK_EQ(h.count_at_most(9), 0u);
+    CHECK_EQ(h.count_at_most(~0ULL), 100u);
+    h.reset();
+    CHECK_EQ(h.count(), 0u);
+    CHECK_EQ(h.max(), 0u);
+}
+
+TEST(histogram_concurrent_record) {
+    Histogram h;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&h, t] {
+            for (int i = 0; i < 10000; ++i) h.record(t * 10000 + i);
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    CHECK_EQ(h.count(), 40000u);
+    CHECK_EQ(h.max(), 39999u);
+    CHECK_EQ(h.total_value(), 39999ULL * 40000 / 2);
+}
+
+TEST(metrics_prometheus_format) {
+    Metrics metrics;
+    metrics.command(Metrics::Allowed);
+    metrics.command(Metrics::Allowed);
+    metrics.command(Metrics::Blacklisted);
+    metrics.execution(Metrics::External);
+    metrics.spawn_us.record(300);
+    metrics.spawn_us.record(4000);
+    metrics.pipeline_depth.record(3);
+    metrics.job_started();
+    std::string text = metrics.prometheus("pid=\"7\"");
+
+    CHECK(has_line(text, "# TYPE secshell_commands_total counter"));
+    CHECK(has_line(text, "secshell_commands_total{outcome=\"allowed\",pid=\"7\"} 2"));
+    CHECK(has_line(text, "secshell_commands_total{outcome=\"blacklisted\",pid=\"7\"} 1"));
+    CHECK(has_line(text, "secshell_executions_total{kind=\"external\",pid=\"7\"} 1"));
+    CHECK(has_line(text, "# TYPE secshell_spawn_seconds histogram"));
+    CHECK(has_line(text, "secshell_spawn_seconds_bucket{le=\"0.00025\",pid=\"7\"} 0"));
+    CHECK(has_line(text, "secshell_spawn_seconds_bucket{le=\"0.0005\",pid=\"7\"} 1"));
+    CHECK(has_line(text, "secshell_spawn_seconds_bucket{le=\"+Inf\",pid=\"7\"} 2"));
+    CHECK(has_line(text, "secshell_spawn_seconds_sum{pid=\"7\"} 0.0043"));
+    CHECK(has_line(text, "secshell_pipeline_depth_bucket{le=\"2\",pid=\"7\"} 0"));
+    CHECK(has_line(text, "secshell_pipeline_depth_bucket{le=\"3\",pid=\"7\"} 1"));
+    CHECK(has_line(text, "secshell_background_jobs{pid=\"7\"} 1"));
+    CHECK(has_line(Metrics().prometheus(), "secshell_background_jobs 0"));
+}
+
+TEST(metrics_reset_keeps_running_jobs) {
+    Metrics metrics;
+    metrics.job_started();
+    metrics.job_started();
+    metrics.job_finished();
+    metrics.command(Metrics::NotPermitted);
+    metrics.reset();
+    CHECK_EQ(metrics.commands(Metrics::NotPermitted), 0u);
+    CHECK_EQ(metrics.running_jobs(), 1u);
+    metrics.job_finished();
+    CHECK_EQ(metrics.running_jobs(), 0u);
+}
+
+TEST(metrics_exporter_files) {
+    test::TempDir temp("metrics_test");
+    std::string dir = temp.dir;
+    Metrics metrics;
+    metrics.command(Metrics::Allowed);
+
+    // A shared file keeps its final snapshot
+    MetricsExporter shared;
+    CHECK(shared.start(metrics, dir + "/secshell.prom", 60));
+    CHECK(has_line(read_file(dir + "/secshell.prom"), "secshell_commands_total{outcome=\"allowed\"} 1"));
+    metrics.command(Metrics::Allowed);
+    shared.stop();
+    CHECK(has_line(read_file(dir + "/secshell.prom"), "secshell_commands_total{outcome=\"allowed\"} 2"));
+
+    // A per-session file is labelled with the PID and removed at the end
+    MetricsExporter session;
+    CHECK(session.start(metrics, dir + "/secshell_%p.prom", 60));
+    std::string pid = std::to_string(getpid());
+    CHECK_EQ(session.file(), dir + "/secshell_" + pid + ".prom");
+    CHECK(has_line(read_file(session.file()), "secshell_commands_total{outcome=\"allowed\",pid=\"" + pid + "\"} 2"));
+    session.stop();
+    CHECK(access(session.file().c_str(), F_OK) != 0);
+
+    MetricsExporter unwritable;
+    CHECK(!unwritable.start(metrics, dir + "/missing/secshell.prom", 60));
+    CHECK(!unwritable.running());
+}
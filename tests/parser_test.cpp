@@ -0,0 +1,103 @@
+#include "../src/command_parser.h"
+#include "test.h"
+
+#include <map>
+
+namespace {
+
+std::vector<std::string> words_of(const CommandNode* command) {
+    std::vector<std::string> words;
+    for (const WordNode* word = command->words; word; word = word->next) words.emplace_back(word->text);
+    return words;
+}
+
+const char* lookup(const std::string& name) {
+    static const std::map<std::string, std::string> variables = {{"HOME", "/home/analyst"}, {"EMPTY", ""}};
+    auto it = variables.find(name);
+    return it == variables.end() ? nullptr : it->second.c_str();
+}
+
+std::vector<std::string> split(const std::string& line) {
+    Arena arena;
+    CommandParser parser(arena, lookup);
+    std::vector<std::string> words;
+    std::string error;
+    CHECK(parser.split(line, words, error));
+    return words;
+}
+
+std::string parse_error(const std::string& line) {
+    Arena arena;
+    CommandParser parser(arena, lookup);
+    std::string error;
+    CHECK(parser.parse(line, error) == nullptr);
+    return error;
+}
+
+} // namespace
+
+TEST(parser_pipeline_with_redirects) {
+    Arena arena;
+    CommandParser parser(arena, lookup);
+    std::string error;
+    const PipelineNode* pipeline = parser.parse("cat < in.txt | sort -r >> out.txt &", error);
+    CHECK(pipeline != nullptr);
+    if (!pipeline) return;
+    CHECK_EQ(pipeline->length, 2u);
+    CHECK(pipeline->background);
+
+    const CommandNode* cat = pipeline->commands;
+    CHECK(words_of(cat) == std::vector<std::string>({"cat"}));
+    CHECK(cat->redirects && cat->redirects->kind == RedirectNode::Input);
+    CHECK(cat->redirects && cat->redirects->target == "in.txt");
+
+    const CommandNode* sort = cat->next;
+    CHECK(words_of(sort) == std::vector<std::string>({"sort", "-r"}));
+    CHECK(sort->redirects && sort->redirects->kind == RedirectNode::Append);
+    CHECK(sort->redirects && sort->redirects->target == "out.txt");
+}
+
+TEST(parser_blank_line) {
+    Arena arena;
+    CommandParser parser(arena, lookup);
+    std::string error;
+    const PipelineNode* pipeline = parser.parse("   ", error);
+    CHECK(pipeline != nullptr);
+    CHECK(pipeline && pipeline->length == 0);
+}
+
+TEST(parser_quoting) {
+    CHECK(split("echo 'a  b' \"c d\" e\\ f") == std::vector<std::string>({"echo", "a  b", "c d", "e f"}));
+    CHECK(split("echo \"say \\\"hi\\\"\"") == std::vector<std::string>({"echo", "say \"hi\""}));
+    CHECK(split("echo 'a|b' \"c>d\"") == std::vector<std::string>({"echo", "a|b", "c>d"}));
+}
+
+TEST(parser_quoted_flag) {
+    Arena arena;
+    CommandParser parser(arena, lookup);
+    std::string error;
+    const PipelineNode* pipeline = parser.parse("ls *.log '*.txt'", error);
+    CHECK(pipeline != nullptr);
+    if (!pipeline) return;
+    const WordNode* word = pipeline->commands->words->next;
+    CHECK(!word->quoted);
+    CHECK(word->next->quoted);
+}
+
+TEST(parser_variable_expansion) {
+    CHECK(split("cd $HOME") == std::vector<std::string>({"cd", "/home/analyst"}));
+    CHECK(split("echo ${HOME}/logs") == std::vector<std::string>({"echo", "/home/analyst/logs"}));
+    CHECK(split("echo ${UNSET:-fallback}") == std::vector<std::string>({"echo", "fallback"}));
+    CHECK(split("echo '$HOME'") == std::vector<std::string>({"echo", "$HOME"}));
+    // An unquoted word that expands to nothing is dropped, a quoted one is kept
+    CHECK(split("echo $EMPTY x") == std::vector<std::string>({"echo", "x"}));
+    CHECK(split("echo \"$EMPTY\" x") == std::vector<std::string>({"echo", "", "x"}));
+}
+
+TEST(parser_syntax_errors) {
+    CHECK_EQ(parse_error("| sort"), std::string("Syntax error: Missing command before '|'."));
+    CHECK_EQ(parse_error("ls & ls"), std::string("Syntax error: '&' must end the command."));
+    CHECK_EQ(parse_error("sort <"), std::string("Syntax error: No input file specified for redirection."));
+    CHECK_EQ(parse_error("ls >"), std::string("Syntax error: No output file specified for redirection."));
+    CHECK(!parse_error("echo 'unterminated").empty());
+}
@@ -0,0 +1,154 @@
+#include "../src/pattern_set.h"
+#include "test.h"
+
+#include <algorithm>
+
+namespace {
+
+// The ids of every pattern of this kind that matches text, sorted
+std::vector<int> matches(PatternSet& set, uint8_t kind, const std::string& text) {
+    std::vector<int> ids;
+    set.scan(kind, text, [&](int id) { ids.push_back(id); });
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+const std::vector<int> NONE;
+
+} // namespace
+
+TEST(pattern_set_literal_globs_match_whole_strings) {
+    PatternSet set;
+    std::string error;
+    CHECK(set.add_glob('a', "-w", 1, error));
+    CHECK(set.add_glob('a', "--output*", 2, error));
+    CHECK(set.add_glob('a', "*.pem", 3, error));
+    CHECK(set.add_glob('a', "*secret*", 4, error));
+    set.compile();
+    CHECK_EQ(set.literal_count(), size_t(4));
+    CHECK_EQ(set.nfa_size(), size_t(0));
+
+    CHECK(matches(set, 'a', "-w") == std::vector<int>{1});
+    CHECK(matches(set, 'a', "-wx") == NONE);
+    CHECK(matches(set, 'a', "x-w") == NONE);
+    CHECK(matches(set, 'a', "--output=/tmp/x") == std::vector<int>{2});
+    CHECK(matches(set, 'a', "key.pem") == std::vector<int>{3});
+    CHECK(matches(set, 'a', "key.pem.bak") == NONE);
+    CHECK(matches(set, 'a', "my-secret.pem") == (std::vector<int>{3, 4}));
+    CHECK(matches(set, 'a', "") == NONE);
+}
+
+TEST(pattern_set_kinds_are_separate) {
+    PatternSet set;
+    std::string error;
+    CHECK(set.add_glob('c', "apt", 1, error));
+    CHECK(set.add_glob('a', "apt", 2, error));
+    CHECK(set.add_glob('a', "*", 3, error));
+    CHECK(set.add_regex('p', "/etc/.*", 4, error));
+    set.compile();
+    CHECK(set.has_kind('a'));
+    CHECK(!set.has_kind('r'));
+    CHECK(matches(set, 'c', "apt") == std::vector<int>{1});
+    CHECK(matches(set, 'a', "apt") == (std::vector<int>{2, 3}));
+    CHECK(matches(set, 'a', "/etc/passwd") == std::vector<int>{3});
+    CHECK(matches(set, 'p', "/etc/passwd") == std::vector<int>{4});
+    CHECK(matches(set, 'r', "/etc/passwd") == NONE);
+}
+
+TEST(pattern_set_literals_skip_the_kind_byte) {
+    PatternSet set;
+    std::string error;
+    CHECK(set.add_glob('a', "*a*", 1, error));
+    CHECK(set.add_glob('a', "*a-*", 2, error));
+    CHECK(set.add_glob('p', "*p/*", 3, error));
+    CHECK(set.add_glob('p', "*p", 4, error));
+    CHECK(set.add_glob('c', "c*", 5, error));
+    CHECK(set.add_glob('a', "*\x03*", 6, error));   // A sentinel byte: not an automaton literal
+    set.compile();
+    CHECK_EQ(set.literal_count(), size_t(5));
+    CHECK(matches(set, 'a', "xyz") == NONE);
+    CHECK(matches(set, 'a', "-v") == NONE);
+    CHECK(matches(set, 'a', "bar") == std::vector<int>{1});
+    CHECK(matches(set, 'a', "a-b") == (std::vector<int>{1, 2}));
+    CHECK(matches(set, 'p', "/etc") == NONE);
+    CHECK(matches(set, 'p', "/tmp/x") == std::vector<int>{3});
+    CHECK(matches(set, 'p', "/tmp") == std::vector<int>{4});
+    CHECK(matches(set, 'c', "ls") == NONE);
+    CHECK(matches(set, 'c', "cat") == std::vector<int>{5});
+    CHECK(matches(set, 'a', "x\x03y") == std::vector<int>{6});
+    CHECK(matches(set, 'a', "") == NONE);
+}
+
+TEST(pattern_set_wildcard_globs) {
+    PatternSet set;
+    std::string error;
+    CHECK(set.add_glob('p', "/etc/*", 1, error));
+    CHECK(set.add_glob('p', "/home/*/.ssh/id_?sa*", 2, error));
+    CHECK(set.add_glob('a', "-[wW]", 3, error));
+    CHECK(set.add_glob('a', "[!-]*.key", 4, error));
+    CHECK(set.add_glob('a', "\\*", 5, error));
+    set.compile();
+    CHECK_EQ(set.literal_count(), size_t(2)); // "/etc/*" and the escaped "*"
+
+    CHECK(matches(set, 'p', "/etc/shadow") == std::vector<int>{1});
+    CHECK(matches(set, 'p', "/etc") == NONE);
+    CHECK(matches(set, 'p', "/home/ops/.ssh/id_rsa.pub") == std::vector<int>{2});
+    CHECK(matches(set, 'p', "/home/ops/.ssh/id_ed25519") == NONE);
+    CHECK(matches(set, 'a', "-W") == std::vector<int>{3});
+    CHECK(matches(set, 'a', "-x") == NONE);
+    CHECK(matches(set, 'a', "server.key") == std::vector<int>{4});
+    CHECK(matches(set, 'a', "-server.key") == NONE);
+    CHECK(matches(set, 'a', "*") == std::vector<int>{5});
+    CHECK(matches(set, 'a', "x") == NONE);
+}
+
+TEST(pattern_set_regexes) {
+    PatternSet set;
+    std::string error;
+    CHECK(set.add_regex('a', "169\\.254\\.169\\.254", 1, error));
+    CHECK(set.add_regex('a', "^--?(force|yes)$", 2, error));
+    CHECK(set.add_regex('a', "^[0-9]+$", 3, error));
+    CHECK(set.add_regex('a', "^a\\d?b*c$", 4, error));
+    set.compile();
+
+    CHECK(matches(set, 'a', "http://169.254.169.254/latest") == std::vector<int>{1});
+    CHECK(matches(set, 'a', "169x254.169.254") == NONE);
+    CHECK(matches(set, 'a', "--force") == std::vector<int>{2});
+    CHECK(matches(set, 'a', "-yes") == std::vector<int>{2});
+    CHECK(matches(set, 'a', "--forced") == NONE);
+    CHECK(matches(set, 'a', "8080") == std::vector<int>{3});
+    CHECK(matches(set, 'a', "80a") == NONE);
+    CHECK(matches(set, 'a', "a7bbc") == std::vector<int>{4});
+    CHECK(matches(set, 'a', "ac") == std::vector<int>{4});
+    CHECK(matches(set, 'a', "a77c") == NONE);
+}
+
+TEST(pattern_set_rejects_malformed_patterns) {
+    PatternSet set;
+    std::string error;
+    CHECK(!set.add_glob('a', "[abc", 1, error));
+    CHECK(!error.empty());
+    error.clear();
+    CHECK(!set.add_glob('a', "trailing\\", 1, error));
+    CHECK(!error.empty());
+    error.clear();
+    CHECK(!set.add_regex('a', "(unbalanced", 1, error));
+    CHECK(!error.empty());
+    error.clear();
+    CHECK(!set.add_regex('a', "a{2}", 1, error));
+    CHECK(!error.empty());
+}
+
+TEST(pattern_set_dfa_cache_is_bounded) {
+    PatternSet set;
+    std::string error;
+    for (int i = 0; i < 64; ++i) {
+        CHECK(set.add_regex('a', "^x.*" + std::to_string(i) + "[a-z]+$", i, error));
+    }
+    set.compile();
+    for (int i = 0; i < 20000; ++i) {
+        set.scan('a', "x" + std::to_string(i * 7919) + "abc", [](int) {});
+    }
+    CHECK(set.dfa_size() <= PatternSet::MAX_DFA_STATES + 256);
+    CHECK(matches(set, 'a', "x-63zz") == (std::vector<int>{3, 63}));
+}
@@ -0,0 +1,133 @@
+#include "../src/command_policy.h"
+#include "test.h"
+
+#include <fstream>
+
+namespace {
+
+const char* RULES =
+    "# Captures may not be written into system directories\n"
+    "deny tcpdump arg:-w path:/etc/*\n"
+    "deny apt arg:remove\n"
+    "deny * redirect:/etc/*\n"
+    "deny curl arg:/169\\.254\\.169\\.254/\n"
+    "deny cat path:'/home/*/.ssh/id_*'   # private keys\n"
+    "deny ls path:/root\n"
+    "deny ls path:/root/*\n";
+
+std::string denying_line(PolicyRules& rules, const std::vector<std::string>& args,
+                         const std::vector<std::string>& redirects = {}, const std::string& cwd = "/home/ops") {
+    const PolicyRules::Rule* rule = rules.check(args, redirects, cwd);
+    return rule ? std::to_string(rule->line) : "allowed";
+}
+
+} // namespace
+
+TEST(policy_rules_parse_and_match) {
+    PolicyRules rules;
+    std::vector<std::string> errors;
+    rules.parse(RULES, errors);
+    CHECK(errors.empty());
+    CHECK_EQ(rules.size(), size_t(7));
+    CHECK_EQ(rules.rules()[0].text, std::string("deny tcpdump arg:-w path:/etc/*"));
+    CHECK_EQ(rules.rules()[4].text, std::string("deny cat path:'/home/*/.ssh/id_*'"));
+
+    CHECK_EQ(denying_line(rules, {"tcpdump", "-i", "eth0", "-w", "/etc/cap.pcap"}), std::string("2"));
+    CHECK_EQ(denying_line(rules, {"tcpdump", "-w", "/tmp/cap.pcap"}), std::string("allowed"));
+    CHECK_EQ(denying_line(rules, {"tcpdump", "-i", "eth0"}), std::string("allowed"));
+    CHECK_EQ(denying_line(rules, {"apt", "remove", "nginx"}), std::string("3"));
+    CHECK_EQ(denying_line(rules, {"apt", "install", "nginx"}), std::string("allowed"));
+    CHECK_EQ(denying_line(rules, {"curl", "http://169.254.169.254/latest/meta-data"}), std::string("5"));
+    CHECK_EQ(denying_line(rules, {"cat", "/home/ops/.ssh/id_rsa"}), std::string("6"));
+    CHECK_EQ(denying_line(rules, {"cat", "/home/ops/.ssh/config"}), std::string("allowed"));
+    CHECK_EQ(denying_line(rules, {"ls", "/root"}), std::string("7"));
+    CHECK_EQ(denying_line(rules, {"ls", "-la", "/root/.bashrc"}), std::string("8"));
+    CHECK_EQ(denying_line(rules, {"ls", "/var/log"}), std::string("allowed"));
+}
+
+TEST(policy_rules_check_redirect_targets) {
+    PolicyRules rules;
+    std::vector<std::string> errors;
+    rules.parse(RULES, errors);
+    CHECK_EQ(denying_line(rules, {"echo", "x"}, {"/etc/motd"}), std::string("4"));
+    CHECK_EQ(denying_line(rules, {"echo", "x"}, {"motd"}, "/etc"), std::string("4"));
+    CHECK_EQ(denying_line(rules, {"echo", "x"}, {"/tmp/motd"}), std::string("allowed"));
+    // Redirect targets are not arguments, and arguments are not redirect targets
+    CHECK_EQ(denying_line(rules, {"echo", "/etc/motd"}), std::string("allowed"));
+}
+
+TEST(policy_rules_literals_containing_the_kind_letter) {
+    PolicyRules rules;
+    std::vector<std::string> errors;
+    rules.parse("deny cat arg:*a*\ndeny ls path:*p/*\ndeny grep arg:*a-*\n", errors);
+    CHECK(errors.empty());
+    CHECK_EQ(denying_line(rules, {"cat", "xyz"}), std::string("allowed"));
+    CHECK_EQ(denying_line(rules, {"cat", "data"}), std::string("1"));
+    CHECK_EQ(denying_line(rules, {"ls", "/etc"}), std::string("allowed"));
+    CHECK_EQ(denying_line(rules, {"ls", "/tmp/x"}), std::string("2"));
+    CHECK_EQ(denying_line(rules, {"grep", "-v"}), std::string("allowed"));
+    CHECK_EQ(denying_line(rules, {"grep", "a-b"}), std::string("3"));
+}
+
+TEST(policy_rules_normalize_paths) {
+    CHECK_EQ(PolicyRules::normalize_path("../../root", "/home/ops"), std::string("/root"));
+    CHECK_EQ(PolicyRules::normalize_path("/root//./", "/tmp"), std::string("/root"));
+    CHECK_EQ(PolicyRules::normalize_path("..", "/"), std::string("/"));
+    CHECK_EQ(PolicyRules::normalize_path("a/./b/../c", "/srv"), std::string("/srv/a/c"));
+
+    PolicyRules rules;
+    std::vector<std::string> errors;
+    rules.parse(RULES, errors);
+    CHECK_EQ(denying_line(rules, {"ls", "../../root"}), std::string("7"));
+    CHECK_EQ(denying_line(rules, {"ls", "--directory=/root/."}), std::string("7"));
+    CHECK_EQ(denying_line(rules, {"tcpdump", "-w", "../../etc/x"}), std::string("2"));
+}
+
+TEST(policy_rules_report_bad_lines) {
+    PolicyRules rules;
+    std::vector<std::string> errors;
+    rules.parse("allow ls\n"
+                "deny\n"
+                "deny ls flag:-l\n"
+                "deny ls arg:[a-\n"
+                "deny ls arg:'unterminated\n"
+                "deny ls arg:/(x/\n"
+                "deny ps arg:aux\n",
+                errors);
+    CHECK_EQ(errors.size(), size_t(6));
+    CHECK_EQ(errors[0].substr(0, 7), std::string("line 1:"));
+    CHECK_EQ(errors[5].substr(0, 7), std::string("line 6:"));
+    CHECK_EQ(rules.size(), size_t(1));
+    CHECK_EQ(rules.term_count(), size_t(2)); // Rejected lines leave no patterns behind
+    CHECK_EQ(denying_line(rules, {"ps", "aux"}), std::string("7"));
+    CHECK_EQ(denying_line(rules, {"ls", "-l"}), std::string("allowed"));
+}
+
+TEST(policy_rules_first_rule_wins_and_terms_are_shared) {
+    PolicyRules rules;
+    std::vector<std::string> errors;
+    rules.parse("deny * arg:--force\n"
+                "deny rm arg:--force\n"
+                "deny rm arg:-rf path:/\n",
+                errors);
+    CHECK(errors.empty());
+    CHECK_EQ(rules.term_count(), size_t(5)); // "--force" is one pattern
+    CHECK_EQ(denying_line(rules, {"rm", "--force", "x"}), std::string("1"));
+    CHECK_EQ(denying_line(rules, {"rm", "-rf", "/"}), std::string("3"));
+    CHECK_EQ(denying_line(rules, {"rm", "-rf", "/tmp"}), std::string("allowed"));
+}
+
+TEST(policy_load_rules_keeps_rules_when_unreadable) {
+    test::TempDir temp("rules_test");
+    std::string dir = temp.dir;
+    std::ofstream(dir + "/rules") << "deny apt arg:remove\n";
+
+    CommandPolicy policy({"/bin/"});
+    std::vector<std::string> errors;
+    CHECK(policy.load_rules(dir + "/missing", errors)); // No file, no rules
+    CHECK_EQ(policy.rules().size(), size_t(0));
+    CHECK(policy.load_rules(dir + "/rules", errors));
+    CHECK(policy.denied_by({"apt", "remove", "x"}, {}, "/") != nullptr);
+    CHECK(!policy.load_rules(dir, errors)); // A directory cannot be read as rules
+    CHECK(policy.denied_by({"apt", "remove", "x"}, {}, "/") != nullptr);
+}
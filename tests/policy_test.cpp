@@ -0,0 +1,98 @@
+#include "../src/command_policy.h"
+#include "test.h"
+
+#include <fstream>
+
+#include <sys/stat.h>
+
+namespace {
+
+// A scratch directory holding two executables, a non-executable file and a
+// blacklist file
+struct PolicyFixture {
+    test::TempDir temp{"policy_test"};
+    std::string dir = temp.dir;
+
+    PolicyFixture() {
+        write("scanner", true);
+        write("netcat", true);
+        write("notes.txt", false);
+        std::ofstream(dir + "/blacklist") << "netcat\n  spaced  \n\nnetcat\n";
+    }
+
+    void write(const std::string& name, bool executable) {
+        std::string path = dir + "/" + name;
+        std::ofstream(path) << "#!/bin/sh\n";
+        chmod(path.c_str(), executable ? 0755 : 0644);
+    }
+};
+
+} // namespace
+
+TEST(policy_allows_indexed_executables) {
+    PolicyFixture fixture;
+    CommandPolicy policy({fixture.dir + "/"});
+    policy.index_executables(false);
+
+    std::string resolved;
+    CHECK(policy.allows("scanner", &resolved));
+    CHECK_EQ(resolved, fixture.dir + "/scanner");
+    CHECK(!policy.allows("notes.txt"));
+    CHECK(!policy.allows("missing"));
+}
+
+TEST(policy_blacklist_overrides_index) {
+    PolicyFixture fixture;
+    CommandPolicy policy({fixture.dir + "/"});
+    policy.index_executables(false);
+    CHECK(policy.allows("netcat"));
+    CHECK(policy.load_blacklist(fixture.dir + "/blacklist"));
+    CHECK(policy.blacklisted("netcat"));
+    CHECK(!policy.allows("netcat"));
+    CHECK(policy.allows("scanner"));
+}
+
+TEST(policy_failed_load_keeps_blacklist) {
+    PolicyFixture fixture;
+    CommandPolicy policy({fixture.dir + "/"});
+    CHECK(policy.load_blacklist(fixture.dir + "/blacklist"));
+    CHECK(!policy.load_blacklist(fixture.dir + "/no-such-file"));
+    CHECK(policy.blacklisted("netcat"));
+}
+
+TEST(blacklist_snapshot_parsing) {
+    PolicyFixture fixture;
+    auto snapshot = BlacklistSnapshot::load(fixture.dir + "/blacklist");
+    CHECK(snapshot != nullptr);
+    if (!snapshot) return;
+    // Whitespace trimmed, blank lines and duplicates dropped, file order kept
+    CHECK(snapshot->commands() == std::vector<std::string>({"netcat", "spaced"}));
+    CHECK(snapshot->contains("spaced"));
+    CHECK(!snapshot->contains("  spaced  "));
+    CHECK(BlacklistSnapshot::load(fixture.dir + "/no-such-file") == nullptr);
+}
+
+TEST(blacklist_snapshot_large) {
+    std::vector<std::string> commands;
+    for (int i = 0; i < 100000; ++i) commands.push_back("cmd" + std::to_string(i));
+    BlacklistSnapshot snapshot(commands);
+    CHECK_EQ(snapshot.commands().size(), 100000u);
+    CHECK(snapshot.contains("cmd0"));
+    CHECK(snapshot.contains("cmd99999"));
+    CHECK(!snapshot.contains("cmd100000"));
+}
+
+TEST(executable_index_rebuilds_on_change) {
+    PolicyFixture fixture;
+    ExecutableIndex index;
+    index.build({fixture.dir + "/"}, true);
+    CHECK(index.lookup("scanner") != nullptr);
+    CHECK(index.lookup("fresh") == nullptr);
+    fixture.write("fresh", true);
+    // The shell applies inotify events from its event loop; refresh() is
+    // that step
+    index.refresh();
+    const std::string* path = index.lookup("fresh");
+    CHECK(path != nullptr);
+    CHECK(path && *path == fixture.dir + "/fresh");
+}
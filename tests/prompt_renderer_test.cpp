@@ -0,0 +1,116 @@
+#include "../src/prompt_renderer.h"
+#include "test.h"
+
+#include <fstream>
+
+#include <poll.h>
+#include <sys/stat.h>
+
+namespace {
+
+// repo/.git/HEAD on branch main, repo/src, and plain/ outside any repository
+struct RepoFixture {
+    test::TempDir temp{"prompt_test"};
+    std::string dir = temp.dir;
+
+    RepoFixture() {
+        for (const char* sub : {"/repo", "/repo/.git", "/repo/src", "/plain"}) mkdir((dir + sub).c_str(), 0755);
+        std::ofstream(dir + "/repo/.git/HEAD") << "ref: refs/heads/main\n";
+    }
+};
+
+// The prompt as the terminal shows it, without escapes
+std::string visible(const std::string& prompt) {
+    std::string text;
+    bool hidden = false;
+    for (char c : prompt) {
+        if (c == '\001' || c == '\002') {
+            hidden = c == '\001';
+        } else if (!hidden) {
+            text += c;
+        }
+    }
+    return text;
+}
+
+} // namespace
+
+TEST(prompt_cheap_segments) {
+    PromptRenderer prompt;
+    prompt.set_context("alice", "box", "/home/alice");
+    CHECK_EQ(visible(prompt.render({})), std::string("┌─[SecShell] (alice) [/home/alice]\n└─$ "));
+    CHECK_EQ(visible(prompt.render({1, 2})), std::string("┌─[SecShell] (alice) [/home/alice] jobs:2 exit:1\n└─$ "));
+
+    // Cached until the context changes
+    prompt.set_context("alice", "box", "/tmp");
+    CHECK_EQ(visible(prompt.render({})), std::string("┌─[SecShell] (alice) [/tmp]\n└─$ "));
+
+    std::string error;
+    CHECK(prompt.configure("host,user status", error));
+    CHECK_EQ(visible(prompt.render({127, 0})), std::string("┌─[SecShell] box (alice) exit:127\n└─$ "));
+    CHECK(!prompt.configure("user clock", error));
+    CHECK_EQ(error, std::string("unknown prompt segment 'clock'"));
+    CHECK(!prompt.configure(" , ", error));
+    CHECK_EQ(visible(prompt.render({})), std::string("┌─[SecShell] box (alice)\n└─$ ")); // Kept
+}
+
+TEST(prompt_git_branch) {
+    RepoFixture fixture;
+    CHECK_EQ(PromptRenderer::git_branch(fixture.dir + "/repo"), std::string("main"));
+    CHECK_EQ(PromptRenderer::git_branch(fixture.dir + "/repo/src"), std::string("main"));
+    CHECK_EQ(PromptRenderer::git_branch(fixture.dir + "/plain"), std::string(""));
+
+    std::ofstream(fixture.dir + "/repo/.git/HEAD") << "0123456789abcdef0123456789abcdef01234567\n";
+    std::ofstream(fixture.dir + "/repo/.git/MERGE_HEAD") << "x\n";
+    CHECK_EQ(PromptRenderer::git_branch(fixture.dir + "/repo"), std::string("0123456|merge"));
+
+    // A worktree's .git is a file naming the real directory
+    mkdir((fixture.dir + "/plain/.wt").c_str(), 0755);
+    std::ofstream(fixture.dir + "/plain/.wt/HEAD") << "ref: refs/heads/feature/x\n";
+    std::ofstream(fixture.dir + "/plain/.git") << "gitdir: .wt\n";
+    CHECK_EQ(PromptRenderer::git_branch(fixture.dir + "/plain"), std::string("feature/x"));
+}
+
+TEST(prompt_slow_segments) {
+    RepoFixture fixture;
+    PromptRenderer prompt;
+    std::string error;
+    CHECK(prompt.configure("cwd git load", error));
+
+    // Inline without a worker
+    prompt.set_context("u", "h", fixture.dir + "/repo");
+    std::string text = visible(prompt.render({}));
+    CHECK(text.find("git:main") != std::string::npos);
+    CHECK(text.find(" load:") != std::string::npos);
+
+    // On the worker: in time with a generous deadline
+    CHECK(prompt.start() != -1);
+    prompt.deadline_ms = 5000;
+    prompt.set_context("u", "h", fixture.dir + "/repo/src");
+    CHECK(visible(prompt.render({})).find("git:main") != std::string::npos);
+
+    // Late with none: drawn without the branch, then patched in
+    prompt.set_context("u", "h", fixture.dir + "/plain");
+    CHECK(visible(prompt.render({})).find("git:") == std::string::npos);
+    prompt.deadline_ms = 0;
+    prompt.set_context("u", "h", fixture.dir + "/repo");
+    text = visible(prompt.render({}));
+    if (text.find("git:main") == std::string::npos) {
+        struct pollfd ready = {prompt.fd(), POLLIN, 0};
+        CHECK_EQ(poll(&ready, 1, 5000), 1);
+        std::string updated;
+        CHECK(prompt.take_update(updated));
+        text = visible(updated);
+    }
+    CHECK_EQ(text.substr(0, text.find(" load:")), "┌─[SecShell] [" + fixture.dir + "/repo] git:main");
+    prompt.stop();
+}
+
+TEST(prompt_cursor_rows) {
+    std::string prompt = "\001\033[32m\002┌─[SecShell]\001\033[0m\002 (alice)\n\001\033[32m\002└─\001\033[0m\002$ ";
+    CHECK_EQ(PromptRenderer::display_width(prompt.substr(0, prompt.find('\n'))), 20u);
+    CHECK_EQ(PromptRenderer::rows_above_cursor(prompt, "", 80), 1);
+    CHECK_EQ(PromptRenderer::rows_above_cursor(prompt, "", 10), 2);        // First line wraps
+    CHECK_EQ(PromptRenderer::rows_above_cursor(prompt, "ls -la", 10), 3);  // So does the input
+    CHECK_EQ(PromptRenderer::rows_above_cursor(prompt, "ls", 10), 2);
+}
@@ -0,0 +1,145 @@
+#include "../src/sandbox.h"
+#include "../src/secshell.h"
+#include "test.h"
+
+#include <fstream>
+
+#include <sys/stat.h>
+#include <termios.h>
+
+namespace {
+
+// Runs /bin/sh -c script in the sandbox with stdout on a pipe; returns the
+// exit status and sets output
+int run_script(const Sandbox& sandbox, const std::string& script, std::string& output) {
+    int out[2];
+    CHECK(pipe2(out, O_CLOEXEC) == 0);
+    pid_t pid = -1;
+    int err = sandbox.spawn("/bin/sh", {"sh", "-c", script}, {{out[1], STDOUT_FILENO}}, pid, environ);
+    close(out[1]);
+    CHECK_EQ(err, 0);
+    output.clear();
+    if (err != 0) {
+        close(out[0]);
+        return -1;
+    }
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(out[0], buffer, sizeof(buffer))) > 0) output.append(buffer, n);
+    close(out[0]);
+    int status = -1;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+std::string read_file(const std::string& path) {
+    std::ifstream file(path);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+} // namespace
+
+TEST(sandbox_limits_parse) {
+    CHECK_EQ(Sandbox::cpu_max("50"), std::string("50000 100000"));
+    CHECK_EQ(Sandbox::cpu_max("250"), std::string("250000 100000"));   // Two and a half CPUs
+    CHECK_EQ(Sandbox::cpu_max("0"), std::string(""));
+    CHECK_EQ(Sandbox::cpu_max("half"), std::string(""));
+    CHECK_EQ(Sandbox::bytes("4096"), std::string("4096"));
+    CHECK_EQ(Sandbox::bytes("64M"), std::string("67108864"));
+    CHECK_EQ(Sandbox::bytes("2g"), std::string("2147483648"));
+    CHECK_EQ(Sandbox::bytes("-1"), std::string(""));
+    CHECK_EQ(Sandbox::bytes("10T"), std::string(""));
+    CHECK_EQ(Sandbox::bytes("99999999999999G"), std::string(""));
+}
+
+TEST(sandbox_filter_refuses) {
+    std::vector<struct sock_filter> filter = Sandbox::compile_filter();
+    CHECK(!filter.empty());
+    pid_t pid = fork();
+    if (pid == 0) {
+        // One bit per check that went wrong
+        int wrong = 0;
+        if (!Sandbox::install_filter(filter)) _exit(255);
+        if (mount("none", "/mnt", "tmpfs", 0, nullptr) == 0 || errno != EPERM) wrong |= 1;
+        if (unshare(CLONE_NEWNS) == 0 || errno != EPERM) wrong |= 2;
+        char c = 'x';
+        if (ioctl(STDIN_FILENO, TIOCSTI, &c) == 0 || errno != EPERM) wrong |= 4;
+        if (syscall(SYS_clone3, nullptr, 0) != -1 || errno != ENOSYS) wrong |= 8;
+        if (syscall(SYS_clone, CLONE_NEWUSER | SIGCHLD, 0, 0, 0, 0) != -1 || errno != EPERM) wrong |= 16;
+        if (syscall(SYS_getpid) != getpid()) wrong |= 32;
+        pid_t child = fork();                  // Plain clone is allowed
+        if (child == 0) _exit(0);
+        if (child == -1 || waitpid(child, nullptr, 0) != child) wrong |= 64;
+        _exit(wrong);
+    }
+    int status;
+    CHECK(waitpid(pid, &status, 0) == pid);
+    CHECK(WIFEXITED(status));
+    CHECK_EQ(WEXITSTATUS(status), 0);
+}
+
+TEST(sandbox_spawn_isolated) {
+    test::TempDir temp("sandbox_test");
+    std::string dir = temp.dir;
+
+    Sandbox sandbox;
+    Sandbox::Options options;
+    options.writable = {dir, "/no/such/dir"};
+    std::string error;
+    if (!sandbox.prepare(options, error)) {
+        // No namespaces here (e.g. a container without user namespaces)
+        fprintf(stderr, "sandbox_spawn_isolated: skipped, %s\n", error.c_str());
+        return;
+    }
+    CHECK(sandbox.ready());
+
+    std::string output;
+    CHECK_EQ(run_script(sandbox, "touch " + dir + "/made && echo made", output), 0);
+    CHECK_EQ(output, std::string("made\n"));
+    struct stat st;
+    CHECK(stat((dir + "/made").c_str(), &st) == 0);
+    CHECK_EQ(run_script(sandbox, "touch /usr/sandbox_test 2>/dev/null || echo read-only", output), 0);
+    CHECK_EQ(output, std::string("read-only\n"));
+    CHECK(stat("/usr/sandbox_test", &st) != 0);
+    CHECK_EQ(run_script(sandbox, "grep -E '^(NoNewPrivs|Seccomp):' /proc/self/status", output), 0);
+    CHECK_EQ(output, std::string("NoNewPrivs:\t1\nSeccomp:\t2\n"));
+    if (!sandbox.cgroup().empty()) {
+        std::string name = sandbox.cgroup().substr(sandbox.cgroup().rfind('/'));
+        CHECK_EQ(run_script(sandbox, "grep '^0::' /proc/self/cgroup", output), 0);
+        CHECK(output.find(name + "\n") != std::string::npos);
+    }
+
+    // The working directory carries over; a missing program is reported
+    // by spawn, not as an exit status
+    char cwd[PATH_MAX];
+    CHECK(getcwd(cwd, sizeof(cwd)) != nullptr);
+    CHECK(chdir(dir.c_str()) == 0);
+    CHECK_EQ(run_script(sandbox, "pwd", output), 0);
+    CHECK_EQ(output, dir + "\n");
+    CHECK(chdir(cwd) == 0);
+    pid_t pid;
+    CHECK_EQ(sandbox.spawn("/no/such/program", {"program"}, {}, pid, environ), ENOENT);
+
+    CHECK(sandbox.prepare(options, error));     // Replaces the template and its cgroup
+    CHECK(sandbox.ready());
+}
+
+TEST(sandbox_shell_background_fast_path_fallback) {
+    test::TempDir temp("sandbox_test");
+    std::ofstream(temp.dir + "/.blacklist") << "nc\n";
+    setenv("SECSHELL_SANDBOX", "1", 1);
+    SecShell shell(temp.dir + "/.blacklist", false);
+    unsetenv("SECSHELL_SANDBOX");
+
+    // cat -A is left to the real binary by the fast path
+    std::string foreground = temp.dir + "/foreground", background = temp.dir + "/background";
+    if (shell.run_command("cat -A /proc/self/status > " + foreground) != 0) {
+        fprintf(stderr, "sandbox_shell_background_fast_path_fallback: skipped, no sandbox\n");
+        return;
+    }
+    CHECK(read_file(foreground).find("Seccomp:^I2$") != std::string::npos);
+    CHECK_EQ(shell.run_command("cat -A /proc/self/status > " + background + " &"), 0);
+    for (int i = 0; i < 500 && read_file(background).find("Seccomp:") == std::string::npos; ++i) usleep(10000);
+    CHECK(read_file(background).find("Seccomp:^I2$") != std::string::npos);
+    CHECK(read_file(background).find("NoNewPrivs:^I1$") != std::string::npos);
+}
@@ -0,0 +1,220 @@
+#include "../src/pty_relay.h"
+#include "../src/session_recording.h"
+#include "test.h"
+
+#include <random>
+
+#include <sys/stat.h>
+
+namespace {
+
+bool round_trips(RecordingCodec::Kind kind, const std::string& data) {
+    std::string stored, raw;
+    RecordingCodec::Kind used = RecordingCodec::compress(kind, data.data(), data.size(), stored);
+    return RecordingCodec::decompress(used, stored.data(), stored.size(), data.size(), raw) && raw == data;
+}
+
+// Every Output frame's data in the recording, concatenated
+std::string output_of(RecordingReader& reader) {
+    std::string out, error;
+    std::vector<RecordingReader::Frame> frames;
+    for (size_t i = 0; i < reader.chunk_count(); ++i) {
+        CHECK(reader.read_chunk(i, frames, error));
+        for (const auto& frame : frames) {
+            if (frame.type == SessionRecording::Output) out += frame.data;
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+TEST(recording_codec_round_trip) {
+    std::mt19937 random(7);
+    std::string noise(100000, '\0');
+    for (char& c : noise) c = static_cast<char>(random());
+    std::string lines;
+    for (int i = 0; i < 5000; ++i) lines += "12:00:0" + std::to_string(i % 10) + " IP 10.0.0." + std::to_string(i % 7) + ".443 > host: tcp " + std::to_string(i) + "\n";
+
+    for (RecordingCodec::Kind kind : {RecordingCodec::Stored, RecordingCodec::Lz4, RecordingCodec::preferred()}) {
+        CHECK(round_trips(kind, ""));
+        CHECK(round_trips(kind, "short"));
+        CHECK(round_trips(kind, std::string(70000, 'a')));   // Lengths past 255 continue in extra bytes
+        CHECK(round_trips(kind, noise));
+        CHECK(round_trips(kind, lines));
+    }
+
+    std::string stored;
+    CHECK_EQ(RecordingCodec::compress(RecordingCodec::Lz4, lines.data(), lines.size(), stored), RecordingCodec::Lz4);
+    CHECK(stored.size() < lines.size() / 3);
+    CHECK_EQ(RecordingCodec::compress(RecordingCodec::Lz4, noise.data(), noise.size(), stored), RecordingCodec::Stored);
+
+    // The built-in decoder refuses matches reaching before the output
+    const uint8_t bad[] = {0x10, 'a', 0x05, 0x00};
+    uint8_t out[64];
+    CHECK(!RecordingCodec::lz4_decompress(bad, sizeof(bad), out, 20));
+}
+
+TEST(recording_frames_and_index) {
+    test::TempDir temp("recording_test");
+    std::string path = temp.dir + "/session.rec";
+    int output[2];
+    CHECK(pipe(output) == 0);
+    {
+        SessionRecorder recorder;
+        CHECK(recorder.open(path, 120, 40));
+        CHECK(!SessionRecorder().open(path, 80, 24));   // Never overwritten
+
+        const char* data;
+        CHECK(write(output[1], "$ ", 2) == 2);
+        CHECK_EQ(recorder.read_frame(SessionRecording::Output, output[0], data), 2);
+        CHECK_EQ(std::string(data, 2), std::string("$ "));
+        recorder.frame(SessionRecording::Input, "ls\r", 3);
+        recorder.command("ls");
+        CHECK(write(output[1], "a b\r\n", 5) == 5);
+        CHECK_EQ(recorder.read_frame(SessionRecording::Output, output[0], data), 5);
+        CHECK(write(output[1], "$ ", 2) == 2);
+        CHECK_EQ(recorder.read_frame(SessionRecording::Output, output[0], data), 2);   // Joins the frame before
+        recorder.hidden_input(9);
+        recorder.resize(100, 30);
+        recorder.command("exit");
+        CHECK(recorder.close(3 << 8));
+        CHECK_EQ(recorder.raw_bytes(), 8 * SessionRecording::FRAME_HEADER + 2 + 3 + 2 + 7 + 4 + 4 + 4 + 4);
+    }
+    close(output[0]);
+    close(output[1]);
+
+    struct stat st;
+    CHECK(stat(path.c_str(), &st) == 0 && (st.st_mode & 0777) == 0600);
+    RecordingReader reader;
+    std::string error;
+    CHECK(reader.open(path, error));
+    CHECK(reader.complete());
+    CHECK_EQ(reader.initial_columns(), 120);
+    CHECK_EQ(reader.initial_rows(), 40);
+    CHECK(WIFEXITED(reader.exit_status()) && WEXITSTATUS(reader.exit_status()) == 3);
+    CHECK_EQ(reader.commands().size(), 2u);
+    CHECK_EQ(reader.commands()[0].text, std::string("ls"));
+    CHECK_EQ(reader.commands()[1].text, std::string("exit"));
+    CHECK_EQ(reader.chunk_count(), 3u);   // Each command starts a chunk
+    CHECK_EQ(reader.chunk_at(reader.commands()[0].us), static_cast<size_t>(reader.commands()[0].chunk));
+
+    std::vector<RecordingReader::Frame> frames;
+    CHECK(reader.read_chunk(1, frames, error));
+    CHECK_EQ(frames.size(), 4u);
+    CHECK_EQ(frames[0].type, SessionRecording::Command);
+    CHECK_EQ(std::string(frames[1].data), std::string("a b\r\n$ "));
+    CHECK_EQ(frames[2].type, SessionRecording::HiddenInput);
+    CHECK_EQ(frames[3].type, SessionRecording::Resize);
+    CHECK_EQ(output_of(reader), std::string("$ a b\r\n$ "));
+}
+
+TEST(recording_seek_and_recovery) {
+    test::TempDir temp("recording_test");
+    std::string path = temp.dir + "/long.rec";
+    std::string expected;
+    {
+        SessionRecorder recorder;
+        CHECK(recorder.open(path, 80, 24));
+        for (int command = 0; command < 20; ++command) {
+            recorder.command("cmd " + std::to_string(command));
+            for (int line = 0; line < 2000; ++line) {
+                std::string text = std::to_string(command) + ":" + std::to_string(line) + " some output\r\n";
+                recorder.frame(SessionRecording::Output, text.data(), text.size());
+                expected += text;
+            }
+        }
+        CHECK(recorder.close(0));
+        CHECK(recorder.file_bytes() < recorder.raw_bytes() / 2);
+    }
+
+    RecordingReader reader;
+    std::string error;
+    CHECK(reader.open(path, error));
+    CHECK_EQ(reader.commands().size(), 20u);
+    CHECK_EQ(output_of(reader), expected);
+
+    // Playing from a command boundary starts with that command's output
+    int output[2];
+    CHECK(pipe2(output, O_NONBLOCK) == 0);
+    fcntl(output[1], F_SETPIPE_SZ, 1 << 20);
+    RecordingPlayer player;
+    player.speed = 0;
+    player.output_fd = output[1];
+    CHECK(player.play(reader, reader.commands()[19].us, error));
+    close(output[1]);
+    std::string played;
+    char buffer[65536];
+    ssize_t n;
+    while ((n = read(output[0], buffer, sizeof(buffer))) > 0) played.append(buffer, n);
+    close(output[0]);
+    CHECK_EQ(played, expected.substr(expected.find("19:0 ")));
+
+    // Cut short: no index, so it is rebuilt from the chunks that survived
+    struct stat st;
+    CHECK(stat(path.c_str(), &st) == 0);
+    CHECK(truncate(path.c_str(), st.st_size / 2) == 0);
+    RecordingReader cut;
+    CHECK(cut.open(path, error));
+    CHECK(!cut.complete());
+    CHECK(cut.commands().size() > 0 && cut.commands().size() < 20);
+    std::string partial = output_of(cut);
+    CHECK(!partial.empty() && expected.compare(0, partial.size(), partial) == 0);
+
+    // A damaged chunk is reported, not played
+    std::vector<RecordingReader::Frame> frames;
+    int fd = open(path.c_str(), O_RDWR);
+    char head[256];
+    CHECK(pread(fd, head, sizeof(head), 0) == sizeof(head));
+    char* chunk = static_cast<char*>(memmem(head, sizeof(head), "CHNK", 4));
+    CHECK(chunk != nullptr);
+    if (chunk) {
+        ++chunk[5];   // Raw size
+        CHECK(pwrite(fd, chunk + 5, 1, chunk + 5 - head) == 1);
+    }
+    close(fd);
+    CHECK(!cut.read_chunk(0, frames, error));
+    CHECK_EQ(error, std::string("chunk 0: corrupt"));
+    RecordingReader damaged;
+    CHECK(damaged.open(path, error));
+    CHECK_EQ(damaged.chunk_count(), 0u);
+}
+
+TEST(recording_pty_relay) {
+    test::TempDir temp("recording_test");
+    std::string path = temp.dir + "/relay.rec";
+    int input[2], output[2];
+    CHECK(pipe(input) == 0 && pipe(output) == 0);
+    SessionRecorder recorder;
+    CHECK(recorder.open(path, 80, 24));
+    PtyRelay relay;
+    PtyRelay::Options options;
+    options.input_fd = input[0];
+    options.output_fd = output[1];
+    int status;
+    if (relay.fork_session(recorder, options, status)) {
+        // The session: on a terminal of its own, reporting a command
+        PtyRelay::report_command(relay.command_fd(), "greet");
+        const char text[] = "hello from the pty\n";
+        bool tty = isatty(STDOUT_FILENO);
+        (void)!write(STDOUT_FILENO, text, sizeof(text) - 1);
+        _exit(tty ? 3 : 4);
+    }
+    close(input[1]);
+    close(output[1]);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 3);
+    char buffer[256];
+    ssize_t n = read(output[0], buffer, sizeof(buffer));
+    CHECK_EQ(std::string(buffer, n > 0 ? n : 0), std::string("hello from the pty\r\n"));   // Through the line discipline
+    close(input[0]);
+    close(output[0]);
+
+    RecordingReader reader;
+    std::string error;
+    CHECK(reader.open(path, error));
+    CHECK(reader.complete());
+    CHECK_EQ(reader.exit_status(), status);
+    CHECK_EQ(output_of(reader), std::string("hello from the pty\r\n"));
+    CHECK_EQ(reader.commands().size(), 1u);
+    CHECK_EQ(relay.output_bytes(), 20u);
+}
@@ -0,0 +1,111 @@
+#include "../src/secshell.h"
+#include "test.h"
+
+namespace {
+
+// A shell with its own blacklist and a scratch directory for output files
+struct ShellFixture {
+    test::TempDir temp{"shell_test"};
+    std::string dir = temp.dir;
+    std::unique_ptr<SecShell> shell;
+
+    ShellFixture() {
+        std::ofstream(dir + "/.blacklist") << "nc\n";
+        shell.reset(new SecShell(dir + "/.blacklist", false));
+    }
+
+    std::string read(const std::string& name) {
+        std::ifstream file(dir + "/" + name);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+};
+
+} // namespace
+
+TEST(shell_exit_status) {
+    ShellFixture fixture;
+    CHECK_EQ(fixture.shell->run_command("true"), 0);
+    CHECK_EQ(fixture.shell->run_command("false"), 1);
+    CHECK_EQ(fixture.shell->run_command("nc -l 4444"), 126);
+    CHECK_EQ(fixture.shell->run_command("no-such-command"), 126);
+    CHECK_EQ(fixture.shell->run_command("| sort"), 2);
+}
+
+TEST(shell_pipeline_and_redirects) {
+    ShellFixture fixture;
+    std::string out = fixture.dir + "/out.txt";
+    CHECK_EQ(fixture.shell->run_command("printf 'b\\na\\nb\\n' | sort | uniq -c > " + out), 0);
+    CHECK_EQ(fixture.read("out.txt"), std::string("      1 a\n      2 b\n"));
+    CHECK_EQ(fixture.shell->run_command("echo appended >> " + out), 0);
+    CHECK_EQ(fixture.shell->run_command("wc -l < " + out + " > " + fixture.dir + "/count.txt"), 0);
+    CHECK_EQ(fixture.read("count.txt"), std::string("3\n"));
+}
+
+TEST(shell_builtin_pipeline_larger_than_pipe) {
+    ShellFixture fixture;
+    fixture.shell->run_command("SECSHELL_TEST_BIG=" + std::string(100000, 'x'));
+    fixture.shell->run_command("export SECSHELL_TEST_BIG");
+    // env fills the pipe long before jobs would read it
+    CHECK_EQ(fixture.shell->run_command("env | jobs > " + fixture.dir + "/jobs.txt"), 0);
+    CHECK_EQ(fixture.shell->run_command("env | env | wc -c > " + fixture.dir + "/count.txt"), 0);
+    CHECK(atoi(fixture.read("count.txt").c_str()) > 100000);
+    fixture.shell->run_command("unset SECSHELL_TEST_BIG");
+}
+
+TEST(shell_batch_messages_are_plain) {
+    ShellFixture fixture;
+    std::string log = fixture.dir + "/stderr.txt";
+    int saved = dup(STDERR_FILENO);
+    int fd = open(log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    CHECK(saved != -1 && fd != -1);
+    dup2(fd, STDERR_FILENO);
+    close(fd);
+    fixture.shell->run_command("no-such-command");
+    dup2(saved, STDERR_FILENO);
+    close(saved);
+    CHECK_EQ(fixture.read("stderr.txt"), std::string("[ERROR] Command not permitted: no-such-command\n"));
+}
+
+TEST(shell_parse_arguments) {
+    ShellFixture fixture;
+    fixture.shell->run_command("export SECSHELL_TEST_WORD=expanded");
+    CHECK(fixture.shell->parse_arguments("echo 'a b' $SECSHELL_TEST_WORD | x") ==
+          std::vector<std::string>({"echo", "a b", "expanded", "|", "x"}));
+    fixture.shell->run_command("unset SECSHELL_TEST_WORD");
+}
+
+TEST(shell_glob_expansion) {
+    ShellFixture fixture;
+    for (const char* name : {"b.txt", "a.txt", "secret.key"}) std::ofstream(fixture.dir + "/" + name) << name;
+    std::string out = fixture.dir + "/out";
+    CHECK_EQ(fixture.shell->run_command("echo " + fixture.dir + "/*.txt > " + out), 0);
+    CHECK_EQ(fixture.read("out"), fixture.dir + "/a.txt " + fixture.dir + "/b.txt\n");
+    CHECK_EQ(fixture.shell->run_command("echo '" + fixture.dir + "/*.txt' x{1,2} > " + out), 0);
+    CHECK_EQ(fixture.read("out"), fixture.dir + "/*.txt x1 x2\n");
+    CHECK_EQ(fixture.shell->run_command("cat " + fixture.dir + "/a.* > " + fixture.dir + "/o*"), 0);
+    CHECK_EQ(fixture.read("out"), std::string("a.txt"));
+    CHECK_EQ(fixture.shell->run_command("echo x > " + fixture.dir + "/*.txt"), 1); // Ambiguous redirect
+    CHECK_EQ(fixture.shell->run_command("ls " + fixture.dir + "/*.txt > " + out), 0); // More words than were parsed
+    CHECK_EQ(fixture.read("out"), fixture.dir + "/a.txt\n" + fixture.dir + "/b.txt\n");
+
+    // The argument rules see the expanded names
+    std::ofstream(fixture.dir + "/.rules") << "deny cat path:" + fixture.dir + "/*.key\n";
+    CHECK_EQ(fixture.shell->run_command("cat " + fixture.dir + "/sec*"), 126);
+    CHECK_EQ(fixture.shell->run_command("cat '" + fixture.dir + "/sec*'"), 1); // Literal name, no such file
+}
+
+TEST(shell_services_units_are_not_options) {
+    ShellFixture fixture;
+    std::string stub = fixture.dir + "/systemctl";
+    std::ofstream(stub) << "#!/bin/sh\necho \"$@\" >> " << fixture.dir << "/calls.txt\n";
+    CHECK(chmod(stub.c_str(), 0755) == 0);
+    setenv("SECSHELL_SYSTEMCTL", stub.c_str(), 1);
+    fixture.shell.reset(new SecShell(fixture.dir + "/.blacklist", false));
+    unsetenv("SECSHELL_SYSTEMCTL");
+
+    std::string out = " > " + fixture.dir + "/out.txt";
+    CHECK_EQ(fixture.shell->run_command("services status web" + out), 0);
+    CHECK_EQ(fixture.shell->run_command("services status --now" + out), 2);
+    CHECK_EQ(fixture.shell->run_command("services status web -H" + out), 2);
+    CHECK_EQ(fixture.read("calls.txt"), std::string("status --no-pager -- web\n"));
+}
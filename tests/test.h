@@ -0,0 +1,88 @@
+#ifndef SECSHELL_TEST_H
+#define SECSHELL_TEST_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Minimal unit test harness: TEST registers a case, CHECK and CHECK_EQ
+// record a failure and carry on. tests/main.cpp runs every case, or only
+// those whose name contains the first argument.
+namespace test {
+
+struct Case {
+    const char* name;
+    std::function<void()> body;
+};
+
+inline std::vector<Case>& cases() {
+    static std::vector<Case> registered;
+    return registered;
+}
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+struct Registrar {
+    Registrar(const char* name, std::function<void()> body) { cases().push_back({name, std::move(body)}); }
+};
+
+inline void fail(const char* file, int line, const std::string& message) {
+    fprintf(stderr, "%s:%d: %s\n", file, line, message.c_str());
+    ++failures();
+}
+
+} // namespace test
+
+#define TEST_CONCAT_(a, b) a##b
+#define TEST_CONCAT(a, b) TEST_CONCAT_(a, b)
+
+#define TEST(name)                                                              \
+    static void name();                                                         \
+    static test::Registrar TEST_CONCAT(name, _registrar)(#name, name);          \
+    static void name()
+
+#define CHECK(condition)                                                        \
+    do {                                                                        \
+        if (!(condition)) test::fail(__FILE__, __LINE__, "CHECK(" #condition ") failed"); \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                              \
+    do {                                                                        \
+        auto actual_ = (actual);                                                \
+        auto expected_ = (expected);                                            \
+        if (!(actual_ == expected_)) {                                          \
+            test::fail(__FILE__, __LINE__, "CHECK_EQ(" #actual ", " #expected ") failed"); \
+        }                                                                       \
+    } while (0)
+
+namespace test {
+
+// A scratch directory under /tmp, removed with everything in it when the
+// fixture or case that owns it is done
+struct TempDir {
+    std::string dir;
+
+    explicit TempDir(const char* name = "secshell_test") {
+        std::string path = std::string("/tmp/") + name + ".XXXXXX";
+        dir = mkdtemp(&path[0]) ? path : "";
+        CHECK(!dir.empty());
+    }
+
+    ~TempDir() {
+        if (dir.empty()) return;
+        std::string cleanup = "rm -rf " + dir;
+        if (system(cleanup.c_str()) != 0) perror("rm");
+    }
+
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+};
+
+} // namespace test
+
+#endif
@@ -0,0 +1,65 @@
+#include "../src/variable_store.h"
+#include "test.h"
+
+namespace {
+
+std::vector<std::string> entries(char* const* envp) {
+    std::vector<std::string> result;
+    for (; *envp; ++envp) result.emplace_back(*envp);
+    return result;
+}
+
+} // namespace
+
+TEST(variable_store_import_and_get) {
+    char a[] = "SECSHELL_TEST_A=1", b[] = "SECSHELL_TEST_B=two=2", bad[] = "NOEQUALS";
+    char* env[] = {a, b, bad, nullptr};
+    VariableStore store;
+    store.import(env, "");
+    CHECK_EQ(std::string(store.get("SECSHELL_TEST_A")), std::string("1"));
+    CHECK_EQ(std::string(store.get("SECSHELL_TEST_B")), std::string("two=2"));
+    CHECK(store.get("NOEQUALS") == nullptr);
+    CHECK(entries(store.envp()) == std::vector<std::string>({"SECSHELL_TEST_A=1", "SECSHELL_TEST_B=two=2"}));
+}
+
+TEST(variable_store_allowlist) {
+    char path[] = "PATH=/usr/bin", secret[] = "SECSHELL_TEST_TOKEN=hunter2", lang[] = "LC_ALL=C";
+    char* env[] = {path, secret, lang, nullptr};
+    VariableStore store;
+    store.import(env, "PATH:LC_*");
+    CHECK(store.restricted());
+    CHECK(entries(store.envp()) == std::vector<std::string>({"LC_ALL=C", "PATH=/usr/bin"}));
+    // Refused exports stay shell-local but remain readable
+    CHECK(!store.export_name("SECSHELL_TEST_TOKEN"));
+    CHECK(!store.set("SECSHELL_TEST_OTHER", "x", true));
+    CHECK_EQ(std::string(store.get("SECSHELL_TEST_OTHER")), std::string("x"));
+    CHECK_EQ(entries(store.envp()).size(), 2u);
+    unsetenv("SECSHELL_TEST_OTHER");
+}
+
+TEST(variable_store_envp_cache) {
+    char* env[] = {nullptr};
+    VariableStore store;
+    store.import(env, "");
+    store.envp();
+    unsigned long rebuilds = store.rebuild_count();
+    store.set("SECSHELL_TEST_LOCAL", "1");
+    store.envp();
+    CHECK_EQ(store.rebuild_count(), rebuilds);   // Shell-local: cache still valid
+    store.set("SECSHELL_TEST_LOCAL", "2", true);
+    CHECK(entries(store.envp()) == std::vector<std::string>({"SECSHELL_TEST_LOCAL=2"}));
+    CHECK_EQ(store.rebuild_count(), rebuilds + 1);
+    CHECK_EQ(std::string(getenv("SECSHELL_TEST_LOCAL")), std::string("2"));
+    CHECK(store.unset("SECSHELL_TEST_LOCAL"));
+    CHECK(entries(store.envp()).empty());
+    CHECK(getenv("SECSHELL_TEST_LOCAL") == nullptr);
+    CHECK(!store.unset("SECSHELL_TEST_LOCAL"));
+}
+
+TEST(variable_store_valid_name) {
+    CHECK(VariableStore::valid_name("PATH"));
+    CHECK(VariableStore::valid_name("_x1"));
+    CHECK(!VariableStore::valid_name(""));
+    CHECK(!VariableStore::valid_name("1X"));
+    CHECK(!VariableStore::valid_name("A-B"));
+}
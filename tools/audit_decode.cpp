@@ -0,0 +1,128 @@
+// Offline decoder for SecShell audit logs (SECSHELL_AUDIT_LOG). Prints one
+// JSON object per record, oldest first, for each file given; rotated files
+// (log.1, log.2, ...) can be passed in any order and are decoded as given.
+//
+// Build and run from the repository root:
+//   g++ -O2 -o audit_decode tools/audit_decode.cpp src/secshell_core.cpp src/shell_*.cpp -lreadline -pthread
+//   ./audit_decode ~/.secshell_audit.5 ... ~/.secshell_audit
+#include "../src/secshell.h"
+
+#include <cstdio>
+#include <map>
+
+static void put_json_string(std::string& out, const std::string& value) {
+    out += '"';
+    for (unsigned char c : value) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            out += escape;
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+static const char* verdict_name(AuditLog::Verdict verdict) {
+    switch (verdict) {
+        case AuditLog::Allowed: return "allowed";
+        case AuditLog::Blacklisted: return "blacklisted";
+        case AuditLog::NotPermitted: return "not_permitted";
+        case AuditLog::Denied: return "denied";
+    }
+    return "unknown";
+}
+
+// Records carry only the uid; names are looked up once each
+static const std::string& user_name(uint32_t uid) {
+    static std::map<uint32_t, std::string> names;
+    auto it = names.find(uid);
+    if (it == names.end()) {
+        struct passwd* pw = getpwuid(uid);
+        it = names.emplace(uid, pw ? pw->pw_name : std::to_string(uid)).first;
+    }
+    return it->second;
+}
+
+static bool decode_file(const char* path, BufferedWriter& out) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1) {
+        fprintf(stderr, "audit_decode: %s: %s\n", path, strerror(errno));
+        if (fd != -1) close(fd);
+        return false;
+    }
+    size_t size = st.st_size;
+    void* map = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "audit_decode: %s: empty or unreadable\n", path);
+        return false;
+    }
+    const char* data = static_cast<const char*>(map);
+
+    AuditLog::Header header;
+    size_t pos = AuditLog::read_header(data, size, header);
+    bool ok = pos != 0 && header.version == AuditLog::VERSION;
+    if (!ok) fprintf(stderr, "audit_decode: %s: not a version %u audit log\n", path, AuditLog::VERSION);
+
+    AuditLog::Record record;
+    std::string line;
+    while (ok && pos < size) {
+        size_t next = AuditLog::read_record(data, size, pos, record);
+        if (next == 0) {
+            fprintf(stderr, "audit_decode: %s: truncated record at offset %zu\n", path, pos);
+            ok = false;
+            break;
+        }
+        pos = next;
+
+        char fields[256];
+        snprintf(fields, sizeof(fields),
+                 "{\"time\":%lld.%09lld,\"event\":\"%s\",\"uid\":%u,\"session\":%d",
+                 static_cast<long long>(record.time_ns / 1000000000), static_cast<long long>(record.time_ns % 1000000000),
+                 record.kind == AuditLog::Execution ? "execution" : "decision", record.uid, record.session);
+        line = fields;
+        if (record.kind == AuditLog::Decision) {
+            line += ",\"verdict\":\"";
+            line += verdict_name(record.verdict);
+            line += '"';
+        }
+        line += ",\"user\":";
+        put_json_string(line, user_name(record.uid));
+        if (record.kind == AuditLog::Execution) {
+            snprintf(fields, sizeof(fields), ",\"pid\":%d,\"status\":%d,\"wall_us\":%llu,\"cpu_us\":%llu",
+                     record.pid, record.status, static_cast<unsigned long long>(record.wall_us),
+                     static_cast<unsigned long long>(record.cpu_us));
+            line += fields;
+        }
+        line += ",\"cwd\":";
+        put_json_string(line, record.cwd);
+        line += ",\"argv\":[";
+        for (size_t i = 0; i < record.argv.size(); ++i) {
+            if (i) line += ',';
+            put_json_string(line, record.argv[i]);
+        }
+        line += "]}\n";
+        out << line;
+    }
+    munmap(map, size);
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <audit-log>...\n", argv[0]);
+        return 2;
+    }
+    BufferedWriter out(STDOUT_FILENO);
+    int status = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (!decode_file(argv[i], out)) status = 1;
+    }
+    return status;
+}
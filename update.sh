@@ -3,23 +3,23 @@
 # GitHub repository details
 REPO_OWNER="KaliforniaGator"
 REPO_NAME="SecShell"
-FILE_PATH="secshell.cpp"
 
-# GitHub API URL to fetch the file content
-GITHUB_API_URL="https://api.github.com/repos/$REPO_OWNER/$REPO_NAME/contents/$FILE_PATH"
+# GitHub API URL to fetch the source tree (secshell.cpp plus src/)
+GITHUB_API_URL="https://api.github.com/repos/$REPO_OWNER/$REPO_NAME/tarball"
+ARCHIVE="secshell-src.tar.gz"
 
 # Function to download using curl
 download_with_curl() {
-    curl -H "Accept: application/vnd.github.v3.raw" -o secshell.cpp "$GITHUB_API_URL"
+    curl -L -o "$ARCHIVE" "$GITHUB_API_URL"
 }
 
 # Function to download using wget
 download_with_wget() {
-    wget --header="Accept: application/vnd.github.v3.raw" -O secshell.cpp "$GITHUB_API_URL"
+    wget -O "$ARCHIVE" "$GITHUB_API_URL"
 }
 
 # Try to download using curl, fallback to wget if curl is not available
-echo "Downloading the latest version of secshell.cpp..."
+echo "Downloading the latest SecShell sources..."
 if command -v curl &> /dev/null; then
     download_with_curl
 elif command -v wget &> /dev/null; then
@@ -29,28 +29,34 @@ else
     exit 1
 fi
 
-# Check if the download was successful
-if [ $? -ne 0 ]; then
-    echo "Failed to download secshell.cpp. Please check your internet connection and the URL."
+# Check if the download was successful, then unpack over the current tree
+if [ $? -ne 0 ] || ! tar -xzf "$ARCHIVE" --strip-components=1; then
+    echo "Failed to download the SecShell sources. Please check your internet connection and the URL."
+    rm -f "$ARCHIVE"
     exit 1
 fi
+rm -f "$ARCHIVE"
 
-# Compile secshell.cpp using g++ or clang
-echo "Compiling secshell.cpp..."
-
-# Check if g++ is available
-if command -v g++ &> /dev/null; then
-    COMPILER="g++"
-# Check if clang is available
-elif command -v clang++ &> /dev/null; then
-    COMPILER="clang++"
+# Prefer CMake, which also builds audit_decode; otherwise compile directly
+echo "Compiling SecShell..."
+if command -v cmake &> /dev/null; then
+    cmake -S . -B build -DSECSHELL_BUILD_TESTS=OFF -DSECSHELL_BUILD_BENCHMARKS=OFF && \
+        cmake --build build && cp build/secshell secshell
 else
-    echo "Neither g++ nor clang++ found. Please install one of them to compile secshell.cpp."
-    exit 1
-fi
+    # Check if g++ is available
+    if command -v g++ &> /dev/null; then
+        COMPILER="g++"
+    # Check if clang is available
+    elif command -v clang++ &> /dev/null; then
+        COMPILER="clang++"
+    else
+        echo "Neither g++ nor clang++ found. Please install one of them to compile SecShell."
+        exit 1
+    fi
 
-# Compile the file
-$COMPILER secshell.cpp -o secshell -lreadline
+    # Compile the shell and its core library sources
+    $COMPILER -std=c++17 -O2 secshell.cpp src/secshell_core.cpp src/shell_*.cpp -o secshell -lreadline -pthread
+fi
 
 # Check if the compilation was successful
 if [ $? -eq 0 ]; then